@@ -0,0 +1,67 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// SPEC - https://man7.org/linux/man-pages/man2/getdents.2.html
+// SPEC - https://man7.org/linux/man-pages/man3/glob.3.html
+
+// Size of the buffer each getdents64 call fills, enough for a few hundred entries
+constexpr size_t BATCH_SCAN_DIRENT_BUFFER_SIZE = 32768;
+
+// Counts of a finished batch scan
+struct BatchScanStats
+{
+    uint64_t directories; // Directories walked
+    uint64_t files;       // Regular files seen
+    uint64_t elfFiles;    // Files with the ELF magic, handed to the scan function
+    uint64_t failures;    // ELF files the scan function threw on
+};
+
+// Runs a scan function over every ELF file named by a set of inputs. An input is a file, a directory tree, a glob
+// pattern, or @list, a file naming one input per line (@- for standard input). Directories are walked with raw
+// getdents64 calls relative to the parent's descriptor, using the entry type to avoid a stat per entry, and
+// symbolic links met during the walk are not followed. Each regular file becomes one pool task that first reads the
+// four magic bytes, so non-ELF files cost an open and a pread, and walking carries on while earlier files are being
+// parsed. The text returned by the scan function is written to the output as soon as the file is done, one file at
+// a time, so results stream in completion order; a file the scan function throws on gets an error line instead.
+// A scan function may split the phases of a large file over the same pool through a TaskGroup, letting the workers
+// that run out of files steal its subtasks.
+class BatchScanner
+{
+  public:
+    using ScanFunction = std::function<std::string(const std::string &path)>;
+
+    // Public Constructors/Destructors
+    BatchScanner(ThreadPool &pool, ScanFunction scanFunction, FILE *output = stdout);
+
+    void AddInput(const std::string &input);
+    BatchScanStats Finish();
+
+  private:
+    // Private Data Members
+    ThreadPool &_pool;
+    ScanFunction _scanFunction;
+    FILE *_output;
+    std::mutex _outputMutex;
+    std::atomic<uint64_t> _directories{0};
+    std::atomic<uint64_t> _files{0};
+    std::atomic<uint64_t> _elfFiles{0};
+    std::atomic<uint64_t> _failures{0};
+
+    // Private Helper Methods
+    void AddPath(const std::string &path);
+    void AddListFile(const std::string &listPath);
+    void WalkDirectory(int directoryFd, const std::string &path);
+    void SubmitFile(std::string path);
+    void ScanFile(const std::string &path);
+    void WriteOutput(const std::string &text);
+};
+
+std::string DescribeElfFile(const std::string &path);
+std::string DescribeElfHashes(const std::string &path, ThreadPool *pool);
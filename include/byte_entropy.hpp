@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// SPEC - https://people.math.harvard.edu/~ctm/home/text/others/shannon/entropy/entropy.pdf
+
+// Occurrences of each byte value
+using ByteHistogram = std::array<uint64_t, 256>;
+
+// Entropy of one window of a sliding-window scan
+struct EntropyWindow
+{
+    uint64_t offset; // Offset of the window's first byte within the scanned data
+    double entropy;  // Bits per byte, 0 to 8
+};
+
+ByteHistogram ComputeByteHistogram(std::span<const uint8_t> data);
+double ShannonEntropy(const ByteHistogram &histogram);
+uint64_t EstimateCompressedSize(const ByteHistogram &histogram);
+std::vector<EntropyWindow> SlidingWindowEntropy(std::span<const uint8_t> data, size_t windowSize, size_t stride);
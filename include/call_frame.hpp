@@ -0,0 +1,151 @@
+#pragma once
+
+#include "dwarf.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// SPEC - https://refspecs.linuxfoundation.org/LSB_5.0.0/LSB-Core-generic/LSB-Core-generic/ehframechpt.html
+// SPEC - https://dwarfstd.org/doc/DWARF5.pdf (6.4)
+
+// Pointer encodings of .eh_frame and .eh_frame_hdr, low nibble: value format
+constexpr uint8_t DW_EH_PE_absptr = 0x00;
+constexpr uint8_t DW_EH_PE_uleb128 = 0x01;
+constexpr uint8_t DW_EH_PE_udata2 = 0x02;
+constexpr uint8_t DW_EH_PE_udata4 = 0x03;
+constexpr uint8_t DW_EH_PE_udata8 = 0x04;
+constexpr uint8_t DW_EH_PE_sleb128 = 0x09;
+constexpr uint8_t DW_EH_PE_sdata2 = 0x0a;
+constexpr uint8_t DW_EH_PE_sdata4 = 0x0b;
+constexpr uint8_t DW_EH_PE_sdata8 = 0x0c;
+
+// Pointer encodings, high nibble: what the value is relative to
+constexpr uint8_t DW_EH_PE_pcrel = 0x10;
+constexpr uint8_t DW_EH_PE_textrel = 0x20;
+constexpr uint8_t DW_EH_PE_datarel = 0x30;
+constexpr uint8_t DW_EH_PE_funcrel = 0x40;
+constexpr uint8_t DW_EH_PE_aligned = 0x50;
+constexpr uint8_t DW_EH_PE_indirect = 0x80;
+constexpr uint8_t DW_EH_PE_omit = 0xff;
+
+// Call frame instructions with the operand in the low 6 bits
+constexpr uint8_t DW_CFA_advance_loc = 0x40;
+constexpr uint8_t DW_CFA_offset = 0x80;
+constexpr uint8_t DW_CFA_restore = 0xc0;
+
+// Call frame instructions
+constexpr uint8_t DW_CFA_nop = 0x00;
+constexpr uint8_t DW_CFA_set_loc = 0x01;
+constexpr uint8_t DW_CFA_advance_loc1 = 0x02;
+constexpr uint8_t DW_CFA_advance_loc2 = 0x03;
+constexpr uint8_t DW_CFA_advance_loc4 = 0x04;
+constexpr uint8_t DW_CFA_offset_extended = 0x05;
+constexpr uint8_t DW_CFA_restore_extended = 0x06;
+constexpr uint8_t DW_CFA_undefined = 0x07;
+constexpr uint8_t DW_CFA_same_value = 0x08;
+constexpr uint8_t DW_CFA_register = 0x09;
+constexpr uint8_t DW_CFA_remember_state = 0x0a;
+constexpr uint8_t DW_CFA_restore_state = 0x0b;
+constexpr uint8_t DW_CFA_def_cfa = 0x0c;
+constexpr uint8_t DW_CFA_def_cfa_register = 0x0d;
+constexpr uint8_t DW_CFA_def_cfa_offset = 0x0e;
+constexpr uint8_t DW_CFA_def_cfa_expression = 0x0f;
+constexpr uint8_t DW_CFA_expression = 0x10;
+constexpr uint8_t DW_CFA_offset_extended_sf = 0x11;
+constexpr uint8_t DW_CFA_def_cfa_sf = 0x12;
+constexpr uint8_t DW_CFA_def_cfa_offset_sf = 0x13;
+constexpr uint8_t DW_CFA_val_offset = 0x14;
+constexpr uint8_t DW_CFA_val_offset_sf = 0x15;
+constexpr uint8_t DW_CFA_val_expression = 0x16;
+constexpr uint8_t DW_CFA_GNU_args_size = 0x2e;
+constexpr uint8_t DW_CFA_GNU_negative_offset_extended = 0x2f;
+
+enum class CfiSectionType
+{
+    EhFrame,   // .eh_frame, loaded with the program and used for exception handling
+    DebugFrame // .debug_frame, DWARF call frame information
+};
+
+enum class CfiTableSource
+{
+    None,   // No call frame information
+    Header, // Binary search table of .eh_frame_hdr, used in place
+    Built   // Built by scanning every FDE
+};
+
+// Common Information Entry
+struct CfiCie
+{
+    uint64_t offset;                              // Offset of the entry in its section
+    uint8_t version;                              // CIE version, 1, 3 or 4
+    std::string_view augmentation;                // Augmentation string, "zR", "zPLR", ...
+    uint8_t addressSize;                          // Size of a target address
+    uint64_t codeAlignment;                       // Factor of advance_loc deltas
+    int64_t dataAlignment;                        // Factor of offset operands
+    uint64_t returnAddressRegister;               // Column holding the return address
+    uint8_t fdeEncoding;                          // DW_EH_PE_* of FDE addresses
+    uint8_t lsdaEncoding;                         // DW_EH_PE_* of the FDE language specific data pointer
+    uint64_t personality;                         // Personality routine, 0 if there is none
+    bool signalFrame;                             // 'S': frames of this CIE are signal handlers
+    std::span<const uint8_t> initialInstructions; // CFA instructions run before those of every FDE
+};
+
+// Frame Description Entry
+struct CfiFde
+{
+    uint64_t offset;                       // Offset of the entry in its section
+    uint64_t cieOffset;                    // Offset of its CIE in the same section
+    uint64_t pcBegin;                      // First address covered
+    uint64_t pcEnd;                        // First address past the covered range
+    uint64_t lsda;                         // Language specific data area, 0 if there is none
+    std::span<const uint8_t> instructions; // CFA instructions
+};
+
+// Start of a covered range and the FDE describing it
+struct CfiTableEntry
+{
+    uint64_t pc;
+    uint64_t fdeOffset; // Offset of the FDE in the frame section
+};
+
+// Call frame information of a file. PC lookups binary search the .eh_frame_hdr table directly from the mapping
+// when the file has one; otherwise, and for .debug_frame, an equivalent table is built by scanning the entries once.
+// Every FDE covers exactly one function, so the table also gives the function boundaries of stripped files.
+class CallFrameInfo
+{
+  public:
+    // Public Constructors/Destructors
+    explicit CallFrameInfo(const ElfHandler &elfHandler, CfiSectionType type = CfiSectionType::EhFrame);
+
+    CfiSectionType GetSectionType() const;
+    CfiTableSource GetTableSource() const;
+    size_t GetFdeCount() const;
+    std::optional<uint64_t> FindFdeOffset(uint64_t pc) const;
+    std::optional<CfiFde> FindFde(uint64_t pc, CfiCie *cie = nullptr) const;
+    CfiFde ReadFde(uint64_t offset, CfiCie *cie = nullptr) const;
+    CfiCie ReadCie(uint64_t offset) const;
+    uint64_t ReadLocation(DwarfReader &reader, std::span<const uint8_t> instructions, const CfiCie &cie) const;
+    std::vector<std::pair<uint64_t, uint64_t>> GetFunctionRanges() const;
+
+  private:
+    // Private Data Members
+    CfiSectionType _type;
+    uint8_t _addressSize;
+    std::span<const uint8_t> _frame; // .eh_frame or .debug_frame
+    uint64_t _frameAddress = 0;      // Virtual address of .eh_frame, for pcrel pointers
+    std::span<const uint8_t> _hdrTable;
+    uint64_t _hdrAddress = 0; // Virtual address of .eh_frame_hdr, the base of its datarel pointers
+    size_t _hdrCount = 0;
+    std::vector<CfiTableEntry> _table; // sorted by pc, when built
+    CfiTableSource _source = CfiTableSource::None;
+    std::shared_ptr<const DecompressedSection> _decompressed;
+
+    // Private Helper Methods
+    bool LoadHeaderTable(const ElfHandler &elfHandler, bool locateFrame);
+    void BuildTable();
+    uint64_t ReadEncodedPointer(DwarfReader &reader, uint8_t encoding, uint64_t sectionAddress,
+                                uint64_t dataAddress) const;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "code_functions.hpp"
+#include "elf_handler.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Number of functions listed by PrintFanIn unless told otherwise
+constexpr size_t DEFAULT_CALL_GRAPH_TOP = 20;
+
+// Direct call graph of an x86-64 executable or shared object. Every function is decoded linearly and its direct
+// calls, and its direct jumps leaving the function (tail calls), become edges to the function containing the target.
+// Edges are stored in compressed sparse row form in both directions, one edge per caller and callee pair with the
+// number of call sites behind it. Indirect transfers are not edges. Object files are not supported, their calls are
+// unresolved relocations.
+class CallGraph
+{
+  public:
+    // Public Constructors/Destructors
+    explicit CallGraph(const ElfHandler &elfHandler, ThreadPool *pool = nullptr);
+
+    const CodeFunctions &GetFunctions() const;
+    size_t GetEdgeCount() const;
+    size_t GetCallSiteCount() const;
+    std::span<const uint32_t> GetCallees(uint32_t function) const;
+    std::span<const uint32_t> GetCallSites(uint32_t function) const;
+    std::span<const uint32_t> GetCallers(uint32_t function) const;
+    void PrintFanIn(size_t limit = DEFAULT_CALL_GRAPH_TOP) const;
+
+  private:
+    // Private Data Members
+    CodeFunctions _functions;
+    std::vector<uint32_t> _calleeOffsets; // row n spans [_calleeOffsets[n], _calleeOffsets[n + 1]) of _callees
+    std::vector<uint32_t> _callees;       // sorted within each row
+    std::vector<uint32_t> _callSites;     // call sites behind each entry of _callees
+    std::vector<uint32_t> _callerOffsets; // row n spans [_callerOffsets[n], _callerOffsets[n + 1]) of _callers
+    std::vector<uint32_t> _callers;       // sorted within each row
+
+    // Private Helper Methods
+    void BuildEdges(const ElfHandler &elfHandler, ThreadPool *pool);
+    void BuildCallers();
+};
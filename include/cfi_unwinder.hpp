@@ -0,0 +1,160 @@
+#pragma once
+
+#include "call_frame.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Register columns tracked by the unwinder, DWARF numbering; enough for the general purpose registers and return
+// address column of x86, x86-64 and AArch64
+constexpr size_t CFI_REGISTER_COUNT = 33;
+
+// Default limit on the frames of an unwound stack
+constexpr size_t DEFAULT_MAX_UNWIND_FRAMES = 256;
+
+constexpr char UNWIND_SAMPLES_MAGIC[8] = {'E', 'X', 'P', 'S', 'M', 'P', 'L', 'S'};
+
+// Registers and stack captured by the profiler for one sample, perf_event style
+struct UnwindSample
+{
+    uint64_t pc;                                          // Program counter of the sampled thread
+    std::array<uint64_t, CFI_REGISTER_COUNT> registers{}; // Register values by DWARF register number
+    uint64_t validRegisters = 0;                          // Bit n set when registers[n] was captured
+    uint64_t stackAddress = 0;                            // Address of the first captured stack byte
+    std::span<const uint8_t> stack;                       // Stack bytes copied from the stack pointer upwards
+};
+
+enum class UnwindStopReason
+{
+    EndOfStack,     // The return address column is undefined, the outermost frame was reached
+    MaxFrames,      // The frame limit was reached
+    NoFrameInfo,    // No FDE covers the pc and the frame pointer chain could not be followed
+    InvalidCfa,     // The CFA register was not captured, or the stack did not grow towards the caller
+    StackExhausted, // A saved register lies outside the captured stack bytes
+    BadExpression   // A DWARF expression could not be evaluated
+};
+
+// Program counters of an unwound stack, innermost first
+struct UnwindResult
+{
+    std::vector<uint64_t> frames;
+    UnwindStopReason reason;
+};
+
+// How a register of the caller is recovered
+enum class CfiRuleType : uint8_t
+{
+    Undefined,    // Not recoverable
+    SameValue,    // Unchanged
+    Offset,       // Saved at CFA + value
+    ValOffset,    // Is CFA + value
+    Register,     // Held in register value
+    Expression,   // Saved at the address computed by expression
+    ValExpression // Is the value computed by expression
+};
+
+// Rule for one register column of a row
+struct CfiRegisterRule
+{
+    uint16_t column;
+    CfiRuleType type;
+    int64_t value;                       // Offset or register number
+    std::span<const uint8_t> expression; // DWARF expression of the expression rules
+};
+
+// Row of the unwind table: how to compute the CFA and the caller's registers for a range of addresses. Columns
+// without a rule keep their value.
+struct CfiRow
+{
+    uint64_t pcBegin;
+    uint64_t pcEnd;
+    uint16_t cfaRegister;                   // CFA = register + offset, unless cfaExpression is set
+    int64_t cfaOffset;
+    std::span<const uint8_t> cfaExpression; // CFA = value of the expression
+    uint32_t firstRule;                     // First of the row's entries in CfiFdeRows::rules
+    uint32_t ruleCount;
+};
+
+// Unwind table of one FDE, decoded once by running its CIE and FDE instructions
+struct CfiFdeRows
+{
+    uint64_t pcBegin;
+    uint64_t pcEnd;
+    uint64_t returnAddressColumn;
+    bool signalFrame;
+    std::vector<CfiRow> rows; // sorted by pc
+    std::vector<CfiRegisterRule> rules;
+};
+
+// Offline unwinder for sampled stacks of one binary. Decoded FDE tables are cached and shared between threads, so
+// large batches of samples mostly cost a table lookup per frame. Frames without an FDE fall back to the frame
+// pointer chain.
+class CfiUnwinder
+{
+  public:
+    // Public Constructors/Destructors
+    CfiUnwinder(const CallFrameInfo &callFrames, uint16_t machine, uint64_t loadBias = 0);
+    CfiUnwinder(const CfiUnwinder &) = delete;
+    CfiUnwinder &operator=(const CfiUnwinder &) = delete;
+
+    UnwindResult Unwind(const UnwindSample &sample, size_t maxFrames = DEFAULT_MAX_UNWIND_FRAMES);
+    std::vector<UnwindResult> UnwindBatch(std::span<const UnwindSample> samples, ThreadPool &pool,
+                                          size_t maxFrames = DEFAULT_MAX_UNWIND_FRAMES);
+    std::shared_ptr<const CfiFdeRows> GetRows(uint64_t fdeOffset);
+
+  private:
+    static constexpr size_t CACHE_SHARD_COUNT = 64;
+
+    struct CacheShard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::shared_ptr<const CfiFdeRows>> rows;
+    };
+
+    // Registers of the frame being unwound
+    struct RegisterState
+    {
+        std::array<uint64_t, CFI_REGISTER_COUNT> values;
+        uint64_t valid;
+    };
+
+    // Private Data Members
+    const CallFrameInfo &_callFrames;
+    uint64_t _loadBias;
+    uint8_t _addressSize;
+    uint16_t _stackPointer;
+    uint16_t _framePointer;
+    std::array<CacheShard, CACHE_SHARD_COUNT> _cache;
+
+    // Private Helper Methods
+    std::shared_ptr<const CfiFdeRows> DecodeRows(uint64_t fdeOffset) const;
+    bool ReadStack(const UnwindSample &sample, uint64_t address, uint64_t &value) const;
+    bool Evaluate(std::span<const uint8_t> expression, const UnwindSample &sample, const RegisterState &state,
+                  bool pushCfa, uint64_t cfa, uint64_t &result) const;
+};
+
+// Samples of a capture file, viewing its mapping. After UNWIND_SAMPLES_MAGIC each record holds the pc, the mask of
+// captured registers, one value per set bit from the lowest, then the address and size of the stack bytes followed by
+// the bytes; all fields are 64-bit little-endian, as in the PERF_SAMPLE_REGS_USER and PERF_SAMPLE_STACK_USER records.
+class UnwindSampleFile
+{
+  public:
+    // Public Constructors/Destructors
+    explicit UnwindSampleFile(const std::string &fileName);
+
+    const std::vector<UnwindSample> &GetSamples() const;
+
+  private:
+    // Private Data Members
+    MappedFile _file;
+    std::vector<UnwindSample> _samples;
+};
+
+void PrintUnwoundStacks(CfiUnwinder &unwinder, std::span<const UnwindSample> samples, ThreadPool &pool);
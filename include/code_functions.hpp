@@ -0,0 +1,57 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Functions are swept in batches of at least this many bytes when a pass over them runs in parallel
+constexpr size_t CODE_FUNCTION_BATCH_SIZE = 256 * 1024;
+
+// Where the function boundaries came from
+enum class FunctionSource
+{
+    None,      // No sized function symbols and no call frame information
+    Symbols,   // Sized STT_FUNC symbols of .symtab or, without call frame information either, .dynsym
+    CallFrames // FDE ranges of .eh_frame or .debug_frame, named from .dynsym where a symbol starts the range
+};
+
+// Function in an executable section
+struct CodeFunction
+{
+    uint64_t address;
+    uint64_t size;
+    uint32_t sectionIndex; // Section table index of the executable section holding the code
+    std::string name;      // Empty when the function is only known from its FDE
+};
+
+// Boundaries of the functions of a linked file, from the symbol tables or, in stripped files, the call frame
+// information. PLT stubs are functions of their own, named after their import. The code is read from the mapping of
+// the ElfHandler, which must outlive the list.
+class CodeFunctions
+{
+  public:
+    // Public Constructors/Destructors
+    explicit CodeFunctions(const ElfHandler &elfHandler);
+
+    FunctionSource GetSource() const;
+    const std::vector<CodeFunction> &GetFunctions() const;
+    std::optional<uint32_t> Find(uint64_t address) const;
+    std::span<const uint8_t> GetCode(uint32_t sectionIndex, uint64_t address, uint64_t size) const;
+    std::span<const uint8_t> GetCode(const CodeFunction &function) const;
+
+  private:
+    // Private Data Members
+    FunctionSource _source = FunctionSource::None;
+    std::vector<CodeFunction> _functions;              // sorted by address, without overlaps
+    std::vector<std::span<const uint8_t>> _sectionCode; // contents of every section, by section table index
+    std::vector<uint64_t> _sectionAddresses;            // address of every section, by section table index
+
+    // Private Helper Methods
+    void CollectFunctions(const ElfHandler &elfHandler);
+    void AddPltStubs(const ElfHandler &elfHandler);
+};
+
+const char *FunctionSourceName(FunctionSource source);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// SPEC - https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+// SPEC - https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf
+
+constexpr size_t SHA256_BLOCK_SIZE = 64;
+constexpr size_t SHA256_DIGEST_SIZE = 32;
+
+// Number of messages hashed side by side by the AVX2 SHA-256 kernel, one per 32-bit lane
+constexpr size_t SHA256_LANES = 8;
+
+// Buffers at least this large are hashed as separate tasks when a batch is spread over a thread pool
+constexpr size_t CONTENT_HASH_TASK_SIZE = 4 * 1024 * 1024;
+
+using Sha256Digest = std::array<uint8_t, SHA256_DIGEST_SIZE>;
+
+// Fingerprint of a byte range
+struct ContentHash
+{
+    uint64_t xxh3;       // XXH3 64-bit, seed 0, default secret
+    Sha256Digest sha256; // SHA-256
+};
+
+// Instruction set extensions the hash kernels can use, detected once at startup
+struct ContentHashFeatures
+{
+    bool avx2;   // 256-bit XXH3 accumulation and 8-lane SHA-256
+    bool shaNi;  // SHA-256 rounds in hardware
+};
+
+const ContentHashFeatures &GetContentHashFeatures();
+
+uint64_t Xxh3Hash64(std::span<const uint8_t> data);
+Sha256Digest Sha256Hash(std::span<const uint8_t> data);
+std::vector<Sha256Digest> Sha256HashMultiBuffer(std::span<const std::span<const uint8_t>> buffers);
+std::vector<ContentHash> HashBuffers(std::span<const std::span<const uint8_t>> buffers, ThreadPool *pool = nullptr);
+std::string FormatSha256(const Sha256Digest &digest);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// SPEC - https://sourceware.org/gdb/current/onlinedocs/gdb.html/Separate-Debug-Files.html
+
+constexpr char DEBUG_INDEX_MAGIC[8] = {'E', 'X', 'P', 'D', 'B', 'G', 'I', 'X'};
+constexpr uint32_t DEBUG_INDEX_VERSION = 1;
+constexpr size_t DEBUG_INDEX_MAX_BUILD_ID = 32;
+constexpr char DEFAULT_DEBUG_DIRECTORY[] = "/usr/lib/debug";
+
+// On disk layout of the persistent index. Every table is an array of fixed size records sorted for binary search,
+// so an opened index is used straight from the mapping without any decoding.
+typedef struct
+{
+    char magic[8];           // DEBUG_INDEX_MAGIC
+    uint32_t version;        // DEBUG_INDEX_VERSION
+    uint32_t reserved;       // Zero
+    uint64_t directoryCount; // Number of DebugIndexDirectoryEntry records
+    uint64_t directoryOffset;
+    uint64_t buildIdCount; // Number of DebugIndexBuildIdEntry records
+    uint64_t buildIdOffset;
+    uint64_t nameCount; // Number of DebugIndexNameEntry records
+    uint64_t nameOffset;
+    uint64_t stringsSize; // Size of the NUL terminated path pool
+    uint64_t stringsOffset;
+} DebugIndexHeader;
+
+// A directory visited while building the index, used to detect that the index is stale
+typedef struct
+{
+    uint32_t pathOffset; // Offset of the directory path in the string pool
+    uint32_t reserved;   // Zero
+    int64_t mtime;       // Modification time in nanoseconds when the index was built
+} DebugIndexDirectoryEntry;
+
+// Build-id to debug file, sorted by build-id bytes
+typedef struct
+{
+    uint8_t buildId[DEBUG_INDEX_MAX_BUILD_ID]; // Build-id, zero padded
+    uint32_t buildIdSize;                      // Number of meaningful bytes in buildId
+    uint32_t pathOffset;                       // Offset of the file path in the string pool
+} DebugIndexBuildIdEntry;
+
+// File name hash to debug file, sorted by hash, used to resolve .gnu_debuglink names
+typedef struct
+{
+    uint64_t nameHash;   // FNV-1a hash of the file's base name
+    uint32_t pathOffset; // Offset of the file path in the string pool
+    uint32_t reserved;   // Zero
+} DebugIndexNameEntry;
+
+// Resolves separate debug files by build-id and .gnu_debuglink. The configured directory trees are indexed once
+// into a persistent file that is memory mapped on later runs, so a lookup is a binary search plus a check that the
+// candidate still matches rather than a walk of the file system.
+class DebugFileLocator
+{
+  public:
+    // Public Constructors/Destructors
+    DebugFileLocator(std::vector<std::string> debugDirectories, std::string indexPath);
+
+    std::optional<std::string> FindDebugFile(const std::string &executable);
+    std::optional<std::string> FindByBuildId(std::span<const uint8_t> buildId);
+    std::optional<std::string> FindByDebugLink(const std::string &executable, const std::string &linkName,
+                                               uint32_t crc);
+    void RebuildIndex();
+
+    static std::string CacheDirectory();
+    static std::string DefaultIndexPath();
+    static uint32_t ComputeDebugLinkCrc(const std::string &fileName);
+
+  private:
+    // Private Data Members
+    std::vector<std::string> _debugDirectories;
+    std::string _indexPath;
+    std::unique_ptr<MappedFile> _index;
+    const DebugIndexHeader *_header = nullptr;
+
+    // Private Helper Methods
+    void OpenIndex();
+    bool LoadIndex();
+    bool IsIndexCurrent() const;
+    const char *IndexString(uint32_t offset) const;
+    std::span<const DebugIndexBuildIdEntry> BuildIdEntries() const;
+    std::span<const DebugIndexNameEntry> NameEntries() const;
+    std::span<const DebugIndexDirectoryEntry> DirectoryEntries() const;
+    bool MatchesBuildId(const std::string &fileName, std::span<const uint8_t> buildId) const;
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "section_decompressor.hpp"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// SPEC - https://dwarfstd.org/doc/DWARF5.pdf
+
+// Attribute forms
+constexpr uint16_t DW_FORM_addr = 0x01;
+constexpr uint16_t DW_FORM_block2 = 0x03;
+constexpr uint16_t DW_FORM_block4 = 0x04;
+constexpr uint16_t DW_FORM_data2 = 0x05;
+constexpr uint16_t DW_FORM_data4 = 0x06;
+constexpr uint16_t DW_FORM_data8 = 0x07;
+constexpr uint16_t DW_FORM_string = 0x08;
+constexpr uint16_t DW_FORM_block = 0x09;
+constexpr uint16_t DW_FORM_block1 = 0x0a;
+constexpr uint16_t DW_FORM_data1 = 0x0b;
+constexpr uint16_t DW_FORM_flag = 0x0c;
+constexpr uint16_t DW_FORM_sdata = 0x0d;
+constexpr uint16_t DW_FORM_strp = 0x0e;
+constexpr uint16_t DW_FORM_udata = 0x0f;
+constexpr uint16_t DW_FORM_ref_addr = 0x10;
+constexpr uint16_t DW_FORM_ref1 = 0x11;
+constexpr uint16_t DW_FORM_ref2 = 0x12;
+constexpr uint16_t DW_FORM_ref4 = 0x13;
+constexpr uint16_t DW_FORM_ref8 = 0x14;
+constexpr uint16_t DW_FORM_ref_udata = 0x15;
+constexpr uint16_t DW_FORM_indirect = 0x16;
+constexpr uint16_t DW_FORM_sec_offset = 0x17;
+constexpr uint16_t DW_FORM_exprloc = 0x18;
+constexpr uint16_t DW_FORM_flag_present = 0x19;
+constexpr uint16_t DW_FORM_strx = 0x1a;
+constexpr uint16_t DW_FORM_addrx = 0x1b;
+constexpr uint16_t DW_FORM_ref_sup4 = 0x1c;
+constexpr uint16_t DW_FORM_strp_sup = 0x1d;
+constexpr uint16_t DW_FORM_data16 = 0x1e;
+constexpr uint16_t DW_FORM_line_strp = 0x1f;
+constexpr uint16_t DW_FORM_ref_sig8 = 0x20;
+constexpr uint16_t DW_FORM_implicit_const = 0x21;
+constexpr uint16_t DW_FORM_loclistx = 0x22;
+constexpr uint16_t DW_FORM_rnglistx = 0x23;
+constexpr uint16_t DW_FORM_ref_sup8 = 0x24;
+constexpr uint16_t DW_FORM_strx1 = 0x25;
+constexpr uint16_t DW_FORM_strx2 = 0x26;
+constexpr uint16_t DW_FORM_strx3 = 0x27;
+constexpr uint16_t DW_FORM_strx4 = 0x28;
+constexpr uint16_t DW_FORM_addrx1 = 0x29;
+constexpr uint16_t DW_FORM_addrx2 = 0x2a;
+constexpr uint16_t DW_FORM_addrx3 = 0x2b;
+constexpr uint16_t DW_FORM_addrx4 = 0x2c;
+constexpr uint16_t DW_FORM_GNU_addr_index = 0x1f01;
+constexpr uint16_t DW_FORM_GNU_str_index = 0x1f02;
+constexpr uint16_t DW_FORM_GNU_ref_alt = 0x1f20;
+constexpr uint16_t DW_FORM_GNU_strp_alt = 0x1f21;
+
+// Unit types (DWARF 5)
+constexpr uint8_t DW_UT_compile = 0x01;
+constexpr uint8_t DW_UT_type = 0x02;
+constexpr uint8_t DW_UT_partial = 0x03;
+constexpr uint8_t DW_UT_skeleton = 0x04;
+constexpr uint8_t DW_UT_split_compile = 0x05;
+constexpr uint8_t DW_UT_split_type = 0x06;
+
+// Tags
+constexpr uint16_t DW_TAG_array_type = 0x01;
+constexpr uint16_t DW_TAG_class_type = 0x02;
+constexpr uint16_t DW_TAG_enumeration_type = 0x04;
+constexpr uint16_t DW_TAG_formal_parameter = 0x05;
+constexpr uint16_t DW_TAG_lexical_block = 0x0b;
+constexpr uint16_t DW_TAG_member = 0x0d;
+constexpr uint16_t DW_TAG_pointer_type = 0x0f;
+constexpr uint16_t DW_TAG_compile_unit = 0x11;
+constexpr uint16_t DW_TAG_structure_type = 0x13;
+constexpr uint16_t DW_TAG_typedef = 0x16;
+constexpr uint16_t DW_TAG_union_type = 0x17;
+constexpr uint16_t DW_TAG_inlined_subroutine = 0x1d;
+constexpr uint16_t DW_TAG_base_type = 0x24;
+constexpr uint16_t DW_TAG_subprogram = 0x2e;
+constexpr uint16_t DW_TAG_variable = 0x34;
+constexpr uint16_t DW_TAG_namespace = 0x39;
+constexpr uint16_t DW_TAG_partial_unit = 0x3c;
+constexpr uint16_t DW_TAG_type_unit = 0x41;
+constexpr uint16_t DW_TAG_skeleton_unit = 0x4a;
+
+// Attributes
+constexpr uint16_t DW_AT_sibling = 0x01;
+constexpr uint16_t DW_AT_name = 0x03;
+constexpr uint16_t DW_AT_stmt_list = 0x10;
+constexpr uint16_t DW_AT_low_pc = 0x11;
+constexpr uint16_t DW_AT_high_pc = 0x12;
+constexpr uint16_t DW_AT_language = 0x13;
+constexpr uint16_t DW_AT_comp_dir = 0x1b;
+constexpr uint16_t DW_AT_inline = 0x20;
+constexpr uint16_t DW_AT_producer = 0x25;
+constexpr uint16_t DW_AT_abstract_origin = 0x31;
+constexpr uint16_t DW_AT_declaration = 0x3c;
+constexpr uint16_t DW_AT_external = 0x3f;
+constexpr uint16_t DW_AT_specification = 0x47;
+constexpr uint16_t DW_AT_ranges = 0x55;
+constexpr uint16_t DW_AT_entry_pc = 0x52;
+constexpr uint16_t DW_AT_call_file = 0x58;
+constexpr uint16_t DW_AT_call_line = 0x59;
+constexpr uint16_t DW_AT_call_column = 0x57;
+constexpr uint16_t DW_AT_linkage_name = 0x6e;
+constexpr uint16_t DW_AT_dwo_name = 0x76;
+constexpr uint16_t DW_AT_str_offsets_base = 0x72;
+constexpr uint16_t DW_AT_addr_base = 0x73;
+constexpr uint16_t DW_AT_rnglists_base = 0x74;
+constexpr uint16_t DW_AT_MIPS_linkage_name = 0x2007;
+constexpr uint16_t DW_AT_GNU_dwo_name = 0x2130;
+constexpr uint16_t DW_AT_GNU_dwo_id = 0x2131;
+constexpr uint16_t DW_AT_GNU_ranges_base = 0x2132;
+constexpr uint16_t DW_AT_GNU_addr_base = 0x2133;
+
+// Range list entries (DWARF 5)
+constexpr uint8_t DW_RLE_end_of_list = 0x00;
+constexpr uint8_t DW_RLE_base_addressx = 0x01;
+constexpr uint8_t DW_RLE_startx_endx = 0x02;
+constexpr uint8_t DW_RLE_startx_length = 0x03;
+constexpr uint8_t DW_RLE_offset_pair = 0x04;
+constexpr uint8_t DW_RLE_base_address = 0x05;
+constexpr uint8_t DW_RLE_start_end = 0x06;
+constexpr uint8_t DW_RLE_start_length = 0x07;
+
+// Name index attributes (DWARF 5 .debug_names)
+constexpr uint16_t DW_IDX_compile_unit = 0x01;
+constexpr uint16_t DW_IDX_type_unit = 0x02;
+constexpr uint16_t DW_IDX_die_offset = 0x03;
+constexpr uint16_t DW_IDX_parent = 0x04;
+constexpr uint16_t DW_IDX_type_hash = 0x05;
+
+// Line number program standard opcodes
+constexpr uint8_t DW_LNS_copy = 0x01;
+constexpr uint8_t DW_LNS_advance_pc = 0x02;
+constexpr uint8_t DW_LNS_advance_line = 0x03;
+constexpr uint8_t DW_LNS_set_file = 0x04;
+constexpr uint8_t DW_LNS_set_column = 0x05;
+constexpr uint8_t DW_LNS_negate_stmt = 0x06;
+constexpr uint8_t DW_LNS_set_basic_block = 0x07;
+constexpr uint8_t DW_LNS_const_add_pc = 0x08;
+constexpr uint8_t DW_LNS_fixed_advance_pc = 0x09;
+constexpr uint8_t DW_LNS_set_prologue_end = 0x0a;
+constexpr uint8_t DW_LNS_set_epilogue_begin = 0x0b;
+constexpr uint8_t DW_LNS_set_isa = 0x0c;
+
+// Line number program extended opcodes
+constexpr uint8_t DW_LNE_end_sequence = 0x01;
+constexpr uint8_t DW_LNE_set_address = 0x02;
+constexpr uint8_t DW_LNE_define_file = 0x03;
+constexpr uint8_t DW_LNE_set_discriminator = 0x04;
+
+// Line number header entry formats (DWARF 5)
+constexpr uint16_t DW_LNCT_path = 0x1;
+constexpr uint16_t DW_LNCT_directory_index = 0x2;
+constexpr uint16_t DW_LNCT_timestamp = 0x3;
+constexpr uint16_t DW_LNCT_size = 0x4;
+constexpr uint16_t DW_LNCT_MD5 = 0x5;
+
+// Expression operations
+constexpr uint8_t DW_OP_addr = 0x03;
+constexpr uint8_t DW_OP_deref = 0x06;
+constexpr uint8_t DW_OP_const1u = 0x08;
+constexpr uint8_t DW_OP_const1s = 0x09;
+constexpr uint8_t DW_OP_const2u = 0x0a;
+constexpr uint8_t DW_OP_const2s = 0x0b;
+constexpr uint8_t DW_OP_const4u = 0x0c;
+constexpr uint8_t DW_OP_const4s = 0x0d;
+constexpr uint8_t DW_OP_const8u = 0x0e;
+constexpr uint8_t DW_OP_const8s = 0x0f;
+constexpr uint8_t DW_OP_constu = 0x10;
+constexpr uint8_t DW_OP_consts = 0x11;
+constexpr uint8_t DW_OP_dup = 0x12;
+constexpr uint8_t DW_OP_drop = 0x13;
+constexpr uint8_t DW_OP_over = 0x14;
+constexpr uint8_t DW_OP_pick = 0x15;
+constexpr uint8_t DW_OP_swap = 0x16;
+constexpr uint8_t DW_OP_rot = 0x17;
+constexpr uint8_t DW_OP_abs = 0x19;
+constexpr uint8_t DW_OP_and = 0x1a;
+constexpr uint8_t DW_OP_div = 0x1b;
+constexpr uint8_t DW_OP_minus = 0x1c;
+constexpr uint8_t DW_OP_mod = 0x1d;
+constexpr uint8_t DW_OP_mul = 0x1e;
+constexpr uint8_t DW_OP_neg = 0x1f;
+constexpr uint8_t DW_OP_not = 0x20;
+constexpr uint8_t DW_OP_or = 0x21;
+constexpr uint8_t DW_OP_plus = 0x22;
+constexpr uint8_t DW_OP_plus_uconst = 0x23;
+constexpr uint8_t DW_OP_shl = 0x24;
+constexpr uint8_t DW_OP_shr = 0x25;
+constexpr uint8_t DW_OP_shra = 0x26;
+constexpr uint8_t DW_OP_xor = 0x27;
+constexpr uint8_t DW_OP_bra = 0x28;
+constexpr uint8_t DW_OP_eq = 0x29;
+constexpr uint8_t DW_OP_ge = 0x2a;
+constexpr uint8_t DW_OP_gt = 0x2b;
+constexpr uint8_t DW_OP_le = 0x2c;
+constexpr uint8_t DW_OP_lt = 0x2d;
+constexpr uint8_t DW_OP_ne = 0x2e;
+constexpr uint8_t DW_OP_skip = 0x2f;
+constexpr uint8_t DW_OP_lit0 = 0x30;
+constexpr uint8_t DW_OP_lit31 = 0x4f;
+constexpr uint8_t DW_OP_reg0 = 0x50;
+constexpr uint8_t DW_OP_reg31 = 0x6f;
+constexpr uint8_t DW_OP_breg0 = 0x70;
+constexpr uint8_t DW_OP_breg31 = 0x8f;
+constexpr uint8_t DW_OP_regx = 0x90;
+constexpr uint8_t DW_OP_bregx = 0x92;
+constexpr uint8_t DW_OP_nop = 0x96;
+
+// Raw contents of the debug sections of a file. Empty spans stand for sections the file does not have.
+struct DwarfSections
+{
+    std::span<const uint8_t> info;       // .debug_info
+    std::span<const uint8_t> abbrev;     // .debug_abbrev
+    std::span<const uint8_t> line;       // .debug_line
+    std::span<const uint8_t> lineStr;    // .debug_line_str
+    std::span<const uint8_t> str;        // .debug_str
+    std::span<const uint8_t> strOffsets; // .debug_str_offsets
+    std::span<const uint8_t> addr;       // .debug_addr
+    std::span<const uint8_t> ranges;     // .debug_ranges
+    std::span<const uint8_t> rnglists;   // .debug_rnglists
+    std::span<const uint8_t> aranges;    // .debug_aranges
+    std::span<const uint8_t> names;      // .debug_names
+    std::span<const uint8_t> gdbIndex;   // .gdb_index
+
+    std::vector<std::shared_ptr<const DecompressedSection>> decompressed; // Keeps decompressed sections alive
+};
+
+DwarfSections LoadDwarfSections(const ElfHandler &elfHandler, ThreadPool *pool = nullptr);
+DwarfSections LoadDwarfSections(const ElfHandler &elfHandler, SectionDecompressor &decompressor,
+                                std::string_view suffix = {}, ThreadPool *pool = nullptr);
+
+// Bounds checked little-endian cursor over a DWARF section
+class DwarfReader
+{
+  public:
+    // Public Constructors/Destructors
+    DwarfReader() = default;
+    explicit DwarfReader(std::span<const uint8_t> data, uint64_t offset = 0);
+
+    uint64_t GetOffset() const;
+    void SetOffset(uint64_t offset);
+    uint64_t Remaining() const;
+    bool AtEnd() const;
+    std::span<const uint8_t> GetData() const;
+
+    uint8_t ReadU8();
+    uint16_t ReadU16();
+    uint32_t ReadU24();
+    uint32_t ReadU32();
+    uint64_t ReadU64();
+    uint64_t ReadUnsigned(uint8_t size);
+    uint64_t ReadULEB128();
+    int64_t ReadSLEB128();
+    std::string_view ReadCString();
+    uint64_t ReadUnitLength(bool &is64);
+    uint64_t ReadOffset(bool is64);
+    std::span<const uint8_t> ReadBytes(uint64_t size);
+    void Skip(uint64_t size);
+    void SkipForm(uint16_t form, uint8_t addressSize, bool is64, uint16_t version);
+
+  private:
+    // Private Data Members
+    std::span<const uint8_t> _data;
+    uint64_t _offset = 0;
+
+    // Private Helper Methods
+    void Require(uint64_t size) const;
+};
+
+std::string_view ReadDwarfString(std::span<const uint8_t> section, uint64_t offset);
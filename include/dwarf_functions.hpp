@@ -0,0 +1,104 @@
+#pragma once
+
+#include "dwarf_info.hpp"
+#include "split_dwarf.hpp"
+#include "thread_pool.hpp"
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+constexpr uint32_t DWARF_NO_INLINE = UINT32_MAX;
+
+// Function with code. Names point into the mapped debug sections.
+struct DwarfFunction
+{
+    std::string_view name;        // DW_AT_name, through DW_AT_specification/DW_AT_abstract_origin if needed
+    std::string_view linkageName; // DW_AT_linkage_name, empty for C
+    uint64_t dieOffset;           // Offset of the DW_TAG_subprogram in .debug_info
+    uint32_t firstInline;         // First of the function's entries in the unit's inline array
+    uint32_t inlineCount;         // Number of inline entries, nested calls included
+};
+
+// One address range of an inlined call. A call with several ranges has one entry per range.
+struct DwarfInlinedCall
+{
+    uint64_t low;
+    uint64_t high;
+    std::string_view name;        // Name of the inlined function
+    std::string_view linkageName; // Linkage name of the inlined function
+    uint32_t callFile;            // Line table file index of the call site
+    uint32_t callLine;            // Line of the call site
+    uint32_t callColumn;          // Column of the call site
+    uint32_t depth;               // 0 for calls inlined directly into the function
+    uint32_t parent;              // Entry of the enclosing inlined call, DWARF_NO_INLINE at depth 0
+};
+
+// Address range of a function
+struct DwarfFunctionRange
+{
+    uint64_t low;
+    uint64_t high;
+    uint32_t function; // Index in the unit's function array
+};
+
+// Functions and inlined call trees of a single compilation unit
+class DwarfUnitFunctions
+{
+  public:
+    // Public Constructors/Destructors
+    DwarfUnitFunctions() = default;
+    DwarfUnitFunctions(const DwarfSections &sections, std::span<const DwarfUnitHeader> units, size_t unit,
+                       DwarfAbbrevCache &abbrevs, const DwarfUnit *skeleton = nullptr);
+
+    uint64_t GetUnitOffset() const;
+    std::optional<uint64_t> GetStmtList() const;
+    std::string_view GetCompDir() const;
+    const std::vector<DwarfFunction> &GetFunctions() const;
+    const std::vector<DwarfInlinedCall> &GetInlinedCalls() const;
+    const DwarfFunction *FindFunction(uint64_t address) const;
+    const DwarfInlinedCall *FindInlinedCall(const DwarfFunction &function, uint64_t address) const;
+
+  private:
+    // Private Data Members
+    uint64_t _unitOffset = 0;
+    std::optional<uint64_t> _stmtList;
+    std::string_view _compDir;
+    std::vector<DwarfFunction> _functions;
+    std::vector<DwarfInlinedCall> _inlinedCalls;
+    std::vector<DwarfFunctionRange> _ranges; // sorted by low
+};
+
+// Functions of every unit of a file. Units are walked on first use, independently of each other, or all at once on
+// a thread pool; abbreviation tables are shared between the units and threads. Given a split DWARF resolver, skeleton
+// units are replaced by their split units from the .dwo files or .dwp package.
+class DwarfFunctionIndex
+{
+  public:
+    // Public Constructors/Destructors
+    explicit DwarfFunctionIndex(const DwarfSections &sections, SplitDwarfResolver *splitUnits = nullptr);
+
+    size_t GetUnitCount() const;
+    const DwarfUnitFunctions &GetUnit(size_t unit);
+    const DwarfUnitFunctions *GetUnitAtOffset(uint64_t unitOffset);
+    void Decode(const std::vector<uint64_t> &unitOffsets, ThreadPool &pool);
+    void DecodeAll(ThreadPool &pool);
+
+  private:
+    struct Unit
+    {
+        std::once_flag decoded;
+        std::unique_ptr<DwarfUnitFunctions> functions;
+    };
+
+    // Private Data Members
+    DwarfSections _sections;
+    DwarfAbbrevCache _abbrevs;
+    std::vector<DwarfUnitHeader> _headers;
+    std::unique_ptr<Unit[]> _units;
+    SplitDwarfResolver *_splitUnits;
+
+    // Private Helper Methods
+    size_t FindUnitIndex(uint64_t unitOffset) const;
+    std::unique_ptr<DwarfUnitFunctions> DecodeUnit(size_t unit);
+};
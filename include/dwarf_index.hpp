@@ -0,0 +1,149 @@
+#pragma once
+
+#include "dwarf.hpp"
+#include "dwarf_info.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// SPEC - https://dwarfstd.org/doc/DWARF5.pdf (6.1)
+// SPEC - https://sourceware.org/gdb/current/onlinedocs/gdb.html/Index-Section-Format.html
+
+constexpr char DWARF_INDEX_MAGIC[8] = {'E', 'X', 'P', 'D', 'W', 'F', 'I', 'X'};
+constexpr uint32_t DWARF_INDEX_VERSION = 1;
+constexpr uint32_t DWARF_INDEX_HAS_RANGES = 0x1; // The cache holds the address table
+constexpr uint32_t DWARF_INDEX_HAS_NAMES = 0x2;  // The cache holds the name table
+
+// On disk layout of a built index, cached per build-id. Like the debug file index every table is an array of fixed
+// size records, so a cached index is used straight from the mapping.
+typedef struct
+{
+    char magic[8];     // DWARF_INDEX_MAGIC
+    uint32_t version;  // DWARF_INDEX_VERSION
+    uint32_t flags;    // DWARF_INDEX_HAS_*
+    uint64_t infoSize; // Size of the .debug_info the index was built from
+    uint64_t rangeCount;
+    uint64_t rangeOffset;
+    uint64_t nameCount;
+    uint64_t nameOffset;
+    uint64_t stringsSize;
+    uint64_t stringsOffset;
+} DwarfIndexHeader;
+
+// Address range covered by a unit, sorted by low address
+typedef struct
+{
+    uint64_t low;
+    uint64_t high;
+    uint64_t unitOffset; // Offset of the unit in .debug_info
+} DwarfIndexRange;
+
+// Named DIE, sorted by hash
+typedef struct
+{
+    uint32_t hash;       // DWARF 5 name index (DJB) hash of the name
+    uint32_t nameOffset; // Offset of the name in the string pool
+    uint64_t unitOffset; // Offset of the unit in .debug_info
+    uint64_t dieOffset;  // Offset of the DIE in .debug_info
+} DwarfIndexName;
+
+// Where a table of a DwarfUnitIndex comes from
+enum class DwarfIndexSource
+{
+    None,       // Not looked up yet
+    Aranges,    // .debug_aranges, completed from unit DIEs where it misses units
+    DebugNames, // .debug_names
+    GdbIndex,   // .gdb_index
+    Built,      // Built from .debug_info
+    Cache       // A previously built index
+};
+
+// Unit (and DIE) for an address or a name
+struct DwarfNameMatch
+{
+    uint64_t unitOffset; // Offset of the unit in .debug_info
+    uint64_t dieOffset;  // Offset of the DIE in .debug_info, 0 if the table only records the unit
+};
+
+// Maps addresses and names to the compilation units that describe them, so only those units need decoding.
+// The acceleration tables of the file are used in place when present. Otherwise the equivalent table is built once
+// from .debug_info, one unit per pool task when given a pool, and, given a cache path, written there to be mapped by
+// later runs.
+class DwarfUnitIndex
+{
+  public:
+    // Public Constructors/Destructors
+    explicit DwarfUnitIndex(const DwarfSections &sections, std::string cachePath = {}, ThreadPool *pool = nullptr);
+
+    std::optional<uint64_t> FindUnit(uint64_t address);
+    std::vector<DwarfNameMatch> FindName(std::string_view name);
+    DwarfIndexSource GetAddressSource() const;
+    DwarfIndexSource GetNameSource() const;
+
+    static uint32_t HashName(std::string_view name);
+    static std::string DefaultCachePath(const std::string &buildIdHex);
+
+  private:
+    // Abbreviation of a .debug_names entry
+    struct NameAbbrev
+    {
+        uint64_t code;
+        uint16_t tag;
+        std::vector<std::pair<uint16_t, uint16_t>> attributes; // DW_IDX_*, DW_FORM_*
+    };
+
+    // A name index unit of .debug_names, offsets are relative to the section
+    struct NameIndex
+    {
+        bool is64;
+        uint32_t compUnitCount;
+        uint32_t bucketCount;
+        uint32_t nameCount;
+        uint64_t compUnitsOffset;
+        uint64_t bucketsOffset;
+        uint64_t hashesOffset;
+        uint64_t stringOffsetsOffset;
+        uint64_t entryOffsetsOffset;
+        uint64_t entryPoolOffset;
+        std::vector<NameAbbrev> abbrevs;
+    };
+
+    // Private Data Members
+    DwarfSections _sections;
+    std::string _cachePath;
+    ThreadPool *_pool;
+    DwarfAbbrevCache _abbrevs; // shared by the unit scans of both builds
+    std::unique_ptr<MappedFile> _cache;
+    std::mutex _cacheMutex;
+
+    std::once_flag _rangesBuilt;
+    DwarfIndexSource _addressSource = DwarfIndexSource::None;
+    std::vector<DwarfIndexRange> _rangeStorage;
+    std::span<const DwarfIndexRange> _ranges;
+
+    std::once_flag _namesBuilt;
+    DwarfIndexSource _nameSource = DwarfIndexSource::None;
+    std::vector<NameIndex> _nameIndexes;
+    std::vector<DwarfIndexName> _nameStorage;
+    std::vector<char> _stringStorage;
+    std::span<const DwarfIndexName> _names;
+    std::span<const char> _strings;
+
+    // Private Helper Methods
+    void LoadCache();
+    void SaveCache();
+    void BuildRanges();
+    void BuildNames();
+    std::vector<uint64_t> ParseAranges();
+    void ParseDebugNames();
+    void BuildRangesFromUnits(const std::vector<uint64_t> &unitOffsets);
+    void BuildNamesFromUnits();
+    std::vector<DwarfNameMatch> FindInDebugNames(std::string_view name) const;
+    std::vector<DwarfNameMatch> FindInGdbIndex(std::string_view name) const;
+    std::vector<DwarfNameMatch> FindInNameTable(std::string_view name) const;
+    bool ReadGdbIndexRanges();
+};
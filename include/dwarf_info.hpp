@@ -0,0 +1,152 @@
+#pragma once
+
+#include "dwarf.hpp"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Header of a unit in .debug_info
+struct DwarfUnitHeader
+{
+    uint64_t offset;       // Offset of the unit in .debug_info
+    uint64_t endOffset;    // First byte past the unit
+    uint64_t dieOffset;    // Offset of the unit DIE
+    uint64_t abbrevOffset; // Offset of the unit's abbreviations in .debug_abbrev
+    uint64_t signature;    // Type signature or DWO id, zero if the unit has none
+    uint16_t version;      // DWARF version
+    uint8_t unitType;      // DW_UT_*, DW_UT_compile for units before DWARF 5
+    uint8_t addressSize;   // Size of a target address
+    bool is64;             // Whether the unit uses the 64-bit DWARF format
+};
+
+DwarfUnitHeader ReadUnitHeader(std::span<const uint8_t> info, uint64_t offset);
+std::vector<DwarfUnitHeader> ReadUnitHeaders(std::span<const uint8_t> info);
+
+// Attribute specification of an abbreviation
+struct DwarfAbbrevAttribute
+{
+    uint16_t name;         // DW_AT_*
+    uint16_t form;         // DW_FORM_*
+    int64_t implicitConst; // Value of a DW_FORM_implicit_const attribute
+};
+
+// Abbreviation declaration, the shape shared by every DIE using its code
+struct DwarfAbbrev
+{
+    uint64_t code;
+    uint16_t tag;
+    bool hasChildren;
+    std::vector<DwarfAbbrevAttribute> attributes;
+};
+
+// Abbreviations of a unit. Compilers number the codes from 1 without gaps, so a lookup is an index; other
+// numberings fall back to a binary search.
+class DwarfAbbrevTable
+{
+  public:
+    // Public Constructors/Destructors
+    DwarfAbbrevTable() = default;
+    DwarfAbbrevTable(std::span<const uint8_t> abbrev, uint64_t offset);
+
+    const DwarfAbbrev *Find(uint64_t code) const;
+    size_t GetCount() const;
+
+  private:
+    // Private Data Members
+    std::vector<DwarfAbbrev> _abbrevs; // sorted by code
+    bool _dense = true;                // _abbrevs[i].code == i + 1
+};
+
+// Abbreviation tables of a file keyed by their .debug_abbrev offset. Units usually share tables (every unit of a
+// partially linked object, for example), so each table is decoded once and then used by every thread.
+class DwarfAbbrevCache
+{
+  public:
+    // Public Constructors/Destructors
+    explicit DwarfAbbrevCache(std::span<const uint8_t> abbrev);
+
+    const DwarfAbbrevTable &Get(uint64_t offset);
+
+  private:
+    struct Entry
+    {
+        std::once_flag decoded;
+        DwarfAbbrevTable table;
+    };
+
+    // Private Data Members
+    std::span<const uint8_t> _abbrev;
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, std::unique_ptr<Entry>> _tables;
+};
+
+// Attribute value as read from .debug_info. Values that need the unit to be interpreted (string offsets, address
+// indices) are kept raw and resolved through DwarfUnit.
+struct DwarfAttribute
+{
+    uint16_t name;                  // DW_AT_*
+    uint16_t form;                  // DW_FORM_*
+    uint64_t value;                 // Constant, address, index, section offset, or .debug_info offset for references
+    std::string_view string;        // DW_FORM_string
+    std::span<const uint8_t> block; // Block and exprloc forms
+};
+
+// Debugging information entry
+struct DwarfDie
+{
+    uint64_t offset;                       // Offset of the entry in .debug_info
+    const DwarfAbbrev *abbrev;             // nullptr for the null entry ending a list of children
+    std::vector<DwarfAttribute> attributes;
+
+    uint16_t GetTag() const;
+    bool HasChildren() const;
+    const DwarfAttribute *Find(uint16_t name) const;
+};
+
+// A unit of .debug_info together with the unit DIE attributes its other entries are resolved against. The sections
+// and the abbreviation table are referenced, not copied, and must outlive the unit. A split unit read from a .dwo
+// file or .dwp package takes its address bases, line table and compilation directory from its skeleton unit, which
+// must outlive it as well.
+class DwarfUnit
+{
+  public:
+    // Public Constructors/Destructors
+    DwarfUnit(const DwarfSections &sections, const DwarfUnitHeader &header, const DwarfAbbrevTable &abbrevs,
+              const DwarfUnit *skeleton = nullptr);
+
+    const DwarfUnitHeader &GetHeader() const;
+    const DwarfDie &GetUnitDie() const;
+    std::string_view GetName() const;
+    std::string_view GetCompDir() const;
+    std::optional<uint64_t> GetStmtList() const;
+    bool Contains(uint64_t infoOffset) const;
+
+    bool ReadDie(DwarfReader &reader, DwarfDie &die) const;
+    DwarfDie ReadDieAt(uint64_t offset) const;
+    std::string_view GetString(const DwarfAttribute &attribute) const;
+    std::optional<uint64_t> GetAddress(const DwarfAttribute &attribute) const;
+    std::vector<std::pair<uint64_t, uint64_t>> GetRanges(const DwarfDie &die) const;
+
+  private:
+    // Private Data Members
+    const DwarfSections &_sections;
+    DwarfUnitHeader _header;
+    const DwarfAbbrevTable &_abbrevs;
+    const DwarfUnit *_skeleton;
+    DwarfDie _unitDie;
+    uint64_t _baseAddress = 0;
+    uint64_t _strOffsetsBase = 0;
+    uint64_t _addrBase = 0;
+    uint64_t _rnglistsBase = 0;
+    uint64_t _rangesBase = 0; // DW_AT_GNU_ranges_base of the skeleton, added to split units' .debug_ranges offsets
+
+    // Private Helper Methods
+    DwarfAttribute ReadAttribute(DwarfReader &reader, const DwarfAbbrevAttribute &spec) const;
+    uint64_t ReadAddressIndex(uint64_t index) const;
+    void ReadRangeList(uint64_t offset, std::vector<std::pair<uint64_t, uint64_t>> &ranges) const;
+    void ReadRangeListV5(uint64_t offset, std::vector<std::pair<uint64_t, uint64_t>> &ranges) const;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "dwarf.hpp"
+#include "thread_pool.hpp"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Number of rows between two fully stored rows of a DwarfLineTable
+constexpr size_t DWARF_LINE_CHECKPOINT_INTERVAL = 16;
+
+// A row of the line number matrix
+struct DwarfLineRow
+{
+    uint64_t address;  // Address of the first instruction of the row
+    uint32_t file;     // Index into the file name table
+    uint32_t line;     // Source line, 0 when the instruction has no line
+    uint32_t column;   // Source column, 0 for "unknown"
+    bool isStmt;       // Recommended breakpoint location
+    bool endSequence;  // First address past the end of a sequence
+};
+
+// Source location of an address
+struct DwarfLineInfo
+{
+    std::string fileName;
+    uint32_t line;
+    uint32_t column;
+};
+
+// Line table of a single line number program. Rows from every sequence are sorted by address and kept delta
+// encoded, with every DWARF_LINE_CHECKPOINT_INTERVAL-th row stored in full in a checkpoint array. A lookup binary
+// searches the checkpoints and decodes at most one block of rows.
+class DwarfLineTable
+{
+  public:
+    // Public Constructors/Destructors
+    DwarfLineTable() = default;
+    DwarfLineTable(const DwarfSections &sections, uint64_t offset, std::string_view compDir = {});
+
+    uint64_t GetOffset() const;
+    uint16_t GetVersion() const;
+    size_t GetRowCount() const;
+    size_t GetEncodedSize() const;
+    const std::vector<std::pair<uint64_t, uint64_t>> &GetSequenceRanges() const;
+    std::optional<DwarfLineRow> Lookup(uint64_t address) const;
+    const std::string &GetFileName(uint32_t file) const;
+
+  private:
+    // Full row stored for every block, the following rows of the block are deltas against it
+    struct Checkpoint
+    {
+        uint64_t address;
+        uint32_t encodedOffset; // Offset of the next row in _encoded
+        uint32_t file;
+        uint32_t line;
+        uint32_t column;
+        bool isStmt;
+        bool endSequence;
+    };
+
+    // Private Data Members
+    uint64_t _offset = 0;
+    uint16_t _version = 0;
+    size_t _rowCount = 0;
+    std::vector<Checkpoint> _checkpoints;
+    std::vector<uint8_t> _encoded;
+    std::vector<std::pair<uint64_t, uint64_t>> _sequenceRanges; // [low, high) of every sequence, sorted
+    std::vector<std::string> _fileNames;
+
+    // Private Helper Methods
+    void ParseFileEntries(DwarfReader &reader, const DwarfSections &sections, bool is64, uint8_t addressSize,
+                          std::vector<std::string> &directories, bool isDirectoryTable);
+    void Encode(std::vector<std::vector<DwarfLineRow>> &sequences);
+    static void DecodeRow(const uint8_t *&cursor, DwarfLineRow &row);
+};
+
+// All line number programs of a file. Programs are only decoded when first asked for, independently of each other,
+// so resolving an address through a known DW_AT_stmt_list offset decodes a single compilation unit.
+class DwarfLineIndex
+{
+  public:
+    // Public Constructors/Destructors
+    explicit DwarfLineIndex(const DwarfSections &sections, ThreadPool *pool = nullptr);
+
+    size_t GetUnitCount() const;
+    uint64_t GetUnitOffset(size_t unit) const;
+    const DwarfLineTable &GetTable(size_t unit, std::string_view compDir = {});
+    const DwarfLineTable *GetTableAtOffset(uint64_t offset, std::string_view compDir = {});
+    void DecodeAll();
+    std::optional<DwarfLineInfo> Lookup(uint64_t address);
+    std::optional<DwarfLineInfo> Lookup(uint64_t address, uint64_t stmtList, std::string_view compDir = {});
+
+  private:
+    struct Unit
+    {
+        uint64_t offset;
+        std::once_flag decoded;
+        std::unique_ptr<DwarfLineTable> table;
+    };
+
+    struct UnitRange
+    {
+        uint64_t low;
+        uint64_t high;
+        size_t unit;
+    };
+
+    // Private Data Members
+    DwarfSections _sections;
+    ThreadPool *_pool;
+    size_t _unitCount = 0;
+    std::unique_ptr<Unit[]> _units;
+    std::once_flag _rangesBuilt;
+    std::vector<UnitRange> _ranges;
+
+    // Private Helper Methods
+    static std::optional<DwarfLineInfo> LookupInTable(const DwarfLineTable &table, uint64_t address);
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "elf_segments.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Level of a file an item of a diff belongs to
+enum class DiffLevel
+{
+    Segment,
+    Section,
+    Symbol
+};
+
+// How an item differs between the two files
+enum class DiffChange
+{
+    Added,
+    Removed,
+    Resized,       // The contents may have changed too
+    ContentChanged // Same size, different hash
+};
+
+// ELF header field whose value differs between the two files
+struct ElfHeaderChange
+{
+    std::string field;
+    uint64_t oldValue;
+    uint64_t newValue;
+};
+
+// Segment, section or symbol present in only one file, or different in the two
+struct ElfDiffEntry
+{
+    DiffLevel level;
+    DiffChange change;
+    std::string name; // Segment name from SegmentNames such as LOAD[1], section or symbol name
+    uint64_t oldSize; // Zero when added
+    uint64_t newSize; // Zero when removed
+};
+
+// Structural comparison of two ELF files. Segments are matched by type and position among the segments of that
+// type, sections and symbols by name, with the nth of several items sharing a name matched to the nth in the other
+// file. Matching is a hash join: the old file's items go into a hash table the new file's items are looked up in.
+// Contents are compared by XXH3 hash of each item's file bytes, and only for items whose size did not change.
+// Symbols are the sized function and object symbols of .symtab, or of .dynsym when .symtab is missing.
+class ElfDiff
+{
+  public:
+    // Public Constructors/Destructors
+    ElfDiff(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+            const ElfSegments &newSegments, ThreadPool *pool = nullptr);
+
+    const std::vector<ElfHeaderChange> &GetHeaderChanges() const;
+    const std::vector<ElfDiffEntry> &GetEntries() const;
+    void PrintDiff(size_t limit) const;
+
+  private:
+    // Private Data Members
+    std::vector<ElfHeaderChange> _headerChanges;
+    std::vector<ElfDiffEntry> _entries; // By level, then by growth, largest first
+    uint64_t _oldSizes[3] = {};         // Total size of the items of each level
+    uint64_t _newSizes[3] = {};
+
+    // Private Helper Methods
+    void DiffHeaders(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+                     const ElfSegments &newSegments);
+    void DiffSegments(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+                      const ElfSegments &newSegments, ThreadPool *pool);
+    void DiffSections(const ElfHandler &oldHandler, const ElfHandler &newHandler, ThreadPool *pool);
+    void DiffSymbols(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+                     const ElfSegments &newSegments, ThreadPool *pool);
+};
+
+const char *DiffLevelName(DiffLevel level);
+const char *DiffChangeName(DiffChange change);
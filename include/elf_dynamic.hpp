@@ -0,0 +1,128 @@
+#pragma once
+
+#include "elf_segments.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// SPEC - https://refspecs.linuxfoundation.org/elf/gabi4+/ch5.dynamic.html
+//        https://flapenguin.me/elf-dt-gnu-hash
+
+// The hash tables, .dynsym and .dynstr are read with one pread when they span at most this many bytes
+constexpr size_t DYNAMIC_TABLES_READ_SIZE = 64 * 1024;
+
+// Larger string tables are read on demand in chunks of this size
+constexpr size_t DYNAMIC_STRING_CHUNK_SIZE = 4096;
+
+// Dynamic section tags
+constexpr int64_t DT_NULL = 0;              // Marks end of dynamic section
+constexpr int64_t DT_NEEDED = 1;            // Name of needed library
+constexpr int64_t DT_PLTGOT = 3;            // Processor defined value
+constexpr int64_t DT_HASH = 4;              // Address of symbol hash table
+constexpr int64_t DT_STRTAB = 5;            // Address of string table
+constexpr int64_t DT_SYMTAB = 6;            // Address of symbol table
+constexpr int64_t DT_RELA = 7;              // Address of Rela relocs
+constexpr int64_t DT_STRSZ = 10;            // Size of string table
+constexpr int64_t DT_SYMENT = 11;           // Size of one symbol table entry
+constexpr int64_t DT_INIT = 12;             // Address of init function
+constexpr int64_t DT_FINI = 13;             // Address of termination function
+constexpr int64_t DT_SONAME = 14;           // Name of shared object
+constexpr int64_t DT_RPATH = 15;            // Library search path (deprecated)
+constexpr int64_t DT_REL = 17;              // Address of Rel relocs
+constexpr int64_t DT_TEXTREL = 22;          // Reloc might modify .text
+constexpr int64_t DT_JMPREL = 23;           // Address of PLT relocs
+constexpr int64_t DT_BIND_NOW = 24;         // Process relocations of object
+constexpr int64_t DT_RUNPATH = 29;          // Library search path
+constexpr int64_t DT_FLAGS = 30;            // Flags for the object being loaded
+constexpr int64_t DT_GNU_HASH = 0x6ffffef5; // GNU-style hash table
+constexpr int64_t DT_VERSYM = 0x6ffffff0;   // Address of the symbol version table
+constexpr int64_t DT_FLAGS_1 = 0x6ffffffb;  // State flags
+constexpr int64_t DT_VERDEF = 0x6ffffffc;   // Address of version definition table
+constexpr int64_t DT_VERNEED = 0x6ffffffe;  // Address of table with needed versions
+
+typedef struct DynamicFlags
+{
+    static constexpr uint64_t DF_ORIGIN = 0x1;      // Object may use DF_ORIGIN
+    static constexpr uint64_t DF_SYMBOLIC = 0x2;    // Symbol resolutions starts here
+    static constexpr uint64_t DF_TEXTREL = 0x4;     // Object contains text relocations
+    static constexpr uint64_t DF_BIND_NOW = 0x8;    // No lazy binding for this object
+    static constexpr uint64_t DF_1_NOW = 0x1;       // Set RTLD_NOW for this object
+    static constexpr uint64_t DF_1_PIE = 0x8000000; // Object is a position independent executable
+} DynamicFlags;
+
+// 32bit dynamic section entry
+typedef struct
+{
+    int32_t d_tag;  // Dynamic entry type
+    uint32_t d_val; // Integer value or address
+} Elf32Dyn;
+
+// 64bit dynamic section entry
+typedef struct
+{
+    int64_t d_tag;  // Dynamic entry type
+    uint64_t d_val; // Integer value or address
+} Elf64Dyn;
+
+// Class independent view of a dynamic section entry
+struct ElfDynamicEntry
+{
+    int64_t tag;
+    uint64_t value;
+};
+
+// Entry of the dynamic symbol table; the name views the dynamic string table
+struct ElfDynamicSymbol
+{
+    std::string_view name;
+    uint64_t value;
+    uint64_t size;
+    uint8_t info;          // Type and binding
+    uint16_t sectionIndex; // SHN_UNDEF for imports
+};
+
+using DynamicSymbolCallback = std::function<void(const ElfDynamicSymbol &)>;
+
+// Dynamic section of a file and the tables it points at, read through the program headers alone, as the dynamic
+// loader sees them. Section headers, .symtab and .strtab are never touched; the size of .dynsym comes from DT_HASH
+// or DT_GNU_HASH, and from the address of the table that follows it when DT_GNU_HASH does not cover the imports.
+// Small tables are read with a single pread; on large libraries .dynstr is read in chunks as names are looked up, so
+// walking the imports of a binary exporting thousands of symbols skips most of it. Not safe to use concurrently.
+class ElfDynamic
+{
+  public:
+    // Public Constructors/Destructors
+    explicit ElfDynamic(const ElfSegments &segments);
+
+    bool IsPresent() const;
+    const std::vector<ElfDynamicEntry> &GetEntries() const;
+    std::optional<uint64_t> GetValue(int64_t tag) const;
+    std::vector<std::string_view> GetStrings(int64_t tag) const;
+    size_t GetSymbolCount() const;
+    void ForEachSymbol(const DynamicSymbolCallback &callback) const;
+    void ForEachImport(const DynamicSymbolCallback &callback) const;
+
+  private:
+    // Private Data Members
+    const ElfSegments &_segments;
+    std::vector<ElfDynamicEntry> _entries;
+    uint64_t _stringsAddress = 0;
+    uint64_t _stringsSize = 0;
+    std::span<const uint8_t> _tables; // Hash tables, .dynsym and .dynstr, when read as one range
+    uint64_t _tablesAddress = 0;
+    mutable std::unordered_map<uint64_t, std::span<const uint8_t>> _stringChunks; // by chunk index
+
+    // Private Helper Methods
+    template <typename ElfDyn> void ReadEntries(std::span<const uint8_t> data);
+    void ReadTables(uint64_t strtab, uint64_t strsz);
+    std::span<const uint8_t> ReadVirtual(uint64_t vaddr, uint64_t size) const;
+    std::span<const uint8_t> ReadVirtualAvailable(uint64_t vaddr, uint64_t maxSize) const;
+    std::string_view GetString(uint64_t offset) const;
+    size_t CountGnuHashSymbols(uint64_t vaddr) const;
+    size_t CountSymbolsBeforeNextTable(uint64_t symtab, uint64_t entrySize) const;
+    template <typename ElfSym> void ReadSymbols(const DynamicSymbolCallback &callback, bool importsOnly) const;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "byte_entropy.hpp"
+#include "elf_regions.hpp"
+#include "thread_pool.hpp"
+#include <string>
+#include <vector>
+
+// Entropy above this many bits per byte suggests compressed, packed or encrypted data
+constexpr double HIGH_ENTROPY_THRESHOLD = 7.2;
+
+// Byte distribution of one section or segment
+struct ElfRegionEntropy
+{
+    ElfRegionKind kind;
+    std::string name;
+    uint64_t offset;
+    uint64_t size;
+    ByteHistogram histogram;
+    double entropy;                     // Bits per byte
+    uint64_t estimatedSize;             // Order-0 estimate of the compressed size
+    std::vector<EntropyWindow> windows; // Offsets relative to the region; empty unless a window size was given
+};
+
+// Entropy and compressibility profile of every section and segment of a file, read from the file mapping. Regions
+// are profiled in parallel when a pool is given.
+class ElfEntropyProfile
+{
+  public:
+    // Public Constructors/Destructors
+    ElfEntropyProfile(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool = nullptr,
+                      size_t windowSize = 0, size_t stride = 0);
+
+    const std::vector<ElfRegionEntropy> &GetRegions() const;
+    void PrintProfile() const;
+
+  private:
+    // Private Data Members
+    std::vector<ElfRegionEntropy> _regions;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "content_hash.hpp"
+#include "elf_regions.hpp"
+#include "thread_pool.hpp"
+#include <string>
+#include <vector>
+
+// Content hashes of one section or segment
+struct ElfRegionHash
+{
+    ElfRegionKind kind;
+    std::string name; // Section name, or segment name from SegmentNames such as LOAD[1]
+    uint64_t offset;  // File offset of the hashed bytes
+    uint64_t size;    // Number of hashed bytes; zero for SHT_NOBITS sections
+    ContentHash hash;
+};
+
+// Per-section and per-segment fingerprints of a file, for finding identical code and data across binaries. Every
+// region is hashed straight from the file mapping as one batch, so the SHA-256 digests of the many small sections
+// are computed side by side by the multi-buffer kernel; regions covering the same bytes are hashed once.
+class ElfFingerprint
+{
+  public:
+    // Public Constructors/Destructors
+    ElfFingerprint(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool = nullptr);
+
+    const std::vector<ElfRegionHash> &GetRegions() const;
+    void PrintHashes() const;
+
+  private:
+    // Private Data Members
+    std::vector<ElfRegionHash> _regions;
+};
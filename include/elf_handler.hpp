@@ -1,11 +1,14 @@
 #pragma once
 
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
 #include <array>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
 #include <map>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <variant>
 #include <vector>
 
@@ -113,6 +116,25 @@ enum class ElfOsABI
     ELFOSABI_STANDALONE = 255 // Standalone (embedded) application
 };
 
+enum class ElfObjectType
+{
+    ET_NONE = 0, // No file type
+    ET_REL = 1,  // Relocatable file
+    ET_EXEC = 2, // Executable file
+    ET_DYN = 3,  // Shared object file
+    ET_CORE = 4  // Core file
+};
+
+enum class ElfMachine
+{
+    EM_NONE = 0,      // No machine
+    EM_386 = 3,       // Intel 80386
+    EM_ARM = 40,      // ARM
+    EM_X86_64 = 62,   // AMD x86-64
+    EM_AARCH64 = 183, // ARM AARCH64
+    EM_RISCV = 243    // RISC-V
+};
+
 enum class ProgramHeaderType
 {
     PT_NULL = 0,    // Unused entry
@@ -125,6 +147,11 @@ enum class ProgramHeaderType
     PT_TLS = 7,     // The thread-local storage template
     PT_OS = 8,      // operating system-specific pt entry type
     PT_OROC = 9,    // processor-specific program hdr entry type
+
+    PT_GNU_EH_FRAME = 0x6474e550, // GCC .eh_frame_hdr segment
+    PT_GNU_STACK = 0x6474e551,    // Indicates stack executability
+    PT_GNU_RELRO = 0x6474e552,    // Read-only after relocation
+    PT_GNU_PROPERTY = 0x6474e553, // GNU property notes for linker and run-time loaders
 };
 
 typedef struct ProgramHeaderFlags
@@ -195,6 +222,7 @@ typedef struct SectionHeaderFlags
     static constexpr uint64_t SHF_OS_NONCONFORMING = 0x100; // Non-standard OS specific handling required
     static constexpr uint64_t SHF_GROUP = 0x200;            // Section is member of a group
     static constexpr uint64_t SHF_TLS = 0x400;              // Section hold thread-local data
+    static constexpr uint64_t SHF_COMPRESSED = 0x800;       // Section with compressed data
     static constexpr uint64_t SHF_MASKOS = 0x0ff00000;      // OS-specific
     static constexpr uint64_t SHF_MASKPROC = 0xf0000000;    // Processor-specific
     static constexpr uint64_t SHF_ORDERED = 0x4000000;      // Special ordering requirement (Solaris)
@@ -231,6 +259,29 @@ typedef struct
     Elf64Addr sh_entsize;   // Entry size if section holds table
 } Elf64Shdr;
 
+enum class ElfCompressionType
+{
+    ELFCOMPRESS_ZLIB = 1, // zlib/deflate
+    ELFCOMPRESS_ZSTD = 2  // Zstandard
+};
+
+// 32bit ELF compression header, at the start of every SHF_COMPRESSED section
+typedef struct
+{
+    ElfWord ch_type;      // Compression format
+    ElfWord ch_size;      // Uncompressed data size
+    ElfWord ch_addralign; // Uncompressed data alignment
+} Elf32Chdr;
+
+// 64bit ELF compression header, at the start of every SHF_COMPRESSED section
+typedef struct
+{
+    ElfWord ch_type;        // Compression format
+    ElfWord ch_reserved;    // Padding
+    Elf64Addr ch_size;      // Uncompressed data size
+    Elf64Addr ch_addralign; // Uncompressed data alignment
+} Elf64Chdr;
+
 // 32bit ELF symbol table entry
 typedef struct
 {
@@ -253,20 +304,124 @@ typedef struct
     Elf64Addr st_size;      // Symbol size
 } Elf64Sym;
 
+// 32bit ELF relocation entry with addend
+typedef struct
+{
+    Elf32Addr r_offset; // Location to relocate
+    ElfWord r_info;     // Symbol index and relocation type
+    int32_t r_addend;   // Constant addend
+} Elf32Rela;
+
+// 64bit ELF relocation entry with addend
+typedef struct
+{
+    Elf64Addr r_offset; // Location to relocate
+    uint64_t r_info;    // Symbol index (high 32 bits) and relocation type (low 32 bits)
+    int64_t r_addend;   // Constant addend
+} Elf64Rela;
+
+// x86-64 relocation types binding a GOT slot to a symbol
+constexpr uint32_t R_X86_64_GLOB_DAT = 6;  // GOT entry of a data or function address
+constexpr uint32_t R_X86_64_JUMP_SLOT = 7; // GOT entry of a lazily bound PLT target
+
+// Class independent view of a section header
+struct ElfSection
+{
+    std::string name;   // Section name
+    uint32_t index;     // Index in the section header table
+    uint32_t type;      // Section type
+    uint64_t flags;     // Section flags
+    uint64_t addr;      // Section virtual addr at execution
+    uint64_t offset;    // Section file offset
+    uint64_t size;      // Section size in bytes
+    uint32_t link;      // Link to another section
+    uint32_t info;      // Additional section information
+    uint64_t addralign; // Section alignment
+    uint64_t entsize;   // Entry size if section holds table
+};
+
+// Symbol types, the low nibble of st_info
+enum class SymbolType : uint8_t
+{
+    STT_NOTYPE = 0,    // Symbol type is unspecified
+    STT_OBJECT = 1,    // Symbol is a data object
+    STT_FUNC = 2,      // Symbol is a code object
+    STT_SECTION = 3,   // Symbol associated with a section
+    STT_FILE = 4,      // Symbol's name is file name
+    STT_COMMON = 5,    // Symbol is a common data object
+    STT_TLS = 6,       // Symbol is thread-local data object
+    STT_GNU_IFUNC = 10 // Symbol is indirect code object
+};
+
+// Symbol bindings, the high nibble of st_info
+enum class SymbolBinding : uint8_t
+{
+    STB_LOCAL = 0,      // Local symbol
+    STB_GLOBAL = 1,     // Global symbol
+    STB_WEAK = 2,       // Weak symbol
+    STB_GNU_UNIQUE = 10 // Unique symbol
+};
+
+// Special section indices
+constexpr uint16_t SHN_UNDEF = 0;          // Undefined section
+constexpr uint16_t SHN_LORESERVE = 0xff00; // Start of the reserved indices
+constexpr uint16_t SHN_ABS = 0xfff1;       // Associated symbol is absolute
+constexpr uint16_t SHN_COMMON = 0xfff2;    // Associated symbol is common
+
+// Class independent view of a program header
+struct ElfSegment
+{
+    uint32_t type;   // Type of segment
+    uint32_t flags;  // Segment attributes
+    uint64_t offset; // Offset in file
+    uint64_t vaddr;  // Virtual address in memory
+    uint64_t paddr;  // Reserved
+    uint64_t filesz; // Size of segment in file
+    uint64_t memsz;  // Size of segment in memory
+    uint64_t align;  // Alignment of segment
+};
+
+// Class independent view of a symbol table entry
+struct ElfSymbol
+{
+    std::string name;      // Symbol name
+    uint64_t value;        // Symbol value, an address or, in relocatable files, a section offset
+    uint64_t size;         // Symbol size
+    SymbolType type;       // Symbol type
+    SymbolBinding binding; // Symbol binding
+    uint8_t other;         // Symbol visibility
+    uint16_t sectionIndex; // Section index
+};
+
 class ElfHandler
 {
   public:
     // Public Constructors/Destructors
-    explicit ElfHandler(const std::string &fileName);
+    explicit ElfHandler(const std::string &fileName, ThreadPool *pool = nullptr);
 
     void PrintSectionHeaders();
 
+    const std::string &GetFileName() const;
+    ElfType GetElfType() const;
+    uint16_t GetMachine() const;
+    const std::vector<ElfSection> &GetSections() const;
+    const ElfSection *FindSection(const std::string &name) const;
+    std::span<const uint8_t> GetSectionData(const ElfSection &section) const;
+    const MappedFile &GetFile() const;
+    std::vector<ElfSymbol> GetSymbols() const;
+    std::vector<ElfSymbol> GetDynamicSymbols() const;
+    const std::vector<ElfSegment> &GetSegments() const;
+
   private:
     // Private Data Members
+    MappedFile _mappedFile;
     uint64_t _fileSize;
     std::variant<Elf32Ehdr, Elf64Ehdr> _elfEhdr;
     std::vector<std::variant<Elf32Phdr, Elf64Phdr>> _elfPhdrs;
-    std::vector<std::variant<Elf32Shdr, Elf64Shdr>> _elfShdrs;
+    std::vector<ElfSegment> _segments; // in table order, like _elfPhdrs
+    std::vector<std::variant<Elf32Shdr, Elf64Shdr>> _elfShdrs; // sorted by offset
+    std::vector<uint32_t> _elfShdrIndices;                      // original table index of each entry in _elfShdrs
+    std::vector<ElfSection> _sections;                          // sorted by offset, like _elfShdrs
     std::vector<std::variant<Elf32Sym, Elf64Sym>> _elfSymtab;
     std::vector<std::variant<Elf32Sym, Elf64Sym>> _elfDynamicSymtab;
     ElfType _elfType;
@@ -274,31 +429,35 @@ class ElfHandler
     uint8_t _elfEvCurrent = 0;
     ElfOsABI _elfOsabi;
     std::map<uint64_t, std::string> _sectionHeaderNameMap;
-    std::map<uint64_t, std::string> _symbolTableMap;
-    std::map<uint64_t, std::string> _dynamicSymbolTableMap;
+    std::vector<std::string> _symbolNames;        // name of each .symtab entry, by index
+    std::vector<std::string> _dynamicSymbolNames; // name of each .dynsym entry, by index
 
     // Private Helper Methods
-    void ReadFile(const std::string &fileName);
-    template <typename T> void ReadElfHeader(std::ifstream &file);
-    template <typename T1, typename T2> void ReadElfProgramHeaders(std::ifstream &file);
-    template <typename T1, typename T2> void ReadElfSectionHeaders(std::ifstream &file);
-    template <typename T1, typename T2, typename T3> void CreateSectionHeaderNameMap(std::ifstream &file);
-    template <typename T1, typename T2> void ParseTables(std::ifstream &file);
+    void ReadFile(const std::string &fileName, ThreadPool *pool);
+    template <typename T> void ReadElfHeader();
+    template <typename T1, typename T2> void ReadElfProgramHeaders();
+    template <typename T1, typename T2> void ReadElfSectionHeaders();
+    template <typename T1, typename T2, typename T3> void CreateSectionHeaderNameMap();
+    template <typename T1, typename T2> void ParseTables(ThreadPool *pool);
+    template <typename ElfShdr> void CreateSectionList();
     ElfOsABI MapToElfOsABI(uint16_t value);
+    std::vector<ElfSymbol> CreateSymbolList(const std::vector<std::variant<Elf32Sym, Elf64Sym>> &symtab,
+                                            const std::vector<std::string> &names) const;
 
     // Private Validation Methods
     void ValidateElfMagic(const std::array<uint8_t, EI_NIDENT> &ident);
-    void ValidateElfClass(const std::array<uint8_t, EI_NIDENT> &ident, std::ifstream &file);
+    void ValidateElfClass(const std::array<uint8_t, EI_NIDENT> &ident);
     void ValidateElfDataEncoding(const std::array<uint8_t, EI_NIDENT> &ident);
     void ValidateFileVersion(const std::array<uint8_t, EI_NIDENT> &ident);
     void ValidateOSABI(const std::array<uint8_t, EI_NIDENT> &ident);
     void ValidateABIVersion(const std::array<uint8_t, EI_NIDENT> &ident);
     void ValidatePAD(const std::array<uint8_t, EI_NIDENT> &ident);
     void ValidateIdent(const std::array<uint8_t, EI_NIDENT> &ident);
-    void ValidateElfProgramHeaders(std::ifstream &file);
-    void ValidateElfSectionHeaders(std::ifstream &file);
+    void ValidateElfProgramHeaders();
+    void ValidateElfSectionHeaders();
 
     // Private Methods
-    void CreateSectionHeaderNameMap(std::ifstream &file);
-    void ParseTables(std::ifstream &file);
+    void CreateSectionHeaderNameMap();
+    void ParseTables(ThreadPool *pool);
+    void CreateSectionList();
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "elf_dynamic.hpp"
+#include "elf_segments.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// SPEC - https://www.trapkit.de/tools/checksec/
+// SPEC - https://gcc.gnu.org/onlinedocs/gcc/Instrumentation-Options.html
+
+enum class RelroLevel
+{
+    None,    // No PT_GNU_RELRO segment
+    Partial, // PT_GNU_RELRO, but the GOT entries of lazily bound functions stay writable
+    Full     // PT_GNU_RELRO and immediate binding
+};
+
+enum class PieKind
+{
+    None,         // ET_EXEC, loaded at a fixed address
+    Pie,          // ET_DYN executable, DF_1_PIE or a PT_INTERP segment
+    SharedObject, // ET_DYN library
+    Relocatable   // ET_REL object file
+};
+
+// Exploit mitigations of a binary
+struct ElfHardeningReport
+{
+    RelroLevel relro = RelroLevel::None;
+    bool nx = false;              // PT_GNU_STACK without PF_X
+    PieKind pie = PieKind::None;
+    bool isStatic = false;        // No DT_NEEDED: the canary and FORTIFY checks below cannot be answered
+    bool stackProtector = false;  // Imports __stack_chk_fail or __stack_chk_guard
+    size_t fortified = 0;         // Imported __*_chk functions
+    size_t fortifiable = 0;       // Imported functions that have a FORTIFY_SOURCE variant, fortified or not
+    bool textRelocations = false; // DT_TEXTREL or DF_TEXTREL
+    uint32_t x86Features = 0;     // GNU_PROPERTY_X86_FEATURE_1_AND, CET IBT and SHSTK
+    uint32_t aarch64Features = 0; // GNU_PROPERTY_AARCH64_FEATURE_1_AND, BTI and PAC
+    std::vector<std::string> rpath;
+    std::vector<std::string> runpath;
+};
+
+// checksec style report computed from the program headers, the dynamic section and .dynsym alone. Section headers
+// and .symtab are never read, so a file costs the head read of ElfSegments plus a few preads for the dynamic tables.
+class ElfHardening
+{
+  public:
+    // Public Constructors/Destructors
+    explicit ElfHardening(const ElfSegments &segments);
+
+    const ElfHardeningReport &GetReport() const;
+    void PrintReport() const;
+
+    static const char *RelroLevelName(RelroLevel level);
+    static const char *PieKindName(PieKind kind);
+
+  private:
+    // Private Data Members
+    std::string _fileName;
+    ElfHardeningReport _report;
+
+    // Private Helper Methods
+    void ReadImports(const ElfDynamic &dynamic);
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "elf_segments.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+
+// SPEC - https://refspecs.linuxfoundation.org/elf/gabi4+/ch5.pheader.html#note_section
+//        https://github.com/hjl-tools/linux-abi/wiki
+
+constexpr char ELF_NOTE_GNU[] = "GNU";
+
+// GNU note types
+constexpr uint32_t NT_GNU_ABI_TAG = 1;         // ABI version tag
+constexpr uint32_t NT_GNU_BUILD_ID = 3;        // Unique build ID bitstring
+constexpr uint32_t NT_GNU_PROPERTY_TYPE_0 = 5; // Program property
+
+// NT_GNU_ABI_TAG operating systems
+constexpr uint32_t ELF_NOTE_OS_LINUX = 0;
+constexpr uint32_t ELF_NOTE_OS_GNU = 1;
+constexpr uint32_t ELF_NOTE_OS_SOLARIS2 = 2;
+constexpr uint32_t ELF_NOTE_OS_FREEBSD = 3;
+
+// NT_GNU_PROPERTY_TYPE_0 property types
+constexpr uint32_t GNU_PROPERTY_STACK_SIZE = 1;
+constexpr uint32_t GNU_PROPERTY_NO_COPY_ON_PROTECTED = 2;
+constexpr uint32_t GNU_PROPERTY_AARCH64_FEATURE_1_AND = 0xc0000000;
+constexpr uint32_t GNU_PROPERTY_X86_FEATURE_1_AND = 0xc0000002;
+constexpr uint32_t GNU_PROPERTY_X86_ISA_1_NEEDED = 0xc0008002;
+constexpr uint32_t GNU_PROPERTY_X86_FEATURE_2_NEEDED = 0xc0008001;
+constexpr uint32_t GNU_PROPERTY_X86_ISA_1_USED = 0xc0010002;
+constexpr uint32_t GNU_PROPERTY_X86_FEATURE_2_USED = 0xc0010001;
+
+typedef struct GnuPropertyFlags
+{
+    static constexpr uint32_t X86_FEATURE_1_IBT = 0x1;      // Indirect branch tracking
+    static constexpr uint32_t X86_FEATURE_1_SHSTK = 0x2;    // Shadow stack
+    static constexpr uint32_t X86_ISA_1_BASELINE = 0x1;     // x86-64 baseline
+    static constexpr uint32_t X86_ISA_1_V2 = 0x2;           // x86-64-v2
+    static constexpr uint32_t X86_ISA_1_V3 = 0x4;           // x86-64-v3
+    static constexpr uint32_t X86_ISA_1_V4 = 0x8;           // x86-64-v4
+    static constexpr uint32_t AARCH64_FEATURE_1_BTI = 0x1;  // Branch target identification
+    static constexpr uint32_t AARCH64_FEATURE_1_PAC = 0x2;  // Pointer authentication
+} GnuPropertyFlags;
+
+// Note header, identical for 32bit and 64bit files
+typedef struct
+{
+    ElfWord n_namesz; // Length of the note's name
+    ElfWord n_descsz; // Length of the note's descriptor
+    ElfWord n_type;   // Type of the note
+} ElfNhdr;
+
+// Decoded NT_GNU_ABI_TAG descriptor
+struct ElfGnuAbiTag
+{
+    uint32_t os;    // ELF_NOTE_OS_* value
+    uint32_t major; // Earliest compatible kernel version
+    uint32_t minor;
+    uint32_t patch;
+};
+
+// A single NT_GNU_PROPERTY_TYPE_0 entry. Every property in use today carries a 4 or 8 byte payload, so it is kept
+// as an integer rather than as raw bytes.
+struct ElfGnuProperty
+{
+    uint32_t type;  // GNU_PROPERTY_* value
+    uint32_t size;  // Payload size in bytes
+    uint64_t value; // Payload, zero extended
+};
+
+// Notes recovered from the PT_NOTE segments of an ELF file. Only the ELF header, the program header table and the
+// note segments themselves are read, so extracting a build-id costs one or two pages of the file.
+class ElfNotes
+{
+  public:
+    // Public Constructors/Destructors
+    explicit ElfNotes(const ElfSegments &segments);
+
+    const std::vector<uint8_t> &GetBuildId() const;
+    std::string GetBuildIdHex() const;
+    const std::optional<ElfGnuAbiTag> &GetAbiTag() const;
+    const std::vector<ElfGnuProperty> &GetProperties() const;
+    std::optional<uint64_t> GetProperty(uint32_t type) const;
+    void PrintNotes() const;
+
+  private:
+    // Private Data Members
+    std::vector<uint8_t> _buildId;
+    std::optional<ElfGnuAbiTag> _abiTag;
+    std::vector<ElfGnuProperty> _properties;
+
+    // Private Helper Methods
+    void ParseNoteSegment(std::span<const uint8_t> data, uint64_t align, ElfType elfType);
+    void ParseGnuProperties(std::span<const uint8_t> desc, ElfType elfType);
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "elf_segments.hpp"
+#include <span>
+#include <string>
+#include <vector>
+
+enum class ElfRegionKind
+{
+    Section,
+    Segment
+};
+
+// File contents of one section or segment, viewed in the file mapping
+struct ElfRegion
+{
+    ElfRegionKind kind;
+    std::string name;              // Section name, or segment name from SegmentNames such as LOAD[1]
+    uint64_t offset;               // File offset of the region
+    std::span<const uint8_t> data; // Empty for SHT_NOBITS sections and segments outside the file
+};
+
+std::vector<ElfRegion> CollectElfRegions(const ElfHandler &elfHandler, const ElfSegments &segments);
+const char *ElfRegionKindName(ElfRegionKind kind);
+std::string SegmentTypeName(uint32_t type);
+std::vector<std::string> SegmentNames(const std::vector<ElfSegment> &segments);
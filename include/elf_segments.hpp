@@ -0,0 +1,54 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include <array>
+#include <deque>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Number of bytes read up front. The ELF header, the program header table and the early note sections of a
+// linker produced file all sit in the first page.
+constexpr size_t ELF_SEGMENTS_HEAD_SIZE = 4096;
+
+// Lightweight reader that only looks at the ELF header and the program header table. Section headers and symbol
+// tables are never touched. The first page is read with a single pread and every later range is read on demand,
+// so the common case costs one open, one read and one close.
+class ElfSegments
+{
+  public:
+    // Public Constructors/Destructors
+    explicit ElfSegments(const std::string &fileName);
+    ~ElfSegments();
+
+    ElfSegments(const ElfSegments &) = delete;
+    ElfSegments &operator=(const ElfSegments &) = delete;
+
+    const std::string &GetFileName() const;
+    ElfType GetElfType() const;
+    uint16_t GetObjectType() const;
+    uint16_t GetMachine() const;
+    uint64_t GetEntry() const;
+    const std::vector<ElfSegment> &GetSegments() const;
+    const ElfSegment *FindSegment(ProgramHeaderType type) const;
+    std::span<const uint8_t> GetSegmentData(const ElfSegment &segment) const;
+    std::span<const uint8_t> ReadRange(uint64_t offset, uint64_t size) const;
+    std::optional<uint64_t> VirtualToFileOffset(uint64_t vaddr) const;
+
+  private:
+    // Private Data Members
+    std::string _fileName;
+    int _fd = -1;
+    std::array<uint8_t, ELF_SEGMENTS_HEAD_SIZE> _head;
+    size_t _headSize = 0;
+    mutable std::deque<std::vector<uint8_t>> _buffers; // Ranges that did not fit in the head, kept for span lifetime
+    ElfType _elfType = ElfType::UNKNOWN;
+    uint16_t _objectType = 0;
+    uint16_t _machine = 0;
+    uint64_t _entry = 0;
+    std::vector<ElfSegment> _segments;
+
+    // Private Helper Methods
+    template <typename ElfEhdr, typename ElfPhdr> void ReadSegments();
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "elf_segments.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// SPEC - https://refspecs.linuxfoundation.org/elf/gabi4+/ch4.sheader.html
+// SPEC - https://refspecs.linuxfoundation.org/elf/gabi4+/ch5.pheader.html
+
+// What the bytes of a file are attributed to
+enum class SizeDimension
+{
+    Sections,
+    Segments,     // PT_LOAD segments
+    Symbols,      // Sized function and object symbols of .symtab, or of .dynsym when the file is stripped
+    CompileUnits, // Address ranges of the DWARF compilation units
+};
+
+// Bytes attributed to one label
+struct SizeProfileRow
+{
+    std::string label;
+    uint64_t fileSize; // Bytes of the file
+    uint64_t vmSize;   // Bytes of the PT_LOAD segments once mapped, .bss included
+};
+
+// Labelled byte range; of overlapping ranges, the one added first owns the bytes
+struct SizeRange
+{
+    uint64_t begin;
+    uint64_t end;
+    uint32_t label;
+};
+
+// Attribution of every byte of a file, and every byte of its PT_LOAD segments, to a label of one dimension. Bytes
+// the dimension does not cover fall back to the section holding them, written in brackets, then to the ELF header,
+// program header table or section header table. Bytes left over are gaps: "[Padding]" when they are all zero,
+// "[Unattributed]" otherwise. Each address space is attributed with one sweep over the sorted range boundaries, so
+// the cost grows with the number of symbols or units, not with the size of the file.
+class ElfSizeProfile
+{
+  public:
+    // Public Constructors/Destructors
+    ElfSizeProfile(const ElfHandler &elfHandler, const ElfSegments &segments, SizeDimension dimension,
+                   ThreadPool *pool = nullptr);
+
+    SizeDimension GetDimension() const;
+    const std::vector<SizeProfileRow> &GetRows() const;
+    uint64_t GetFileSize() const;
+    uint64_t GetVmSize() const;
+    void PrintProfile(size_t limit) const;
+
+  private:
+    // Private Data Members
+    SizeDimension _dimension;
+    std::vector<SizeProfileRow> _rows; // Sorted by file size, then VM size, largest first
+    std::unordered_map<std::string, uint32_t> _labels;
+    std::vector<SizeRange> _fileRanges;
+    std::vector<SizeRange> _vmRanges;
+
+    // Private Helper Methods
+    uint32_t Label(const std::string &label);
+    void AddSegments(const ElfSegments &segments);
+    void AddSymbols(const ElfHandler &elfHandler, const ElfSegments &segments);
+    void AddCompileUnits(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool);
+    void AddSections(const ElfHandler &elfHandler, bool bracketed);
+    void AddHeaders(const ElfHandler &elfHandler, const ElfSegments &segments);
+    void Attribute(const ElfHandler &elfHandler, const ElfSegments &segments);
+};
+
+std::optional<SizeDimension> ParseSizeDimension(const std::string &name);
+const char *SizeDimensionName(SizeDimension dimension);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "code_functions.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// SPEC - http://infolab.stanford.edu/~ullman/mmds/ch3.pdf (3.3 MinHash, 3.4 Locality-sensitive hashing)
+
+// Number of hash functions, and of values, in a MinHash signature
+constexpr size_t MINHASH_SIZE = 64;
+
+// Consecutive normalised instructions hashed together into one shingle
+constexpr size_t FINGERPRINT_NGRAM_SIZE = 4;
+
+// Functions shorter than this many instructions are not fingerprinted; thunks, stubs and accessors match everything
+constexpr uint32_t FINGERPRINT_MIN_INSTRUCTIONS = 16;
+
+using MinHashSignature = std::array<uint32_t, MINHASH_SIZE>;
+
+// MinHash signature of one function of a CodeFunctions collection
+struct FunctionFingerprint
+{
+    uint32_t function;         // Index in CodeFunctions::GetFunctions()
+    uint32_t instructionCount; // Instructions decoded from the function body
+    MinHashSignature signature;
+};
+
+bool ComputeFunctionSignature(std::span<const uint8_t> code, MinHashSignature &signature,
+                              uint32_t &instructionCount);
+std::vector<FunctionFingerprint> FingerprintFunctions(const CodeFunctions &functions, ThreadPool *pool = nullptr);
+double EstimateSimilarity(const MinHashSignature &a, const MinHashSignature &b);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+// SPEC - https://go.dev/s/go12symtab
+// SPEC - https://github.com/golang/go/blob/master/src/runtime/symtab.go (pcHeader, _func)
+// SPEC - https://github.com/golang/go/blob/master/src/debug/gosym/pclntab.go
+
+// Magic of the table header, changed with every layout change
+constexpr uint32_t GO_PCLNTAB_MAGIC_12 = 0xfffffffb;  // Go 1.2 to 1.15
+constexpr uint32_t GO_PCLNTAB_MAGIC_116 = 0xfffffffa; // Go 1.16 and 1.17
+constexpr uint32_t GO_PCLNTAB_MAGIC_118 = 0xfffffff0; // Go 1.18 and 1.19
+constexpr uint32_t GO_PCLNTAB_MAGIC_120 = 0xfffffff1; // Go 1.20 and later
+
+// Layout of the table, named after the first Go release using it
+enum class GoPclnVersion
+{
+    None, // No table found
+    Go12,
+    Go116,
+    Go118,
+    Go120
+};
+
+// Function of the table
+struct GoFunction
+{
+    uint64_t entry;        // First instruction
+    uint64_t end;          // Entry of the next function
+    std::string_view name; // Points into the mapped file
+    uint64_t dataOffset;   // Offset of the function's _func record in the function data
+};
+
+// Position of an instruction in the Go source
+struct GoSourceLocation
+{
+    std::string_view fileName; // Points into the mapped file
+    uint32_t line;
+};
+
+// Function names, entry points and line tables of a Go binary, read from the runtime's pclntab. The table survives
+// stripping because the runtime needs it for tracebacks: it is the .gopclntab section, or part of .data.rel.ro in
+// position independent builds, where it is found by its header. Nothing is decoded up front. A lookup is a binary
+// search of the function table followed by a walk of the one function's pc-value tables, all straight from the
+// mapping of the ElfHandler, which must outlive the table. Big-endian tables are not supported.
+class GoPclnTable
+{
+  public:
+    // Public Constructors/Destructors
+    explicit GoPclnTable(const ElfHandler &elfHandler);
+
+    GoPclnVersion GetVersion() const;
+    size_t GetFunctionCount() const;
+    std::optional<GoFunction> FindFunction(uint64_t address) const;
+    std::optional<GoSourceLocation> FindLocation(const GoFunction &function, uint64_t address) const;
+
+  private:
+    // Private Data Members
+    GoPclnVersion _version = GoPclnVersion::None;
+    uint8_t _quantum = 1;     // Instruction size unit of the pc deltas
+    uint8_t _pointerSize = 8; // Size of the header words, and of the function table fields before Go 1.18
+    uint64_t _textStart = 0;  // Base of the entry offsets from Go 1.18 on
+    uint64_t _functionCount = 0;
+    std::span<const uint8_t> _table;         // Whole table, header first
+    std::span<const uint8_t> _functionNames; // NUL terminated names, indexed by _func.nameOff
+    std::span<const uint8_t> _compileUnits;  // File table offsets of each compile unit's files, from Go 1.16 on
+    std::span<const uint8_t> _files;         // File names; offsets of the names in _table for Go 1.2
+    std::span<const uint8_t> _pcTables;      // pc-value tables, indexed by the _func offsets
+    std::span<const uint8_t> _functionData;  // _func records, indexed by the function table offsets
+    std::span<const uint8_t> _functionTable; // Entry and _func offset of each function, then the end of the last
+
+    // Private Helper Methods
+    bool Load(std::span<const uint8_t> table, uint64_t textAddress);
+    uint64_t FieldSize() const;
+    uint64_t EntryAt(uint64_t index) const;
+    uint32_t FunctionField(uint64_t dataOffset, uint32_t field) const;
+    std::optional<int32_t> PcValue(uint32_t tableOffset, uint64_t entry, uint64_t address) const;
+};
+
+const char *GoPclnVersionName(GoPclnVersion version);
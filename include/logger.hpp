@@ -7,6 +7,7 @@
 #include <unordered_map>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <cstdarg>
 
 struct SourceLocationHash {
@@ -40,6 +41,7 @@ public:
     static Logger& Instance();
     
     void InitializeLogFile(const std::string& logFilePath);
+    void SetConsoleLevel(LogLevel level); // Lower levels only go to the log file
     
     std::runtime_error Log(LogLevel level, const char* format, const std::source_location location = std::source_location::current(), ...);
 
@@ -49,8 +51,10 @@ private:
     Logger() = default; // singleton instance
     void outputLog(LogLevel level, const std::string& message, const std::source_location& location);
 
+    std::mutex logMutex; // Serialises log calls from worker threads
     std::ofstream logFile;
     bool logFileInitialized = false;
+    LogLevel consoleLevel = LogLevel::Debug;
     std::unordered_map<std::source_location, uint64_t, SourceLocationHash, SourceLocationEqual> logDict;
 };
 
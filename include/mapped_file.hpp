@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are only faulted in when touched, so callers that look at a
+// handful of headers pay for a handful of pages regardless of the file size.
+class MappedFile
+{
+  public:
+    // Public Constructors/Destructors
+    explicit MappedFile(const std::string &fileName);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    const uint8_t *Data() const;
+    uint64_t Size() const;
+    const std::string &GetFileName() const;
+    std::span<const uint8_t> Slice(uint64_t offset, uint64_t size) const;
+    void AdviseRandomAccess() const;
+
+  private:
+    // Private Data Members
+    std::string _fileName;
+    const uint8_t *_data = nullptr;
+    uint64_t _size = 0;
+
+    // Private Helper Methods
+    void Unmap();
+};
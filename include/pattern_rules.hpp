@@ -0,0 +1,97 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "signature_scanner.hpp"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// SPEC - https://yara.readthedocs.io/en/stable/writingrules.html#hexadecimal-strings
+
+// Longest literal run used as the prefilter atom of a rule
+constexpr size_t PATTERN_MAX_ATOM_SIZE = 8;
+
+// Byte of a pattern; bits outside the mask match anything
+struct MaskedByte
+{
+    uint8_t value;
+    uint8_t mask; // 0xff for a literal, 0xf0 or 0x0f for a nibble wildcard, 0 for ??
+};
+
+// Gap of min to max arbitrary bytes between two segments
+struct PatternJump
+{
+    uint32_t min;
+    uint32_t max;
+};
+
+// Hex pattern with wildcards, nibble masks and bounded jumps, split at its jumps into fixed length segments
+struct PatternRule
+{
+    std::string name;
+    std::vector<std::vector<MaskedByte>> segments;
+    std::vector<PatternJump> jumps; // jumps[i] lies between segments i and i + 1
+};
+
+struct PatternMatch
+{
+    uint32_t rule;   // Index of the rule in its set
+    uint64_t offset; // Offset of the first matching byte within the scanned data
+    uint64_t size;   // Number of bytes matched
+};
+
+using PatternCallback = std::function<void(const PatternMatch &)>;
+using SectionPatternCallback = std::function<void(const ElfSection &, const PatternMatch &)>;
+
+// Set of hex pattern rules compiled for repeated scanning. The longest literal run of each rule, preferring bytes
+// other than 00, ff, 90 and cc, becomes its atom; the atoms of all rules are searched with a SignatureSet and each
+// atom hit is verified in place, the atom's segment first, then the following segments forwards and the preceding
+// ones backwards across their jumps. Rules without a literal byte are tried at every position.
+class PatternRuleSet
+{
+  public:
+    // Public Constructors/Destructors
+    explicit PatternRuleSet(std::vector<PatternRule> rules);
+
+    static PatternRule ParseRule(const std::string &name, const std::string &pattern);
+    static PatternRuleSet FromFile(const std::string &path);
+
+    size_t GetRuleCount() const;
+    const PatternRule &GetRule(uint32_t index) const;
+    void Scan(std::span<const uint8_t> data, const PatternCallback &callback) const;
+
+  private:
+    // Literal run of a rule searched by the prefilter
+    struct Atom
+    {
+        uint32_t rule;
+        uint32_t segment;
+        uint32_t offset; // Offset of the atom within its segment
+    };
+
+    // Private Data Members
+    std::vector<PatternRule> _rules;
+    std::vector<Atom> _atoms;               // by signature index in _atomSet
+    std::vector<uint32_t> _unanchoredRules; // Rules without a literal byte
+    SignatureSet _atomSet;
+
+    // Private Helper Methods
+    static SignatureSet SelectAtoms(const std::vector<PatternRule> &rules, std::vector<Atom> &atoms,
+                                    std::vector<uint32_t> &unanchoredRules);
+    static bool MatchSegment(std::span<const uint8_t> data, const std::vector<MaskedByte> &segment,
+                             uint64_t position);
+    bool MatchForward(std::span<const uint8_t> data, const PatternRule &rule, size_t segment, uint64_t position,
+                      uint64_t &end) const;
+    void MatchBackward(std::span<const uint8_t> data, const PatternRule &rule, size_t segment, uint64_t position,
+                       std::vector<uint64_t> &starts) const;
+    void Verify(std::span<const uint8_t> data, uint32_t rule, size_t segment, uint64_t position,
+                std::vector<PatternMatch> &matches) const;
+};
+
+void ScanSectionPatterns(const ElfHandler &elfHandler, const PatternRuleSet &rules,
+                         const std::vector<std::string> &sectionNames, bool executableOnly,
+                         const SectionPatternCallback &callback);
+void PrintPatternMatches(const ElfHandler &elfHandler, const PatternRuleSet &rules,
+                         const std::vector<std::string> &sectionNames, bool executableOnly);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Default limit on the decompressed bytes kept by a SectionDecompressor
+constexpr size_t DEFAULT_SECTION_CACHE_LIMIT = 512ULL << 20;
+
+// Decompressed section contents in an anonymous mapping. Large buffers are backed by fresh zero pages rather than
+// heap memory, and the mapping is reused for another section once it is no longer referenced.
+class DecompressedSection
+{
+  public:
+    // Public Constructors/Destructors
+    explicit DecompressedSection(size_t capacity);
+    ~DecompressedSection();
+    DecompressedSection(const DecompressedSection &) = delete;
+    DecompressedSection &operator=(const DecompressedSection &) = delete;
+
+    std::span<const uint8_t> GetData() const;
+    size_t GetCapacity() const;
+
+  private:
+    friend class SectionDecompressor;
+
+    // Private Data Members
+    uint8_t *_data = nullptr;
+    size_t _size = 0;
+    size_t _capacity = 0;
+};
+
+// Section contents with SHF_COMPRESSED (zlib or zstd behind an Elf_Chdr) and legacy .zdebug ("ZLIB" and a big-endian
+// size) sections decompressed on demand. Recently used sections are kept in an LRU bounded by their decompressed
+// size; evicted sections stay valid for as long as a caller still holds them.
+class SectionDecompressor
+{
+  public:
+    // Public Constructors/Destructors
+    explicit SectionDecompressor(const ElfHandler &elfHandler, size_t cacheLimit = DEFAULT_SECTION_CACHE_LIMIT);
+    SectionDecompressor(const SectionDecompressor &) = delete;
+    SectionDecompressor &operator=(const SectionDecompressor &) = delete;
+
+    static bool IsCompressed(const ElfSection &section);
+    std::shared_ptr<const DecompressedSection> Get(const ElfSection &section);
+    void Prefetch(const std::vector<const ElfSection *> &sections, ThreadPool *pool = nullptr);
+    size_t GetCachedBytes() const;
+
+  private:
+    struct CacheEntry
+    {
+        uint32_t index; // Section header index
+        std::shared_ptr<DecompressedSection> section;
+    };
+
+    // Private Data Members
+    const ElfHandler &_elfHandler;
+    size_t _cacheLimit;
+    mutable std::mutex _mutex;
+    std::list<CacheEntry> _lru; // most recently used first
+    std::unordered_map<uint32_t, std::list<CacheEntry>::iterator> _entries;
+    size_t _cachedBytes = 0;
+    std::vector<std::shared_ptr<DecompressedSection>> _spare; // evicted mappings nobody references any more
+
+    // Private Helper Methods
+    std::shared_ptr<DecompressedSection> Decompress(const ElfSection &section);
+    std::shared_ptr<DecompressedSection> Allocate(size_t size);
+    void Insert(uint32_t index, const std::shared_ptr<DecompressedSection> &section);
+    static void Inflate(std::span<const uint8_t> input, DecompressedSection &output, const ElfSection &section);
+    static void DecompressZstd(std::span<const uint8_t> input, DecompressedSection &output,
+                               const ElfSection &section);
+};
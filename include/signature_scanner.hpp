@@ -0,0 +1,95 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// SPEC - https://dl.acm.org/doi/10.1145/360825.360855 (Aho-Corasick)
+// SPEC - https://www.usenix.org/conference/nsdi19/presentation/wang-xiang (Hyperscan, FDR)
+
+// Length of the prefilter's hashed substrings. Shorter signatures are found with an exact two byte table instead.
+constexpr size_t SIGNATURE_QGRAM_SIZE = 4;
+
+// Largest distance between the positions sampled by the prefilter
+constexpr size_t SIGNATURE_MAX_STRIDE = 8;
+
+// log2 of the number of bits of the prefilter table, 256KB
+constexpr size_t SIGNATURE_FILTER_BITS = 21;
+
+// Named byte string to search for
+struct Signature
+{
+    std::string name;
+    std::vector<uint8_t> bytes;
+};
+
+struct SignatureMatch
+{
+    uint32_t signature; // Index of the signature in its set
+    uint64_t offset;    // Offset of the first matching byte within the scanned data
+};
+
+using SignatureCallback = std::function<void(const SignatureMatch &)>;
+using SectionSignatureCallback = std::function<void(const ElfSection &, const SignatureMatch &)>;
+
+// Set of signatures compiled once for repeated scanning. The signatures form a trie, the goto function of an
+// Aho-Corasick automaton, which is walked from each candidate start found by the prefilter. The prefilter follows
+// FDR: every 4-byte substring a signature can present at a sampled position is hashed into a bitmap, and the scan
+// samples one position in every `stride`, where the stride is bounded by the shortest signature. Most positions are
+// rejected by one bit test; the few that pass have their possible start positions checked against the hashed first
+// q-grams before any trie walk.
+class SignatureSet
+{
+  public:
+    // Public Constructors/Destructors
+    explicit SignatureSet(std::vector<Signature> signatures);
+
+    static SignatureSet FromFile(const std::string &path);
+
+    size_t GetSignatureCount() const;
+    const Signature &GetSignature(uint32_t index) const;
+    void Scan(std::span<const uint8_t> data, const SignatureCallback &callback) const;
+
+  private:
+    // Trie node; the edges of a node are sorted by byte
+    struct TrieNode
+    {
+        uint32_t firstEdge;
+        uint32_t edgeCount;
+        uint32_t firstOutput; // Signatures ending at the node, in _outputs
+        uint32_t outputCount;
+    };
+
+    // Private Data Members
+    std::vector<Signature> _signatures;
+    std::vector<TrieNode> _nodes; // Node 0 is the root
+    std::vector<uint8_t> _edgeBytes;
+    std::vector<uint32_t> _edgeTargets;
+    std::vector<uint32_t> _outputs;
+    std::array<uint32_t, 256> _rootChildren{}; // 0 when the root has no such edge
+    std::vector<uint64_t> _longFilter;         // Hashed substrings of signatures at least a q-gram long
+    std::vector<uint64_t> _prefixFilter;       // Hashed first q-grams of the same signatures
+    std::vector<uint64_t> _shortFilter;        // First two bytes of shorter signatures, one bit per value
+    size_t _stride = 1;
+    bool _hasLong = false;
+    bool _hasShort = false;
+
+    // Private Helper Methods
+    void BuildTrie();
+    void BuildFilters();
+    uint32_t Child(uint32_t node, uint8_t byte) const;
+    void Walk(std::span<const uint8_t> data, uint64_t start, size_t minDepth, size_t maxDepth,
+              const SignatureCallback &callback) const;
+    void ScanLong(std::span<const uint8_t> data, const SignatureCallback &callback) const;
+    void ScanShort(std::span<const uint8_t> data, const SignatureCallback &callback) const;
+    void CheckSample(std::span<const uint8_t> data, uint64_t position, const SignatureCallback &callback) const;
+};
+
+void ScanSectionSignatures(const ElfHandler &elfHandler, const SignatureSet &signatures,
+                           const std::vector<std::string> &sectionNames, const SectionSignatureCallback &callback);
+void PrintSignatureMatches(const ElfHandler &elfHandler, const SignatureSet &signatures,
+                           const std::vector<std::string> &sectionNames);
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "function_fingerprint.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// SPEC - http://infolab.stanford.edu/~ullman/mmds/ch3.pdf (3.4.1 LSH for MinHash signatures)
+
+constexpr char SIMILARITY_INDEX_MAGIC[8] = {'E', 'X', 'P', 'S', 'I', 'M', 'I', 'X'};
+constexpr uint32_t SIMILARITY_INDEX_VERSION = 1;
+
+// The signature is cut into bands of rows; two functions become candidates when all rows of one band agree. With 16
+// bands of 4 rows, pairs of similarity 0.5 are found with probability 0.64 and pairs of 0.8 with probability 0.9996.
+constexpr size_t SIMILARITY_BAND_COUNT = 16;
+constexpr size_t SIMILARITY_BAND_ROWS = MINHASH_SIZE / SIMILARITY_BAND_COUNT;
+
+// Matches below this estimated similarity are dropped unless told otherwise
+constexpr double DEFAULT_MIN_SIMILARITY = 0.5;
+
+// On disk layout of the similarity index. Every table is an array of fixed size records, so an opened index is used
+// straight from the mapping without any decoding.
+typedef struct
+{
+    char magic[8];     // SIMILARITY_INDEX_MAGIC
+    uint32_t version;  // SIMILARITY_INDEX_VERSION
+    uint32_t hashSize; // MINHASH_SIZE of the build
+    uint32_t bandCount;
+    uint32_t reserved; // Zero
+    uint64_t fileCount; // Number of SimilarityIndexFile records
+    uint64_t fileOffset;
+    uint64_t functionCount; // Number of SimilarityIndexFunction records, and of signatures
+    uint64_t functionOffset;
+    uint64_t signatureOffset; // functionCount signatures of hashSize 32-bit values
+    uint64_t bucketOffset;    // bandCount tables of functionCount SimilarityIndexBucket records, one per band
+    uint64_t stringsSize;     // Size of the NUL terminated string pool
+    uint64_t stringsOffset;
+} SimilarityIndexHeader;
+
+// An indexed file
+typedef struct
+{
+    uint32_t pathOffset;    // Offset of the file path in the string pool
+    uint32_t firstFunction; // Index of the file's first SimilarityIndexFunction
+    uint32_t functionCount;
+    uint32_t reserved; // Zero
+} SimilarityIndexFile;
+
+// An indexed function
+typedef struct
+{
+    uint64_t address;
+    uint32_t size;
+    uint32_t file;             // Index of the SimilarityIndexFile
+    uint32_t nameOffset;       // Offset of the name in the string pool; 0, the empty string, for unnamed functions
+    uint32_t instructionCount;
+} SimilarityIndexFunction;
+
+// Hash of the rows of one band of a function's signature; each band's table is sorted by hash, then function
+typedef struct
+{
+    uint32_t bandHash;
+    uint32_t function; // Index of the SimilarityIndexFunction
+} SimilarityIndexBucket;
+
+// Indexed function resembling a queried one
+struct SimilarityMatch
+{
+    uint32_t function; // Index of the SimilarityIndexFunction
+    double similarity; // Estimated Jaccard similarity of the normalised instruction n-grams
+};
+
+// Near-duplicate function lookup across a corpus of x86-64 files. Every function of every file under a set of
+// directories is fingerprinted by FingerprintFunctions, and its signature is filed under one hash per band. A query
+// hashes its own bands, gathers the functions sharing at least one of them with a binary search per band, and ranks
+// them by the similarity of the full signatures, so the cost depends on the number of candidates, not on the size
+// of the corpus.
+class SimilarityIndex
+{
+  public:
+    // Public Constructors/Destructors
+    explicit SimilarityIndex(const std::string &indexPath);
+
+    std::vector<SimilarityMatch> Query(const MinHashSignature &signature, double minSimilarity, size_t limit) const;
+    const SimilarityIndexFunction &GetFunction(uint32_t function) const;
+    const char *GetFunctionName(uint32_t function) const;
+    const char *GetFilePath(uint32_t function) const;
+    size_t GetFileCount() const;
+    size_t GetFunctionCount() const;
+
+    static void Build(const std::vector<std::string> &directories, const std::string &indexPath,
+                      ThreadPool *pool = nullptr);
+    static std::string DefaultIndexPath();
+
+  private:
+    // Private Data Members
+    std::unique_ptr<MappedFile> _index;
+    const SimilarityIndexHeader *_header = nullptr;
+
+    // Private Helper Methods
+    const char *IndexString(uint32_t offset) const;
+    std::span<const SimilarityIndexFile> Files() const;
+    std::span<const SimilarityIndexFunction> Functions() const;
+    std::span<const SimilarityIndexBucket> Buckets(size_t band) const;
+    const MinHashSignature &Signature(uint32_t function) const;
+};
+
+uint32_t SimilarityBandHash(const MinHashSignature &signature, size_t band);
+void PrintSimilarFunctions(const SimilarityIndex &index, const ElfHandler &elfHandler, const std::string &functionName,
+                           double minSimilarity, size_t limit, ThreadPool *pool = nullptr);
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "dwarf_info.hpp"
+#include "elf_handler.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// SPEC - https://dwarfstd.org/doc/DWARF5.pdf (7.3.5)
+// SPEC - https://gcc.gnu.org/wiki/DebugFissionDWP
+
+// Section columns of a DWARF 5 package index
+constexpr uint32_t DW_SECT_INFO = 1;
+constexpr uint32_t DW_SECT_ABBREV = 3;
+constexpr uint32_t DW_SECT_LINE = 4;
+constexpr uint32_t DW_SECT_LOCLISTS = 5;
+constexpr uint32_t DW_SECT_STR_OFFSETS = 6;
+constexpr uint32_t DW_SECT_MACRO = 7;
+constexpr uint32_t DW_SECT_RNGLISTS = 8;
+
+// Section columns of a version 2 (GNU, DWARF 4) package index that differ from DWARF 5
+constexpr uint32_t DW_SECT_V2_TYPES = 2;
+constexpr uint32_t DW_SECT_V2_LOC = 5;
+constexpr uint32_t DW_SECT_V2_MACINFO = 7;
+constexpr uint32_t DW_SECT_V2_MACRO = 8;
+
+// Highest section column identifier of either version
+constexpr uint32_t DW_SECT_MAX = 8;
+
+// Part of a package section belonging to one unit
+struct DwarfPackageContribution
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Hash table of a .dwp package, .debug_cu_index or .debug_tu_index, mapping unit signatures to their contributions.
+// Lookups probe the table in place, so only the slots on the probe sequence and one row of the offset and size
+// tables are read.
+class DwarfPackageIndex
+{
+  public:
+    // Public Constructors/Destructors
+    DwarfPackageIndex() = default;
+    explicit DwarfPackageIndex(std::span<const uint8_t> index);
+
+    uint32_t GetVersion() const;
+    uint32_t GetUnitCount() const;
+    std::optional<uint32_t> FindRow(uint64_t signature) const;
+    std::optional<DwarfPackageContribution> GetContribution(uint32_t row, uint32_t section) const;
+
+  private:
+    // Private Data Members
+    std::span<const uint8_t> _index;
+    uint32_t _version = 0;
+    uint32_t _columnCount = 0;
+    uint32_t _unitCount = 0;
+    uint32_t _slotCount = 0;
+    uint64_t _signaturesOffset = 0;
+    uint64_t _rowsOffset = 0;
+    uint64_t _offsetsOffset = 0; // First row of the offset table, past the column identifiers
+    uint64_t _sizesOffset = 0;
+    std::array<int32_t, DW_SECT_MAX + 1> _columns{}; // Column of each DW_SECT_* identifier, -1 when absent
+};
+
+// Unit of a .dwo file or .dwp package, with views restricted to its own contributions. The .debug_addr,
+// .debug_ranges and .debug_line sections are those of the skeleton's file.
+struct SplitDwarfUnit
+{
+    DwarfSections sections;
+    DwarfUnitHeader header; // Offsets relative to sections.info
+    std::unique_ptr<DwarfAbbrevCache> abbrevs;
+    std::string fileName; // The .dwo file or .dwp package holding the unit
+};
+
+// Resolves the skeleton units of a binary built with -gsplit-dwarf to their split units. The package next to the
+// binary, <binary>.dwp, is preferred; otherwise each skeleton's DW_AT_dwo_name is opened relative to its
+// DW_AT_comp_dir, or to the binary's directory. Files are mapped without read-ahead and units are resolved on first
+// use, so resolving one address reads the index slots and the pages of a single unit. Safe to use concurrently.
+class SplitDwarfResolver
+{
+  public:
+    // Public Constructors/Destructors
+    SplitDwarfResolver(const DwarfSections &skeletonSections, std::string executable, std::string packagePath = {});
+
+    const SplitDwarfUnit *Resolve(const DwarfUnit &skeleton);
+    const SplitDwarfUnit *FindTypeUnit(uint64_t signature);
+
+    static std::optional<uint64_t> GetDwoId(const DwarfUnit &unit);
+
+  private:
+    // A .dwo file or .dwp package
+    struct SplitFile
+    {
+        std::unique_ptr<ElfHandler> elfHandler;
+        std::unique_ptr<SectionDecompressor> decompressor;
+        DwarfSections sections; // Whole .dwo sections
+        DwarfPackageIndex cuIndex;
+        DwarfPackageIndex tuIndex;
+    };
+
+    // Private Data Members
+    DwarfSections _skeletonSections;
+    std::string _executable;
+    std::string _packagePath;
+    std::once_flag _packageOpened;
+    std::unique_ptr<SplitFile> _package;
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::unique_ptr<SplitFile>> _dwoFiles;   // by path, nullptr if unreadable
+    std::unordered_map<uint64_t, std::unique_ptr<SplitDwarfUnit>> _units;     // by DWO id, nullptr if unresolved
+    std::unordered_map<uint64_t, std::unique_ptr<SplitDwarfUnit>> _typeUnits; // by type signature
+
+    // Private Helper Methods
+    const SplitFile *GetPackage();
+    const SplitFile *GetDwoFile(const std::string &path);
+    std::unique_ptr<SplitFile> OpenFile(const std::string &path) const;
+    std::unique_ptr<SplitDwarfUnit> FromPackage(const SplitFile &package, const DwarfPackageIndex &index,
+                                                uint64_t signature) const;
+    std::unique_ptr<SplitDwarfUnit> FromDwoFile(const SplitFile &file, const std::string &path,
+                                                uint64_t dwoId) const;
+    std::vector<std::string> DwoCandidates(const DwarfUnit &skeleton) const;
+};
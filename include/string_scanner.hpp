@@ -0,0 +1,44 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Default minimum number of characters of a reported string, as in GNU strings
+constexpr size_t DEFAULT_MIN_STRING_LENGTH = 4;
+
+// Bytes classified per step of the scanner, one bit each in the printable and zero masks
+constexpr size_t STRING_SCAN_BLOCK_SIZE = 64;
+
+enum class StringEncoding
+{
+    Ascii,  // Printable bytes
+    Utf16Le // Printable bytes each followed by a zero byte
+};
+
+struct StringScanOptions
+{
+    size_t minLength = DEFAULT_MIN_STRING_LENGTH; // Minimum number of characters
+    bool ascii = true;
+    bool utf16le = false;
+};
+
+// String found by the scanner. The bytes are a view of the scanned data, so reporting a string allocates nothing.
+struct FoundString
+{
+    StringEncoding encoding;
+    uint64_t offset;                // Offset of the first byte within the scanned data
+    std::span<const uint8_t> bytes; // Raw bytes, two per character for UTF-16LE
+    size_t length;                  // Number of characters
+};
+
+using StringCallback = std::function<void(const FoundString &)>;
+using SectionStringCallback = std::function<void(const ElfSection &, const FoundString &)>;
+
+void ScanStrings(std::span<const uint8_t> data, const StringScanOptions &options, const StringCallback &callback);
+void ScanSectionStrings(const ElfHandler &elfHandler, const std::vector<std::string> &sectionNames,
+                        const StringScanOptions &options, const SectionStringCallback &callback);
+void PrintString(const ElfSection &section, const FoundString &string);
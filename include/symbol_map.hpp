@@ -0,0 +1,22 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include <cstdint>
+#include <vector>
+
+// Lookup of the function or object symbol containing a location, from .symtab or, in stripped files, .dynsym.
+// Locations are a section index and an address, which for relocatable files is the offset within the section, so
+// executables, shared objects and object files are handled alike.
+class SymbolMap
+{
+  public:
+    // Public Constructors/Destructors
+    explicit SymbolMap(const ElfHandler &elfHandler);
+
+    const ElfSymbol *Find(uint16_t sectionIndex, uint64_t address) const;
+    const std::vector<ElfSymbol> &GetSymbols() const;
+
+  private:
+    // Private Data Members
+    std::vector<ElfSymbol> _symbols; // defined, sized code and data symbols, sorted by section then value
+};
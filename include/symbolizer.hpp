@@ -0,0 +1,54 @@
+#pragma once
+
+#include "call_frame.hpp"
+#include "dwarf_functions.hpp"
+#include "dwarf_index.hpp"
+#include "dwarf_line.hpp"
+#include "elf_handler.hpp"
+#include "go_pclntab.hpp"
+#include "split_dwarf.hpp"
+#include "thread_pool.hpp"
+#include <span>
+#include <string>
+#include <vector>
+
+// One level of the inline chain of an address
+struct SymbolizedFrame
+{
+    std::string function; // Linkage name when known, else the plain name; empty if the function is unknown
+    std::string fileName;
+    uint32_t line;
+    uint32_t column;
+    bool inlined; // Whether this frame was inlined into the next one
+};
+
+// Inline-aware address to source resolution. Only the units the addresses fall into are decoded: the unit index maps
+// an address to its unit, then the unit's functions and line program are decoded on first use. Addresses without
+// debug information, in stripped files for instance, still get their function, file and line from the pclntab of Go
+// binaries, or otherwise their function from the .eh_frame FDE covering them.
+// Functions of -gsplit-dwarf builds are read from the split units of the .dwp package or .dwo files.
+class Symbolizer
+{
+  public:
+    // Public Constructors/Destructors
+    explicit Symbolizer(const ElfHandler &elfHandler, std::string cachePath = {}, std::string packagePath = {},
+                        ThreadPool *pool = nullptr);
+
+    std::vector<SymbolizedFrame> Symbolize(uint64_t address);
+    std::vector<std::vector<SymbolizedFrame>> SymbolizeBatch(std::span<const uint64_t> addresses, ThreadPool &pool);
+
+  private:
+    // Private Data Members
+    DwarfSections _sections;
+    DwarfUnitIndex _unitIndex;
+    DwarfLineIndex _lineIndex;
+    SplitDwarfResolver _splitUnits;
+    DwarfFunctionIndex _functionIndex;
+    CallFrameInfo _callFrames;
+    GoPclnTable _goTable;
+
+    // Private Helper Methods
+    std::vector<SymbolizedFrame> Resolve(uint64_t address, std::optional<uint64_t> unitOffset);
+    std::vector<SymbolizedFrame> ResolveFromGoTable(uint64_t address) const;
+    std::vector<SymbolizedFrame> ResolveFromCallFrames(uint64_t address) const;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// SPEC - https://itanium-cxx-abi.github.io/cxx-abi/abi.html#mangling
+
+// Levels of the hierarchy printed unless told otherwise
+constexpr size_t DEFAULT_TEMPLATE_BLOAT_DEPTH = 4;
+
+// Symbols are demangled in batches of this many when the work is spread over a thread pool
+constexpr size_t TEMPLATE_BLOAT_BATCH_SIZE = 4096;
+
+// Index of the root node, the parent of the outermost namespaces, classes and functions
+constexpr uint32_t TEMPLATE_BLOAT_ROOT = 0;
+
+// Namespace, class, function or object of the name hierarchy. Template arguments are stripped from every level, so
+// all instantiations of a template share one node.
+struct TemplateBloatNode
+{
+    std::string name;               // Last component of the qualified name, with <> in place of template arguments
+    uint32_t parent;                // Index of the enclosing node
+    uint64_t selfSize;              // Bytes of the symbols naming exactly this node
+    uint64_t totalSize;             // Bytes of the symbols naming this node or a node nested in it
+    uint32_t selfSymbols;           // Symbols, one per instantiation or overload, naming exactly this node
+    uint32_t totalSymbols;          // Symbols naming this node or a node nested in it
+    std::vector<uint32_t> children; // Sorted by total size, largest first
+};
+
+// Sizes of the sized function and object symbols of .symtab aggregated by their demangled qualified name. Each
+// symbol is demangled, its return type, parameters and template arguments are dropped, and what remains is split at
+// the scope operators: namespaces::classes::name. The symbol's size goes to the self size of the last component and
+// to the total size of every enclosing one, so the total of a class template covers all of its instantiations and
+// member functions. vtables, VTTs, typeinfo and guard variables are leaves of the class or object they belong to,
+// thunks count toward their target, and C symbols sit under [C]. Aliases of the same bytes are counted once.
+class TemplateBloatReport
+{
+  public:
+    // Public Constructors/Destructors
+    explicit TemplateBloatReport(const ElfHandler &elfHandler, ThreadPool *pool = nullptr);
+
+    const std::vector<TemplateBloatNode> &GetNodes() const;
+    void PrintReport(size_t limit, size_t maxDepth = DEFAULT_TEMPLATE_BLOAT_DEPTH) const;
+
+  private:
+    // Private Data Members
+    std::vector<TemplateBloatNode> _nodes; // The root first
+
+    // Private Helper Methods
+    void PrintNode(uint32_t node, size_t depth, size_t limit, size_t maxDepth) const;
+};
+
+std::vector<std::string> SplitSymbolName(std::string_view demangled);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Activity of one worker since the pool was created
+struct ThreadPoolWorkerStats
+{
+    uint64_t tasks;           // Tasks run, subtasks run while waiting on a TaskGroup included
+    uint64_t stolen;          // Tasks taken from the deque of another worker
+    uint64_t busyNanoseconds; // Time spent in tasks, less the time blocked in TaskGroup::Wait with nothing to run
+};
+
+// Fixed set of worker threads, each with its own task deque. A worker runs its own tasks newest first and, once out
+// of work, steals the oldest task of another worker, so a few large tasks (compilation units of very different
+// sizes, for instance) do not leave the other threads idle. Tasks that split their own work go through a TaskGroup,
+// which keeps the waiting worker running tasks; the per-worker counters show how evenly the work was spread.
+class ThreadPool
+{
+  public:
+    // Public Constructors/Destructors
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void Submit(std::function<void()> task);
+    void Wait();
+    size_t GetThreadCount() const;
+    std::vector<ThreadPoolWorkerStats> GetWorkerStats() const;
+    uint64_t GetElapsedNanoseconds() const;
+
+  private:
+    friend class TaskGroup;
+
+    // Deque and counters of one worker, on their own cache lines so that counting does not slow the other workers
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+        std::atomic<uint64_t> busyNanoseconds{0};
+    };
+
+    // Private Data Members
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _taskAvailable;
+    std::condition_variable _allDone;
+    std::condition_variable _groupDone; // Wakes threads outside the pool waiting on a TaskGroup
+    std::atomic<size_t> _queued{0};     // Tasks waiting in a deque
+    std::atomic<size_t> _unfinished{0}; // Tasks submitted and not yet finished
+    std::atomic<size_t> _nextQueue{0};  // Round robin target for tasks submitted from outside the pool
+    bool _stopping = false;
+    std::exception_ptr _error;
+    std::chrono::steady_clock::time_point _started = std::chrono::steady_clock::now();
+
+    // Private Helper Methods
+    void WorkerLoop(size_t index);
+    bool TryPop(size_t index, std::function<void()> &task);
+    void Execute(std::function<void()> &task, size_t index);
+    void RunUntilDone(const std::atomic<size_t> &unfinished);
+    void NotifyGroupDone();
+};
+
+// Tasks of a ThreadPool that can be waited on as a set, from inside a task of the same pool as well as from outside
+// it. A worker waiting on a group keeps running queued tasks, its own subtasks first, so a task working on one large
+// file can split a phase into subtasks for idle workers to steal without tying up the thread it runs on.
+class TaskGroup
+{
+  public:
+    // Public Constructors/Destructors
+    explicit TaskGroup(ThreadPool &pool);
+    ~TaskGroup();
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void Submit(std::function<void()> task);
+    void Wait();
+
+  private:
+    // Private Data Members
+    ThreadPool &_pool;
+    std::atomic<size_t> _unfinished{0};
+    std::mutex _mutex;
+    std::exception_ptr _error;
+};
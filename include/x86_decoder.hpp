@@ -0,0 +1,69 @@
+#pragma once
+
+#include "elf_handler.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// SPEC - https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html (Vol. 2, 2.1-2.7, A.3)
+// SPEC - https://www.amd.com/content/dam/amd/en/documents/processor-tech-docs/programmer-references/24594.pdf
+
+// Architectural limit on the length of an instruction
+constexpr size_t X86_MAX_INSTRUCTION_LENGTH = 15;
+
+// Blocks of code are cut into chunks of this size when swept in parallel
+constexpr size_t X86_SWEEP_CHUNK_SIZE = 1024 * 1024;
+
+enum class X86FlowType : uint8_t
+{
+    None,            // Falls through to the next instruction
+    Call,            // call rel32
+    Jump,            // jmp rel8/rel32
+    ConditionalJump, // jcc, loop and jrcxz, falls through when not taken
+    IndirectCall,    // call through a register or memory operand, or far call
+    IndirectJump,    // jmp through a register or memory operand, or far jump
+    Return,          // ret, retf and iret
+    Trap             // int3, ud2 and hlt, never fall through in compiled code
+};
+
+// Length and control flow of one decoded instruction
+struct X86Instruction
+{
+    uint8_t length;
+    uint8_t operandOffset; // Start of the displacement and immediate bytes, which run to the end of the instruction
+    X86FlowType flow;
+    int32_t displacement; // Branch displacement of direct calls and jumps, relative to the next instruction
+};
+
+// Control transfer instruction found by a sweep
+struct X86Branch
+{
+    uint64_t source; // Address of the instruction
+    uint64_t target; // Destination of direct calls and jumps, 0 otherwise
+    X86FlowType type;
+};
+
+// Result of a linear sweep over a block of code
+struct X86CodeMap
+{
+    uint64_t address = 0;
+    uint64_t size = 0;
+    std::vector<uint64_t> boundaries; // Bit n set when an instruction starts at address + n
+    std::vector<X86Branch> branches;  // In address order
+    size_t instructionCount = 0;
+    size_t invalidCount = 0; // Bytes skipped because they did not start a valid instruction
+
+    bool IsBoundary(uint64_t instructionAddress) const;
+};
+
+using SectionCodeCallback = std::function<void(const ElfSection &, const X86CodeMap &)>;
+
+bool DecodeX86Instruction(std::span<const uint8_t> code, X86Instruction &instruction);
+X86CodeMap SweepX86Code(std::span<const uint8_t> code, uint64_t address, ThreadPool *pool = nullptr);
+void ScanSectionCode(const ElfHandler &elfHandler, const std::vector<std::string> &sectionNames, ThreadPool *pool,
+                     const SectionCodeCallback &callback);
+const char *X86FlowTypeName(X86FlowType type);
+void PrintCodeMap(const ElfSection &section, const X86CodeMap &codeMap);
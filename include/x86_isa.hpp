@@ -0,0 +1,105 @@
+#pragma once
+
+#include "code_functions.hpp"
+#include "elf_handler.hpp"
+#include "elf_segments.hpp"
+#include "thread_pool.hpp"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// SPEC - https://gitlab.com/x86-psABIs/x86-64-ABI (3.1.1, Micro-architecture levels)
+// SPEC - https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html (Vol. 2, Appendix A)
+
+// Instruction set extensions told apart by the ISA scanner
+enum class X86IsaExtension : uint8_t
+{
+    // x86-64 baseline
+    Base, // General purpose, x87 and MMX instructions
+    Sse,
+    Sse2,
+    // x86-64-v2
+    Sse3,
+    Ssse3,
+    Sse41,
+    Sse42,
+    Popcnt,
+    Cx16,     // cmpxchg16b
+    LahfSahf, // lahf and sahf, missing from the first 64-bit processors
+    // x86-64-v3
+    Avx,
+    Avx2,
+    Fma,
+    F16c,
+    Bmi1,
+    Bmi2,
+    Lzcnt,
+    Movbe,
+    // x86-64-v4
+    Avx512, // Anything EVEX encoded and the VEX encoded opmask instructions
+    // Outside the levels
+    Aes,
+    Pclmul,
+    Sha,
+    Other, // ADX, RDRAND, RDSEED, GFNI, SSE4a, AVX-VNNI, AMX and the like
+    Count
+};
+
+constexpr size_t X86_ISA_EXTENSION_COUNT = static_cast<size_t>(X86IsaExtension::Count);
+
+// x86-64 micro-architecture levels, as numbered by the psABI
+constexpr uint8_t X86_ISA_LEVEL_BASELINE = 1;
+constexpr uint8_t X86_ISA_LEVEL_V4 = 4;
+
+// Comparison of the level the code needs with the level a GNU property note records
+enum class IsaNoteCheck
+{
+    Absent,     // The file has no such note
+    Match,      // The note records the level the code needs
+    CodeHigher, // The code uses instructions above the note's level, often behind runtime CPU dispatch
+    NoteHigher  // The note records a higher level than any instruction needs
+};
+
+// Instruction set usage of the code of an x86-64 file. Every function, and every stretch of executable section
+// between functions, is decoded linearly and each instruction is classified by extension. Code reached only after
+// a runtime CPU check counts like any other, which is why the per-function breakdown is kept: it shows whether a
+// high level comes from a few dispatched kernels or from the whole program. The maxima are cross-checked against the
+// GNU_PROPERTY_X86_ISA_1_NEEDED and GNU_PROPERTY_X86_ISA_1_USED notes.
+class X86IsaProfile
+{
+  public:
+    // Public Constructors/Destructors
+    X86IsaProfile(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool = nullptr);
+
+    const CodeFunctions &GetFunctions() const;
+    uint32_t GetExtensions() const;
+    uint32_t GetFunctionExtensions(uint32_t function) const;
+    uint8_t GetLevel() const;
+    const std::array<uint64_t, X86_ISA_EXTENSION_COUNT> &GetInstructionCounts() const;
+    std::optional<uint8_t> GetNeededNoteLevel() const;
+    std::optional<uint8_t> GetUsedNoteLevel() const;
+    IsaNoteCheck CheckNote(std::optional<uint8_t> noteLevel) const;
+    void PrintReport() const;
+
+  private:
+    // Private Data Members
+    std::string _fileName;
+    CodeFunctions _functions;
+    std::vector<uint32_t> _functionExtensions; // bit n set when the function uses X86IsaExtension n
+    uint32_t _extensions = 0;                  // union over the whole file
+    std::array<uint64_t, X86_ISA_EXTENSION_COUNT> _instructionCounts{};
+    std::optional<uint8_t> _neededNoteLevel;
+    std::optional<uint8_t> _usedNoteLevel;
+
+    // Private Helper Methods
+    void Scan(const ElfHandler &elfHandler, ThreadPool *pool);
+};
+
+X86IsaExtension ClassifyX86Instruction(std::span<const uint8_t> instruction);
+uint8_t X86IsaExtensionLevel(X86IsaExtension extension);
+uint8_t X86IsaLevel(uint32_t extensions);
+const char *X86IsaExtensionName(X86IsaExtension extension);
+const char *X86IsaLevelName(uint8_t level);
+const char *IsaNoteCheckName(IsaNoteCheck check);
@@ -0,0 +1,322 @@
+#include "batch_scan.hpp"
+#include "elf_fingerprint.hpp"
+#include "elf_hardening.hpp"
+#include "elf_notes.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <glob.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// Record of the getdents64 system call, which older glibc releases do not declare
+struct LinuxDirent64
+{
+    uint64_t inode;
+    int64_t offset;        // Position of the next record
+    uint16_t recordLength; // Size of this record, name and padding included
+    uint8_t type;          // DT_* type, DT_UNKNOWN on file systems that do not store it
+    char name[];           // NUL terminated
+};
+
+/**
+ * @brief Constructor for the BatchScanner class.
+ *
+ * @param pool The pool the files are parsed on. Must not be shared with other work until Finish returns.
+ * @param scanFunction Produces the output text of one ELF file; may throw, which counts the file as failed.
+ * @param output Where the text of each file is written.
+ */
+BatchScanner::BatchScanner(ThreadPool &pool, ScanFunction scanFunction, FILE *output)
+    : _pool(pool), _scanFunction(std::move(scanFunction)), _output(output)
+{
+}
+
+/**
+ * @brief Starts scanning the files named by an input. Returns once the input is walked, not once it is scanned.
+ *
+ * @param input A file, a directory, a glob pattern, or @ followed by the path of a list of inputs (@- for stdin).
+ */
+void BatchScanner::AddInput(const std::string &input)
+{
+    if (input.size() > 1 && input[0] == '@')
+    {
+        AddListFile(input.substr(1));
+        return;
+    }
+    if (input.find_first_of("*?[") == std::string::npos)
+    {
+        AddPath(input);
+        return;
+    }
+
+    glob_t matches;
+    int result = glob(input.c_str(), GLOB_NOSORT, nullptr, &matches);
+    if (result == GLOB_NOMATCH)
+    {
+        LOG(Logger::LogLevel::Warning, "No file matches %s", input.c_str());
+    }
+    else if (result != 0)
+    {
+        LOG(Logger::LogLevel::Warning, "Failed to expand %s", input.c_str());
+    }
+    else
+    {
+        for (size_t i = 0; i < matches.gl_pathc; i++)
+        {
+            AddPath(matches.gl_pathv[i]);
+        }
+    }
+    globfree(&matches);
+}
+
+/**
+ * @brief Waits for every submitted file to be scanned.
+ *
+ * @return The counts of the whole scan.
+ */
+BatchScanStats BatchScanner::Finish()
+{
+    _pool.Wait();
+    fflush(_output);
+    return {_directories, _files, _elfFiles, _failures};
+}
+
+/**
+ * @brief Classifies an input path through an O_PATH descriptor, which neither reads the file nor needs read
+ * permission, then walks it if it is a directory or submits it if it is a regular file. Symbolic links are followed
+ * here since the path was named explicitly.
+ */
+void BatchScanner::AddPath(const std::string &path)
+{
+    int pathFd = open(path.c_str(), O_PATH | O_CLOEXEC);
+    struct stat status;
+    if (pathFd < 0 || fstat(pathFd, &status) != 0)
+    {
+        LOG(Logger::LogLevel::Warning, "Cannot access %s: %s", path.c_str(), strerror(errno));
+        if (pathFd >= 0)
+        {
+            close(pathFd);
+        }
+        return;
+    }
+
+    if (S_ISREG(status.st_mode))
+    {
+        SubmitFile(path);
+    }
+    else if (S_ISDIR(status.st_mode))
+    {
+        // getdents64 needs a descriptor opened for reading, reopened relative to the O_PATH one
+        int directoryFd = openat(pathFd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryFd < 0)
+        {
+            LOG(Logger::LogLevel::Warning, "Cannot open directory %s: %s", path.c_str(), strerror(errno));
+        }
+        else
+        {
+            _directories++;
+            WalkDirectory(directoryFd, path);
+            close(directoryFd);
+        }
+    }
+    close(pathFd);
+}
+
+/**
+ * @brief Adds every line of a list file as an input. Empty lines are skipped.
+ */
+void BatchScanner::AddListFile(const std::string &listPath)
+{
+    std::ifstream file;
+    if (listPath != "-")
+    {
+        file.open(listPath);
+        if (!file.is_open())
+        {
+            LOG(Logger::LogLevel::Warning, "Cannot open file list %s", listPath.c_str());
+            return;
+        }
+    }
+    std::istream &list = listPath == "-" ? std::cin : file;
+
+    std::string line;
+    while (std::getline(list, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            AddInput(line);
+        }
+    }
+}
+
+/**
+ * @brief Walks a directory tree depth first. Subdirectories are opened relative to their parent's descriptor, so
+ * no path is resolved twice, and only entries of unknown type cost an fstatat.
+ *
+ * @param directoryFd Descriptor of the directory, opened for reading; left open for the caller to close.
+ * @param path The directory's path, the prefix of the paths handed to the scan function.
+ */
+void BatchScanner::WalkDirectory(int directoryFd, const std::string &path)
+{
+    std::vector<uint8_t> buffer(BATCH_SCAN_DIRENT_BUFFER_SIZE);
+    std::string prefix = path.back() == '/' ? path : path + '/';
+
+    for (;;)
+    {
+        long count = syscall(SYS_getdents64, directoryFd, buffer.data(), buffer.size());
+        if (count < 0)
+        {
+            LOG(Logger::LogLevel::Warning, "Failed to read directory %s: %s", path.c_str(), strerror(errno));
+            return;
+        }
+        if (count == 0)
+        {
+            return;
+        }
+
+        for (long offset = 0; offset < count;)
+        {
+            const auto *entry = reinterpret_cast<const LinuxDirent64 *>(buffer.data() + offset);
+            offset += entry->recordLength;
+            if (strcmp(entry->name, ".") == 0 || strcmp(entry->name, "..") == 0)
+            {
+                continue;
+            }
+
+            uint8_t type = entry->type;
+            if (type == DT_UNKNOWN)
+            {
+                struct stat status;
+                if (fstatat(directoryFd, entry->name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    continue;
+                }
+                type = S_ISDIR(status.st_mode) ? DT_DIR : S_ISREG(status.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if (type == DT_REG)
+            {
+                SubmitFile(prefix + entry->name);
+            }
+            else if (type == DT_DIR)
+            {
+                int childFd = openat(directoryFd, entry->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (childFd < 0)
+                {
+                    LOG(Logger::LogLevel::Debug, "Skipping directory %s%s: %s", prefix.c_str(), entry->name,
+                        strerror(errno));
+                    continue;
+                }
+                _directories++;
+                WalkDirectory(childFd, prefix + entry->name);
+                close(childFd);
+            }
+        }
+    }
+}
+
+void BatchScanner::SubmitFile(std::string path)
+{
+    _files++;
+    _pool.Submit([this, path = std::move(path)]() { ScanFile(path); });
+}
+
+/**
+ * @brief Checks the ELF magic, then hands the file to the scan function. Runs on a pool worker.
+ */
+void BatchScanner::ScanFile(const std::string &path)
+{
+    // O_NONBLOCK keeps an entry replaced by a FIFO since the walk from stalling the worker
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat status;
+    uint32_t magic = 0;
+    bool isElf = fstat(fd, &status) == 0 && S_ISREG(status.st_mode) &&
+                 pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == ELFMAG;
+    close(fd);
+    if (!isElf)
+    {
+        return;
+    }
+
+    _elfFiles++;
+    try
+    {
+        WriteOutput(_scanFunction(path));
+    }
+    catch (const std::exception &e)
+    {
+        _failures++;
+        WriteOutput(path + "\terror\t" + e.what() + "\n");
+    }
+}
+
+void BatchScanner::WriteOutput(const std::string &text)
+{
+    std::lock_guard<std::mutex> lock(_outputMutex);
+    fwrite(text.data(), 1, text.size(), _output);
+}
+
+/**
+ * @brief Summarises an ELF file on one tab separated line: path, class, machine, object type, RELRO, NX, stack
+ * protector, fortified/fortifiable imports and build-id. Only the program headers and the dynamic tables are read.
+ *
+ * @param path The file to describe.
+ * @return The line, newline terminated.
+ * @throws std::runtime_error if the file is not a valid ELF file.
+ */
+std::string DescribeElfFile(const std::string &path)
+{
+    ElfSegments segments(path);
+    ElfHardening hardening(segments);
+    const ElfHardeningReport &report = hardening.GetReport();
+    std::string buildId = ElfNotes(segments).GetBuildIdHex();
+
+    const char *canary = report.isStatic ? "n/a" : report.stackProtector ? "canary" : "-";
+    char fields[256];
+    snprintf(fields, sizeof(fields), "\t%s\t%u\t%s\t%s\t%s\t%s\t%zu/%zu\t%s\n",
+             segments.GetElfType() == ElfType::ELF_64 ? "ELF64" : "ELF32", segments.GetMachine(),
+             ElfHardening::PieKindName(report.pie), ElfHardening::RelroLevelName(report.relro),
+             report.nx ? "nx" : "-", canary, report.fortified, report.fortifiable,
+             buildId.empty() ? "-" : buildId.c_str());
+    return path + fields;
+}
+
+/**
+ * @brief Lists the XXH3 and SHA-256 hashes of every section and segment of an ELF file, one tab separated line per
+ * region: path, kind, name, file offset, size, XXH3 and SHA-256.
+ *
+ * @param path The file to hash.
+ * @param pool The pool to split the symbol name resolution and the hashing over, typically the one running the batch,
+ * or nullptr.
+ * @return The lines, newline terminated.
+ * @throws std::runtime_error if the file is not a valid ELF file.
+ */
+std::string DescribeElfHashes(const std::string &path, ThreadPool *pool)
+{
+    ElfHandler elfHandler(path, pool);
+    ElfSegments segments(path);
+    ElfFingerprint fingerprint(elfHandler, segments, pool);
+    std::string text;
+    for (const auto &region : fingerprint.GetRegions())
+    {
+        char fields[256];
+        snprintf(fields, sizeof(fields), "\t%s\t%s\t0x%lx\t%lu\t%016lx\t", ElfRegionKindName(region.kind),
+                 region.name.c_str(), region.offset, region.size, region.hash.xxh3);
+        text += path + fields + FormatSha256(region.hash.sha256) + "\n";
+    }
+    return text;
+}
@@ -0,0 +1,544 @@
+#include "call_frame.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+// CIE id of .eh_frame entries; .debug_frame uses all ones of the offset size
+constexpr uint64_t EH_FRAME_CIE_ID = 0;
+
+// Version of the .eh_frame_hdr layout
+constexpr uint8_t EH_FRAME_HDR_VERSION = 1;
+
+/**
+ * @brief Views the file bytes from a virtual address to the end of the PT_LOAD segment holding it.
+ *
+ * @return The bytes, or an empty span if no segment maps the address from the file.
+ */
+static std::span<const uint8_t> GetLoadedData(const ElfHandler &elfHandler, uint64_t address)
+{
+    for (const ElfSegment &segment : elfHandler.GetSegments())
+    {
+        if (segment.type == static_cast<uint32_t>(ProgramHeaderType::PT_LOAD) && address >= segment.vaddr &&
+            address - segment.vaddr < segment.filesz)
+        {
+            uint64_t skipped = address - segment.vaddr;
+            return elfHandler.GetFile().Slice(segment.offset + skipped, segment.filesz - skipped);
+        }
+    }
+    return {};
+}
+
+/**
+ * @brief Constructor for the CallFrameInfo class. Locates the frame section and its lookup table. Without an
+ * .eh_frame section, as in files stripped of their section headers, .eh_frame is found through the frame pointer of
+ * the PT_GNU_EH_FRAME header instead and runs to the end of its PT_LOAD segment.
+ *
+ * @param elfHandler The parsed ELF file; must outlive the object, whose views point into its mapping.
+ * @param type Which frame section to use.
+ * @throws std::runtime_error if the lookup table has to be built and an entry is malformed.
+ */
+CallFrameInfo::CallFrameInfo(const ElfHandler &elfHandler, CfiSectionType type)
+    : _type(type), _addressSize(elfHandler.GetElfType() == ElfType::ELF_32 ? 4 : 8)
+{
+    const ElfSection *section = elfHandler.FindSection(type == CfiSectionType::EhFrame ? ".eh_frame" : ".debug_frame");
+    if (section != nullptr && SectionDecompressor::IsCompressed(*section))
+    {
+        _decompressed = SectionDecompressor(elfHandler).Get(*section);
+        _frame = _decompressed->GetData();
+        _frameAddress = section->addr;
+    }
+    else if (section != nullptr)
+    {
+        _frame = elfHandler.GetSectionData(*section);
+        _frameAddress = section->addr;
+    }
+    else if (type == CfiSectionType::DebugFrame)
+    {
+        return;
+    }
+
+    if (type == CfiSectionType::EhFrame && LoadHeaderTable(elfHandler, section == nullptr))
+    {
+        _source = CfiTableSource::Header;
+        return;
+    }
+    if (_frame.empty())
+    {
+        return;
+    }
+    BuildTable();
+    _source = CfiTableSource::Built;
+}
+
+CfiSectionType CallFrameInfo::GetSectionType() const
+{
+    return _type;
+}
+
+CfiTableSource CallFrameInfo::GetTableSource() const
+{
+    return _source;
+}
+
+size_t CallFrameInfo::GetFdeCount() const
+{
+    return _hdrCount != 0 ? _hdrCount : _table.size();
+}
+
+/**
+ * @brief Finds the FDE covering an address.
+ *
+ * @param pc The address to look up.
+ * @param cie Receives the CIE of the FDE when not nullptr.
+ * @return The FDE, or std::nullopt if no FDE covers the address.
+ * @throws std::runtime_error if the entry is malformed.
+ */
+std::optional<CfiFde> CallFrameInfo::FindFde(uint64_t pc, CfiCie *cie) const
+{
+    auto offset = FindFdeOffset(pc);
+    if (!offset)
+    {
+        return std::nullopt;
+    }
+    CfiFde fde = ReadFde(*offset, cie);
+    if (pc < fde.pcBegin || pc >= fde.pcEnd)
+    {
+        return std::nullopt;
+    }
+    return fde;
+}
+
+/**
+ * @brief Reads the FDE at an offset of the frame section, and its CIE.
+ *
+ * @param offset The offset of the FDE.
+ * @param cie Receives the CIE of the FDE when not nullptr.
+ * @return The FDE.
+ * @throws std::runtime_error if the entry is not an FDE or is malformed.
+ */
+CfiFde CallFrameInfo::ReadFde(uint64_t offset, CfiCie *cie) const
+{
+    DwarfReader reader(_frame, offset);
+    bool is64 = false;
+    uint64_t length = reader.ReadUnitLength(is64);
+    uint64_t end = reader.GetOffset() + length;
+    if (length == 0 || end > _frame.size())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Invalid FDE length at offset 0x%lx", offset);
+    }
+    reader = DwarfReader(_frame.subspan(0, end), reader.GetOffset());
+
+    CfiFde fde{};
+    fde.offset = offset;
+    uint64_t idOffset = reader.GetOffset();
+    uint64_t id = reader.ReadOffset(is64);
+    fde.cieOffset = _type == CfiSectionType::EhFrame ? idOffset - id : id;
+    if ((_type == CfiSectionType::EhFrame && id == EH_FRAME_CIE_ID) ||
+        (_type == CfiSectionType::DebugFrame && id == (is64 ? UINT64_MAX : UINT32_MAX)))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Expected an FDE at offset 0x%lx, found a CIE", offset);
+    }
+
+    CfiCie entryCie = ReadCie(fde.cieOffset);
+    fde.pcBegin = ReadEncodedPointer(reader, entryCie.fdeEncoding, _frameAddress, 0);
+    fde.pcEnd = fde.pcBegin + ReadEncodedPointer(reader, entryCie.fdeEncoding & 0x0f, _frameAddress, 0);
+    if (entryCie.augmentation.starts_with('z'))
+    {
+        uint64_t augmentationLength = reader.ReadULEB128();
+        uint64_t augmentationEnd = reader.GetOffset() + augmentationLength;
+        if (entryCie.lsdaEncoding != DW_EH_PE_omit)
+        {
+            fde.lsda = ReadEncodedPointer(reader, entryCie.lsdaEncoding, _frameAddress, 0);
+        }
+        reader.SetOffset(augmentationEnd);
+    }
+    fde.instructions = reader.ReadBytes(reader.Remaining());
+    if (cie != nullptr)
+    {
+        *cie = entryCie;
+    }
+    return fde;
+}
+
+/**
+ * @brief Reads the CIE at an offset of the frame section.
+ *
+ * @param offset The offset of the CIE.
+ * @return The CIE.
+ * @throws std::runtime_error if the entry is not a CIE or is malformed.
+ */
+CfiCie CallFrameInfo::ReadCie(uint64_t offset) const
+{
+    DwarfReader reader(_frame, offset);
+    bool is64 = false;
+    uint64_t length = reader.ReadUnitLength(is64);
+    uint64_t end = reader.GetOffset() + length;
+    if (length == 0 || end > _frame.size())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Invalid CIE length at offset 0x%lx", offset);
+    }
+    reader = DwarfReader(_frame.subspan(0, end), reader.GetOffset());
+
+    uint64_t id = reader.ReadOffset(is64);
+    if ((_type == CfiSectionType::EhFrame && id != EH_FRAME_CIE_ID) ||
+        (_type == CfiSectionType::DebugFrame && id != (is64 ? UINT64_MAX : UINT32_MAX)))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Expected a CIE at offset 0x%lx", offset);
+    }
+
+    CfiCie cie{};
+    cie.offset = offset;
+    cie.version = reader.ReadU8();
+    if (cie.version != 1 && cie.version != 3 && cie.version != 4)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported CIE version %u at offset 0x%lx", cie.version, offset);
+    }
+    cie.augmentation = reader.ReadCString();
+    cie.addressSize = _addressSize;
+    cie.fdeEncoding = DW_EH_PE_absptr;
+    cie.lsdaEncoding = DW_EH_PE_omit;
+    if (cie.augmentation.find("eh") != std::string_view::npos)
+    {
+        reader.Skip(_addressSize); // Pre-"z" GCC exception table pointer
+    }
+    if (cie.version >= 4)
+    {
+        cie.addressSize = reader.ReadU8();
+        reader.ReadU8(); // Segment selector size
+    }
+    cie.codeAlignment = reader.ReadULEB128();
+    cie.dataAlignment = reader.ReadSLEB128();
+    cie.returnAddressRegister = cie.version == 1 ? reader.ReadU8() : reader.ReadULEB128();
+
+    if (cie.augmentation.starts_with('z'))
+    {
+        uint64_t augmentationLength = reader.ReadULEB128();
+        uint64_t augmentationEnd = reader.GetOffset() + augmentationLength;
+        for (char c : cie.augmentation.substr(1))
+        {
+            if (c == 'L')
+                cie.lsdaEncoding = reader.ReadU8();
+            else if (c == 'R')
+                cie.fdeEncoding = reader.ReadU8();
+            else if (c == 'S')
+                cie.signalFrame = true;
+            else if (c == 'P')
+            {
+                uint8_t encoding = reader.ReadU8();
+                cie.personality = ReadEncodedPointer(reader, encoding, _frameAddress, 0);
+            }
+            else if (c != 'B' && c != 'G')
+                break; // Unknown augmentation, the rest of the data is skipped through its length
+        }
+        reader.SetOffset(augmentationEnd);
+    }
+    cie.initialInstructions = reader.ReadBytes(reader.Remaining());
+    return cie;
+}
+
+/**
+ * @brief Reads the address operand of DW_CFA_set_loc. In .eh_frame it uses the FDE pointer encoding of the CIE,
+ * so pcrel operands are relative to their own position; .debug_frame stores a plain target address.
+ *
+ * @param reader The reader over the instructions, positioned at the operand.
+ * @param instructions The instructions being run, a view into the frame section.
+ * @param cie The CIE of the instructions.
+ * @return The address in the file.
+ * @throws std::runtime_error if the operand is truncated or its encoding is unsupported.
+ */
+uint64_t CallFrameInfo::ReadLocation(DwarfReader &reader, std::span<const uint8_t> instructions,
+                                     const CfiCie &cie) const
+{
+    if (_type == CfiSectionType::DebugFrame)
+    {
+        return reader.ReadUnsigned(cie.addressSize);
+    }
+    uint64_t instructionsAddress = _frameAddress + static_cast<uint64_t>(instructions.data() - _frame.data());
+    return ReadEncodedPointer(reader, cie.fdeEncoding, instructionsAddress, 0);
+}
+
+/**
+ * @brief Lists the address range of every FDE, which for compiler output is the range of one function.
+ *
+ * @return The [begin, end) ranges, sorted by start address.
+ */
+std::vector<std::pair<uint64_t, uint64_t>> CallFrameInfo::GetFunctionRanges() const
+{
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    ranges.reserve(GetFdeCount());
+    auto add = [&](uint64_t fdeOffset) {
+        CfiFde fde = ReadFde(fdeOffset);
+        ranges.emplace_back(fde.pcBegin, fde.pcEnd);
+    };
+    if (_hdrCount != 0)
+    {
+        for (size_t i = 0; i < _hdrCount; i++)
+        {
+            int32_t fdeAddress;
+            std::memcpy(&fdeAddress, _hdrTable.data() + i * 8 + 4, sizeof(fdeAddress));
+            add(_hdrAddress + static_cast<int64_t>(fdeAddress) - _frameAddress);
+        }
+    }
+    else
+    {
+        for (const CfiTableEntry &entry : _table)
+        {
+            add(entry.fdeOffset);
+        }
+    }
+    std::sort(ranges.begin(), ranges.end());
+    return ranges;
+}
+
+/**
+ * @brief Uses the binary search table of .eh_frame_hdr, found through PT_GNU_EH_FRAME like the runtime unwinder
+ * does, or by section name in files without program headers. The usual datarel|sdata4 table is searched in place;
+ * any other encoding is decoded into the in-memory table.
+ *
+ * @param elfHandler The parsed ELF file.
+ * @param locateFrame Whether .eh_frame is taken from the frame pointer of the header, for files without the section.
+ * @return Whether the header exists and has a usable table.
+ */
+bool CallFrameInfo::LoadHeaderTable(const ElfHandler &elfHandler, bool locateFrame)
+{
+    std::span<const uint8_t> header;
+    const std::vector<ElfSegment> &segments = elfHandler.GetSegments();
+    auto segment = std::find_if(segments.begin(), segments.end(), [](const ElfSegment &s) {
+        return s.type == static_cast<uint32_t>(ProgramHeaderType::PT_GNU_EH_FRAME);
+    });
+    if (segment != segments.end())
+    {
+        _hdrAddress = segment->vaddr;
+        header = elfHandler.GetFile().Slice(segment->offset, segment->filesz);
+    }
+    else if (const ElfSection *section = elfHandler.FindSection(".eh_frame_hdr"))
+    {
+        _hdrAddress = section->addr;
+        header = elfHandler.GetSectionData(*section);
+    }
+    else
+    {
+        return false;
+    }
+    DwarfReader reader(header);
+    if (reader.Remaining() < 4 || reader.ReadU8() != EH_FRAME_HDR_VERSION)
+    {
+        LOG(Logger::LogLevel::Warning, "Unsupported .eh_frame_hdr, building the FDE table");
+        return false;
+    }
+    uint8_t framePointerEncoding = reader.ReadU8();
+    uint8_t countEncoding = reader.ReadU8();
+    uint8_t tableEncoding = reader.ReadU8();
+    uint64_t framePointer = ReadEncodedPointer(reader, framePointerEncoding, _hdrAddress, _hdrAddress);
+    if (locateFrame)
+    {
+        _frame = GetLoadedData(elfHandler, framePointer);
+        _frameAddress = framePointer;
+        if (_frame.empty())
+        {
+            LOG(Logger::LogLevel::Warning, ".eh_frame_hdr points at 0x%lx, outside the loaded segments", framePointer);
+            return false;
+        }
+    }
+    if (countEncoding == DW_EH_PE_omit || tableEncoding == DW_EH_PE_omit)
+    {
+        return false;
+    }
+    if (framePointer != _frameAddress)
+    {
+        LOG(Logger::LogLevel::Warning, ".eh_frame_hdr points at 0x%lx instead of .eh_frame, building the FDE table",
+            framePointer);
+        return false;
+    }
+    uint64_t count = ReadEncodedPointer(reader, countEncoding, _hdrAddress, _hdrAddress);
+
+    if (tableEncoding == (DW_EH_PE_datarel | DW_EH_PE_sdata4))
+    {
+        if (count > reader.Remaining() / 8)
+        {
+            LOG(Logger::LogLevel::Warning, "Truncated .eh_frame_hdr table, building the FDE table");
+            return false;
+        }
+        _hdrTable = reader.ReadBytes(count * 8);
+        _hdrCount = count;
+        return _hdrCount != 0;
+    }
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t pc = ReadEncodedPointer(reader, tableEncoding, _hdrAddress, _hdrAddress);
+        uint64_t fdeAddress = ReadEncodedPointer(reader, tableEncoding, _hdrAddress, _hdrAddress);
+        _table.push_back({pc, fdeAddress - _frameAddress});
+    }
+    return !_table.empty();
+}
+
+/**
+ * @brief Scans every entry of the frame section and builds a sorted PC to FDE table. CIEs are read once.
+ */
+void CallFrameInfo::BuildTable()
+{
+    std::unordered_map<uint64_t, CfiCie> cies;
+    DwarfReader reader(_frame);
+    while (reader.Remaining() >= 4)
+    {
+        uint64_t offset = reader.GetOffset();
+        bool is64 = false;
+        uint64_t length = reader.ReadUnitLength(is64);
+        if (length == 0)
+        {
+            if (_type == CfiSectionType::EhFrame)
+            {
+                break; // Terminator
+            }
+            continue;
+        }
+        uint64_t end = reader.GetOffset() + length;
+        if (end > _frame.size())
+        {
+            LOG(Logger::LogLevel::Warning, "Truncated call frame entry at offset 0x%lx", offset);
+            break;
+        }
+
+        DwarfReader entry(_frame.subspan(0, end), reader.GetOffset());
+        uint64_t idOffset = entry.GetOffset();
+        uint64_t id = entry.ReadOffset(is64);
+        bool isCie = _type == CfiSectionType::EhFrame ? id == EH_FRAME_CIE_ID : id == (is64 ? UINT64_MAX : UINT32_MAX);
+        reader.SetOffset(end);
+        if (isCie)
+        {
+            continue;
+        }
+
+        uint64_t cieOffset = _type == CfiSectionType::EhFrame ? idOffset - id : id;
+        auto cie = cies.find(cieOffset);
+        if (cie == cies.end())
+        {
+            cie = cies.emplace(cieOffset, ReadCie(cieOffset)).first;
+        }
+        uint64_t pc = ReadEncodedPointer(entry, cie->second.fdeEncoding, _frameAddress, 0);
+        uint64_t range = ReadEncodedPointer(entry, cie->second.fdeEncoding & 0x0f, _frameAddress, 0);
+        if (pc != 0 && range != 0) // FDEs of discarded sections are left at address 0
+        {
+            _table.push_back({pc, offset});
+        }
+    }
+
+    std::sort(_table.begin(), _table.end(), [](const auto &a, const auto &b) { return a.pc < b.pc; });
+    _table.erase(std::unique(_table.begin(), _table.end(), [](const auto &a, const auto &b) { return a.pc == b.pc; }),
+                 _table.end());
+}
+
+/**
+ * @brief Finds the FDE with the greatest start address not above pc, without reading it. The FDE may still end
+ * before pc.
+ *
+ * @return The offset of the FDE in the frame section, or std::nullopt if pc precedes every FDE.
+ */
+std::optional<uint64_t> CallFrameInfo::FindFdeOffset(uint64_t pc) const
+{
+    if (_hdrCount != 0)
+    {
+        // Entries are pairs of sdata4 offsets from the start of .eh_frame_hdr
+        auto entryPc = [this](size_t i) {
+            int32_t value;
+            std::memcpy(&value, _hdrTable.data() + i * 8, sizeof(value));
+            return _hdrAddress + static_cast<int64_t>(value);
+        };
+        size_t low = 0;
+        size_t high = _hdrCount;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            if (entryPc(middle) <= pc)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low == 0)
+        {
+            return std::nullopt;
+        }
+        int32_t fdeAddress;
+        std::memcpy(&fdeAddress, _hdrTable.data() + (low - 1) * 8 + 4, sizeof(fdeAddress));
+        return _hdrAddress + static_cast<int64_t>(fdeAddress) - _frameAddress;
+    }
+
+    auto it = std::upper_bound(_table.begin(), _table.end(), pc,
+                               [](uint64_t value, const CfiTableEntry &entry) { return value < entry.pc; });
+    if (it == _table.begin())
+    {
+        return std::nullopt;
+    }
+    return (--it)->fdeOffset;
+}
+
+/**
+ * @brief Reads a pointer in one of the DW_EH_PE_* encodings.
+ *
+ * @param reader The reader positioned at the pointer.
+ * @param encoding The encoding of the pointer.
+ * @param sectionAddress The virtual address of the section being read, for pcrel pointers.
+ * @param dataAddress The base of datarel pointers.
+ * @return The decoded pointer. For indirect pointers this is the address of the pointer itself.
+ * @throws std::runtime_error if the encoding is unsupported.
+ */
+uint64_t CallFrameInfo::ReadEncodedPointer(DwarfReader &reader, uint8_t encoding, uint64_t sectionAddress,
+                                           uint64_t dataAddress) const
+{
+    if (encoding == DW_EH_PE_omit)
+    {
+        return 0;
+    }
+
+    uint64_t position = reader.GetOffset();
+    uint64_t value;
+    switch (encoding & 0x0f)
+    {
+    case DW_EH_PE_absptr:
+        value = reader.ReadUnsigned(_addressSize);
+        break;
+    case DW_EH_PE_uleb128:
+        value = reader.ReadULEB128();
+        break;
+    case DW_EH_PE_udata2:
+        value = reader.ReadU16();
+        break;
+    case DW_EH_PE_udata4:
+        value = reader.ReadU32();
+        break;
+    case DW_EH_PE_udata8:
+        value = reader.ReadU64();
+        break;
+    case DW_EH_PE_sleb128:
+        value = static_cast<uint64_t>(reader.ReadSLEB128());
+        break;
+    case DW_EH_PE_sdata2:
+        value = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int16_t>(reader.ReadU16())));
+        break;
+    case DW_EH_PE_sdata4:
+        value = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(reader.ReadU32())));
+        break;
+    case DW_EH_PE_sdata8:
+        value = reader.ReadU64();
+        break;
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported pointer encoding 0x%x", encoding);
+    }
+
+    switch (encoding & 0x70)
+    {
+    case 0:
+        break;
+    case DW_EH_PE_pcrel:
+        value += sectionAddress + position;
+        break;
+    case DW_EH_PE_datarel:
+        value += dataAddress;
+        break;
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported pointer application 0x%x", encoding & 0x70);
+    }
+    return _addressSize == 4 ? value & UINT32_MAX : value;
+}
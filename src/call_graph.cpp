@@ -0,0 +1,287 @@
+#include "call_graph.hpp"
+#include "logger.hpp"
+#include "x86_decoder.hpp"
+#include <algorithm>
+
+// Run of consecutive functions swept by one task, with the rows it produced
+struct EdgeBatch
+{
+    uint32_t first;                 // First function of the batch
+    uint32_t last;                  // One past the last function
+    std::vector<uint32_t> rowSizes; // Distinct callees of each function
+    std::vector<uint32_t> callees;
+    std::vector<uint32_t> callSites;
+    size_t edgeOffset = 0; // Position of the batch's first edge in the merged arrays
+};
+
+/**
+ * @brief Constructor for the CallGraph class. Collects the functions, sweeps each of them for direct calls and
+ * tail calls, and builds the callee and caller rows.
+ *
+ * @param elfHandler The parsed file, which must outlive this object.
+ * @param pool The pool to spread the functions over, or nullptr to sweep on the calling thread.
+ * @throws std::runtime_error If the file is not x86-64.
+ */
+CallGraph::CallGraph(const ElfHandler &elfHandler, ThreadPool *pool) : _functions(elfHandler)
+{
+    if (elfHandler.GetMachine() != static_cast<uint16_t>(ElfMachine::EM_X86_64))
+        LOG_THROW(Logger::LogLevel::Error, "Call graphs need an x86-64 file, machine is %u", elfHandler.GetMachine());
+
+    if (_functions.GetFunctions().empty())
+    {
+        LOG(Logger::LogLevel::Warning, "No function symbols or call frame information in %s",
+            elfHandler.GetFileName().c_str());
+    }
+    BuildEdges(elfHandler, pool);
+    BuildCallers();
+}
+
+const CodeFunctions &CallGraph::GetFunctions() const
+{
+    return _functions;
+}
+
+size_t CallGraph::GetEdgeCount() const
+{
+    return _callees.size();
+}
+
+size_t CallGraph::GetCallSiteCount() const
+{
+    size_t count = 0;
+    for (uint32_t sites : _callSites)
+    {
+        count += sites;
+    }
+    return count;
+}
+
+/**
+ * @brief Lists the functions called, or tail called, by a function.
+ *
+ * @param function The index of the caller in GetFunctions().
+ * @return The callee indices in increasing order, each listed once.
+ */
+std::span<const uint32_t> CallGraph::GetCallees(uint32_t function) const
+{
+    return std::span<const uint32_t>(_callees).subspan(_calleeOffsets[function],
+                                                       _calleeOffsets[function + 1] - _calleeOffsets[function]);
+}
+
+/**
+ * @brief Lists the number of call sites behind each edge returned by GetCallees for the same function.
+ *
+ * @param function The index of the caller in GetFunctions().
+ * @return One count per callee, in the same order.
+ */
+std::span<const uint32_t> CallGraph::GetCallSites(uint32_t function) const
+{
+    return std::span<const uint32_t>(_callSites)
+        .subspan(_calleeOffsets[function], _calleeOffsets[function + 1] - _calleeOffsets[function]);
+}
+
+/**
+ * @brief Lists the functions calling, or tail calling, a function. The length of the list is the fan-in.
+ *
+ * @param function The index of the callee in GetFunctions().
+ * @return The caller indices in increasing order, each listed once.
+ */
+std::span<const uint32_t> CallGraph::GetCallers(uint32_t function) const
+{
+    return std::span<const uint32_t>(_callers).subspan(_callerOffsets[function],
+                                                       _callerOffsets[function + 1] - _callerOffsets[function]);
+}
+
+/**
+ * @brief Prints the number of functions, edges and call sites, then the functions with the most distinct callers,
+ * one per line: fan-in, incoming call sites, address and name. Ties are broken by call sites, then address.
+ *
+ * @param limit The number of functions to list.
+ */
+void CallGraph::PrintFanIn(size_t limit) const
+{
+    const std::vector<CodeFunction> &functions = _functions.GetFunctions();
+    std::vector<uint64_t> incomingSites(functions.size(), 0);
+    for (size_t i = 0; i < _callees.size(); i++)
+    {
+        incomingSites[_callees[i]] += _callSites[i];
+    }
+
+    std::vector<uint32_t> order(functions.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    limit = std::min(limit, order.size());
+    std::partial_sort(order.begin(), order.begin() + limit, order.end(), [&](uint32_t a, uint32_t b) {
+        uint32_t fanInA = _callerOffsets[a + 1] - _callerOffsets[a];
+        uint32_t fanInB = _callerOffsets[b + 1] - _callerOffsets[b];
+        if (fanInA != fanInB)
+            return fanInA > fanInB;
+        if (incomingSites[a] != incomingSites[b])
+            return incomingSites[a] > incomingSites[b];
+        return a < b;
+    });
+
+    printf("%lu functions from %s, %lu edges, %lu call sites\n", functions.size(),
+           FunctionSourceName(_functions.GetSource()), GetEdgeCount(), GetCallSiteCount());
+    for (size_t i = 0; i < limit; i++)
+    {
+        const CodeFunction &function = functions[order[i]];
+        printf("%8u %8lu 0x%lx %s\n", _callerOffsets[order[i] + 1] - _callerOffsets[order[i]],
+               incomingSites[order[i]], function.address, function.name.empty() ? "-" : function.name.c_str());
+    }
+}
+
+/**
+ * @brief Sweeps the functions in batches of consecutive functions. Each batch decodes its functions and keeps the
+ * sorted, deduplicated callees of each in arrays of its own; once every batch is done, their positions in the
+ * merged rows follow from a prefix sum and each batch copies its rows into its own slice, so no locks are taken.
+ *
+ * @param elfHandler The parsed file.
+ * @param pool The pool to spread the batches over, or nullptr.
+ */
+void CallGraph::BuildEdges(const ElfHandler &elfHandler, ThreadPool *pool)
+{
+    const std::vector<CodeFunction> &functions = _functions.GetFunctions();
+    std::vector<EdgeBatch> batches;
+    uint64_t batchBytes = 0;
+    for (uint32_t i = 0; i < functions.size(); i++)
+    {
+        if (batches.empty() || batchBytes >= CODE_FUNCTION_BATCH_SIZE)
+        {
+            batches.push_back({i, i, {}, {}, {}});
+            batchBytes = 0;
+        }
+        batches.back().last = i + 1;
+        batchBytes += functions[i].size;
+    }
+
+    auto sweepBatch = [&](EdgeBatch &batch) {
+        std::vector<uint32_t> targets;
+        batch.rowSizes.reserve(batch.last - batch.first);
+        for (uint32_t index = batch.first; index < batch.last; index++)
+        {
+            const CodeFunction &function = functions[index];
+            std::span<const uint8_t> code = _functions.GetCode(function);
+
+            targets.clear();
+            size_t offset = 0;
+            while (offset < code.size())
+            {
+                X86Instruction instruction;
+                if (!DecodeX86Instruction(code.subspan(offset), instruction))
+                {
+                    offset++;
+                    continue;
+                }
+                offset += instruction.length;
+                if (instruction.flow > X86FlowType::ConditionalJump || instruction.flow == X86FlowType::None)
+                {
+                    continue;
+                }
+
+                // Jumps only count when they leave the function; calls inside it only when they recurse
+                uint64_t target = function.address + offset + static_cast<int64_t>(instruction.displacement);
+                bool inside = target - function.address < function.size;
+                if (inside && (instruction.flow != X86FlowType::Call || target != function.address))
+                {
+                    continue;
+                }
+                std::optional<uint32_t> callee = inside ? index : _functions.Find(target);
+                if (callee.has_value())
+                {
+                    targets.push_back(*callee);
+                }
+            }
+
+            std::sort(targets.begin(), targets.end());
+            uint32_t rowSize = 0;
+            for (size_t i = 0; i < targets.size(); i++)
+            {
+                if (i == 0 || targets[i] != targets[i - 1])
+                {
+                    batch.callees.push_back(targets[i]);
+                    batch.callSites.push_back(0);
+                    rowSize++;
+                }
+                batch.callSites.back()++;
+            }
+            batch.rowSizes.push_back(rowSize);
+        }
+    };
+
+    auto copyBatch = [this](const EdgeBatch &batch) {
+        std::copy(batch.callees.begin(), batch.callees.end(), _callees.begin() + batch.edgeOffset);
+        std::copy(batch.callSites.begin(), batch.callSites.end(), _callSites.begin() + batch.edgeOffset);
+        uint32_t offset = static_cast<uint32_t>(batch.edgeOffset);
+        for (uint32_t i = batch.first; i < batch.last; i++)
+        {
+            _calleeOffsets[i] = offset;
+            offset += batch.rowSizes[i - batch.first];
+        }
+    };
+
+    auto forEachBatch = [&](auto &&task) {
+        if (pool == nullptr)
+        {
+            for (EdgeBatch &batch : batches)
+            {
+                task(batch);
+            }
+            return;
+        }
+        TaskGroup group(*pool);
+        for (EdgeBatch &batch : batches)
+        {
+            group.Submit([&task, &batch]() { task(batch); });
+        }
+        group.Wait();
+    };
+
+    forEachBatch(sweepBatch);
+
+    size_t edgeCount = 0;
+    for (EdgeBatch &batch : batches)
+    {
+        batch.edgeOffset = edgeCount;
+        edgeCount += batch.callees.size();
+    }
+    if (edgeCount > UINT32_MAX)
+        LOG_THROW(Logger::LogLevel::Error, "Call graph of %s has too many edges (%lu)",
+                  elfHandler.GetFileName().c_str(), edgeCount);
+
+    _calleeOffsets.resize(functions.size() + 1);
+    _calleeOffsets[functions.size()] = static_cast<uint32_t>(edgeCount);
+    _callees.resize(edgeCount);
+    _callSites.resize(edgeCount);
+    forEachBatch(copyBatch);
+}
+
+/**
+ * @brief Builds the caller rows from the callee rows with a counting sort. Callers are visited in increasing order,
+ * so each row comes out sorted.
+ */
+void CallGraph::BuildCallers()
+{
+    size_t count = _functions.GetFunctions().size();
+    _callerOffsets.assign(count + 1, 0);
+    for (uint32_t callee : _callees)
+    {
+        _callerOffsets[callee + 1]++;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        _callerOffsets[i + 1] += _callerOffsets[i];
+    }
+
+    _callers.resize(_callees.size());
+    std::vector<uint32_t> next(_callerOffsets.begin(), _callerOffsets.end() - 1);
+    for (uint32_t caller = 0; caller < count; caller++)
+    {
+        for (uint32_t edge = _calleeOffsets[caller]; edge < _calleeOffsets[caller + 1]; edge++)
+        {
+            _callers[next[_callees[edge]]++] = caller;
+        }
+    }
+}
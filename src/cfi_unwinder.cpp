@@ -0,0 +1,816 @@
+#include "cfi_unwinder.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Largest stack a DWARF expression may build
+constexpr size_t DWARF_EXPRESSION_STACK_SIZE = 64;
+
+// Operations evaluated before an expression is considered to loop
+constexpr size_t DWARF_EXPRESSION_MAX_STEPS = 4096;
+
+// Samples unwound by one task of UnwindBatch
+constexpr size_t UNWIND_BATCH_CHUNK = 64;
+
+/**
+ * @brief Constructor for the CfiUnwinder class.
+ *
+ * @param callFrames The call frame information of the binary; must outlive the unwinder.
+ * @param machine The ELF machine of the binary, which fixes the stack and frame pointer registers.
+ * @param loadBias The difference between the runtime addresses of the samples and the addresses in the file.
+ * @throws std::runtime_error if the machine is not supported.
+ */
+CfiUnwinder::CfiUnwinder(const CallFrameInfo &callFrames, uint16_t machine, uint64_t loadBias)
+    : _callFrames(callFrames), _loadBias(loadBias)
+{
+    switch (static_cast<ElfMachine>(machine))
+    {
+    case ElfMachine::EM_X86_64:
+        _addressSize = 8;
+        _stackPointer = 7;
+        _framePointer = 6;
+        break;
+    case ElfMachine::EM_386:
+        _addressSize = 4;
+        _stackPointer = 4;
+        _framePointer = 5;
+        break;
+    case ElfMachine::EM_AARCH64:
+        _addressSize = 8;
+        _stackPointer = 31;
+        _framePointer = 29;
+        break;
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Unwinding is not supported for machine %u", machine);
+    }
+}
+
+/**
+ * @brief Unwinds the stack of one sample.
+ *
+ * @param sample The captured registers and stack.
+ * @param maxFrames The most frames to return.
+ * @return The program counters of the stack, innermost first, and why unwinding stopped.
+ */
+UnwindResult CfiUnwinder::Unwind(const UnwindSample &sample, size_t maxFrames)
+{
+    UnwindResult result{{}, UnwindStopReason::MaxFrames};
+    RegisterState state{sample.registers, sample.validRegisters};
+    uint64_t stackPointerBit = 1ULL << _stackPointer;
+    uint64_t pc = sample.pc;
+    bool callerOfSignalFrame = true; // The sampled pc is not a return address
+    if (pc == 0 || maxFrames == 0)
+    {
+        result.reason = UnwindStopReason::EndOfStack;
+        return result;
+    }
+    result.frames.push_back(pc);
+
+    while (result.frames.size() < maxFrames)
+    {
+        // A return address points after the call, which may be the first address of the next function
+        uint64_t filePc = (callerOfSignalFrame ? pc : pc - 1) - _loadBias;
+        std::shared_ptr<const CfiFdeRows> rows;
+        if (auto fdeOffset = _callFrames.FindFdeOffset(filePc))
+        {
+            rows = GetRows(*fdeOffset);
+            if (rows != nullptr && (filePc < rows->pcBegin || filePc >= rows->pcEnd))
+            {
+                rows = nullptr;
+            }
+        }
+
+        RegisterState caller = state;
+        uint64_t cfa;
+        uint64_t returnAddress;
+        if (rows == nullptr)
+        {
+            // Frame record of the frame pointer chain: saved frame pointer, then the return address
+            uint64_t framePointerBit = 1ULL << _framePointer;
+            uint64_t framePointer = state.values[_framePointer];
+            uint64_t savedFramePointer;
+            if ((state.valid & framePointerBit) == 0 || !ReadStack(sample, framePointer, savedFramePointer) ||
+                !ReadStack(sample, framePointer + _addressSize, returnAddress))
+            {
+                result.reason = UnwindStopReason::NoFrameInfo;
+                return result;
+            }
+            cfa = framePointer + 2 * _addressSize;
+            caller.values[_framePointer] = savedFramePointer;
+            callerOfSignalFrame = false;
+        }
+        else
+        {
+            const CfiRow &row = *--std::upper_bound(rows->rows.begin(), rows->rows.end(), filePc,
+                                                    [](uint64_t value, const CfiRow &r) { return value < r.pcBegin; });
+            if (!row.cfaExpression.empty())
+            {
+                if (!Evaluate(row.cfaExpression, sample, state, false, 0, cfa))
+                {
+                    result.reason = UnwindStopReason::BadExpression;
+                    return result;
+                }
+            }
+            else if (row.cfaRegister < CFI_REGISTER_COUNT && (state.valid & (1ULL << row.cfaRegister)) != 0)
+            {
+                cfa = state.values[row.cfaRegister] + row.cfaOffset;
+            }
+            else
+            {
+                result.reason = UnwindStopReason::InvalidCfa;
+                return result;
+            }
+
+            bool returnAddressLost = false;
+            for (uint32_t i = row.firstRule; i < row.firstRule + row.ruleCount; i++)
+            {
+                const CfiRegisterRule &rule = rows->rules[i];
+                uint64_t bit = 1ULL << rule.column;
+                uint64_t &value = caller.values[rule.column];
+                bool ok = true;
+                switch (rule.type)
+                {
+                case CfiRuleType::Undefined:
+                    caller.valid &= ~bit;
+                    continue;
+                case CfiRuleType::SameValue:
+                    continue;
+                case CfiRuleType::Offset:
+                    ok = ReadStack(sample, cfa + rule.value, value);
+                    break;
+                case CfiRuleType::ValOffset:
+                    value = cfa + rule.value;
+                    break;
+                case CfiRuleType::Register:
+                    ok = uint64_t(rule.value) < CFI_REGISTER_COUNT && (state.valid & (1ULL << rule.value)) != 0;
+                    value = ok ? state.values[rule.value] : 0;
+                    break;
+                case CfiRuleType::Expression: {
+                    uint64_t address;
+                    ok = Evaluate(rule.expression, sample, state, true, cfa, address) &&
+                         ReadStack(sample, address, value);
+                }
+                break;
+                case CfiRuleType::ValExpression:
+                    ok = Evaluate(rule.expression, sample, state, true, cfa, value);
+                    break;
+                }
+                if (ok)
+                    caller.valid |= bit;
+                else
+                    caller.valid &= ~bit;
+                returnAddressLost |= !ok && rule.column == rows->returnAddressColumn;
+            }
+
+            uint64_t returnBit = 1ULL << rows->returnAddressColumn;
+            if (rows->returnAddressColumn >= CFI_REGISTER_COUNT || (caller.valid & returnBit) == 0)
+            {
+                result.reason = returnAddressLost ? UnwindStopReason::StackExhausted : UnwindStopReason::EndOfStack;
+                return result;
+            }
+            returnAddress = caller.values[rows->returnAddressColumn];
+            callerOfSignalFrame = rows->signalFrame;
+        }
+
+        // The caller's stack pointer is the CFA, which must lie above the callee's
+        if ((state.valid & stackPointerBit) != 0 && cfa <= state.values[_stackPointer])
+        {
+            result.reason = UnwindStopReason::InvalidCfa;
+            return result;
+        }
+        if (returnAddress == 0)
+        {
+            result.reason = UnwindStopReason::EndOfStack;
+            return result;
+        }
+        caller.values[_stackPointer] = cfa;
+        caller.valid |= stackPointerBit;
+        state = caller;
+        pc = returnAddress;
+        result.frames.push_back(pc);
+    }
+    return result;
+}
+
+/**
+ * @brief Unwinds many samples on a thread pool.
+ *
+ * @param samples The captured registers and stacks.
+ * @param pool The pool to run on.
+ * @param maxFrames The most frames to return per sample.
+ * @return The unwound stacks, in the order of the samples.
+ */
+std::vector<UnwindResult> CfiUnwinder::UnwindBatch(std::span<const UnwindSample> samples, ThreadPool &pool,
+                                                   size_t maxFrames)
+{
+    std::vector<UnwindResult> results(samples.size());
+    TaskGroup group(pool);
+    for (size_t start = 0; start < samples.size(); start += UNWIND_BATCH_CHUNK)
+    {
+        group.Submit([&, start]() {
+            size_t end = std::min(start + UNWIND_BATCH_CHUNK, samples.size());
+            for (size_t i = start; i < end; i++)
+            {
+                results[i] = Unwind(samples[i], maxFrames);
+            }
+        });
+    }
+    group.Wait();
+    return results;
+}
+
+/**
+ * @brief Returns the decoded unwind table of an FDE, decoding it on first use. Safe to call concurrently.
+ *
+ * @param fdeOffset The offset of the FDE in the frame section.
+ * @return The table, or nullptr if the FDE could not be decoded.
+ */
+std::shared_ptr<const CfiFdeRows> CfiUnwinder::GetRows(uint64_t fdeOffset)
+{
+    CacheShard &shard = _cache[(fdeOffset >> 3) % CACHE_SHARD_COUNT];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.rows.find(fdeOffset);
+        if (found != shard.rows.end())
+        {
+            return found->second;
+        }
+    }
+
+    std::shared_ptr<const CfiFdeRows> rows;
+    try
+    {
+        rows = DecodeRows(fdeOffset);
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Warning, "Failed to decode the FDE at offset 0x%lx", fdeOffset);
+    }
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.rows.emplace(fdeOffset, std::move(rows)).first->second;
+}
+
+/**
+ * @brief Runs the CIE and FDE instructions of an FDE and records a row for every address range they describe.
+ */
+std::shared_ptr<const CfiFdeRows> CfiUnwinder::DecodeRows(uint64_t fdeOffset) const
+{
+    CfiCie cie;
+    CfiFde fde = _callFrames.ReadFde(fdeOffset, &cie);
+    auto rows = std::make_shared<CfiFdeRows>();
+    rows->pcBegin = fde.pcBegin;
+    rows->pcEnd = fde.pcEnd;
+    rows->returnAddressColumn = cie.returnAddressRegister;
+    rows->signalFrame = cie.signalFrame;
+
+    struct State
+    {
+        uint16_t cfaRegister = 0;
+        int64_t cfaOffset = 0;
+        std::span<const uint8_t> cfaExpression;
+        std::array<CfiRegisterRule, CFI_REGISTER_COUNT> rules{};
+        uint64_t defined = 0; // Columns with a rule
+    };
+    State state;
+    State initial;
+    std::vector<State> remembered;
+    uint64_t location = fde.pcBegin;
+
+    auto emitRow = [&](uint64_t end) {
+        if (end <= location)
+        {
+            return;
+        }
+        CfiRow row{location, end, state.cfaRegister, state.cfaOffset, state.cfaExpression,
+                   static_cast<uint32_t>(rows->rules.size()), 0};
+        for (uint16_t column = 0; column < CFI_REGISTER_COUNT; column++)
+        {
+            if ((state.defined & (1ULL << column)) != 0)
+            {
+                rows->rules.push_back(state.rules[column]);
+                row.ruleCount++;
+            }
+        }
+        rows->rows.push_back(row);
+        location = end;
+    };
+    auto setRule = [&state](uint64_t column, CfiRuleType type, int64_t value,
+                            std::span<const uint8_t> expression = {}) {
+        if (column < CFI_REGISTER_COUNT)
+        {
+            state.rules[column] = {static_cast<uint16_t>(column), type, value, expression};
+            state.defined |= 1ULL << column;
+        }
+    };
+    auto restoreRule = [&state, &initial](uint64_t column) {
+        if (column < CFI_REGISTER_COUNT)
+        {
+            uint64_t bit = 1ULL << column;
+            state.rules[column] = initial.rules[column];
+            state.defined = (state.defined & ~bit) | (initial.defined & bit);
+        }
+    };
+
+    auto execute = [&](std::span<const uint8_t> instructions) {
+        DwarfReader reader(instructions);
+        int64_t dataAlignment = cie.dataAlignment;
+        while (!reader.AtEnd())
+        {
+            uint8_t opcode = reader.ReadU8();
+            uint8_t operand = opcode & 0x3f;
+            switch (opcode & 0xc0)
+            {
+            case DW_CFA_advance_loc:
+                emitRow(location + operand * cie.codeAlignment);
+                continue;
+            case DW_CFA_offset:
+                setRule(operand, CfiRuleType::Offset, int64_t(reader.ReadULEB128()) * dataAlignment);
+                continue;
+            case DW_CFA_restore:
+                restoreRule(operand);
+                continue;
+            }
+
+            switch (opcode)
+            {
+            case DW_CFA_nop:
+                break;
+            case DW_CFA_set_loc:
+                emitRow(_callFrames.ReadLocation(reader, instructions, cie));
+                break;
+            case DW_CFA_advance_loc1:
+                emitRow(location + reader.ReadU8() * cie.codeAlignment);
+                break;
+            case DW_CFA_advance_loc2:
+                emitRow(location + reader.ReadU16() * cie.codeAlignment);
+                break;
+            case DW_CFA_advance_loc4:
+                emitRow(location + reader.ReadU32() * cie.codeAlignment);
+                break;
+            case DW_CFA_offset_extended: {
+                uint64_t column = reader.ReadULEB128();
+                setRule(column, CfiRuleType::Offset, int64_t(reader.ReadULEB128()) * dataAlignment);
+            }
+            break;
+            case DW_CFA_restore_extended:
+                restoreRule(reader.ReadULEB128());
+                break;
+            case DW_CFA_undefined:
+                setRule(reader.ReadULEB128(), CfiRuleType::Undefined, 0);
+                break;
+            case DW_CFA_same_value:
+                setRule(reader.ReadULEB128(), CfiRuleType::SameValue, 0);
+                break;
+            case DW_CFA_register: {
+                uint64_t column = reader.ReadULEB128();
+                uint64_t source = reader.ReadULEB128();
+                // A register outside the tracked set cannot be recovered
+                setRule(column, source < CFI_REGISTER_COUNT ? CfiRuleType::Register : CfiRuleType::Undefined,
+                        source < CFI_REGISTER_COUNT ? int64_t(source) : 0);
+            }
+            break;
+            case DW_CFA_remember_state:
+                remembered.push_back(state);
+                break;
+            case DW_CFA_restore_state:
+                if (remembered.empty())
+                {
+                    LOG_THROW(Logger::LogLevel::Error, "DW_CFA_restore_state without a remembered state");
+                }
+                state = remembered.back();
+                remembered.pop_back();
+                break;
+            case DW_CFA_def_cfa:
+                state.cfaRegister = static_cast<uint16_t>(reader.ReadULEB128());
+                state.cfaOffset = int64_t(reader.ReadULEB128());
+                state.cfaExpression = {};
+                break;
+            case DW_CFA_def_cfa_sf:
+                state.cfaRegister = static_cast<uint16_t>(reader.ReadULEB128());
+                state.cfaOffset = reader.ReadSLEB128() * dataAlignment;
+                state.cfaExpression = {};
+                break;
+            case DW_CFA_def_cfa_register:
+                state.cfaRegister = static_cast<uint16_t>(reader.ReadULEB128());
+                state.cfaExpression = {};
+                break;
+            case DW_CFA_def_cfa_offset:
+                state.cfaOffset = int64_t(reader.ReadULEB128());
+                break;
+            case DW_CFA_def_cfa_offset_sf:
+                state.cfaOffset = reader.ReadSLEB128() * dataAlignment;
+                break;
+            case DW_CFA_def_cfa_expression:
+                state.cfaExpression = reader.ReadBytes(reader.ReadULEB128());
+                break;
+            case DW_CFA_expression:
+            case DW_CFA_val_expression: {
+                uint64_t column = reader.ReadULEB128();
+                auto expression = reader.ReadBytes(reader.ReadULEB128());
+                setRule(column, opcode == DW_CFA_expression ? CfiRuleType::Expression : CfiRuleType::ValExpression,
+                        0, expression);
+            }
+            break;
+            case DW_CFA_offset_extended_sf: {
+                uint64_t column = reader.ReadULEB128();
+                setRule(column, CfiRuleType::Offset, reader.ReadSLEB128() * dataAlignment);
+            }
+            break;
+            case DW_CFA_val_offset: {
+                uint64_t column = reader.ReadULEB128();
+                setRule(column, CfiRuleType::ValOffset, int64_t(reader.ReadULEB128()) * dataAlignment);
+            }
+            break;
+            case DW_CFA_val_offset_sf: {
+                uint64_t column = reader.ReadULEB128();
+                setRule(column, CfiRuleType::ValOffset, reader.ReadSLEB128() * dataAlignment);
+            }
+            break;
+            case DW_CFA_GNU_args_size:
+                reader.ReadULEB128();
+                break;
+            case DW_CFA_GNU_negative_offset_extended: {
+                uint64_t column = reader.ReadULEB128();
+                setRule(column, CfiRuleType::Offset, -int64_t(reader.ReadULEB128()) * dataAlignment);
+            }
+            break;
+            case 0x2d: // DW_CFA_GNU_window_save (SPARC), DW_CFA_AARCH64_negate_ra_state; no registers to track
+                break;
+            default:
+                LOG_THROW(Logger::LogLevel::Error, "Unsupported call frame instruction 0x%x", opcode);
+            }
+        }
+    };
+
+    execute(cie.initialInstructions);
+    initial = state;
+    execute(fde.instructions);
+    emitRow(fde.pcEnd);
+    if (rows->rows.empty())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "FDE at offset 0x%lx covers no addresses", fdeOffset);
+    }
+    rows->rows.shrink_to_fit();
+    rows->rules.shrink_to_fit();
+    return rows;
+}
+
+/**
+ * @brief Reads a pointer sized value from the captured stack.
+ *
+ * @return false if the value lies outside the captured bytes.
+ */
+bool CfiUnwinder::ReadStack(const UnwindSample &sample, uint64_t address, uint64_t &value) const
+{
+    if (address < sample.stackAddress || address - sample.stackAddress > sample.stack.size() ||
+        sample.stack.size() - (address - sample.stackAddress) < _addressSize)
+    {
+        return false;
+    }
+    value = 0;
+    std::memcpy(&value, sample.stack.data() + (address - sample.stackAddress), _addressSize);
+    return true;
+}
+
+/**
+ * @brief Evaluates a DWARF expression of a CFA or register rule. Memory reads are limited to the captured stack.
+ *
+ * @param expression The expression.
+ * @param sample The sample, for memory reads.
+ * @param state The registers of the frame being unwound.
+ * @param pushCfa Whether the CFA is pushed before evaluation, as for register rules.
+ * @param cfa The CFA.
+ * @param result Receives the value on top of the stack.
+ * @return false if the expression is malformed, unsupported, or reads outside the known registers and stack.
+ */
+bool CfiUnwinder::Evaluate(std::span<const uint8_t> expression, const UnwindSample &sample,
+                           const RegisterState &state, bool pushCfa, uint64_t cfa, uint64_t &result) const
+{
+    std::array<uint64_t, DWARF_EXPRESSION_STACK_SIZE> stack;
+    size_t depth = 0;
+    auto push = [&](uint64_t value) {
+        if (depth == stack.size())
+        {
+            return false;
+        }
+        stack[depth++] = value;
+        return true;
+    };
+    auto registerValue = [&state](uint64_t column, uint64_t &value) {
+        if (column >= CFI_REGISTER_COUNT || (state.valid & (1ULL << column)) == 0)
+        {
+            return false;
+        }
+        value = state.values[column];
+        return true;
+    };
+    if (pushCfa)
+    {
+        push(cfa);
+    }
+
+    try
+    {
+        DwarfReader reader(expression);
+        for (size_t step = 0; !reader.AtEnd(); step++)
+        {
+            if (step == DWARF_EXPRESSION_MAX_STEPS)
+                return false;
+            uint8_t opcode = reader.ReadU8();
+            uint64_t value = 0;
+            if (opcode >= DW_OP_lit0 && opcode <= DW_OP_lit31)
+            {
+                if (!push(opcode - DW_OP_lit0))
+                    return false;
+                continue;
+            }
+            if ((opcode >= DW_OP_breg0 && opcode <= DW_OP_breg31) || opcode == DW_OP_bregx)
+            {
+                uint64_t column = opcode == DW_OP_bregx ? reader.ReadULEB128() : opcode - DW_OP_breg0;
+                int64_t offset = reader.ReadSLEB128();
+                if (!registerValue(column, value) || !push(value + offset))
+                    return false;
+                continue;
+            }
+            if ((opcode >= DW_OP_reg0 && opcode <= DW_OP_reg31) || opcode == DW_OP_regx)
+            {
+                return false; // Register locations do not compute an address or value
+            }
+
+            // Binary operations take the top two entries and push one
+            if (opcode >= DW_OP_and && opcode <= DW_OP_ne && opcode != DW_OP_neg && opcode != DW_OP_not &&
+                opcode != DW_OP_plus_uconst && opcode != DW_OP_bra)
+            {
+                if (depth < 2)
+                    return false;
+                uint64_t b = stack[--depth];
+                uint64_t a = stack[depth - 1];
+                uint64_t &top = stack[depth - 1];
+                switch (opcode)
+                {
+                case DW_OP_and:
+                    top = a & b;
+                    break;
+                case DW_OP_div:
+                    if (b == 0)
+                        return false;
+                    top = static_cast<uint64_t>(static_cast<int64_t>(a) / static_cast<int64_t>(b));
+                    break;
+                case DW_OP_minus:
+                    top = a - b;
+                    break;
+                case DW_OP_mod:
+                    if (b == 0)
+                        return false;
+                    top = a % b;
+                    break;
+                case DW_OP_mul:
+                    top = a * b;
+                    break;
+                case DW_OP_or:
+                    top = a | b;
+                    break;
+                case DW_OP_plus:
+                    top = a + b;
+                    break;
+                case DW_OP_shl:
+                    top = b < 64 ? a << b : 0;
+                    break;
+                case DW_OP_shr:
+                    top = b < 64 ? a >> b : 0;
+                    break;
+                case DW_OP_shra:
+                    top = static_cast<uint64_t>(static_cast<int64_t>(a) >> std::min<uint64_t>(b, 63));
+                    break;
+                case DW_OP_xor:
+                    top = a ^ b;
+                    break;
+                case DW_OP_eq:
+                    top = a == b;
+                    break;
+                case DW_OP_ge:
+                    top = static_cast<int64_t>(a) >= static_cast<int64_t>(b);
+                    break;
+                case DW_OP_gt:
+                    top = static_cast<int64_t>(a) > static_cast<int64_t>(b);
+                    break;
+                case DW_OP_le:
+                    top = static_cast<int64_t>(a) <= static_cast<int64_t>(b);
+                    break;
+                case DW_OP_lt:
+                    top = static_cast<int64_t>(a) < static_cast<int64_t>(b);
+                    break;
+                case DW_OP_ne:
+                    top = a != b;
+                    break;
+                default:
+                    return false;
+                }
+                continue;
+            }
+
+            switch (opcode)
+            {
+            case DW_OP_addr:
+                value = reader.ReadUnsigned(_addressSize) + _loadBias;
+                break;
+            case DW_OP_const1u:
+                value = reader.ReadU8();
+                break;
+            case DW_OP_const1s:
+                value = static_cast<uint64_t>(static_cast<int8_t>(reader.ReadU8()));
+                break;
+            case DW_OP_const2u:
+                value = reader.ReadU16();
+                break;
+            case DW_OP_const2s:
+                value = static_cast<uint64_t>(static_cast<int16_t>(reader.ReadU16()));
+                break;
+            case DW_OP_const4u:
+                value = reader.ReadU32();
+                break;
+            case DW_OP_const4s:
+                value = static_cast<uint64_t>(static_cast<int32_t>(reader.ReadU32()));
+                break;
+            case DW_OP_const8u:
+            case DW_OP_const8s:
+                value = reader.ReadU64();
+                break;
+            case DW_OP_constu:
+                value = reader.ReadULEB128();
+                break;
+            case DW_OP_consts:
+                value = static_cast<uint64_t>(reader.ReadSLEB128());
+                break;
+            case DW_OP_dup:
+            case DW_OP_over:
+            case DW_OP_pick: {
+                uint64_t index = opcode == DW_OP_dup ? 0 : opcode == DW_OP_over ? 1 : reader.ReadU8();
+                if (index >= depth)
+                    return false;
+                value = stack[depth - 1 - index];
+            }
+            break;
+            case DW_OP_drop:
+                if (depth == 0)
+                    return false;
+                depth--;
+                continue;
+            case DW_OP_swap:
+                if (depth < 2)
+                    return false;
+                std::swap(stack[depth - 1], stack[depth - 2]);
+                continue;
+            case DW_OP_rot:
+                if (depth < 3)
+                    return false;
+                std::rotate(stack.begin() + depth - 3, stack.begin() + depth - 1, stack.begin() + depth);
+                continue;
+            case DW_OP_deref:
+                if (depth == 0 || !ReadStack(sample, stack[depth - 1], stack[depth - 1]))
+                    return false;
+                continue;
+            case DW_OP_abs:
+            case DW_OP_neg:
+            case DW_OP_not:
+            case DW_OP_plus_uconst: {
+                if (depth == 0)
+                    return false;
+                uint64_t &top = stack[depth - 1];
+                if (opcode == DW_OP_abs)
+                    top = static_cast<int64_t>(top) < 0 ? -top : top;
+                else if (opcode == DW_OP_neg)
+                    top = -top;
+                else if (opcode == DW_OP_not)
+                    top = ~top;
+                else
+                    top += reader.ReadULEB128();
+            }
+                continue;
+            case DW_OP_skip:
+            case DW_OP_bra: {
+                int16_t skip = static_cast<int16_t>(reader.ReadU16());
+                if (opcode == DW_OP_bra)
+                {
+                    if (depth == 0)
+                        return false;
+                    if (stack[--depth] == 0)
+                        continue;
+                }
+                int64_t target = static_cast<int64_t>(reader.GetOffset()) + skip;
+                if (target < 0 || static_cast<uint64_t>(target) > expression.size())
+                    return false;
+                reader.SetOffset(static_cast<uint64_t>(target));
+            }
+                continue;
+            case DW_OP_nop:
+                continue;
+            default:
+                return false;
+            }
+            if (!push(value))
+                return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        return false;
+    }
+
+    if (depth == 0)
+    {
+        return false;
+    }
+    result = stack[depth - 1];
+    return true;
+}
+
+/**
+ * @brief Constructor for the UnwindSampleFile class. Maps a capture file and indexes its samples; the stacks of the
+ * samples point into the mapping.
+ *
+ * @param fileName The capture file.
+ * @throws std::runtime_error if the file cannot be read, is not a capture file or a record is truncated.
+ */
+UnwindSampleFile::UnwindSampleFile(const std::string &fileName) : _file(fileName)
+{
+    std::span<const uint8_t> data = _file.Slice(0, _file.Size());
+    if (data.size() < sizeof(UNWIND_SAMPLES_MAGIC) ||
+        std::memcmp(data.data(), UNWIND_SAMPLES_MAGIC, sizeof(UNWIND_SAMPLES_MAGIC)) != 0)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "%s is not a sample capture file", fileName.c_str());
+    }
+
+    DwarfReader reader(data, sizeof(UNWIND_SAMPLES_MAGIC));
+    try
+    {
+        while (!reader.AtEnd())
+        {
+            UnwindSample &sample = _samples.emplace_back();
+            sample.pc = reader.ReadU64();
+            uint64_t mask = reader.ReadU64();
+            for (size_t column = 0; column < 64; column++)
+            {
+                if ((mask & (1ULL << column)) == 0)
+                {
+                    continue;
+                }
+                uint64_t value = reader.ReadU64();
+                if (column < CFI_REGISTER_COUNT) // Registers the unwinder does not track are skipped
+                {
+                    sample.registers[column] = value;
+                    sample.validRegisters |= 1ULL << column;
+                }
+            }
+            sample.stackAddress = reader.ReadU64();
+            sample.stack = reader.ReadBytes(reader.ReadU64());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Truncated sample %zu in %s", _samples.size() - 1, fileName.c_str());
+    }
+}
+
+const std::vector<UnwindSample> &UnwindSampleFile::GetSamples() const
+{
+    return _samples;
+}
+
+static const char *StopReasonName(UnwindStopReason reason)
+{
+    switch (reason)
+    {
+    case UnwindStopReason::EndOfStack:
+        return "end of stack";
+    case UnwindStopReason::MaxFrames:
+        return "frame limit";
+    case UnwindStopReason::NoFrameInfo:
+        return "no frame info";
+    case UnwindStopReason::InvalidCfa:
+        return "invalid CFA";
+    case UnwindStopReason::StackExhausted:
+        return "stack exhausted";
+    case UnwindStopReason::BadExpression:
+        return "bad expression";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Unwinds the samples on a pool and prints one line per sample: its index, the program counters innermost
+ * first, and why unwinding stopped.
+ */
+void PrintUnwoundStacks(CfiUnwinder &unwinder, std::span<const UnwindSample> samples, ThreadPool &pool)
+{
+    std::vector<UnwindResult> results = unwinder.UnwindBatch(samples, pool);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        printf("%zu:", i);
+        for (uint64_t pc : results[i].frames)
+        {
+            printf(" 0x%lx", pc);
+        }
+        printf(" (%s)\n", StopReasonName(results[i].reason));
+    }
+}
@@ -0,0 +1,290 @@
+#include "code_functions.hpp"
+#include "call_frame.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+static bool IsFunctionSymbol(const ElfSymbol &symbol)
+{
+    return (symbol.type == SymbolType::STT_FUNC || symbol.type == SymbolType::STT_GNU_IFUNC) && symbol.size != 0;
+}
+
+/**
+ * @brief Constructor for the CodeFunctions class. Collects the function boundaries and keeps a view of every section
+ * so that the code of a function can be looked up without the ElfHandler.
+ *
+ * @param elfHandler The parsed file, which must outlive this object.
+ */
+CodeFunctions::CodeFunctions(const ElfHandler &elfHandler)
+{
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        if (section.index >= _sectionCode.size())
+        {
+            _sectionCode.resize(section.index + 1);
+            _sectionAddresses.resize(section.index + 1, 0);
+        }
+        _sectionCode[section.index] = elfHandler.GetSectionData(section);
+        _sectionAddresses[section.index] = section.addr;
+    }
+    CollectFunctions(elfHandler);
+}
+
+FunctionSource CodeFunctions::GetSource() const
+{
+    return _source;
+}
+
+const std::vector<CodeFunction> &CodeFunctions::GetFunctions() const
+{
+    return _functions;
+}
+
+/**
+ * @brief Finds the function containing an address.
+ *
+ * @param address The address.
+ * @return The index of the function in GetFunctions(), or std::nullopt if no function covers the address.
+ */
+std::optional<uint32_t> CodeFunctions::Find(uint64_t address) const
+{
+    auto it = std::upper_bound(_functions.begin(), _functions.end(), address,
+                               [](uint64_t value, const CodeFunction &function) { return value < function.address; });
+    if (it == _functions.begin())
+    {
+        return std::nullopt;
+    }
+    --it;
+    if (address - it->address >= it->size)
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(it - _functions.begin());
+}
+
+/**
+ * @brief Returns the bytes of a range of code.
+ *
+ * @param sectionIndex The section table index of the section holding the range.
+ * @param address The address of the range, inside the section.
+ * @param size The size of the range, which must not extend past the section.
+ */
+std::span<const uint8_t> CodeFunctions::GetCode(uint32_t sectionIndex, uint64_t address, uint64_t size) const
+{
+    return _sectionCode[sectionIndex].subspan(address - _sectionAddresses[sectionIndex], size);
+}
+
+std::span<const uint8_t> CodeFunctions::GetCode(const CodeFunction &function) const
+{
+    return GetCode(function.sectionIndex, function.address, function.size);
+}
+
+/**
+ * @brief Collects the function boundaries: sized function symbols of .symtab, or in stripped files the FDE ranges of
+ * .eh_frame or .debug_frame, and failing both the exported functions of .dynsym. Only code inside an executable
+ * section with file content is kept. Of several symbols starting at the same address the global one is kept, and a
+ * function overlapping the next one is cut short so that every address belongs to at most one function.
+ *
+ * @param elfHandler The parsed file.
+ */
+void CodeFunctions::CollectFunctions(const ElfHandler &elfHandler)
+{
+    std::vector<const ElfSection *> codeSections;
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        if ((section.flags & SectionHeaderFlags::SHF_EXECINSTR) != 0 &&
+            section.type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+        {
+            codeSections.push_back(&section);
+        }
+    }
+    auto findSection = [&codeSections](uint64_t address, uint64_t size) -> const ElfSection * {
+        for (const ElfSection *section : codeSections)
+        {
+            if (address >= section->addr && address - section->addr < section->size &&
+                size <= section->addr + section->size - address)
+            {
+                return section;
+            }
+        }
+        return nullptr;
+    };
+
+    auto addSymbols = [&](std::vector<ElfSymbol> symbols) {
+        auto rank = [](const ElfSymbol &symbol) { return symbol.binding == SymbolBinding::STB_GLOBAL ? 0 : 1; };
+        symbols.erase(std::remove_if(symbols.begin(), symbols.end(),
+                                     [](const ElfSymbol &symbol) { return !IsFunctionSymbol(symbol); }),
+                      symbols.end());
+        std::sort(symbols.begin(), symbols.end(), [&rank](const ElfSymbol &a, const ElfSymbol &b) {
+            if (a.value != b.value)
+                return a.value < b.value;
+            return rank(a) < rank(b);
+        });
+        for (ElfSymbol &symbol : symbols)
+        {
+            if (!_functions.empty() && _functions.back().address == symbol.value)
+            {
+                continue;
+            }
+            const ElfSection *section = findSection(symbol.value, symbol.size);
+            if (section != nullptr && section->index == symbol.sectionIndex)
+            {
+                _functions.push_back({symbol.value, symbol.size, section->index, std::move(symbol.name)});
+            }
+        }
+    };
+
+    addSymbols(elfHandler.GetSymbols());
+    _source = FunctionSource::Symbols;
+    if (_functions.empty())
+    {
+        CallFrameInfo callFrames(elfHandler);
+        if (callFrames.GetTableSource() == CfiTableSource::None)
+        {
+            callFrames = CallFrameInfo(elfHandler, CfiSectionType::DebugFrame);
+        }
+
+        std::vector<ElfSymbol> exports = elfHandler.GetDynamicSymbols();
+        exports.erase(std::remove_if(exports.begin(), exports.end(),
+                                     [](const ElfSymbol &symbol) { return !IsFunctionSymbol(symbol); }),
+                      exports.end());
+        std::sort(exports.begin(), exports.end(), [](const ElfSymbol &a, const ElfSymbol &b) {
+            if (a.value != b.value)
+                return a.value < b.value;
+            return a.binding == SymbolBinding::STB_GLOBAL && b.binding != SymbolBinding::STB_GLOBAL;
+        });
+
+        for (const auto &[begin, end] : callFrames.GetFunctionRanges())
+        {
+            if (end <= begin || (!_functions.empty() && _functions.back().address == begin))
+            {
+                continue;
+            }
+            const ElfSection *section = findSection(begin, end - begin);
+            if (section == nullptr)
+            {
+                continue;
+            }
+            auto it = std::lower_bound(exports.begin(), exports.end(), begin,
+                                       [](const ElfSymbol &symbol, uint64_t value) { return symbol.value < value; });
+            std::string name = it != exports.end() && it->value == begin ? it->name : std::string();
+            _functions.push_back({begin, end - begin, section->index, std::move(name)});
+        }
+        _source = FunctionSource::CallFrames;
+    }
+    if (_functions.empty())
+    {
+        addSymbols(elfHandler.GetDynamicSymbols());
+        _source = _functions.empty() ? FunctionSource::None : FunctionSource::Symbols;
+    }
+
+    AddPltStubs(elfHandler);
+
+    for (size_t i = 0; i + 1 < _functions.size(); i++)
+    {
+        _functions[i].size = std::min(_functions[i].size, _functions[i + 1].address - _functions[i].address);
+    }
+}
+
+/**
+ * @brief Replaces whatever covered the PLT sections, usually one FDE per section, with one function per stub named
+ * after the import it jumps to, so that calls through the PLT land on a function of their own. A stub is
+ * recognised by its jmp through a GOT slot that a JUMP_SLOT or GLOB_DAT relocation binds to a .dynsym entry; the
+ * lazy binding entry at the start of .plt is not a function.
+ *
+ * @param elfHandler The parsed file.
+ */
+void CodeFunctions::AddPltStubs(const ElfHandler &elfHandler)
+{
+    const ElfSection *dynsym = elfHandler.FindSection(".dynsym");
+    std::vector<ElfSymbol> imports = elfHandler.GetDynamicSymbols();
+    if (dynsym == nullptr || imports.empty())
+    {
+        return;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> slots; // GOT slot address to .dynsym index
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        if (section.type != static_cast<uint32_t>(SectionHeaderType::SHT_RELA) || section.link != dynsym->index)
+        {
+            continue;
+        }
+        std::span<const uint8_t> data = elfHandler.GetSectionData(section);
+        for (size_t offset = 0; offset + sizeof(Elf64Rela) <= data.size(); offset += sizeof(Elf64Rela))
+        {
+            Elf64Rela rela;
+            std::memcpy(&rela, data.data() + offset, sizeof(rela));
+            uint32_t type = static_cast<uint32_t>(rela.r_info);
+            uint32_t symbol = static_cast<uint32_t>(rela.r_info >> 32);
+            if ((type == R_X86_64_JUMP_SLOT || type == R_X86_64_GLOB_DAT) && symbol != 0 && symbol < imports.size())
+            {
+                slots.emplace(rela.r_offset, symbol);
+            }
+        }
+    }
+
+    std::vector<CodeFunction> stubs;
+    std::vector<std::pair<uint64_t, uint64_t>> pltRanges;
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        if ((section.name != ".plt" && section.name != ".plt.sec" && section.name != ".plt.got") ||
+            section.type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS) || section.entsize < 6)
+        {
+            continue;
+        }
+        pltRanges.emplace_back(section.addr, section.addr + section.size);
+
+        // jmp *slot(%rip), possibly behind endbr64 and a bnd prefix
+        std::span<const uint8_t> data = elfHandler.GetSectionData(section);
+        for (size_t entry = 0; entry + section.entsize <= data.size(); entry += section.entsize)
+        {
+            for (size_t i = entry; i + 6 <= entry + section.entsize; i++)
+            {
+                if (data[i] != 0xff || data[i + 1] != 0x25)
+                {
+                    continue;
+                }
+                int32_t displacement;
+                std::memcpy(&displacement, data.data() + i + 2, sizeof(displacement));
+                auto slot = slots.find(section.addr + i + 6 + static_cast<int64_t>(displacement));
+                if (slot != slots.end())
+                {
+                    stubs.push_back({section.addr + entry, section.entsize, section.index,
+                                     imports[slot->second].name + "@plt"});
+                }
+                break;
+            }
+        }
+    }
+    if (stubs.empty())
+    {
+        return;
+    }
+
+    _functions.erase(std::remove_if(_functions.begin(), _functions.end(),
+                                    [&pltRanges](const CodeFunction &function) {
+                                        for (const auto &[begin, end] : pltRanges)
+                                        {
+                                            if (function.address >= begin && function.address < end)
+                                                return true;
+                                        }
+                                        return false;
+                                    }),
+                     _functions.end());
+    _functions.insert(_functions.end(), std::make_move_iterator(stubs.begin()), std::make_move_iterator(stubs.end()));
+    std::sort(_functions.begin(), _functions.end(),
+              [](const CodeFunction &a, const CodeFunction &b) { return a.address < b.address; });
+}
+
+const char *FunctionSourceName(FunctionSource source)
+{
+    switch (source)
+    {
+    case FunctionSource::Symbols:
+        return "symbols";
+    case FunctionSource::CallFrames:
+        return "call frames";
+    default:
+        return "none";
+    }
+}
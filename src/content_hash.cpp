@@ -0,0 +1,764 @@
+#include "content_hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define CONTENT_HASH_X86 1
+#endif
+
+constexpr uint32_t XXH_PRIME32_1 = 0x9E3779B1U;
+constexpr uint32_t XXH_PRIME32_2 = 0x85EBCA77U;
+constexpr uint32_t XXH_PRIME32_3 = 0xC2B2AE3DU;
+constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+constexpr uint64_t XXH_PRIME_MX1 = 0x165667919E3779F9ULL;
+constexpr uint64_t XXH_PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+constexpr size_t XXH_STRIPE_LEN = 64;
+constexpr size_t XXH_SECRET_CONSUME_RATE = 8;
+constexpr size_t XXH_SECRET_LASTACC_START = 7;
+constexpr size_t XXH_SECRET_MERGEACCS_START = 11;
+constexpr size_t XXH3_SECRET_SIZE_MIN = 136;
+constexpr size_t XXH3_MIDSIZE_MAX = 240;
+constexpr size_t XXH3_MIDSIZE_STARTOFFSET = 3;
+constexpr size_t XXH3_MIDSIZE_LASTOFFSET = 17;
+
+// Default secret of XXH3
+alignas(64) constexpr uint8_t XXH3_SECRET[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d,
+    0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0,
+    0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21, 0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0,
+    0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b,
+    0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac,
+    0xd8, 0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51,
+    0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83, 0x34,
+    0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb, 0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49,
+    0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8,
+    0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b,
+    0x40, 0x7e,
+};
+
+constexpr size_t XXH3_STRIPES_PER_BLOCK = (sizeof(XXH3_SECRET) - XXH_STRIPE_LEN) / XXH_SECRET_CONSUME_RATE;
+constexpr size_t XXH3_BLOCK_LEN = XXH_STRIPE_LEN * XXH3_STRIPES_PER_BLOCK;
+
+constexpr uint32_t SHA256_INITIAL_STATE[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                              0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+alignas(16) constexpr uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/**
+ * @brief Detects the instruction set extensions used by the hash kernels.
+ */
+const ContentHashFeatures &GetContentHashFeatures()
+{
+    static const ContentHashFeatures features = []() {
+        ContentHashFeatures detected{false, false};
+#ifdef CONTENT_HASH_X86
+        __builtin_cpu_init();
+        detected.avx2 = __builtin_cpu_supports("avx2");
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        {
+            detected.shaNi = (ebx & (1U << 29)) != 0 && __builtin_cpu_supports("sse4.1");
+        }
+#endif
+        return detected;
+    }();
+    return features;
+}
+
+static inline uint64_t ReadLE64(const uint8_t *data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t ReadLE32(const uint8_t *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t ReadBE32(const uint8_t *data)
+{
+    return __builtin_bswap32(ReadLE32(data));
+}
+
+static inline uint64_t RotateLeft64(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t Multiply128Fold64(uint64_t lhs, uint64_t rhs)
+{
+    unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+static inline uint64_t Xxh64Avalanche(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static inline uint64_t Xxh3Avalanche(uint64_t hash)
+{
+    hash ^= hash >> 37;
+    hash *= XXH_PRIME_MX1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static inline uint64_t Xxh3Mix16(const uint8_t *input, const uint8_t *secret)
+{
+    return Multiply128Fold64(ReadLE64(input) ^ ReadLE64(secret), ReadLE64(input + 8) ^ ReadLE64(secret + 8));
+}
+
+static uint64_t Xxh3HashShort(const uint8_t *input, size_t len)
+{
+    const uint8_t *secret = XXH3_SECRET;
+    if (len > 8)
+    {
+        uint64_t low = ReadLE64(input) ^ (ReadLE64(secret + 24) ^ ReadLE64(secret + 32));
+        uint64_t high = ReadLE64(input + len - 8) ^ (ReadLE64(secret + 40) ^ ReadLE64(secret + 48));
+        return Xxh3Avalanche(len + __builtin_bswap64(low) + high + Multiply128Fold64(low, high));
+    }
+    if (len >= 4)
+    {
+        uint64_t input64 = ReadLE32(input + len - 4) + (static_cast<uint64_t>(ReadLE32(input)) << 32);
+        uint64_t hash = input64 ^ (ReadLE64(secret + 8) ^ ReadLE64(secret + 16));
+        hash ^= RotateLeft64(hash, 49) ^ RotateLeft64(hash, 24);
+        hash *= XXH_PRIME_MX2;
+        hash ^= (hash >> 35) + len;
+        hash *= XXH_PRIME_MX2;
+        return hash ^ (hash >> 28);
+    }
+    if (len > 0)
+    {
+        uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) | (static_cast<uint32_t>(input[len >> 1]) << 24) |
+                            input[len - 1] | (static_cast<uint32_t>(len) << 8);
+        return Xxh64Avalanche(combined ^ (ReadLE32(secret) ^ ReadLE32(secret + 4)));
+    }
+    return Xxh64Avalanche(ReadLE64(secret + 56) ^ ReadLE64(secret + 64));
+}
+
+static uint64_t Xxh3HashMedium(const uint8_t *input, size_t len)
+{
+    const uint8_t *secret = XXH3_SECRET;
+    uint64_t acc = len * XXH_PRIME64_1;
+    if (len <= 128)
+    {
+        for (size_t i = (len - 1) / 32 + 1; i-- > 0;)
+        {
+            acc += Xxh3Mix16(input + 16 * i, secret + 32 * i);
+            acc += Xxh3Mix16(input + len - 16 * (i + 1), secret + 32 * i + 16);
+        }
+        return Xxh3Avalanche(acc);
+    }
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        acc += Xxh3Mix16(input + 16 * i, secret + 16 * i);
+    }
+    uint64_t accEnd = Xxh3Mix16(input + len - 16, secret + XXH3_SECRET_SIZE_MIN - XXH3_MIDSIZE_LASTOFFSET);
+    acc = Xxh3Avalanche(acc);
+    for (size_t i = 8; i < len / 16; i++)
+    {
+        accEnd += Xxh3Mix16(input + 16 * i, secret + 16 * (i - 8) + XXH3_MIDSIZE_STARTOFFSET);
+    }
+    return Xxh3Avalanche(acc + accEnd);
+}
+
+static uint64_t Xxh3MergeAccumulators(const uint64_t acc[8], uint64_t len)
+{
+    const uint8_t *secret = XXH3_SECRET + XXH_SECRET_MERGEACCS_START;
+    uint64_t result = len * XXH_PRIME64_1;
+    for (size_t i = 0; i < 4; i++)
+    {
+        result += Multiply128Fold64(acc[2 * i] ^ ReadLE64(secret + 16 * i),
+                                    acc[2 * i + 1] ^ ReadLE64(secret + 16 * i + 8));
+    }
+    return Xxh3Avalanche(result);
+}
+
+static inline void Xxh3AccumulateScalar(uint64_t acc[8], const uint8_t *input, const uint8_t *secret)
+{
+    for (size_t lane = 0; lane < 8; lane++)
+    {
+        uint64_t value = ReadLE64(input + lane * 8);
+        uint64_t key = value ^ ReadLE64(secret + lane * 8);
+        acc[lane ^ 1] += value;
+        acc[lane] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+}
+
+static inline void Xxh3ScrambleScalar(uint64_t acc[8], const uint8_t *secret)
+{
+    for (size_t lane = 0; lane < 8; lane++)
+    {
+        uint64_t value = acc[lane];
+        value ^= value >> 47;
+        value ^= ReadLE64(secret + lane * 8);
+        acc[lane] = value * XXH_PRIME32_1;
+    }
+}
+
+static uint64_t Xxh3HashLongScalar(const uint8_t *input, size_t len)
+{
+    uint64_t acc[8] = {XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+                       XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1};
+    size_t blocks = (len - 1) / XXH3_BLOCK_LEN;
+    for (size_t block = 0; block < blocks; block++)
+    {
+        for (size_t stripe = 0; stripe < XXH3_STRIPES_PER_BLOCK; stripe++)
+        {
+            Xxh3AccumulateScalar(acc, input + block * XXH3_BLOCK_LEN + stripe * XXH_STRIPE_LEN,
+                                 XXH3_SECRET + stripe * XXH_SECRET_CONSUME_RATE);
+        }
+        Xxh3ScrambleScalar(acc, XXH3_SECRET + sizeof(XXH3_SECRET) - XXH_STRIPE_LEN);
+    }
+    size_t stripes = ((len - 1) - blocks * XXH3_BLOCK_LEN) / XXH_STRIPE_LEN;
+    for (size_t stripe = 0; stripe < stripes; stripe++)
+    {
+        Xxh3AccumulateScalar(acc, input + blocks * XXH3_BLOCK_LEN + stripe * XXH_STRIPE_LEN,
+                             XXH3_SECRET + stripe * XXH_SECRET_CONSUME_RATE);
+    }
+    Xxh3AccumulateScalar(acc, input + len - XXH_STRIPE_LEN,
+                         XXH3_SECRET + sizeof(XXH3_SECRET) - XXH_STRIPE_LEN - XXH_SECRET_LASTACC_START);
+    return Xxh3MergeAccumulators(acc, len);
+}
+
+#ifdef CONTENT_HASH_X86
+__attribute__((target("avx2"))) static inline void Xxh3AccumulateAvx2(__m256i acc[2], const uint8_t *input,
+                                                                      const uint8_t *secret)
+{
+    for (size_t i = 0; i < 2; i++)
+    {
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input) + i);
+        __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + i));
+        __m256i product = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+        __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        acc[i] = _mm256_add_epi64(acc[i], _mm256_add_epi64(product, swapped));
+    }
+}
+
+__attribute__((target("avx2"))) static inline void Xxh3ScrambleAvx2(__m256i acc[2], const uint8_t *secret)
+{
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(XXH_PRIME32_1));
+    for (size_t i = 0; i < 2; i++)
+    {
+        __m256i value = _mm256_xor_si256(acc[i], _mm256_srli_epi64(acc[i], 47));
+        value = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + i));
+        __m256i low = _mm256_mul_epu32(value, prime);
+        __m256i high = _mm256_mul_epu32(_mm256_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        acc[i] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+    }
+}
+
+// Same as Xxh3HashLongScalar, with the eight accumulators in two AVX2 registers
+__attribute__((target("avx2"))) static uint64_t Xxh3HashLongAvx2(const uint8_t *input, size_t len)
+{
+    __m256i acc[2] = {_mm256_set_epi64x(XXH_PRIME64_3, XXH_PRIME64_2, XXH_PRIME64_1, XXH_PRIME32_3),
+                      _mm256_set_epi64x(XXH_PRIME32_1, XXH_PRIME64_5, XXH_PRIME32_2, XXH_PRIME64_4)};
+    size_t blocks = (len - 1) / XXH3_BLOCK_LEN;
+    for (size_t block = 0; block < blocks; block++)
+    {
+        for (size_t stripe = 0; stripe < XXH3_STRIPES_PER_BLOCK; stripe++)
+        {
+            Xxh3AccumulateAvx2(acc, input + block * XXH3_BLOCK_LEN + stripe * XXH_STRIPE_LEN,
+                               XXH3_SECRET + stripe * XXH_SECRET_CONSUME_RATE);
+        }
+        Xxh3ScrambleAvx2(acc, XXH3_SECRET + sizeof(XXH3_SECRET) - XXH_STRIPE_LEN);
+    }
+    size_t stripes = ((len - 1) - blocks * XXH3_BLOCK_LEN) / XXH_STRIPE_LEN;
+    for (size_t stripe = 0; stripe < stripes; stripe++)
+    {
+        Xxh3AccumulateAvx2(acc, input + blocks * XXH3_BLOCK_LEN + stripe * XXH_STRIPE_LEN,
+                           XXH3_SECRET + stripe * XXH_SECRET_CONSUME_RATE);
+    }
+    Xxh3AccumulateAvx2(acc, input + len - XXH_STRIPE_LEN,
+                       XXH3_SECRET + sizeof(XXH3_SECRET) - XXH_STRIPE_LEN - XXH_SECRET_LASTACC_START);
+
+    alignas(32) uint64_t merged[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(merged), acc[0]);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(merged) + 1, acc[1]);
+    return Xxh3MergeAccumulators(merged, len);
+}
+#endif
+
+/**
+ * @brief Computes the 64-bit XXH3 hash of a buffer, with seed 0 and the default secret, as xxhsum -H3 does.
+ *
+ * @param data The bytes to hash.
+ * @return The hash.
+ */
+uint64_t Xxh3Hash64(std::span<const uint8_t> data)
+{
+    if (data.size() <= 16)
+    {
+        return Xxh3HashShort(data.data(), data.size());
+    }
+    if (data.size() <= XXH3_MIDSIZE_MAX)
+    {
+        return Xxh3HashMedium(data.data(), data.size());
+    }
+#ifdef CONTENT_HASH_X86
+    if (GetContentHashFeatures().avx2)
+    {
+        return Xxh3HashLongAvx2(data.data(), data.size());
+    }
+#endif
+    return Xxh3HashLongScalar(data.data(), data.size());
+}
+
+static inline uint32_t RotateRight32(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static void Sha256CompressScalar(uint32_t state[8], const uint8_t *blocks, size_t count)
+{
+    for (size_t block = 0; block < count; block++, blocks += SHA256_BLOCK_SIZE)
+    {
+        uint32_t w[64];
+        for (size_t i = 0; i < 16; i++)
+        {
+            w[i] = ReadBE32(blocks + i * 4);
+        }
+        for (size_t i = 16; i < 64; i++)
+        {
+            uint32_t s0 = RotateRight32(w[i - 15], 7) ^ RotateRight32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = RotateRight32(w[i - 2], 17) ^ RotateRight32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (size_t i = 0; i < 64; i++)
+        {
+            uint32_t s1 = RotateRight32(e, 6) ^ RotateRight32(e, 11) ^ RotateRight32(e, 25);
+            uint32_t t1 = h + s1 + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+            uint32_t s0 = RotateRight32(a, 2) ^ RotateRight32(a, 13) ^ RotateRight32(a, 22);
+            uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef CONTENT_HASH_X86
+// Four rounds per iteration with the SHA-NI instructions, the state kept as ABEF/CDGH register pairs
+__attribute__((target("sha,sse4.1,ssse3"))) static void Sha256CompressShaNi(uint32_t state[8], const uint8_t *blocks,
+                                                                           size_t count)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state));
+    __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4));
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (size_t block = 0; block < count; block++, blocks += SHA256_BLOCK_SIZE)
+    {
+        __m128i abefSaved = abef;
+        __m128i cdghSaved = cdgh;
+        __m128i messages[4];
+        for (size_t i = 0; i < 4; i++)
+        {
+            messages[i] =
+                _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks) + i), byteSwap);
+        }
+        for (size_t group = 0; group < 16; group++)
+        {
+            __m128i &current = messages[group % 4];
+            if (group >= 4)
+            {
+                // W[t..t+3] from W[t-16..t-13], W[t-12..t-9], W[t-8..t-5] and W[t-4..t-1]
+                __m128i previous = messages[(group + 3) % 4];
+                current = _mm_sha256msg1_epu32(current, messages[(group + 1) % 4]);
+                current = _mm_add_epi32(current, _mm_alignr_epi8(previous, messages[(group + 2) % 4], 4));
+                current = _mm_sha256msg2_epu32(current, previous);
+            }
+            __m128i message =
+                _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i *>(SHA256_K) + group));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+        }
+        abef = _mm_add_epi32(abef, abefSaved);
+        cdgh = _mm_add_epi32(cdgh, cdghSaved);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+__attribute__((target("avx2"))) static inline __m256i RotateRight32x8(__m256i value, int bits)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(value, bits), _mm256_slli_epi32(value, 32 - bits));
+}
+
+// Loads 8 consecutive message words of each lane and transposes them, so register i holds word i of every lane
+__attribute__((target("avx2"))) static inline void Sha256LoadWordsAvx2(__m256i words[8],
+                                                                       const uint8_t *const blocks[SHA256_LANES],
+                                                                       size_t offset)
+{
+    const __m256i byteSwap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8,
+                                             9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i rows[8], pairs[8], quads[8];
+    for (size_t lane = 0; lane < SHA256_LANES; lane++)
+    {
+        rows[lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(blocks[lane] + offset));
+    }
+    for (size_t i = 0; i < 8; i += 2)
+    {
+        pairs[i] = _mm256_unpacklo_epi32(rows[i], rows[i + 1]);
+        pairs[i + 1] = _mm256_unpackhi_epi32(rows[i], rows[i + 1]);
+    }
+    for (size_t i = 0; i < 8; i += 4)
+    {
+        quads[i] = _mm256_unpacklo_epi64(pairs[i], pairs[i + 2]);
+        quads[i + 1] = _mm256_unpackhi_epi64(pairs[i], pairs[i + 2]);
+        quads[i + 2] = _mm256_unpacklo_epi64(pairs[i + 1], pairs[i + 3]);
+        quads[i + 3] = _mm256_unpackhi_epi64(pairs[i + 1], pairs[i + 3]);
+    }
+    for (size_t i = 0; i < 4; i++)
+    {
+        words[i] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(quads[i], quads[i + 4], 0x20), byteSwap);
+        words[i + 4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(quads[i], quads[i + 4], 0x31), byteSwap);
+    }
+}
+
+// One block of each of 8 messages; state[i] holds word i of the state of every lane
+__attribute__((target("avx2"))) static void Sha256CompressAvx2(uint32_t state[8][SHA256_LANES],
+                                                               const uint8_t *const blocks[SHA256_LANES])
+{
+    __m256i w[16];
+    Sha256LoadWordsAvx2(w, blocks, 0);
+    Sha256LoadWordsAvx2(w + 8, blocks, 32);
+
+    __m256i v[8];
+    for (size_t i = 0; i < 8; i++)
+    {
+        v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(state[i]));
+    }
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+    for (size_t i = 0; i < 64; i++)
+    {
+        if (i >= 16)
+        {
+            __m256i w15 = w[(i - 15) & 15];
+            __m256i w2 = w[(i - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(RotateRight32x8(w15, 7), RotateRight32x8(w15, 18)),
+                                          _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(RotateRight32x8(w2, 17), RotateRight32x8(w2, 19)),
+                                          _mm256_srli_epi32(w2, 10));
+            w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0), _mm256_add_epi32(w[(i - 7) & 15], s1));
+        }
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(RotateRight32x8(e, 6), RotateRight32x8(e, 11)),
+                                      RotateRight32x8(e, 25));
+        __m256i choice = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1), _mm256_add_epi32(choice, w[i & 15]));
+        t1 = _mm256_add_epi32(t1, _mm256_set1_epi32(static_cast<int>(SHA256_K[i])));
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(RotateRight32x8(a, 2), RotateRight32x8(a, 13)),
+                                      RotateRight32x8(a, 22));
+        __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, _mm256_add_epi32(s0, majority));
+    }
+    __m256i result[8] = {a, b, c, d, e, f, g, h};
+    for (size_t i = 0; i < 8; i++)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[i]), _mm256_add_epi32(v[i], result[i]));
+    }
+}
+#endif
+
+static void Sha256Compress(uint32_t state[8], const uint8_t *blocks, size_t count)
+{
+#ifdef CONTENT_HASH_X86
+    if (GetContentHashFeatures().shaNi)
+    {
+        Sha256CompressShaNi(state, blocks, count);
+        return;
+    }
+#endif
+    Sha256CompressScalar(state, blocks, count);
+}
+
+// A message split into its whole blocks, read in place, and its padded final one or two blocks
+struct Sha256Message
+{
+    const uint8_t *data;
+    size_t fullBlocks;
+    size_t totalBlocks;
+    alignas(32) uint8_t tail[2 * SHA256_BLOCK_SIZE];
+
+    explicit Sha256Message(std::span<const uint8_t> message)
+        : data(message.data()), fullBlocks(message.size() / SHA256_BLOCK_SIZE)
+    {
+        size_t remainder = message.size() % SHA256_BLOCK_SIZE;
+        size_t tailBlocks = remainder + 9 > SHA256_BLOCK_SIZE ? 2 : 1;
+        memset(tail, 0, sizeof(tail));
+        if (remainder != 0)
+        {
+            memcpy(tail, data + fullBlocks * SHA256_BLOCK_SIZE, remainder);
+        }
+        tail[remainder] = 0x80;
+        uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+        for (size_t i = 0; i < 8; i++)
+        {
+            tail[tailBlocks * SHA256_BLOCK_SIZE - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+        }
+        totalBlocks = fullBlocks + tailBlocks;
+    }
+
+    const uint8_t *Block(size_t block) const
+    {
+        return block < fullBlocks ? data + block * SHA256_BLOCK_SIZE : tail + (block - fullBlocks) * SHA256_BLOCK_SIZE;
+    }
+
+    // Runs the remaining blocks from a block boundary
+    void Finish(uint32_t state[8], size_t block) const
+    {
+        if (block < fullBlocks)
+        {
+            Sha256Compress(state, data + block * SHA256_BLOCK_SIZE, fullBlocks - block);
+            block = fullBlocks;
+        }
+        Sha256Compress(state, tail + (block - fullBlocks) * SHA256_BLOCK_SIZE, totalBlocks - block);
+    }
+};
+
+static Sha256Digest DigestFromState(const uint32_t state[8])
+{
+    Sha256Digest digest;
+    for (size_t i = 0; i < 8; i++)
+    {
+        uint32_t word = __builtin_bswap32(state[i]);
+        memcpy(digest.data() + i * 4, &word, sizeof(word));
+    }
+    return digest;
+}
+
+/**
+ * @brief Computes the SHA-256 digest of a buffer, with the SHA-NI instructions when the processor has them.
+ *
+ * @param data The bytes to hash.
+ * @return The digest.
+ */
+Sha256Digest Sha256Hash(std::span<const uint8_t> data)
+{
+    uint32_t state[8];
+    memcpy(state, SHA256_INITIAL_STATE, sizeof(state));
+    Sha256Message(data).Finish(state, 0);
+    return DigestFromState(state);
+}
+
+/**
+ * @brief Computes the SHA-256 digests of many buffers at once. With AVX2, eight messages are hashed side by side,
+ * one per 32-bit lane; a lane whose message ends is refilled with the next one, longest messages first so the lanes
+ * stay busy. Processors with SHA-NI hash one buffer at a time instead, the hardware rounds being about twice as fast
+ * as the eight lanes together.
+ *
+ * @param buffers The messages.
+ * @return The digest of every message, in the order of the buffers.
+ */
+std::vector<Sha256Digest> Sha256HashMultiBuffer(std::span<const std::span<const uint8_t>> buffers)
+{
+    std::vector<Sha256Digest> digests(buffers.size());
+#ifdef CONTENT_HASH_X86
+    const ContentHashFeatures &features = GetContentHashFeatures();
+    if (features.avx2 && !features.shaNi && buffers.size() > 1)
+    {
+        std::vector<size_t> order(buffers.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&buffers](size_t a, size_t b) { return buffers[a].size() > buffers[b].size(); });
+
+        struct Lane
+        {
+            size_t buffer;
+            size_t block;
+            std::unique_ptr<Sha256Message> message;
+        };
+        std::array<Lane, SHA256_LANES> lanes{};
+        alignas(32) uint32_t state[8][SHA256_LANES];
+        alignas(32) static const uint8_t idleBlock[SHA256_BLOCK_SIZE] = {};
+        size_t next = 0;
+        for (;;)
+        {
+            size_t active = 0;
+            for (size_t lane = 0; lane < SHA256_LANES; lane++)
+            {
+                if (!lanes[lane].message && next < order.size())
+                {
+                    lanes[lane] = {order[next], 0, std::make_unique<Sha256Message>(buffers[order[next]])};
+                    next++;
+                    for (size_t word = 0; word < 8; word++)
+                    {
+                        state[word][lane] = SHA256_INITIAL_STATE[word];
+                    }
+                }
+                active += lanes[lane].message ? 1 : 0;
+            }
+            if (active == 0)
+            {
+                break;
+            }
+
+            const uint8_t *blocks[SHA256_LANES];
+            for (size_t lane = 0; lane < SHA256_LANES; lane++)
+            {
+                blocks[lane] = lanes[lane].message ? lanes[lane].message->Block(lanes[lane].block) : idleBlock;
+            }
+            Sha256CompressAvx2(state, blocks);
+            for (size_t lane = 0; lane < SHA256_LANES; lane++)
+            {
+                Lane &current = lanes[lane];
+                if (current.message && ++current.block == current.message->totalBlocks)
+                {
+                    uint32_t laneState[8];
+                    for (size_t word = 0; word < 8; word++)
+                    {
+                        laneState[word] = state[word][lane];
+                    }
+                    digests[current.buffer] = DigestFromState(laneState);
+                    current.message.reset();
+                }
+            }
+        }
+        return digests;
+    }
+#endif
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        digests[i] = Sha256Hash(buffers[i]);
+    }
+    return digests;
+}
+
+/**
+ * @brief Computes the XXH3 and SHA-256 hashes of a batch of buffers. Without a pool everything runs on the calling
+ * thread; with one, each large buffer is a task of its own and the small ones are grouped into tasks of about
+ * CONTENT_HASH_TASK_SIZE bytes, each group hashed with the multi-buffer SHA-256 kernel.
+ *
+ * @param buffers The buffers, typically views of a mapped file.
+ * @param pool The pool to run on, or nullptr.
+ * @return The hashes of every buffer, in the order of the buffers.
+ */
+std::vector<ContentHash> HashBuffers(std::span<const std::span<const uint8_t>> buffers, ThreadPool *pool)
+{
+    std::vector<ContentHash> hashes(buffers.size());
+    auto hashGroup = [&hashes, buffers](const std::vector<size_t> &group) {
+        std::vector<std::span<const uint8_t>> members;
+        for (size_t index : group)
+        {
+            hashes[index].xxh3 = Xxh3Hash64(buffers[index]);
+            members.push_back(buffers[index]);
+        }
+        std::vector<Sha256Digest> digests = Sha256HashMultiBuffer(members);
+        for (size_t i = 0; i < group.size(); i++)
+        {
+            hashes[group[i]].sha256 = digests[i];
+        }
+    };
+
+    if (pool == nullptr)
+    {
+        std::vector<size_t> all(buffers.size());
+        std::iota(all.begin(), all.end(), 0);
+        hashGroup(all);
+        return hashes;
+    }
+
+    std::vector<std::vector<size_t>> groups;
+    std::vector<size_t> small;
+    size_t smallBytes = 0;
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if (buffers[i].size() >= CONTENT_HASH_TASK_SIZE)
+        {
+            groups.push_back({i});
+            continue;
+        }
+        small.push_back(i);
+        smallBytes += buffers[i].size();
+        if (smallBytes >= CONTENT_HASH_TASK_SIZE)
+        {
+            groups.push_back(std::move(small));
+            small.clear();
+            smallBytes = 0;
+        }
+    }
+    if (!small.empty())
+    {
+        groups.push_back(std::move(small));
+    }
+    TaskGroup tasks(*pool);
+    for (const auto &group : groups)
+    {
+        tasks.Submit([&hashGroup, &group]() { hashGroup(group); });
+    }
+    tasks.Wait();
+    return hashes;
+}
+
+/**
+ * @brief Formats a SHA-256 digest as lowercase hexadecimal, as sha256sum prints it.
+ */
+std::string FormatSha256(const Sha256Digest &digest)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+    text.reserve(digest.size() * 2);
+    for (uint8_t byte : digest)
+    {
+        text.push_back(digits[byte >> 4]);
+        text.push_back(digits[byte & 0xf]);
+    }
+    return text;
+}
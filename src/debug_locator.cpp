@@ -0,0 +1,594 @@
+#include "debug_locator.hpp"
+#include "elf_handler.hpp"
+#include "elf_notes.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <array>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * @brief 64-bit FNV-1a hash, used for the debug link name table.
+ */
+static uint64_t HashName(std::string_view name)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : name)
+    {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Returns the modification time of a path in nanoseconds, or std::nullopt if it cannot be stat'd.
+ */
+static std::optional<int64_t> ModificationTime(const std::string &path)
+{
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0)
+    {
+        return std::nullopt;
+    }
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Checks for the ELF magic without going through the logging error path for non-ELF files.
+ */
+static bool HasElfMagic(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    uint32_t magic = 0;
+    bool isElf = pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == ELFMAG;
+    close(fd);
+    return isElf;
+}
+
+/**
+ * @brief Decodes a hex string into bytes, as used by the .build-id directory layout.
+ */
+static bool DecodeHex(std::string_view hex, std::vector<uint8_t> &bytes)
+{
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    if (hex.size() % 2 != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < hex.size(); i += 2)
+    {
+        int high = nibble(hex[i]);
+        int low = nibble(hex[i + 1]);
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+        bytes.push_back(static_cast<uint8_t>(high << 4 | low));
+    }
+    return true;
+}
+
+/**
+ * @brief Builds the fixed size, zero padded index key for a build-id.
+ */
+static DebugIndexBuildIdEntry MakeBuildIdKey(std::span<const uint8_t> buildId)
+{
+    DebugIndexBuildIdEntry entry{};
+    memcpy(entry.buildId, buildId.data(), buildId.size());
+    entry.buildIdSize = static_cast<uint32_t>(buildId.size());
+    return entry;
+}
+
+static bool BuildIdLess(const DebugIndexBuildIdEntry &a, const DebugIndexBuildIdEntry &b)
+{
+    int order = memcmp(a.buildId, b.buildId, DEBUG_INDEX_MAX_BUILD_ID);
+    return order != 0 ? order < 0 : a.buildIdSize < b.buildIdSize;
+}
+
+/**
+ * @brief Constructor for the DebugFileLocator class.
+ *
+ * @param debugDirectories The directory trees to search, in priority order. /usr/lib/debug is used when empty.
+ * @param indexPath Where the persistent index lives. It is built on first use and whenever it is found stale.
+ */
+DebugFileLocator::DebugFileLocator(std::vector<std::string> debugDirectories, std::string indexPath)
+    : _debugDirectories(std::move(debugDirectories)), _indexPath(std::move(indexPath))
+{
+    if (_debugDirectories.empty())
+    {
+        _debugDirectories.push_back(DEFAULT_DEBUG_DIRECTORY);
+    }
+}
+
+/**
+ * @brief Returns the cache directory shared by the persistent indexes, $XDG_CACHE_HOME/exepose or ~/.cache/exepose.
+ */
+std::string DebugFileLocator::CacheDirectory()
+{
+    if (const char *cacheHome = getenv("XDG_CACHE_HOME"); cacheHome != nullptr && *cacheHome != '\0')
+    {
+        return std::string(cacheHome) + "/exepose";
+    }
+    if (const char *home = getenv("HOME"); home != nullptr && *home != '\0')
+    {
+        return std::string(home) + "/.cache/exepose";
+    }
+    return ".";
+}
+
+/**
+ * @brief Returns the default index location, debug-index.bin in the cache directory.
+ */
+std::string DebugFileLocator::DefaultIndexPath()
+{
+    return CacheDirectory() + "/debug-index.bin";
+}
+
+/**
+ * @brief Computes the CRC32 that .gnu_debuglink stores for the debug file.
+ *
+ * @param fileName The candidate debug file.
+ * @return The CRC of the whole file.
+ * @throws std::runtime_error if the file cannot be mapped.
+ */
+uint32_t DebugFileLocator::ComputeDebugLinkCrc(const std::string &fileName)
+{
+    MappedFile file(fileName);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    constexpr uint64_t chunkSize = 1ULL << 30; // crc32 takes a 32-bit length
+    for (uint64_t offset = 0; offset < file.Size(); offset += chunkSize)
+    {
+        uint64_t length = std::min(chunkSize, file.Size() - offset);
+        crc = crc32(crc, file.Data() + offset, static_cast<uInt>(length));
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+/**
+ * @brief Finds the debug file of an executable, first by build-id and then by .gnu_debuglink.
+ *
+ * @param executable The stripped executable or shared object.
+ * @return The path of the debug file, or std::nullopt if none was found.
+ * @throws std::runtime_error if the executable cannot be parsed.
+ */
+std::optional<std::string> DebugFileLocator::FindDebugFile(const std::string &executable)
+{
+    {
+        ElfSegments segments(executable);
+        ElfNotes notes(segments);
+        if (!notes.GetBuildId().empty())
+        {
+            if (auto path = FindByBuildId(notes.GetBuildId()))
+            {
+                return path;
+            }
+        }
+    }
+
+    ElfHandler elfHandler(executable);
+    const ElfSection *debugLink = elfHandler.FindSection(".gnu_debuglink");
+    if (debugLink == nullptr)
+    {
+        LOG(Logger::LogLevel::Info, "No build-id match and no .gnu_debuglink in %s", executable.c_str());
+        return std::nullopt;
+    }
+
+    // File name, NUL, padding to 4 bytes, then the CRC32 of the debug file
+    std::span<const uint8_t> data = elfHandler.GetSectionData(*debugLink);
+    size_t nameLength = strnlen(reinterpret_cast<const char *>(data.data()), data.size());
+    size_t crcOffset = (nameLength + 4) & ~size_t(3);
+    if (nameLength == 0 || crcOffset + sizeof(uint32_t) > data.size())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Invalid .gnu_debuglink section in %s", executable.c_str());
+    }
+
+    uint32_t crc;
+    memcpy(&crc, data.data() + crcOffset, sizeof(crc));
+    return FindByDebugLink(executable, std::string(reinterpret_cast<const char *>(data.data()), nameLength), crc);
+}
+
+/**
+ * @brief Finds a debug file by build-id.
+ *
+ * @param buildId The NT_GNU_BUILD_ID descriptor of the executable.
+ * @return The path of a file carrying the same build-id, or std::nullopt if none was found.
+ */
+std::optional<std::string> DebugFileLocator::FindByBuildId(std::span<const uint8_t> buildId)
+{
+    if (buildId.empty())
+    {
+        return std::nullopt;
+    }
+
+    if (buildId.size() <= DEBUG_INDEX_MAX_BUILD_ID)
+    {
+        OpenIndex();
+        auto entries = BuildIdEntries();
+        DebugIndexBuildIdEntry key = MakeBuildIdKey(buildId);
+        auto it = std::lower_bound(entries.begin(), entries.end(), key, BuildIdLess);
+        if (it != entries.end() && !BuildIdLess(key, *it))
+        {
+            std::string path = IndexString(it->pathOffset);
+            if (MatchesBuildId(path, buildId))
+            {
+                return path;
+            }
+            LOG(Logger::LogLevel::Warning, "Indexed debug file %s no longer matches, consider rebuilding the index",
+                path.c_str());
+        }
+    }
+
+    // Files installed since the index was built can still be found through the well known layout
+    static const char hexChars[] = "0123456789abcdef";
+    std::string hex;
+    for (uint8_t byte : buildId)
+    {
+        hex += hexChars[byte >> 4];
+        hex += hexChars[byte & 0x0F];
+    }
+    for (const auto &directory : _debugDirectories)
+    {
+        std::string path = directory + "/.build-id/" + hex.substr(0, 2) + "/" + hex.substr(2) + ".debug";
+        if (access(path.c_str(), R_OK) == 0 && MatchesBuildId(path, buildId))
+        {
+            return path;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Finds a debug file named by .gnu_debuglink.
+ *
+ * @details The standard locations are tried first: next to the executable, in its .debug subdirectory and below
+ * each debug directory mirroring the executable's directory. After that every indexed file with the same base name
+ * is a candidate. A candidate is only accepted if its CRC32 matches.
+ *
+ * @param executable The executable holding the link.
+ * @param linkName The file name stored in .gnu_debuglink.
+ * @param crc The CRC32 stored in .gnu_debuglink.
+ * @return The path of the debug file, or std::nullopt if none was found.
+ */
+std::optional<std::string> DebugFileLocator::FindByDebugLink(const std::string &executable,
+                                                             const std::string &linkName, uint32_t crc)
+{
+    std::error_code error;
+    std::filesystem::path executablePath = std::filesystem::canonical(executable, error);
+    if (error)
+    {
+        executablePath = std::filesystem::absolute(executable);
+    }
+    std::string executableDir = executablePath.parent_path().string();
+
+    std::vector<std::string> candidates = {executableDir + "/" + linkName, executableDir + "/.debug/" + linkName};
+    for (const auto &directory : _debugDirectories)
+    {
+        candidates.push_back(directory + executableDir + "/" + linkName);
+    }
+
+    OpenIndex();
+    uint64_t nameHash = HashName(linkName);
+    auto names = NameEntries();
+    auto range = std::equal_range(names.begin(), names.end(), DebugIndexNameEntry{nameHash, 0, 0},
+                                  [](const auto &a, const auto &b) { return a.nameHash < b.nameHash; });
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        std::string path = IndexString(it->pathOffset);
+        if (std::filesystem::path(path).filename() == linkName)
+        {
+            candidates.push_back(path);
+        }
+    }
+
+    for (const auto &candidate : candidates)
+    {
+        if (access(candidate.c_str(), R_OK) != 0 || std::filesystem::equivalent(candidate, executablePath, error))
+        {
+            continue;
+        }
+        if (ComputeDebugLinkCrc(candidate) == crc)
+        {
+            return candidate;
+        }
+        LOG(Logger::LogLevel::Debug, "Debug link candidate %s has a mismatched CRC", candidate.c_str());
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Opens the persistent index, building it first if it is missing, from another version or stale.
+ */
+void DebugFileLocator::OpenIndex()
+{
+    if (_header != nullptr)
+    {
+        return;
+    }
+    if (!LoadIndex() || !IsIndexCurrent())
+    {
+        RebuildIndex();
+        if (!LoadIndex())
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Failed to load rebuilt debug index: %s", _indexPath.c_str());
+        }
+    }
+}
+
+/**
+ * @brief Maps the index file and validates its header and table bounds.
+ *
+ * @return true if a usable index was mapped.
+ */
+bool DebugFileLocator::LoadIndex()
+{
+    _header = nullptr;
+    _index.reset();
+    if (access(_indexPath.c_str(), R_OK) != 0)
+    {
+        return false;
+    }
+
+    auto index = std::make_unique<MappedFile>(_indexPath);
+    if (index->Size() < sizeof(DebugIndexHeader))
+    {
+        return false;
+    }
+    auto header = reinterpret_cast<const DebugIndexHeader *>(index->Data());
+    if (memcmp(header->magic, DEBUG_INDEX_MAGIC, sizeof(DEBUG_INDEX_MAGIC)) != 0 ||
+        header->version != DEBUG_INDEX_VERSION)
+    {
+        LOG(Logger::LogLevel::Info, "Debug index %s has an unknown format, rebuilding", _indexPath.c_str());
+        return false;
+    }
+
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset <= index->Size() && count <= (index->Size() - offset) / size;
+    };
+    if (!fits(header->directoryOffset, header->directoryCount, sizeof(DebugIndexDirectoryEntry)) ||
+        !fits(header->buildIdOffset, header->buildIdCount, sizeof(DebugIndexBuildIdEntry)) ||
+        !fits(header->nameOffset, header->nameCount, sizeof(DebugIndexNameEntry)) ||
+        !fits(header->stringsOffset, header->stringsSize, 1) || header->stringsSize == 0 ||
+        index->Data()[header->stringsOffset + header->stringsSize - 1] != '\0')
+    {
+        LOG(Logger::LogLevel::Warning, "Debug index %s is corrupt, rebuilding", _indexPath.c_str());
+        return false;
+    }
+
+    _index = std::move(index);
+    _header = header;
+    return true;
+}
+
+/**
+ * @brief Checks that the index covers the configured directories and that none of the directories it visited
+ * changed since. Only directories are stat'd, no directory is read.
+ *
+ * @return true if the index can be used as is.
+ */
+bool DebugFileLocator::IsIndexCurrent() const
+{
+    auto directories = DirectoryEntries();
+    for (const auto &root : _debugDirectories)
+    {
+        bool found = std::any_of(directories.begin(), directories.end(),
+                                 [&](const auto &entry) { return root == IndexString(entry.pathOffset); });
+        if (!found && access(root.c_str(), R_OK) == 0)
+        {
+            return false;
+        }
+    }
+    for (const auto &entry : directories)
+    {
+        if (ModificationTime(IndexString(entry.pathOffset)) != entry.mtime)
+        {
+            LOG(Logger::LogLevel::Info, "Debug directory %s changed, rebuilding index", IndexString(entry.pathOffset));
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Walks the configured directories and writes a fresh index.
+ *
+ * @details Entries below a .build-id directory are keyed by their file name. Every other ELF file has its build-id
+ * read from its note segment, which costs a single page. The index is written to a temporary file and renamed into
+ * place so that concurrent readers never see a partial index.
+ *
+ * @throws std::runtime_error if the index cannot be written.
+ */
+void DebugFileLocator::RebuildIndex()
+{
+    LOG(Logger::LogLevel::Info, "Building debug index: %s", _indexPath.c_str());
+    _header = nullptr;
+    _index.reset();
+
+    std::string strings(1, '\0'); // offset 0 is the empty string
+    auto addString = [&strings](const std::string &value) {
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings.append(value).push_back('\0');
+        return offset;
+    };
+
+    std::vector<DebugIndexDirectoryEntry> directories;
+    std::vector<DebugIndexBuildIdEntry> buildIds;
+    std::vector<DebugIndexNameEntry> names;
+    auto addDirectory = [&](const std::string &path) {
+        if (auto mtime = ModificationTime(path))
+        {
+            directories.push_back({addString(path), 0, *mtime});
+        }
+    };
+
+    for (const auto &root : _debugDirectories)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_directory(root, error))
+        {
+            continue;
+        }
+        addDirectory(root);
+
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, options, error);
+             it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            if (error)
+            {
+                break;
+            }
+            const std::filesystem::path &path = it->path();
+            if (it->is_directory(error) && !it->is_symlink(error))
+            {
+                addDirectory(path.string());
+                continue;
+            }
+
+            // <root>/.build-id/xx/yyyy.debug, the build-id is spelled out in the path
+            if (path.parent_path().parent_path().filename() == ".build-id")
+            {
+                std::vector<uint8_t> buildId;
+                if (path.extension() == ".debug" &&
+                    DecodeHex(path.parent_path().filename().string() + path.stem().string(), buildId) &&
+                    buildId.size() <= DEBUG_INDEX_MAX_BUILD_ID)
+                {
+                    DebugIndexBuildIdEntry entry = MakeBuildIdKey(buildId);
+                    entry.pathOffset = addString(path.string());
+                    buildIds.push_back(entry);
+                }
+                continue;
+            }
+
+            if (!it->is_regular_file(error) || it->is_symlink(error) || !HasElfMagic(path.string()))
+            {
+                continue;
+            }
+
+            uint32_t pathOffset = addString(path.string());
+            names.push_back({HashName(path.filename().string()), pathOffset, 0});
+            try
+            {
+                ElfSegments segments(path.string());
+                ElfNotes notes(segments);
+                const auto &buildId = notes.GetBuildId();
+                if (!buildId.empty() && buildId.size() <= DEBUG_INDEX_MAX_BUILD_ID)
+                {
+                    DebugIndexBuildIdEntry entry = MakeBuildIdKey(buildId);
+                    entry.pathOffset = pathOffset;
+                    buildIds.push_back(entry);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                LOG(Logger::LogLevel::Debug, "Skipping %s: %s", path.c_str(), e.what());
+            }
+        }
+    }
+
+    // Earlier directories take priority, so keep the first entry of each build-id
+    std::stable_sort(buildIds.begin(), buildIds.end(), BuildIdLess);
+    buildIds.erase(std::unique(buildIds.begin(), buildIds.end(),
+                               [](const auto &a, const auto &b) { return !BuildIdLess(a, b) && !BuildIdLess(b, a); }),
+                   buildIds.end());
+    std::stable_sort(names.begin(), names.end(), [](const auto &a, const auto &b) { return a.nameHash < b.nameHash; });
+
+    DebugIndexHeader header{};
+    memcpy(header.magic, DEBUG_INDEX_MAGIC, sizeof(DEBUG_INDEX_MAGIC));
+    header.version = DEBUG_INDEX_VERSION;
+    header.directoryCount = directories.size();
+    header.directoryOffset = sizeof(DebugIndexHeader);
+    header.buildIdCount = buildIds.size();
+    header.buildIdOffset = header.directoryOffset + directories.size() * sizeof(DebugIndexDirectoryEntry);
+    header.nameCount = names.size();
+    header.nameOffset = header.buildIdOffset + buildIds.size() * sizeof(DebugIndexBuildIdEntry);
+    header.stringsSize = strings.size();
+    header.stringsOffset = header.nameOffset + names.size() * sizeof(DebugIndexNameEntry);
+
+    std::error_code error;
+    std::filesystem::path indexPath(_indexPath);
+    if (indexPath.has_parent_path())
+    {
+        std::filesystem::create_directories(indexPath.parent_path(), error);
+    }
+
+    std::string tempPath = _indexPath + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Failed to write debug index: %s", tempPath.c_str());
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(directories.data()),
+                  directories.size() * sizeof(DebugIndexDirectoryEntry));
+        out.write(reinterpret_cast<const char *>(buildIds.data()), buildIds.size() * sizeof(DebugIndexBuildIdEntry));
+        out.write(reinterpret_cast<const char *>(names.data()), names.size() * sizeof(DebugIndexNameEntry));
+        out.write(strings.data(), strings.size());
+        if (!out.good())
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Failed to write debug index: %s", tempPath.c_str());
+        }
+    }
+    if (rename(tempPath.c_str(), _indexPath.c_str()) != 0)
+    {
+        unlink(tempPath.c_str());
+        LOG_THROW(Logger::LogLevel::Error, "Failed to move debug index into place: %s", _indexPath.c_str());
+    }
+    LOG(Logger::LogLevel::Info, "Indexed %zu build-ids and %zu files from %zu directories", buildIds.size(),
+        names.size(), directories.size());
+}
+
+const char *DebugFileLocator::IndexString(uint32_t offset) const
+{
+    if (offset >= _header->stringsSize)
+    {
+        return "";
+    }
+    return reinterpret_cast<const char *>(_index->Data() + _header->stringsOffset + offset);
+}
+
+std::span<const DebugIndexBuildIdEntry> DebugFileLocator::BuildIdEntries() const
+{
+    return {reinterpret_cast<const DebugIndexBuildIdEntry *>(_index->Data() + _header->buildIdOffset),
+            _header->buildIdCount};
+}
+
+std::span<const DebugIndexNameEntry> DebugFileLocator::NameEntries() const
+{
+    return {reinterpret_cast<const DebugIndexNameEntry *>(_index->Data() + _header->nameOffset), _header->nameCount};
+}
+
+std::span<const DebugIndexDirectoryEntry> DebugFileLocator::DirectoryEntries() const
+{
+    return {reinterpret_cast<const DebugIndexDirectoryEntry *>(_index->Data() + _header->directoryOffset),
+            _header->directoryCount};
+}
+
+/**
+ * @brief Checks that a candidate file still carries the expected build-id.
+ */
+bool DebugFileLocator::MatchesBuildId(const std::string &fileName, std::span<const uint8_t> buildId) const
+{
+    try
+    {
+        ElfSegments segments(fileName);
+        ElfNotes notes(segments);
+        return std::ranges::equal(notes.GetBuildId(), buildId);
+    }
+    catch (const std::exception &e)
+    {
+        return false;
+    }
+}
@@ -0,0 +1,370 @@
+#include "dwarf.hpp"
+#include "logger.hpp"
+
+/**
+ * @brief Collects the debug sections of a file, decompressing the compressed ones.
+ *
+ * @param elfHandler The parsed ELF file.
+ * @param pool The pool to decompress on, or nullptr to decompress on the calling thread.
+ * @return Views over each debug section, empty where the section is missing.
+ */
+DwarfSections LoadDwarfSections(const ElfHandler &elfHandler, ThreadPool *pool)
+{
+    SectionDecompressor decompressor(elfHandler);
+    return LoadDwarfSections(elfHandler, decompressor, {}, pool);
+}
+
+/**
+ * @brief Collects the debug sections of a file. Compressed sections (SHF_COMPRESSED or .zdebug_*) are decompressed
+ * through the given decompressor, in parallel when given a pool, and kept alive by the returned sections.
+ *
+ * @param elfHandler The parsed ELF file.
+ * @param decompressor The decompressor, and cache, for the file's compressed sections.
+ * @param suffix Suffix of the section names, ".dwo" for the split sections of .dwo files and .dwp packages.
+ * @param pool The pool to decompress on, or nullptr to decompress on the calling thread.
+ * @return Views over each debug section, empty where the section is missing.
+ * @throws std::runtime_error if a compressed section cannot be decompressed.
+ */
+DwarfSections LoadDwarfSections(const ElfHandler &elfHandler, SectionDecompressor &decompressor,
+                                std::string_view suffix, ThreadPool *pool)
+{
+    const std::pair<const char *, std::span<const uint8_t> DwarfSections::*> sectionNames[] = {
+        {"info", &DwarfSections::info},         {"abbrev", &DwarfSections::abbrev},
+        {"line", &DwarfSections::line},         {"line_str", &DwarfSections::lineStr},
+        {"str", &DwarfSections::str},           {"str_offsets", &DwarfSections::strOffsets},
+        {"addr", &DwarfSections::addr},         {"ranges", &DwarfSections::ranges},
+        {"rnglists", &DwarfSections::rnglists}, {"aranges", &DwarfSections::aranges},
+        {"names", &DwarfSections::names},
+    };
+
+    std::vector<std::pair<const ElfSection *, std::span<const uint8_t> DwarfSections::*>> found;
+    for (const auto &[name, member] : sectionNames)
+    {
+        const ElfSection *section = elfHandler.FindSection(std::string(".debug_") + name + std::string(suffix));
+        section =
+            section != nullptr ? section : elfHandler.FindSection(std::string(".zdebug_") + name + std::string(suffix));
+        if (section != nullptr)
+        {
+            found.emplace_back(section, member);
+        }
+    }
+    if (const ElfSection *section = elfHandler.FindSection(".gdb_index"))
+    {
+        found.emplace_back(section, &DwarfSections::gdbIndex);
+    }
+
+    std::vector<const ElfSection *> candidates;
+    for (const auto &[section, member] : found)
+    {
+        candidates.push_back(section);
+    }
+    decompressor.Prefetch(candidates, pool);
+
+    DwarfSections sections;
+    for (const auto &[section, member] : found)
+    {
+        if (auto decompressed = decompressor.Get(*section))
+        {
+            sections.*member = decompressed->GetData();
+            sections.decompressed.push_back(std::move(decompressed));
+        }
+        else
+        {
+            sections.*member = elfHandler.GetSectionData(*section);
+        }
+    }
+    return sections;
+}
+
+/**
+ * @brief Reads a NUL terminated string from a string section such as .debug_str.
+ *
+ * @param section The string section.
+ * @param offset The offset of the string.
+ * @return The string, without its terminator.
+ * @throws std::runtime_error if the offset is out of range or the string is unterminated.
+ */
+std::string_view ReadDwarfString(std::span<const uint8_t> section, uint64_t offset)
+{
+    if (offset >= section.size())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Invalid DWARF string offset 0x%lx", offset);
+    }
+    const char *start = reinterpret_cast<const char *>(section.data() + offset);
+    size_t length = strnlen(start, section.size() - offset);
+    if (length == section.size() - offset)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Unterminated DWARF string at offset 0x%lx", offset);
+    }
+    return {start, length};
+}
+
+/**
+ * @brief Constructor for the DwarfReader class.
+ *
+ * @param data The section to read.
+ * @param offset The starting offset within the section.
+ */
+DwarfReader::DwarfReader(std::span<const uint8_t> data, uint64_t offset) : _data(data), _offset(offset)
+{
+}
+
+uint64_t DwarfReader::GetOffset() const
+{
+    return _offset;
+}
+
+void DwarfReader::SetOffset(uint64_t offset)
+{
+    _offset = offset;
+}
+
+uint64_t DwarfReader::Remaining() const
+{
+    return _offset < _data.size() ? _data.size() - _offset : 0;
+}
+
+bool DwarfReader::AtEnd() const
+{
+    return _offset >= _data.size();
+}
+
+std::span<const uint8_t> DwarfReader::GetData() const
+{
+    return _data;
+}
+
+/**
+ * @brief Throws unless at least size bytes remain.
+ */
+void DwarfReader::Require(uint64_t size) const
+{
+    if (size > Remaining())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Truncated DWARF data at offset 0x%lx", _offset);
+    }
+}
+
+uint8_t DwarfReader::ReadU8()
+{
+    Require(1);
+    return _data[_offset++];
+}
+
+uint16_t DwarfReader::ReadU16()
+{
+    return static_cast<uint16_t>(ReadUnsigned(2));
+}
+
+uint32_t DwarfReader::ReadU24()
+{
+    return static_cast<uint32_t>(ReadUnsigned(3));
+}
+
+uint32_t DwarfReader::ReadU32()
+{
+    return static_cast<uint32_t>(ReadUnsigned(4));
+}
+
+uint64_t DwarfReader::ReadU64()
+{
+    return ReadUnsigned(8);
+}
+
+/**
+ * @brief Reads a little-endian unsigned integer of 1 to 8 bytes.
+ */
+uint64_t DwarfReader::ReadUnsigned(uint8_t size)
+{
+    Require(size);
+    uint64_t value = 0;
+    memcpy(&value, _data.data() + _offset, size > sizeof(value) ? sizeof(value) : size);
+    _offset += size;
+    return value;
+}
+
+uint64_t DwarfReader::ReadULEB128()
+{
+    uint64_t result = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = ReadU8();
+        if (shift < 64)
+        {
+            result |= uint64_t(byte & 0x7f) << shift;
+        }
+        shift += 7;
+    } while (byte & 0x80);
+    return result;
+}
+
+int64_t DwarfReader::ReadSLEB128()
+{
+    int64_t result = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = ReadU8();
+        if (shift < 64)
+        {
+            result |= int64_t(byte & 0x7f) << shift;
+        }
+        shift += 7;
+    } while (byte & 0x80);
+    if (shift < 64 && (byte & 0x40))
+    {
+        result |= static_cast<int64_t>(~uint64_t(0) << shift);
+    }
+    return result;
+}
+
+std::string_view DwarfReader::ReadCString()
+{
+    std::string_view value = ReadDwarfString(_data, _offset);
+    _offset += value.size() + 1;
+    return value;
+}
+
+/**
+ * @brief Reads an initial length field, detecting the 64-bit DWARF format.
+ *
+ * @param is64 Set to true if the unit uses the 64-bit DWARF format.
+ * @return The length of the unit following the length field.
+ */
+uint64_t DwarfReader::ReadUnitLength(bool &is64)
+{
+    uint64_t length = ReadU32();
+    is64 = length == 0xffffffff;
+    if (is64)
+    {
+        length = ReadU64();
+    }
+    else if (length >= 0xfffffff0)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Reserved DWARF unit length 0x%lx", length);
+    }
+    return length;
+}
+
+uint64_t DwarfReader::ReadOffset(bool is64)
+{
+    return is64 ? ReadU64() : ReadU32();
+}
+
+std::span<const uint8_t> DwarfReader::ReadBytes(uint64_t size)
+{
+    Require(size);
+    std::span<const uint8_t> bytes = _data.subspan(_offset, size);
+    _offset += size;
+    return bytes;
+}
+
+void DwarfReader::Skip(uint64_t size)
+{
+    Require(size);
+    _offset += size;
+}
+
+/**
+ * @brief Skips over an attribute value of the given form.
+ *
+ * @param form The DW_FORM_* of the value.
+ * @param addressSize The size of a target address.
+ * @param is64 Whether the unit uses the 64-bit DWARF format.
+ * @param version The DWARF version of the unit, DW_FORM_ref_addr was address sized before version 3.
+ * @throws std::runtime_error for unknown forms.
+ */
+void DwarfReader::SkipForm(uint16_t form, uint8_t addressSize, bool is64, uint16_t version)
+{
+    uint8_t offsetSize = is64 ? 8 : 4;
+    switch (form)
+    {
+    case DW_FORM_flag_present:
+    case DW_FORM_implicit_const:
+        break;
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+        Skip(1);
+        break;
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+        Skip(2);
+        break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+        Skip(3);
+        break;
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+        Skip(4);
+        break;
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+        Skip(8);
+        break;
+    case DW_FORM_data16:
+        Skip(16);
+        break;
+    case DW_FORM_addr:
+        Skip(addressSize);
+        break;
+    case DW_FORM_ref_addr:
+        Skip(version <= 2 ? addressSize : offsetSize);
+        break;
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_sec_offset:
+    case DW_FORM_strp_sup:
+    case DW_FORM_GNU_ref_alt:
+    case DW_FORM_GNU_strp_alt:
+        Skip(offsetSize);
+        break;
+    case DW_FORM_sdata:
+        ReadSLEB128();
+        break;
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+    case DW_FORM_GNU_addr_index:
+    case DW_FORM_GNU_str_index:
+        ReadULEB128();
+        break;
+    case DW_FORM_string:
+        ReadCString();
+        break;
+    case DW_FORM_block1:
+        Skip(ReadU8());
+        break;
+    case DW_FORM_block2:
+        Skip(ReadU16());
+        break;
+    case DW_FORM_block4:
+        Skip(ReadU32());
+        break;
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+        Skip(ReadULEB128());
+        break;
+    case DW_FORM_indirect:
+        SkipForm(static_cast<uint16_t>(ReadULEB128()), addressSize, is64, version);
+        break;
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Unknown DWARF form 0x%x", form);
+    }
+}
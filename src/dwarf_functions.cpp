@@ -0,0 +1,379 @@
+#include "dwarf_functions.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+// Longest DW_AT_specification/DW_AT_abstract_origin chain followed for a name
+constexpr int DWARF_MAX_NAME_HOPS = 4;
+
+// Resolves the names of entries that only refer to their declaration or abstract instance. Inlined calls of the
+// same function all point at one abstract instance, so resolved names are cached by DIE offset.
+class DwarfNameResolver
+{
+  public:
+    using Names = std::pair<std::string_view, std::string_view>; // name, linkage name
+
+    DwarfNameResolver(const DwarfSections &sections, std::span<const DwarfUnitHeader> units, DwarfAbbrevCache &abbrevs)
+        : _sections(sections), _units(units), _abbrevs(abbrevs)
+    {
+    }
+
+    Names Resolve(const DwarfUnit &unit, const DwarfDie &die, int hops = 0)
+    {
+        Names names;
+        if (const DwarfAttribute *name = die.Find(DW_AT_name))
+        {
+            names.first = unit.GetString(*name);
+        }
+        const DwarfAttribute *linkageName = die.Find(DW_AT_linkage_name);
+        linkageName = linkageName != nullptr ? linkageName : die.Find(DW_AT_MIPS_linkage_name);
+        if (linkageName != nullptr)
+        {
+            names.second = unit.GetString(*linkageName);
+        }
+        if ((!names.first.empty() && !names.second.empty()) || hops >= DWARF_MAX_NAME_HOPS)
+        {
+            return names;
+        }
+
+        const DwarfAttribute *reference = die.Find(DW_AT_abstract_origin);
+        reference = reference != nullptr ? reference : die.Find(DW_AT_specification);
+        if (reference == nullptr)
+        {
+            return names;
+        }
+
+        Names referenced;
+        if (auto cached = _cache.find(reference->value); cached != _cache.end())
+        {
+            referenced = cached->second;
+        }
+        else
+        {
+            referenced = ResolveReference(unit, reference->value, hops + 1);
+            _cache.emplace(reference->value, referenced);
+        }
+        if (names.first.empty())
+        {
+            names.first = referenced.first;
+        }
+        if (names.second.empty())
+        {
+            names.second = referenced.second;
+        }
+        return names;
+    }
+
+  private:
+    const DwarfSections &_sections;
+    std::span<const DwarfUnitHeader> _units;
+    DwarfAbbrevCache &_abbrevs;
+    std::unordered_map<uint64_t, Names> _cache;
+
+    Names ResolveReference(const DwarfUnit &unit, uint64_t offset, int hops)
+    {
+        if (unit.Contains(offset))
+        {
+            return Resolve(unit, unit.ReadDieAt(offset), hops);
+        }
+
+        // DW_FORM_ref_addr into another unit, as LTO produces
+        auto it = std::upper_bound(_units.begin(), _units.end(), offset,
+                                   [](uint64_t value, const DwarfUnitHeader &header) { return value < header.offset; });
+        if (it == _units.begin() || offset >= (--it)->endOffset)
+        {
+            return {};
+        }
+        DwarfUnit other(_sections, *it, _abbrevs.Get(it->abbrevOffset));
+        return Resolve(other, other.ReadDieAt(offset), hops);
+    }
+};
+
+/**
+ * @brief Walks the DIEs of a unit, collecting the functions with code and the calls inlined into them.
+ *
+ * @details Functions without code (declarations, abstract instances of inline functions) and their children are
+ * skipped, through DW_AT_sibling where the producer emits it. Inlined calls are stored in DIE order, so the calls of
+ * a function are contiguous and an enclosing call always precedes the calls nested in it.
+ *
+ * @param sections The debug sections of the file.
+ * @param units The headers of every unit of the file, sorted by offset, for references between units.
+ * @param unit The index of the unit to walk.
+ * @param abbrevs The shared abbreviation tables.
+ * @param skeleton The skeleton unit when walking a split unit; the functions are then reported at its offset.
+ * @throws std::runtime_error if the unit is malformed.
+ */
+DwarfUnitFunctions::DwarfUnitFunctions(const DwarfSections &sections, std::span<const DwarfUnitHeader> units,
+                                       size_t unit, DwarfAbbrevCache &abbrevs, const DwarfUnit *skeleton)
+{
+    const DwarfUnitHeader &header = units[unit];
+    DwarfUnit dwarfUnit(sections, header, abbrevs.Get(header.abbrevOffset), skeleton);
+    _unitOffset = skeleton != nullptr ? skeleton->GetHeader().offset : header.offset;
+    _stmtList = dwarfUnit.GetStmtList();
+    _compDir = dwarfUnit.GetCompDir();
+    if (!dwarfUnit.GetUnitDie().HasChildren())
+    {
+        return;
+    }
+
+    constexpr uint32_t noFunction = UINT32_MAX;
+    struct Scope
+    {
+        uint32_t function;    // Innermost enclosing function with code
+        uint32_t inlinedCall; // Innermost enclosing inlined call
+        bool opensFunction;   // The DIE owning this scope is the function itself
+    };
+
+    DwarfNameResolver names(sections, units, abbrevs);
+    std::vector<Scope> scopes{{noFunction, DWARF_NO_INLINE, false}};
+    DwarfReader reader(sections.info.subspan(0, header.endOffset), header.dieOffset);
+    DwarfDie die{};
+    dwarfUnit.ReadDie(reader, die);
+    while (!scopes.empty() && !reader.AtEnd())
+    {
+        if (!dwarfUnit.ReadDie(reader, die))
+        {
+            if (scopes.back().opensFunction)
+            {
+                DwarfFunction &function = _functions[scopes.back().function];
+                function.inlineCount = static_cast<uint32_t>(_inlinedCalls.size() - function.firstInline);
+            }
+            scopes.pop_back();
+            continue;
+        }
+
+        Scope scope = scopes.back();
+        scope.opensFunction = false;
+        if (die.GetTag() == DW_TAG_subprogram)
+        {
+            auto ranges = dwarfUnit.GetRanges(die);
+            if (ranges.empty())
+            {
+                const DwarfAttribute *sibling = die.Find(DW_AT_sibling);
+                if (die.HasChildren() && sibling != nullptr && dwarfUnit.Contains(sibling->value))
+                {
+                    reader.SetOffset(sibling->value);
+                    continue;
+                }
+                scope = {noFunction, DWARF_NO_INLINE, false};
+            }
+            else
+            {
+                auto [name, linkageName] = names.Resolve(dwarfUnit, die);
+                uint32_t index = static_cast<uint32_t>(_functions.size());
+                _functions.push_back({name, linkageName, die.offset, static_cast<uint32_t>(_inlinedCalls.size()), 0});
+                for (const auto &[low, high] : ranges)
+                {
+                    _ranges.push_back({low, high, index});
+                }
+                scope = {index, DWARF_NO_INLINE, true};
+            }
+        }
+        else if (die.GetTag() == DW_TAG_inlined_subroutine && scope.function != noFunction)
+        {
+            auto ranges = dwarfUnit.GetRanges(die);
+            if (!ranges.empty())
+            {
+                auto [name, linkageName] = names.Resolve(dwarfUnit, die);
+                auto value = [&die](uint16_t attribute) {
+                    const DwarfAttribute *found = die.Find(attribute);
+                    return found != nullptr ? static_cast<uint32_t>(found->value) : 0;
+                };
+                uint32_t depth = scope.inlinedCall == DWARF_NO_INLINE ? 0 : _inlinedCalls[scope.inlinedCall].depth + 1;
+                uint32_t first = static_cast<uint32_t>(_inlinedCalls.size());
+                for (const auto &[low, high] : ranges)
+                {
+                    _inlinedCalls.push_back({low, high, name, linkageName, value(DW_AT_call_file),
+                                             value(DW_AT_call_line), value(DW_AT_call_column), depth,
+                                             scope.inlinedCall});
+                }
+                scope.inlinedCall = first;
+            }
+        }
+
+        if (die.HasChildren())
+        {
+            scopes.push_back(scope);
+        }
+    }
+
+    std::sort(_ranges.begin(), _ranges.end(), [](const auto &a, const auto &b) { return a.low < b.low; });
+    _functions.shrink_to_fit();
+    _inlinedCalls.shrink_to_fit();
+    _ranges.shrink_to_fit();
+}
+
+uint64_t DwarfUnitFunctions::GetUnitOffset() const
+{
+    return _unitOffset;
+}
+
+std::optional<uint64_t> DwarfUnitFunctions::GetStmtList() const
+{
+    return _stmtList;
+}
+
+std::string_view DwarfUnitFunctions::GetCompDir() const
+{
+    return _compDir;
+}
+
+const std::vector<DwarfFunction> &DwarfUnitFunctions::GetFunctions() const
+{
+    return _functions;
+}
+
+const std::vector<DwarfInlinedCall> &DwarfUnitFunctions::GetInlinedCalls() const
+{
+    return _inlinedCalls;
+}
+
+/**
+ * @brief Finds the function whose code contains an address.
+ *
+ * @return The function, or nullptr if no function of the unit covers the address.
+ */
+const DwarfFunction *DwarfUnitFunctions::FindFunction(uint64_t address) const
+{
+    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), address,
+                               [](uint64_t value, const DwarfFunctionRange &range) { return value < range.low; });
+    if (it == _ranges.begin() || address >= (--it)->high)
+    {
+        return nullptr;
+    }
+    return &_functions[it->function];
+}
+
+/**
+ * @brief Finds the innermost inlined call containing an address; its parent chain leads back to the function.
+ *
+ * @return The inlined call, or nullptr if the address is in the function's own code.
+ */
+const DwarfInlinedCall *DwarfUnitFunctions::FindInlinedCall(const DwarfFunction &function, uint64_t address) const
+{
+    const DwarfInlinedCall *innermost = nullptr;
+    for (uint32_t i = function.firstInline; i < function.firstInline + function.inlineCount; i++)
+    {
+        const DwarfInlinedCall &call = _inlinedCalls[i];
+        if (address >= call.low && address < call.high && (innermost == nullptr || call.depth > innermost->depth))
+        {
+            innermost = &call;
+        }
+    }
+    return innermost;
+}
+
+/**
+ * @brief Constructor for the DwarfFunctionIndex class. Only the unit headers are read.
+ *
+ * @param sections The debug sections of the file.
+ * @param splitUnits Resolver of the split units of skeleton units; nullptr to walk the skeletons themselves.
+ */
+DwarfFunctionIndex::DwarfFunctionIndex(const DwarfSections &sections, SplitDwarfResolver *splitUnits)
+    : _sections(sections), _abbrevs(_sections.abbrev), _headers(ReadUnitHeaders(_sections.info)),
+      _splitUnits(splitUnits)
+{
+    _units = std::make_unique<Unit[]>(_headers.size());
+}
+
+size_t DwarfFunctionIndex::GetUnitCount() const
+{
+    return _headers.size();
+}
+
+/**
+ * @brief Returns the functions of a unit, walking it on first use. Safe to call concurrently.
+ *
+ * @param unit The index of the unit.
+ * @return The functions; empty if the unit could not be read.
+ */
+const DwarfUnitFunctions &DwarfFunctionIndex::GetUnit(size_t unit)
+{
+    Unit &entry = _units[unit];
+    std::call_once(entry.decoded, [&]() {
+        try
+        {
+            entry.functions = DecodeUnit(unit);
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Skipping functions of DWARF unit at 0x%lx", _headers[unit].offset);
+            entry.functions = std::make_unique<DwarfUnitFunctions>();
+        }
+    });
+    return *entry.functions;
+}
+
+/**
+ * @brief Returns the functions of the unit at a .debug_info offset.
+ *
+ * @return The functions, or nullptr if no unit starts at that offset.
+ */
+const DwarfUnitFunctions *DwarfFunctionIndex::GetUnitAtOffset(uint64_t unitOffset)
+{
+    size_t unit = FindUnitIndex(unitOffset);
+    return unit < _headers.size() ? &GetUnit(unit) : nullptr;
+}
+
+/**
+ * @brief Walks the given units on a thread pool, one task per unit, and waits for them.
+ *
+ * @param unitOffsets The .debug_info offsets of the units.
+ * @param pool The pool to run on.
+ */
+void DwarfFunctionIndex::Decode(const std::vector<uint64_t> &unitOffsets, ThreadPool &pool)
+{
+    TaskGroup group(pool);
+    for (uint64_t unitOffset : unitOffsets)
+    {
+        size_t unit = FindUnitIndex(unitOffset);
+        if (unit < _headers.size())
+        {
+            group.Submit([this, unit]() { GetUnit(unit); });
+        }
+    }
+    group.Wait();
+}
+
+/**
+ * @brief Walks every unit on a thread pool. The largest units are queued first so they do not end up last.
+ */
+void DwarfFunctionIndex::DecodeAll(ThreadPool &pool)
+{
+    std::vector<size_t> order(_headers.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return _headers[a].endOffset - _headers[a].offset > _headers[b].endOffset - _headers[b].offset;
+    });
+    TaskGroup group(pool);
+    for (size_t unit : order)
+    {
+        group.Submit([this, unit]() { GetUnit(unit); });
+    }
+    group.Wait();
+}
+
+size_t DwarfFunctionIndex::FindUnitIndex(uint64_t unitOffset) const
+{
+    auto it = std::lower_bound(_headers.begin(), _headers.end(), unitOffset,
+                               [](const DwarfUnitHeader &header, uint64_t value) { return header.offset < value; });
+    return it != _headers.end() && it->offset == unitOffset ? size_t(it - _headers.begin()) : _headers.size();
+}
+
+std::unique_ptr<DwarfUnitFunctions> DwarfFunctionIndex::DecodeUnit(size_t unit)
+{
+    if (_splitUnits != nullptr)
+    {
+        const DwarfUnitHeader &header = _headers[unit];
+        DwarfUnit skeleton(_sections, header, _abbrevs.Get(header.abbrevOffset));
+        if (const SplitDwarfUnit *split = _splitUnits->Resolve(skeleton))
+        {
+            return std::make_unique<DwarfUnitFunctions>(split->sections, std::span(&split->header, 1), 0,
+                                                        *split->abbrevs, &skeleton);
+        }
+    }
+    return std::make_unique<DwarfUnitFunctions>(_sections, _headers, unit, _abbrevs);
+}
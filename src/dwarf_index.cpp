@@ -0,0 +1,997 @@
+#include "dwarf_index.hpp"
+#include "debug_locator.hpp"
+#include "dwarf_info.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <unistd.h>
+
+// Section relative layout of a .gdb_index
+struct GdbIndexLayout
+{
+    uint32_t version;
+    uint64_t compUnitsOffset;
+    uint64_t compUnitCount;
+    uint64_t addressOffset;
+    uint64_t addressCount;
+    uint64_t symbolTableOffset;
+    uint64_t symbolTableSize; // Number of slots, a power of two
+    uint64_t constantPoolOffset;
+};
+
+constexpr uint64_t GDB_INDEX_CU_SIZE = 16;      // offset, length
+constexpr uint64_t GDB_INDEX_ADDRESS_SIZE = 20; // low, high, CU index
+constexpr uint64_t GDB_INDEX_SLOT_SIZE = 8;     // name offset, CU vector offset
+
+/**
+ * @brief Reads the header of a .gdb_index (versions 7 to 9).
+ *
+ * @return false if the section is missing, of another version or inconsistent.
+ */
+static bool ReadGdbIndexLayout(std::span<const uint8_t> section, GdbIndexLayout &layout)
+{
+    if (section.empty())
+    {
+        return false;
+    }
+    try
+    {
+        DwarfReader reader(section);
+        layout.version = reader.ReadU32();
+        if (layout.version < 7 || layout.version > 9)
+        {
+            LOG(Logger::LogLevel::Warning, "Unsupported .gdb_index version %u", layout.version);
+            return false;
+        }
+        uint64_t compUnits = reader.ReadU32();
+        uint64_t typeUnits = reader.ReadU32();
+        uint64_t addresses = reader.ReadU32();
+        uint64_t symbolTable = reader.ReadU32();
+        uint64_t symbolTableEnd = reader.ReadU32(); // shortcut table from version 9, constant pool before
+        uint64_t constantPool = layout.version >= 9 ? reader.ReadU32() : symbolTableEnd;
+        if (!(compUnits <= typeUnits && typeUnits <= addresses && addresses <= symbolTable &&
+              symbolTable <= symbolTableEnd && symbolTableEnd <= constantPool && constantPool <= section.size()))
+        {
+            LOG(Logger::LogLevel::Warning, "Malformed .gdb_index header");
+            return false;
+        }
+        layout.compUnitsOffset = compUnits;
+        layout.compUnitCount = (typeUnits - compUnits) / GDB_INDEX_CU_SIZE;
+        layout.addressOffset = addresses;
+        layout.addressCount = (symbolTable - addresses) / GDB_INDEX_ADDRESS_SIZE;
+        layout.symbolTableOffset = symbolTable;
+        layout.symbolTableSize = (symbolTableEnd - symbolTable) / GDB_INDEX_SLOT_SIZE;
+        layout.constantPoolOffset = constantPool;
+        return (layout.symbolTableSize & (layout.symbolTableSize - 1)) == 0;
+    }
+    catch (const std::exception &e)
+    {
+        return false;
+    }
+}
+
+/**
+ * @brief The symbol hash of .gdb_index (version 5 and later), case insensitive.
+ */
+static uint32_t HashGdbIndexName(std::string_view name)
+{
+    uint32_t hash = 0;
+    for (unsigned char c : name)
+    {
+        hash = hash * 67 + static_cast<uint32_t>(tolower(c)) - 113;
+    }
+    return hash;
+}
+
+/**
+ * @brief Reads a .debug_names entry attribute value as an integer; values of other classes are skipped.
+ */
+static uint64_t ReadIndexValue(DwarfReader &reader, uint16_t form, bool is64)
+{
+    switch (form)
+    {
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+        return reader.ReadU8();
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+        return reader.ReadU16();
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+        return reader.ReadU32();
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+        return reader.ReadU64();
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+        return reader.ReadULEB128();
+    case DW_FORM_flag_present:
+        return 1;
+    default:
+        reader.SkipForm(form, 8, is64, 5);
+        return 0;
+    }
+}
+
+/**
+ * @brief Checks whether a DIE is one that a name index would list: a definition at namespace scope with a name
+ * that can be looked up.
+ */
+static bool IsIndexedEntry(const DwarfDie &die)
+{
+    if (die.Find(DW_AT_declaration) != nullptr)
+    {
+        return false;
+    }
+    switch (die.GetTag())
+    {
+    case DW_TAG_subprogram:
+        return die.Find(DW_AT_low_pc) != nullptr || die.Find(DW_AT_ranges) != nullptr ||
+               die.Find(DW_AT_inline) != nullptr;
+    case DW_TAG_variable:
+    case DW_TAG_base_type:
+    case DW_TAG_class_type:
+    case DW_TAG_structure_type:
+    case DW_TAG_union_type:
+    case DW_TAG_enumeration_type:
+    case DW_TAG_typedef:
+    case DW_TAG_namespace:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Runs readUnit(i) for every i below unitCount, as separate tasks of the pool when there is one, so that
+ * idle workers pick up the units of a large file.
+ */
+static void ForEachUnit(size_t unitCount, ThreadPool *pool, const std::function<void(size_t)> &readUnit)
+{
+    if (pool == nullptr)
+    {
+        for (size_t i = 0; i < unitCount; i++)
+        {
+            readUnit(i);
+        }
+        return;
+    }
+    TaskGroup group(*pool);
+    for (size_t i = 0; i < unitCount; i++)
+    {
+        group.Submit([&readUnit, i]() { readUnit(i); });
+    }
+    group.Wait();
+}
+
+/**
+ * @brief Constructor for the DwarfUnitIndex class. Nothing is parsed until the first lookup.
+ *
+ * @param sections The debug sections of the file.
+ * @param cachePath Where a built index is stored and looked for; empty to keep built indexes in memory only.
+ * @param pool The pool to build missing tables on, or nullptr to build them on the calling thread. Lookups that
+ * build a table must then not run as tasks of that pool.
+ */
+DwarfUnitIndex::DwarfUnitIndex(const DwarfSections &sections, std::string cachePath, ThreadPool *pool)
+    : _sections(sections), _cachePath(std::move(cachePath)), _pool(pool), _abbrevs(_sections.abbrev)
+{
+    if (!_cachePath.empty())
+    {
+        LoadCache();
+    }
+}
+
+/**
+ * @brief Returns the cache location for a file, under the debug index cache directory.
+ *
+ * @param buildIdHex The build-id of the file, which identifies its debug information.
+ */
+std::string DwarfUnitIndex::DefaultCachePath(const std::string &buildIdHex)
+{
+    return DebugFileLocator::CacheDirectory() + "/dwarf/" + buildIdHex + ".idx";
+}
+
+/**
+ * @brief The hash used by DWARF 5 name indexes (Bernstein's hash).
+ */
+uint32_t DwarfUnitIndex::HashName(std::string_view name)
+{
+    uint32_t hash = 5381;
+    for (unsigned char c : name)
+    {
+        hash = hash * 33 + c;
+    }
+    return hash;
+}
+
+DwarfIndexSource DwarfUnitIndex::GetAddressSource() const
+{
+    return _addressSource;
+}
+
+DwarfIndexSource DwarfUnitIndex::GetNameSource() const
+{
+    return _nameSource;
+}
+
+/**
+ * @brief Finds the unit describing the code at an address.
+ *
+ * @param address The address to look up.
+ * @return The offset of the unit in .debug_info, or std::nullopt if no unit covers the address.
+ */
+std::optional<uint64_t> DwarfUnitIndex::FindUnit(uint64_t address)
+{
+    std::call_once(_rangesBuilt, [this]() { BuildRanges(); });
+
+    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), address,
+                               [](uint64_t value, const DwarfIndexRange &range) { return value < range.low; });
+    if (it == _ranges.begin() || address >= (--it)->high)
+    {
+        return std::nullopt;
+    }
+    return it->unitOffset;
+}
+
+/**
+ * @brief Finds the units, and where the table knows them the DIEs, defining a name.
+ *
+ * @param name A plain or linkage (mangled) name.
+ * @return Every match, empty if the name is unknown.
+ */
+std::vector<DwarfNameMatch> DwarfUnitIndex::FindName(std::string_view name)
+{
+    std::call_once(_namesBuilt, [this]() { BuildNames(); });
+
+    switch (_nameSource)
+    {
+    case DwarfIndexSource::DebugNames:
+        return FindInDebugNames(name);
+    case DwarfIndexSource::GdbIndex:
+        return FindInGdbIndex(name);
+    case DwarfIndexSource::Built:
+    case DwarfIndexSource::Cache:
+        return FindInNameTable(name);
+    default:
+        return {};
+    }
+}
+
+/**
+ * @brief Maps a previously built index if it exists and matches the debug information.
+ */
+void DwarfUnitIndex::LoadCache()
+{
+    if (access(_cachePath.c_str(), R_OK) != 0)
+    {
+        return;
+    }
+
+    try
+    {
+        auto cache = std::make_unique<MappedFile>(_cachePath);
+        if (cache->Size() < sizeof(DwarfIndexHeader))
+        {
+            return;
+        }
+        auto header = reinterpret_cast<const DwarfIndexHeader *>(cache->Data());
+        if (memcmp(header->magic, DWARF_INDEX_MAGIC, sizeof(DWARF_INDEX_MAGIC)) != 0 ||
+            header->version != DWARF_INDEX_VERSION || header->infoSize != _sections.info.size())
+        {
+            LOG(Logger::LogLevel::Info, "DWARF index %s is stale, ignoring it", _cachePath.c_str());
+            return;
+        }
+
+        auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+            return offset <= cache->Size() && count <= (cache->Size() - offset) / size;
+        };
+        if (!fits(header->rangeOffset, header->rangeCount, sizeof(DwarfIndexRange)) ||
+            !fits(header->nameOffset, header->nameCount, sizeof(DwarfIndexName)) ||
+            !fits(header->stringsOffset, header->stringsSize, 1))
+        {
+            LOG(Logger::LogLevel::Warning, "DWARF index %s is corrupt, ignoring it", _cachePath.c_str());
+            return;
+        }
+
+        const uint8_t *data = cache->Data();
+        if (header->flags & DWARF_INDEX_HAS_RANGES)
+        {
+            _ranges = {reinterpret_cast<const DwarfIndexRange *>(data + header->rangeOffset), header->rangeCount};
+            _addressSource = DwarfIndexSource::Cache;
+        }
+        if (header->flags & DWARF_INDEX_HAS_NAMES)
+        {
+            _names = {reinterpret_cast<const DwarfIndexName *>(data + header->nameOffset), header->nameCount};
+            _strings = {reinterpret_cast<const char *>(data + header->stringsOffset), header->stringsSize};
+            _nameSource = DwarfIndexSource::Cache;
+        }
+        _cache = std::move(cache);
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Warning, "Failed to open DWARF index %s", _cachePath.c_str());
+    }
+}
+
+/**
+ * @brief Writes the tables built so far to the cache path. Failures only cost the next run a rebuild, so they are
+ * logged rather than thrown.
+ */
+void DwarfUnitIndex::SaveCache()
+{
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+
+    DwarfIndexHeader header{};
+    memcpy(header.magic, DWARF_INDEX_MAGIC, sizeof(DWARF_INDEX_MAGIC));
+    header.version = DWARF_INDEX_VERSION;
+    header.infoSize = _sections.info.size();
+    if (_addressSource != DwarfIndexSource::None)
+    {
+        header.flags |= DWARF_INDEX_HAS_RANGES;
+        header.rangeCount = _ranges.size();
+    }
+    if (_nameSource == DwarfIndexSource::Built || _nameSource == DwarfIndexSource::Cache)
+    {
+        header.flags |= DWARF_INDEX_HAS_NAMES;
+        header.nameCount = _names.size();
+        header.stringsSize = _strings.size();
+    }
+    header.rangeOffset = sizeof(DwarfIndexHeader);
+    header.nameOffset = header.rangeOffset + header.rangeCount * sizeof(DwarfIndexRange);
+    header.stringsOffset = header.nameOffset + header.nameCount * sizeof(DwarfIndexName);
+
+    std::error_code error;
+    std::filesystem::path cachePath(_cachePath);
+    if (cachePath.has_parent_path())
+    {
+        std::filesystem::create_directories(cachePath.parent_path(), error);
+    }
+
+    std::string tempPath = _cachePath + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            LOG(Logger::LogLevel::Warning, "Failed to write DWARF index: %s", tempPath.c_str());
+            return;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(_ranges.data()), header.rangeCount * sizeof(DwarfIndexRange));
+        out.write(reinterpret_cast<const char *>(_names.data()), header.nameCount * sizeof(DwarfIndexName));
+        out.write(_strings.data(), header.stringsSize);
+        if (!out.good())
+        {
+            LOG(Logger::LogLevel::Warning, "Failed to write DWARF index: %s", tempPath.c_str());
+            unlink(tempPath.c_str());
+            return;
+        }
+    }
+    if (rename(tempPath.c_str(), _cachePath.c_str()) != 0)
+    {
+        unlink(tempPath.c_str());
+        LOG(Logger::LogLevel::Warning, "Failed to move DWARF index into place: %s", _cachePath.c_str());
+    }
+}
+
+/**
+ * @brief Builds the address table, from .debug_aranges or .gdb_index when present. Units those tables do not
+ * cover (or every unit, without them) have their ranges read from their unit DIE.
+ */
+void DwarfUnitIndex::BuildRanges()
+{
+    if (_addressSource == DwarfIndexSource::Cache)
+    {
+        return;
+    }
+
+    DwarfIndexSource source = DwarfIndexSource::Built;
+    std::vector<uint64_t> missing;
+    if (!_sections.aranges.empty())
+    {
+        source = DwarfIndexSource::Aranges;
+        std::vector<uint64_t> covered = ParseAranges();
+        for (const auto &header : ReadUnitHeaders(_sections.info))
+        {
+            bool hasCode = header.unitType == DW_UT_compile || header.unitType == DW_UT_partial ||
+                           header.unitType == DW_UT_skeleton;
+            if (hasCode && !std::binary_search(covered.begin(), covered.end(), header.offset))
+            {
+                missing.push_back(header.offset);
+            }
+        }
+    }
+    else if (ReadGdbIndexRanges())
+    {
+        source = DwarfIndexSource::GdbIndex;
+    }
+    else
+    {
+        for (const auto &header : ReadUnitHeaders(_sections.info))
+        {
+            if (header.unitType == DW_UT_compile || header.unitType == DW_UT_partial ||
+                header.unitType == DW_UT_skeleton)
+            {
+                missing.push_back(header.offset);
+            }
+        }
+    }
+
+    if (!missing.empty())
+    {
+        LOG(Logger::LogLevel::Debug, "Reading address ranges of %zu DWARF units", missing.size());
+        BuildRangesFromUnits(missing);
+    }
+    std::sort(_rangeStorage.begin(), _rangeStorage.end(),
+              [](const auto &a, const auto &b) { return a.low < b.low; });
+
+    {
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        _ranges = _rangeStorage;
+        _addressSource = source;
+    }
+    if (!missing.empty() && !_cachePath.empty())
+    {
+        SaveCache();
+    }
+}
+
+/**
+ * @brief Reads every address range set of .debug_aranges into _rangeStorage.
+ *
+ * @return The sorted offsets of the units that have a set.
+ */
+std::vector<uint64_t> DwarfUnitIndex::ParseAranges()
+{
+    std::vector<uint64_t> covered;
+    DwarfReader reader(_sections.aranges);
+    try
+    {
+        while (!reader.AtEnd())
+        {
+            uint64_t setOffset = reader.GetOffset();
+            bool is64 = false;
+            uint64_t length = reader.ReadUnitLength(is64);
+            uint64_t setEnd = reader.GetOffset() + length;
+            reader.ReadU16(); // version
+            uint64_t unitOffset = reader.ReadOffset(is64);
+            uint8_t addressSize = reader.ReadU8();
+            uint8_t segmentSize = reader.ReadU8();
+            if (addressSize != 4 && addressSize != 8)
+            {
+                LOG_THROW(Logger::LogLevel::Error, "Unsupported address size %u in .debug_aranges", addressSize);
+            }
+
+            // The first tuple is aligned to the tuple size, counted from the start of the set
+            uint64_t tupleSize = 2 * addressSize + segmentSize;
+            uint64_t headerSize = reader.GetOffset() - setOffset;
+            reader.SetOffset(setOffset + (headerSize + tupleSize - 1) / tupleSize * tupleSize);
+            covered.push_back(unitOffset);
+            while (reader.GetOffset() + tupleSize <= setEnd)
+            {
+                reader.Skip(segmentSize);
+                uint64_t start = reader.ReadUnsigned(addressSize);
+                uint64_t size = reader.ReadUnsigned(addressSize);
+                if (start == 0 && size == 0)
+                {
+                    break;
+                }
+                // Ranges of discarded code are left at 0 or at a tombstone that wraps around
+                if (start != 0 && size != 0 && start + size > start)
+                {
+                    _rangeStorage.push_back({start, start + size, unitOffset});
+                }
+            }
+            reader.SetOffset(setEnd);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Warning, "Stopped reading .debug_aranges after %zu sets", covered.size());
+    }
+
+    std::sort(covered.begin(), covered.end());
+    return covered;
+}
+
+/**
+ * @brief Reads the address area of .gdb_index into _rangeStorage.
+ *
+ * @return false if the file has no usable .gdb_index.
+ */
+bool DwarfUnitIndex::ReadGdbIndexRanges()
+{
+    GdbIndexLayout layout{};
+    if (!ReadGdbIndexLayout(_sections.gdbIndex, layout))
+    {
+        return false;
+    }
+
+    DwarfReader reader(_sections.gdbIndex, layout.addressOffset);
+    DwarfReader units(_sections.gdbIndex);
+    for (uint64_t i = 0; i < layout.addressCount; i++)
+    {
+        uint64_t low = reader.ReadU64();
+        uint64_t high = reader.ReadU64();
+        uint32_t unit = reader.ReadU32();
+        if (unit < layout.compUnitCount && low != 0 && high > low)
+        {
+            units.SetOffset(layout.compUnitsOffset + unit * GDB_INDEX_CU_SIZE);
+            _rangeStorage.push_back({low, high, units.ReadU64()});
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the ranges of the given units from their unit DIEs, one pool task each. Units whose DIE carries no
+ * ranges contribute the ranges of their functions instead.
+ *
+ * @param unitOffsets The offsets of the units in .debug_info.
+ */
+void DwarfUnitIndex::BuildRangesFromUnits(const std::vector<uint64_t> &unitOffsets)
+{
+    std::vector<std::vector<DwarfIndexRange>> unitRanges(unitOffsets.size());
+    ForEachUnit(unitOffsets.size(), _pool, [&](size_t i) {
+        try
+        {
+            DwarfUnitHeader header = ReadUnitHeader(_sections.info, unitOffsets[i]);
+            DwarfUnit unit(_sections, header, _abbrevs.Get(header.abbrevOffset));
+
+            auto ranges = unit.GetRanges(unit.GetUnitDie());
+            if (ranges.empty() && unit.GetUnitDie().HasChildren())
+            {
+                DwarfReader reader(_sections.info.subspan(0, header.endOffset), header.dieOffset);
+                DwarfDie die{};
+                unit.ReadDie(reader, die);
+                while (!reader.AtEnd())
+                {
+                    if (unit.ReadDie(reader, die) && die.GetTag() == DW_TAG_subprogram)
+                    {
+                        auto functionRanges = unit.GetRanges(die);
+                        ranges.insert(ranges.end(), functionRanges.begin(), functionRanges.end());
+                    }
+                }
+            }
+
+            for (const auto &[low, high] : ranges)
+            {
+                if (low != 0)
+                {
+                    unitRanges[i].push_back({low, high, header.offset});
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Skipping ranges of DWARF unit at 0x%lx", unitOffsets[i]);
+        }
+    });
+
+    for (const auto &ranges : unitRanges)
+    {
+        _rangeStorage.insert(_rangeStorage.end(), ranges.begin(), ranges.end());
+    }
+}
+
+/**
+ * @brief Sets up name lookups, through .debug_names or .gdb_index in place when present, by building the name
+ * table otherwise.
+ */
+void DwarfUnitIndex::BuildNames()
+{
+    if (_nameSource == DwarfIndexSource::Cache)
+    {
+        return;
+    }
+
+    if (!_sections.names.empty())
+    {
+        ParseDebugNames();
+        if (!_nameIndexes.empty())
+        {
+            _nameSource = DwarfIndexSource::DebugNames;
+            return;
+        }
+    }
+
+    GdbIndexLayout layout{};
+    if (ReadGdbIndexLayout(_sections.gdbIndex, layout))
+    {
+        _nameSource = DwarfIndexSource::GdbIndex;
+        return;
+    }
+
+    BuildNamesFromUnits();
+    if (!_cachePath.empty())
+    {
+        SaveCache();
+    }
+}
+
+/**
+ * @brief Reads the header and abbreviations of every name index in .debug_names. The hash table, name table and
+ * entry pool are used in place by FindInDebugNames.
+ */
+void DwarfUnitIndex::ParseDebugNames()
+{
+    DwarfReader reader(_sections.names);
+    try
+    {
+        while (!reader.AtEnd())
+        {
+            NameIndex index{};
+            uint64_t length = reader.ReadUnitLength(index.is64);
+            uint64_t end = reader.GetOffset() + length;
+            uint16_t version = reader.ReadU16();
+            if (version != 5)
+            {
+                LOG(Logger::LogLevel::Warning, "Skipping .debug_names index of version %u", version);
+                reader.SetOffset(end);
+                continue;
+            }
+            reader.ReadU16(); // padding
+            index.compUnitCount = reader.ReadU32();
+            uint32_t localTypeUnitCount = reader.ReadU32();
+            uint32_t foreignTypeUnitCount = reader.ReadU32();
+            index.bucketCount = reader.ReadU32();
+            index.nameCount = reader.ReadU32();
+            uint32_t abbrevTableSize = reader.ReadU32();
+            uint32_t augmentationSize = reader.ReadU32();
+            reader.Skip((uint64_t(augmentationSize) + 3) & ~uint64_t(3));
+
+            uint64_t offsetSize = index.is64 ? 8 : 4;
+            index.compUnitsOffset = reader.GetOffset();
+            index.bucketsOffset = index.compUnitsOffset +
+                                  (uint64_t(index.compUnitCount) + localTypeUnitCount) * offsetSize +
+                                  uint64_t(foreignTypeUnitCount) * 8;
+            index.hashesOffset = index.bucketsOffset + uint64_t(index.bucketCount) * 4;
+            index.stringOffsetsOffset =
+                index.hashesOffset + (index.bucketCount != 0 ? uint64_t(index.nameCount) * 4 : 0);
+            index.entryOffsetsOffset = index.stringOffsetsOffset + uint64_t(index.nameCount) * offsetSize;
+            uint64_t abbrevOffset = index.entryOffsetsOffset + uint64_t(index.nameCount) * offsetSize;
+            index.entryPoolOffset = abbrevOffset + abbrevTableSize;
+            if (index.entryPoolOffset > end || end > _sections.names.size())
+            {
+                LOG_THROW(Logger::LogLevel::Error, "Malformed .debug_names index at 0x%lx", index.compUnitsOffset);
+            }
+
+            reader.SetOffset(abbrevOffset);
+            for (uint64_t code = reader.ReadULEB128(); code != 0; code = reader.ReadULEB128())
+            {
+                NameAbbrev abbrev{code, static_cast<uint16_t>(reader.ReadULEB128()), {}};
+                for (;;)
+                {
+                    uint16_t attribute = static_cast<uint16_t>(reader.ReadULEB128());
+                    uint16_t form = static_cast<uint16_t>(reader.ReadULEB128());
+                    if (attribute == 0 && form == 0)
+                    {
+                        break;
+                    }
+                    abbrev.attributes.emplace_back(attribute, form);
+                }
+                index.abbrevs.push_back(std::move(abbrev));
+            }
+            std::sort(index.abbrevs.begin(), index.abbrevs.end(),
+                      [](const auto &a, const auto &b) { return a.code < b.code; });
+            _nameIndexes.push_back(std::move(index));
+            reader.SetOffset(end);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Warning, "Stopped reading .debug_names after %zu indexes", _nameIndexes.size());
+    }
+}
+
+/**
+ * @brief Looks a name up in the hash tables of .debug_names.
+ */
+std::vector<DwarfNameMatch> DwarfUnitIndex::FindInDebugNames(std::string_view name) const
+{
+    std::vector<DwarfNameMatch> matches;
+    uint32_t hash = HashName(name);
+    for (const auto &index : _nameIndexes)
+    {
+        uint64_t offsetSize = index.is64 ? 8 : 4;
+        DwarfReader table(_sections.names);
+        auto readOffset = [&](uint64_t at) {
+            table.SetOffset(at);
+            return table.ReadOffset(index.is64);
+        };
+        auto matchesName = [&](uint32_t i) {
+            return ReadDwarfString(_sections.str, readOffset(index.stringOffsetsOffset + i * offsetSize)) == name;
+        };
+        auto collect = [&](uint32_t i) {
+            DwarfReader entries(_sections.names, index.entryPoolOffset + readOffset(index.entryOffsetsOffset +
+                                                                                    i * offsetSize));
+            for (uint64_t code = entries.ReadULEB128(); code != 0; code = entries.ReadULEB128())
+            {
+                auto abbrev = std::lower_bound(index.abbrevs.begin(), index.abbrevs.end(), code,
+                                               [](const NameAbbrev &a, uint64_t value) { return a.code < value; });
+                if (abbrev == index.abbrevs.end() || abbrev->code != code)
+                {
+                    LOG(Logger::LogLevel::Warning, "Unknown .debug_names abbreviation %lu", code);
+                    return;
+                }
+
+                // A single unit index may leave DW_IDX_compile_unit out
+                uint64_t unit = index.compUnitCount == 1 ? 0 : UINT64_MAX;
+                uint64_t dieOffset = 0;
+                bool isTypeUnit = false;
+                for (const auto &[attribute, form] : abbrev->attributes)
+                {
+                    uint64_t value = ReadIndexValue(entries, form, index.is64);
+                    if (attribute == DW_IDX_compile_unit)
+                        unit = value;
+                    else if (attribute == DW_IDX_type_unit)
+                        isTypeUnit = true;
+                    else if (attribute == DW_IDX_die_offset)
+                        dieOffset = value;
+                }
+                if (!isTypeUnit && unit < index.compUnitCount)
+                {
+                    uint64_t unitOffset = readOffset(index.compUnitsOffset + unit * offsetSize);
+                    matches.push_back({unitOffset, dieOffset != 0 ? unitOffset + dieOffset : 0});
+                }
+            }
+        };
+
+        try
+        {
+            if (index.bucketCount == 0)
+            {
+                for (uint32_t i = 0; i < index.nameCount; i++)
+                {
+                    if (matchesName(i))
+                    {
+                        collect(i);
+                    }
+                }
+                continue;
+            }
+
+            uint32_t bucket = hash % index.bucketCount;
+            table.SetOffset(index.bucketsOffset + uint64_t(bucket) * 4);
+            // Bucket entries are 1-based name indices, 0 for an empty bucket
+            for (uint32_t i = table.ReadU32(); i != 0 && i <= index.nameCount; i++)
+            {
+                table.SetOffset(index.hashesOffset + uint64_t(i - 1) * 4);
+                uint32_t nameHash = table.ReadU32();
+                if (nameHash % index.bucketCount != bucket)
+                {
+                    break;
+                }
+                if (nameHash == hash && matchesName(i - 1))
+                {
+                    collect(i - 1);
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Malformed .debug_names entry for %.*s", int(name.size()), name.data());
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Looks a name up in the symbol hash table of .gdb_index, which only records units.
+ */
+std::vector<DwarfNameMatch> DwarfUnitIndex::FindInGdbIndex(std::string_view name) const
+{
+    std::vector<DwarfNameMatch> matches;
+    GdbIndexLayout layout{};
+    if (!ReadGdbIndexLayout(_sections.gdbIndex, layout) || layout.symbolTableSize == 0)
+    {
+        return matches;
+    }
+
+    try
+    {
+        DwarfReader reader(_sections.gdbIndex);
+        uint32_t hash = HashGdbIndexName(name);
+        uint64_t mask = layout.symbolTableSize - 1;
+        uint64_t slot = hash & mask;
+        uint64_t step = ((uint64_t(hash) * 17) & mask) | 1;
+        for (uint64_t probe = 0; probe < layout.symbolTableSize; probe++, slot = (slot + step) & mask)
+        {
+            reader.SetOffset(layout.symbolTableOffset + slot * GDB_INDEX_SLOT_SIZE);
+            uint32_t nameOffset = reader.ReadU32();
+            uint32_t vectorOffset = reader.ReadU32();
+            if (nameOffset == 0 && vectorOffset == 0)
+            {
+                break;
+            }
+            if (ReadDwarfString(_sections.gdbIndex, layout.constantPoolOffset + nameOffset) != name)
+            {
+                continue;
+            }
+
+            reader.SetOffset(layout.constantPoolOffset + vectorOffset);
+            uint32_t count = reader.ReadU32();
+            DwarfReader units(_sections.gdbIndex);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint32_t unit = reader.ReadU32() & 0xffffff; // the top byte holds the symbol kind
+                if (unit < layout.compUnitCount)
+                {
+                    units.SetOffset(layout.compUnitsOffset + unit * GDB_INDEX_CU_SIZE);
+                    matches.push_back({units.ReadU64(), 0});
+                }
+            }
+            break;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Warning, "Malformed .gdb_index entry for %.*s", int(name.size()), name.data());
+    }
+    return matches;
+}
+
+/**
+ * @brief Looks a name up in a built or cached name table.
+ */
+std::vector<DwarfNameMatch> DwarfUnitIndex::FindInNameTable(std::string_view name) const
+{
+    std::vector<DwarfNameMatch> matches;
+    uint32_t hash = HashName(name);
+    auto [first, last] = std::equal_range(_names.begin(), _names.end(), DwarfIndexName{hash, 0, 0, 0},
+                                          [](const auto &a, const auto &b) { return a.hash < b.hash; });
+    for (auto it = first; it != last; ++it)
+    {
+        if (it->nameOffset < _strings.size() &&
+            std::string_view(_strings.data() + it->nameOffset, strnlen(_strings.data() + it->nameOffset,
+                                                                       _strings.size() - it->nameOffset)) == name)
+        {
+            matches.push_back({it->unitOffset, it->dieOffset});
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Builds the name table by walking the DIEs of every unit, one pool task each.
+ *
+ * @details Definitions at namespace scope are recorded under their name and linkage name. Out of line definitions
+ * that only refer to a declaration through DW_AT_specification or DW_AT_abstract_origin take the declaration's
+ * names. Function bodies are skipped, through DW_AT_sibling where the producer emits it.
+ */
+void DwarfUnitIndex::BuildNamesFromUnits()
+{
+    struct UnitNames
+    {
+        std::vector<DwarfIndexName> names;
+        std::string strings;
+    };
+
+    std::vector<DwarfUnitHeader> headers = ReadUnitHeaders(_sections.info);
+    std::vector<UnitNames> unitNames(headers.size());
+    LOG(Logger::LogLevel::Debug, "Building DWARF name index from %zu units", headers.size());
+    ForEachUnit(headers.size(), _pool, [&](size_t i) {
+        const DwarfUnitHeader &header = headers[i];
+        if (header.unitType == DW_UT_type || header.unitType == DW_UT_split_type)
+        {
+            return;
+        }
+
+        UnitNames &out = unitNames[i];
+        auto add = [&](std::string_view name, uint64_t dieOffset) {
+            if (!name.empty())
+            {
+                out.names.push_back({HashName(name), static_cast<uint32_t>(out.strings.size()), header.offset,
+                                     dieOffset});
+                out.strings.append(name);
+                out.strings.push_back('\0');
+            }
+        };
+
+        try
+        {
+            DwarfUnit unit(_sections, header, _abbrevs.Get(header.abbrevOffset));
+            DwarfReader reader(_sections.info.subspan(0, header.endOffset), header.dieOffset);
+            DwarfDie die{};
+            unit.ReadDie(reader, die);
+            size_t depth = die.HasChildren() ? 1 : 0;
+            size_t functionDepth = 0; // depth of the outermost enclosing function, 0 outside functions
+
+            while (depth > 0 && !reader.AtEnd())
+            {
+                if (!unit.ReadDie(reader, die))
+                {
+                    if (depth-- == functionDepth)
+                    {
+                        functionDepth = 0;
+                    }
+                    continue;
+                }
+
+                if (functionDepth == 0 && IsIndexedEntry(die))
+                {
+                    // Take the names of the declaration an out of line definition refers to
+                    const DwarfDie *named = &die;
+                    DwarfDie origin{};
+                    for (int hops = 0; hops < 2 && named->Find(DW_AT_name) == nullptr; hops++)
+                    {
+                        const DwarfAttribute *reference = named->Find(DW_AT_specification);
+                        reference = reference != nullptr ? reference : named->Find(DW_AT_abstract_origin);
+                        if (reference == nullptr || !unit.Contains(reference->value))
+                        {
+                            break;
+                        }
+                        origin = unit.ReadDieAt(reference->value);
+                        named = &origin;
+                    }
+
+                    const DwarfAttribute *name = named->Find(DW_AT_name);
+                    const DwarfAttribute *linkageName = named->Find(DW_AT_linkage_name);
+                    linkageName = linkageName != nullptr ? linkageName : named->Find(DW_AT_MIPS_linkage_name);
+                    std::string_view plain = name != nullptr ? unit.GetString(*name) : std::string_view{};
+                    std::string_view linkage = linkageName != nullptr ? unit.GetString(*linkageName)
+                                                                      : std::string_view{};
+                    add(plain, die.offset);
+                    if (linkage != plain)
+                    {
+                        add(linkage, die.offset);
+                    }
+                }
+
+                if (die.HasChildren())
+                {
+                    const DwarfAttribute *sibling = die.Find(DW_AT_sibling);
+                    if (die.GetTag() == DW_TAG_subprogram && sibling != nullptr && unit.Contains(sibling->value))
+                    {
+                        reader.SetOffset(sibling->value);
+                        continue;
+                    }
+                    depth++;
+                    if (functionDepth == 0 && die.GetTag() == DW_TAG_subprogram)
+                    {
+                        functionDepth = depth;
+                    }
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Skipping names of DWARF unit at 0x%lx", header.offset);
+        }
+    });
+
+    size_t nameCount = 0;
+    size_t stringsSize = 0;
+    for (const auto &names : unitNames)
+    {
+        nameCount += names.names.size();
+        stringsSize += names.strings.size();
+    }
+    if (stringsSize > UINT32_MAX)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "DWARF name index exceeds 4GB of strings");
+    }
+
+    _nameStorage.reserve(nameCount);
+    _stringStorage.reserve(stringsSize);
+    for (const auto &names : unitNames)
+    {
+        uint32_t base = static_cast<uint32_t>(_stringStorage.size());
+        for (auto entry : names.names)
+        {
+            entry.nameOffset += base;
+            _nameStorage.push_back(entry);
+        }
+        _stringStorage.insert(_stringStorage.end(), names.strings.begin(), names.strings.end());
+    }
+    std::stable_sort(_nameStorage.begin(), _nameStorage.end(),
+                     [](const auto &a, const auto &b) { return a.hash < b.hash; });
+
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    _names = _nameStorage;
+    _strings = {_stringStorage.data(), _stringStorage.size()};
+    _nameSource = DwarfIndexSource::Built;
+}
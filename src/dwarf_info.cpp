@@ -0,0 +1,648 @@
+#include "dwarf_info.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+/**
+ * @brief Reads the header of the unit starting at an offset of .debug_info.
+ *
+ * @param info The .debug_info section.
+ * @param offset The offset of the unit.
+ * @return The unit header.
+ * @throws std::runtime_error if the header is truncated or of an unsupported version.
+ */
+DwarfUnitHeader ReadUnitHeader(std::span<const uint8_t> info, uint64_t offset)
+{
+    DwarfReader reader(info, offset);
+    DwarfUnitHeader header{};
+    header.offset = offset;
+    uint64_t length = reader.ReadUnitLength(header.is64);
+    if (length > reader.Remaining())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "DWARF unit at 0x%lx exceeds .debug_info", offset);
+    }
+    header.endOffset = reader.GetOffset() + length;
+    header.version = reader.ReadU16();
+    if (header.version < 2 || header.version > 5)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported DWARF unit version %u at 0x%lx", header.version, offset);
+    }
+
+    if (header.version >= 5)
+    {
+        header.unitType = reader.ReadU8();
+        header.addressSize = reader.ReadU8();
+        header.abbrevOffset = reader.ReadOffset(header.is64);
+        switch (header.unitType)
+        {
+        case DW_UT_skeleton:
+        case DW_UT_split_compile:
+            header.signature = reader.ReadU64();
+            break;
+        case DW_UT_type:
+        case DW_UT_split_type:
+            header.signature = reader.ReadU64();
+            reader.ReadOffset(header.is64); // type_offset
+            break;
+        default:
+            break;
+        }
+    }
+    else
+    {
+        header.unitType = DW_UT_compile;
+        header.abbrevOffset = reader.ReadOffset(header.is64);
+        header.addressSize = reader.ReadU8();
+    }
+
+    if (header.addressSize != 4 && header.addressSize != 8)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported DWARF address size %u at 0x%lx", header.addressSize, offset);
+    }
+    header.dieOffset = reader.GetOffset();
+    return header;
+}
+
+/**
+ * @brief Reads the header of every unit in .debug_info, without reading any DIE.
+ *
+ * @param info The .debug_info section.
+ * @return The unit headers in section order; a malformed unit ends the list.
+ */
+std::vector<DwarfUnitHeader> ReadUnitHeaders(std::span<const uint8_t> info)
+{
+    std::vector<DwarfUnitHeader> headers;
+    uint64_t offset = 0;
+    try
+    {
+        while (offset < info.size())
+        {
+            headers.push_back(ReadUnitHeader(info, offset));
+            offset = headers.back().endOffset;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Warning, "Stopped scanning .debug_info after %zu units", headers.size());
+    }
+    return headers;
+}
+
+/**
+ * @brief Constructor for the DwarfAbbrevTable class.
+ *
+ * @param abbrev The .debug_abbrev section.
+ * @param offset The offset of the unit's abbreviations.
+ * @throws std::runtime_error if the table is malformed.
+ */
+DwarfAbbrevTable::DwarfAbbrevTable(std::span<const uint8_t> abbrev, uint64_t offset)
+{
+    DwarfReader reader(abbrev, offset);
+    for (uint64_t code = reader.ReadULEB128(); code != 0; code = reader.ReadULEB128())
+    {
+        DwarfAbbrev entry{code, 0, false, {}};
+        entry.tag = static_cast<uint16_t>(reader.ReadULEB128());
+        entry.hasChildren = reader.ReadU8() != 0;
+        for (;;)
+        {
+            uint16_t name = static_cast<uint16_t>(reader.ReadULEB128());
+            uint16_t form = static_cast<uint16_t>(reader.ReadULEB128());
+            int64_t implicitConst = form == DW_FORM_implicit_const ? reader.ReadSLEB128() : 0;
+            if (name == 0 && form == 0)
+            {
+                break;
+            }
+            entry.attributes.push_back({name, form, implicitConst});
+        }
+        _dense = _dense && code == _abbrevs.size() + 1;
+        _abbrevs.push_back(std::move(entry));
+    }
+
+    if (!_dense)
+    {
+        std::sort(_abbrevs.begin(), _abbrevs.end(), [](const auto &a, const auto &b) { return a.code < b.code; });
+    }
+}
+
+/**
+ * @brief Finds the abbreviation with a code.
+ *
+ * @return The abbreviation, or nullptr if the table has no such code.
+ */
+const DwarfAbbrev *DwarfAbbrevTable::Find(uint64_t code) const
+{
+    if (_dense)
+    {
+        return code - 1 < _abbrevs.size() ? &_abbrevs[code - 1] : nullptr;
+    }
+    auto it = std::lower_bound(_abbrevs.begin(), _abbrevs.end(), code,
+                               [](const DwarfAbbrev &abbrev, uint64_t value) { return abbrev.code < value; });
+    return it != _abbrevs.end() && it->code == code ? &*it : nullptr;
+}
+
+size_t DwarfAbbrevTable::GetCount() const
+{
+    return _abbrevs.size();
+}
+
+/**
+ * @brief Constructor for the DwarfAbbrevCache class.
+ *
+ * @param abbrev The .debug_abbrev section.
+ */
+DwarfAbbrevCache::DwarfAbbrevCache(std::span<const uint8_t> abbrev) : _abbrev(abbrev)
+{
+}
+
+/**
+ * @brief Returns the table at an offset, decoding it on first use. Safe to call concurrently; only the map lookup
+ * is serialised, threads asking for different tables decode them in parallel.
+ *
+ * @throws std::runtime_error if the table is malformed.
+ */
+const DwarfAbbrevTable &DwarfAbbrevCache::Get(uint64_t offset)
+{
+    Entry *entry;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &slot = _tables[offset];
+        if (!slot)
+        {
+            slot = std::make_unique<Entry>();
+        }
+        entry = slot.get();
+    }
+    std::call_once(entry->decoded, [&]() { entry->table = DwarfAbbrevTable(_abbrev, offset); });
+    return entry->table;
+}
+
+uint16_t DwarfDie::GetTag() const
+{
+    return abbrev != nullptr ? abbrev->tag : 0;
+}
+
+bool DwarfDie::HasChildren() const
+{
+    return abbrev != nullptr && abbrev->hasChildren;
+}
+
+const DwarfAttribute *DwarfDie::Find(uint16_t name) const
+{
+    for (const auto &attribute : attributes)
+    {
+        if (attribute.name == name)
+        {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Constructor for the DwarfUnit class. Reads the unit DIE and the bases of the unit's indexed forms.
+ *
+ * @param sections The debug sections of the file.
+ * @param header The header of the unit.
+ * @param abbrevs The abbreviation table at header.abbrevOffset.
+ * @param skeleton The skeleton unit of a split unit, nullptr for any other unit.
+ * @throws std::runtime_error if the unit DIE cannot be read.
+ */
+DwarfUnit::DwarfUnit(const DwarfSections &sections, const DwarfUnitHeader &header, const DwarfAbbrevTable &abbrevs,
+                     const DwarfUnit *skeleton)
+    : _sections(sections), _header(header), _abbrevs(abbrevs), _skeleton(skeleton)
+{
+    DwarfReader reader(_sections.info.subspan(0, _header.endOffset), _header.dieOffset);
+    if (!ReadDie(reader, _unitDie))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "DWARF unit at 0x%lx has no unit DIE", _header.offset);
+    }
+
+    // Split units have no DW_AT_str_offsets_base, their contribution starts right after the section header
+    _strOffsetsBase = _header.version >= 5 ? (_header.is64 ? 16 : 8) : 0;
+    for (const auto &attribute : _unitDie.attributes)
+    {
+        switch (attribute.name)
+        {
+        case DW_AT_str_offsets_base:
+            _strOffsetsBase = attribute.value;
+            break;
+        case DW_AT_addr_base:
+        case DW_AT_GNU_addr_base:
+            _addrBase = attribute.value;
+            break;
+        case DW_AT_rnglists_base:
+            _rnglistsBase = attribute.value;
+            break;
+        default:
+            break;
+        }
+    }
+    if (_skeleton != nullptr)
+    {
+        // The .debug_addr contribution and base address belong to the skeleton; a DWARF 5 .debug_rnglists.dwo
+        // contribution starts with its own header
+        _addrBase = _skeleton->_addrBase;
+        _baseAddress = _skeleton->_baseAddress;
+        _rnglistsBase = _header.version >= 5 ? (_header.is64 ? 20 : 12) : 0;
+        if (const DwarfAttribute *rangesBase = _skeleton->_unitDie.Find(DW_AT_GNU_ranges_base))
+        {
+            _rangesBase = rangesBase->value;
+        }
+    }
+    if (const DwarfAttribute *lowPc = _unitDie.Find(DW_AT_low_pc))
+    {
+        _baseAddress = GetAddress(*lowPc).value_or(0);
+    }
+}
+
+const DwarfUnitHeader &DwarfUnit::GetHeader() const
+{
+    return _header;
+}
+
+const DwarfDie &DwarfUnit::GetUnitDie() const
+{
+    return _unitDie;
+}
+
+std::string_view DwarfUnit::GetName() const
+{
+    const DwarfAttribute *name = _unitDie.Find(DW_AT_name);
+    return name != nullptr ? GetString(*name) : std::string_view{};
+}
+
+std::string_view DwarfUnit::GetCompDir() const
+{
+    if (_skeleton != nullptr)
+    {
+        return _skeleton->GetCompDir();
+    }
+    const DwarfAttribute *compDir = _unitDie.Find(DW_AT_comp_dir);
+    return compDir != nullptr ? GetString(*compDir) : std::string_view{};
+}
+
+/**
+ * @brief Returns the DW_AT_stmt_list of the unit, its line number program offset in .debug_line. Split units use
+ * the line program of their skeleton.
+ */
+std::optional<uint64_t> DwarfUnit::GetStmtList() const
+{
+    if (_skeleton != nullptr)
+    {
+        return _skeleton->GetStmtList();
+    }
+    const DwarfAttribute *stmtList = _unitDie.Find(DW_AT_stmt_list);
+    return stmtList != nullptr ? std::optional<uint64_t>(stmtList->value) : std::nullopt;
+}
+
+/**
+ * @brief Checks whether a .debug_info offset lies within the unit's DIEs.
+ */
+bool DwarfUnit::Contains(uint64_t infoOffset) const
+{
+    return infoOffset >= _header.dieOffset && infoOffset < _header.endOffset;
+}
+
+/**
+ * @brief Reads the DIE at the position of a reader and advances past it; children are not skipped.
+ *
+ * @param reader A reader over .debug_info positioned at a DIE of this unit.
+ * @param die Receives the entry; its attribute vector is reused.
+ * @return false for the null entry that ends a list of children.
+ * @throws std::runtime_error if the entry is malformed.
+ */
+bool DwarfUnit::ReadDie(DwarfReader &reader, DwarfDie &die) const
+{
+    die.offset = reader.GetOffset();
+    die.attributes.clear();
+    uint64_t code = reader.ReadULEB128();
+    if (code == 0)
+    {
+        die.abbrev = nullptr;
+        return false;
+    }
+
+    die.abbrev = _abbrevs.Find(code);
+    if (die.abbrev == nullptr)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Unknown DWARF abbreviation %lu at 0x%lx", code, die.offset);
+    }
+    for (const auto &spec : die.abbrev->attributes)
+    {
+        die.attributes.push_back(ReadAttribute(reader, spec));
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the DIE at an offset of .debug_info, which must belong to this unit.
+ *
+ * @throws std::runtime_error if the offset is outside the unit or the entry is malformed.
+ */
+DwarfDie DwarfUnit::ReadDieAt(uint64_t offset) const
+{
+    if (!Contains(offset))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "DIE offset 0x%lx is outside the unit at 0x%lx", offset, _header.offset);
+    }
+    DwarfReader reader(_sections.info.subspan(0, _header.endOffset), offset);
+    DwarfDie die{};
+    ReadDie(reader, die);
+    return die;
+}
+
+/**
+ * @brief Reads an attribute value. References local to the unit are turned into .debug_info offsets.
+ */
+DwarfAttribute DwarfUnit::ReadAttribute(DwarfReader &reader, const DwarfAbbrevAttribute &spec) const
+{
+    DwarfAttribute attribute{spec.name, spec.form, 0, {}, {}};
+    switch (spec.form)
+    {
+    case DW_FORM_addr:
+        attribute.value = reader.ReadUnsigned(_header.addressSize);
+        break;
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+        attribute.value = reader.ReadU8();
+        break;
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+        attribute.value = reader.ReadU16();
+        break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+        attribute.value = reader.ReadU24();
+        break;
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+        attribute.value = reader.ReadU32();
+        break;
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+        attribute.value = reader.ReadU64();
+        break;
+    case DW_FORM_data16:
+        attribute.block = reader.ReadBytes(16);
+        break;
+    case DW_FORM_sdata:
+        attribute.value = static_cast<uint64_t>(reader.ReadSLEB128());
+        break;
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+    case DW_FORM_GNU_addr_index:
+    case DW_FORM_GNU_str_index:
+        attribute.value = reader.ReadULEB128();
+        break;
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_sec_offset:
+    case DW_FORM_strp_sup:
+    case DW_FORM_GNU_ref_alt:
+    case DW_FORM_GNU_strp_alt:
+        attribute.value = reader.ReadOffset(_header.is64);
+        break;
+    case DW_FORM_ref_addr:
+        attribute.value = _header.version <= 2 ? reader.ReadUnsigned(_header.addressSize)
+                                               : reader.ReadOffset(_header.is64);
+        break;
+    case DW_FORM_string:
+        attribute.string = reader.ReadCString();
+        break;
+    case DW_FORM_block1:
+        attribute.block = reader.ReadBytes(reader.ReadU8());
+        break;
+    case DW_FORM_block2:
+        attribute.block = reader.ReadBytes(reader.ReadU16());
+        break;
+    case DW_FORM_block4:
+        attribute.block = reader.ReadBytes(reader.ReadU32());
+        break;
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+        attribute.block = reader.ReadBytes(reader.ReadULEB128());
+        break;
+    case DW_FORM_flag_present:
+        attribute.value = 1;
+        break;
+    case DW_FORM_implicit_const:
+        attribute.value = static_cast<uint64_t>(spec.implicitConst);
+        break;
+    case DW_FORM_indirect:
+        return ReadAttribute(reader, {spec.name, static_cast<uint16_t>(reader.ReadULEB128()), 0});
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Unknown DWARF form 0x%x at 0x%lx", spec.form, reader.GetOffset());
+    }
+
+    switch (spec.form)
+    {
+    case DW_FORM_ref1:
+    case DW_FORM_ref2:
+    case DW_FORM_ref4:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_udata:
+        attribute.value += _header.offset;
+        break;
+    default:
+        break;
+    }
+    return attribute;
+}
+
+/**
+ * @brief Resolves a string attribute of any string form.
+ *
+ * @return The string, or an empty view if the attribute is not of a string form.
+ * @throws std::runtime_error if the string offset or index is out of range.
+ */
+std::string_view DwarfUnit::GetString(const DwarfAttribute &attribute) const
+{
+    switch (attribute.form)
+    {
+    case DW_FORM_string:
+        return attribute.string;
+    case DW_FORM_strp:
+        return ReadDwarfString(_sections.str, attribute.value);
+    case DW_FORM_line_strp:
+        return ReadDwarfString(_sections.lineStr, attribute.value);
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4:
+    case DW_FORM_GNU_str_index: {
+        DwarfReader reader(_sections.strOffsets, _strOffsetsBase + attribute.value * (_header.is64 ? 8 : 4));
+        return ReadDwarfString(_sections.str, reader.ReadOffset(_header.is64));
+    }
+    default:
+        return {};
+    }
+}
+
+/**
+ * @brief Resolves an address attribute, direct or through .debug_addr.
+ *
+ * @return The address, or std::nullopt if the attribute is not of an address form.
+ */
+std::optional<uint64_t> DwarfUnit::GetAddress(const DwarfAttribute &attribute) const
+{
+    switch (attribute.form)
+    {
+    case DW_FORM_addr:
+        return attribute.value;
+    case DW_FORM_addrx:
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+    case DW_FORM_GNU_addr_index:
+        return ReadAddressIndex(attribute.value);
+    default:
+        return std::nullopt;
+    }
+}
+
+uint64_t DwarfUnit::ReadAddressIndex(uint64_t index) const
+{
+    DwarfReader reader(_sections.addr, _addrBase + index * _header.addressSize);
+    return reader.ReadUnsigned(_header.addressSize);
+}
+
+/**
+ * @brief Returns the address ranges of a DIE, from DW_AT_low_pc/DW_AT_high_pc or DW_AT_ranges.
+ *
+ * @param die An entry of this unit.
+ * @return The [low, high) ranges, empty if the entry has no code.
+ * @throws std::runtime_error if a range list is malformed.
+ */
+std::vector<std::pair<uint64_t, uint64_t>> DwarfUnit::GetRanges(const DwarfDie &die) const
+{
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    const DwarfAttribute *lowPc = die.Find(DW_AT_low_pc);
+    const DwarfAttribute *highPc = die.Find(DW_AT_high_pc);
+    if (lowPc != nullptr && highPc != nullptr)
+    {
+        std::optional<uint64_t> low = GetAddress(*lowPc);
+        // DWARF 4 and later allow DW_AT_high_pc as a constant offset from DW_AT_low_pc
+        std::optional<uint64_t> high = GetAddress(*highPc);
+        if (!high && low)
+        {
+            high = *low + highPc->value;
+        }
+        if (low && high && *high > *low)
+        {
+            ranges.emplace_back(*low, *high);
+        }
+    }
+
+    if (const DwarfAttribute *list = die.Find(DW_AT_ranges))
+    {
+        if (_header.version >= 5)
+        {
+            uint64_t offset = list->value;
+            if (list->form == DW_FORM_rnglistx)
+            {
+                DwarfReader reader(_sections.rnglists, _rnglistsBase + list->value * (_header.is64 ? 8 : 4));
+                offset = _rnglistsBase + reader.ReadOffset(_header.is64);
+            }
+            ReadRangeListV5(offset, ranges);
+        }
+        else
+        {
+            ReadRangeList(_rangesBase + list->value, ranges);
+        }
+    }
+    return ranges;
+}
+
+/**
+ * @brief Reads a .debug_ranges list (DWARF 2 to 4).
+ */
+void DwarfUnit::ReadRangeList(uint64_t offset, std::vector<std::pair<uint64_t, uint64_t>> &ranges) const
+{
+    DwarfReader reader(_sections.ranges, offset);
+    uint64_t base = _baseAddress;
+    uint64_t baseSelection = _header.addressSize == 4 ? UINT32_MAX : UINT64_MAX;
+    for (;;)
+    {
+        uint64_t start = reader.ReadUnsigned(_header.addressSize);
+        uint64_t end = reader.ReadUnsigned(_header.addressSize);
+        if (start == 0 && end == 0)
+        {
+            break;
+        }
+        if (start == baseSelection)
+        {
+            base = end;
+            continue;
+        }
+        if (end > start)
+        {
+            ranges.emplace_back(base + start, base + end);
+        }
+    }
+}
+
+/**
+ * @brief Reads a .debug_rnglists list (DWARF 5).
+ */
+void DwarfUnit::ReadRangeListV5(uint64_t offset, std::vector<std::pair<uint64_t, uint64_t>> &ranges) const
+{
+    DwarfReader reader(_sections.rnglists, offset);
+    uint64_t base = _baseAddress;
+    for (;;)
+    {
+        uint64_t start = 0;
+        uint64_t end = 0;
+        switch (reader.ReadU8())
+        {
+        case DW_RLE_end_of_list:
+            return;
+        case DW_RLE_base_addressx:
+            base = ReadAddressIndex(reader.ReadULEB128());
+            continue;
+        case DW_RLE_base_address:
+            base = reader.ReadUnsigned(_header.addressSize);
+            continue;
+        case DW_RLE_startx_endx:
+            start = ReadAddressIndex(reader.ReadULEB128());
+            end = ReadAddressIndex(reader.ReadULEB128());
+            break;
+        case DW_RLE_startx_length:
+            start = ReadAddressIndex(reader.ReadULEB128());
+            end = start + reader.ReadULEB128();
+            break;
+        case DW_RLE_offset_pair:
+            start = base + reader.ReadULEB128();
+            end = base + reader.ReadULEB128();
+            break;
+        case DW_RLE_start_end:
+            start = reader.ReadUnsigned(_header.addressSize);
+            end = reader.ReadUnsigned(_header.addressSize);
+            break;
+        case DW_RLE_start_length:
+            start = reader.ReadUnsigned(_header.addressSize);
+            end = start + reader.ReadULEB128();
+            break;
+        default:
+            LOG_THROW(Logger::LogLevel::Error, "Unknown range list entry at 0x%lx", reader.GetOffset() - 1);
+        }
+        if (end > start)
+        {
+            ranges.emplace_back(start, end);
+        }
+    }
+}
@@ -0,0 +1,630 @@
+#include "dwarf_line.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+// Flags of an encoded row
+constexpr uint8_t ROW_END_SEQUENCE = 0x01;
+constexpr uint8_t ROW_IS_STMT = 0x02;
+constexpr uint8_t ROW_FILE_CHANGED = 0x04;
+constexpr uint8_t ROW_LINE_CHANGED = 0x08;
+constexpr uint8_t ROW_COLUMN_CHANGED = 0x10;
+
+static void WriteULEB128(std::vector<uint8_t> &out, uint64_t value)
+{
+    do
+    {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        out.push_back(value != 0 ? byte | 0x80 : byte);
+    } while (value != 0);
+}
+
+static uint64_t ReadULEB128Unchecked(const uint8_t *&cursor)
+{
+    uint64_t result = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = *cursor++;
+        result |= uint64_t(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return result;
+}
+
+/**
+ * @brief Joins a directory and a file name the way addr2line does, leaving absolute names untouched.
+ */
+static std::string JoinPath(std::string_view directory, std::string_view name)
+{
+    if (directory.empty() || (!name.empty() && name[0] == '/'))
+    {
+        return std::string(name);
+    }
+    std::string path(directory);
+    if (path.back() != '/')
+    {
+        path += '/';
+    }
+    return path.append(name);
+}
+
+/**
+ * @brief Reads a string valued line header attribute.
+ */
+static std::string_view ReadLineString(DwarfReader &reader, const DwarfSections &sections, uint16_t form, bool is64)
+{
+    switch (form)
+    {
+    case DW_FORM_string:
+        return reader.ReadCString();
+    case DW_FORM_line_strp:
+        return ReadDwarfString(sections.lineStr, reader.ReadOffset(is64));
+    case DW_FORM_strp:
+        return ReadDwarfString(sections.str, reader.ReadOffset(is64));
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported DWARF line header string form 0x%x", form);
+    }
+}
+
+/**
+ * @brief Decodes a line number program.
+ *
+ * @details The header is parsed for DWARF versions 2 to 5, then the state machine is run over the whole program.
+ * Each sequence is collected separately, the sequences are sorted by start address and the rows encoded.
+ *
+ * @param sections The debug sections of the file.
+ * @param offset The offset of the program in .debug_line, i.e. the DW_AT_stmt_list of its unit.
+ * @param compDir The compilation directory of the unit, used for the implicit directory 0 before DWARF 5.
+ * @throws std::runtime_error if the program is malformed.
+ */
+DwarfLineTable::DwarfLineTable(const DwarfSections &sections, uint64_t offset, std::string_view compDir)
+    : _offset(offset)
+{
+    DwarfReader reader(sections.line, offset);
+    bool is64 = false;
+    uint64_t unitLength = reader.ReadUnitLength(is64);
+    uint64_t unitEnd = reader.GetOffset() + unitLength;
+    if (unitLength > reader.Remaining())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "DWARF line program at 0x%lx exceeds .debug_line", offset);
+    }
+
+    _version = reader.ReadU16();
+    if (_version < 2 || _version > 5)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported DWARF line program version %u", _version);
+    }
+
+    uint8_t addressSize = 8;
+    if (_version >= 5)
+    {
+        addressSize = reader.ReadU8();
+        reader.ReadU8(); // segment_selector_size
+    }
+
+    uint64_t headerLength = reader.ReadOffset(is64);
+    uint64_t programStart = reader.GetOffset() + headerLength;
+    uint8_t minimumInstructionLength = reader.ReadU8();
+    if (_version >= 4)
+    {
+        reader.ReadU8(); // maximum_operations_per_instruction, VLIW op_index is not tracked
+    }
+    bool defaultIsStmt = reader.ReadU8() != 0;
+    int8_t lineBase = static_cast<int8_t>(reader.ReadU8());
+    uint8_t lineRange = reader.ReadU8();
+    uint8_t opcodeBase = reader.ReadU8();
+    if (lineRange == 0 || opcodeBase == 0)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Invalid DWARF line program header at 0x%lx", offset);
+    }
+    std::vector<uint8_t> standardOpcodeLengths(opcodeBase - 1);
+    for (auto &length : standardOpcodeLengths)
+    {
+        length = reader.ReadU8();
+    }
+
+    std::vector<std::string> directories;
+    if (_version >= 5)
+    {
+        ParseFileEntries(reader, sections, is64, addressSize, directories, true);
+        ParseFileEntries(reader, sections, is64, addressSize, directories, false);
+    }
+    else
+    {
+        // Directory 0 and file 0 are implicit before DWARF 5
+        directories.emplace_back(compDir);
+        for (std::string_view directory = reader.ReadCString(); !directory.empty(); directory = reader.ReadCString())
+        {
+            directories.push_back(JoinPath(compDir, directory));
+        }
+        _fileNames.emplace_back("??");
+        for (std::string_view name = reader.ReadCString(); !name.empty(); name = reader.ReadCString())
+        {
+            uint64_t directory = reader.ReadULEB128();
+            reader.ReadULEB128(); // modification time
+            reader.ReadULEB128(); // length
+            _fileNames.push_back(JoinPath(directory < directories.size() ? directories[directory] : "", name));
+        }
+    }
+
+    // Line number state machine
+    std::vector<std::vector<DwarfLineRow>> sequences;
+    std::vector<DwarfLineRow> sequence;
+    DwarfLineRow state{0, 1, 1, 0, defaultIsStmt, false};
+    auto resetState = [&]() { state = {0, 1, 1, 0, defaultIsStmt, false}; };
+    auto emitRow = [&]() {
+        sequence.push_back(state);
+        if (state.endSequence)
+        {
+            sequences.push_back(std::move(sequence));
+            sequence.clear();
+            resetState();
+        }
+    };
+
+    DwarfReader program(sections.line.subspan(0, unitEnd), programStart);
+    while (!program.AtEnd())
+    {
+        uint8_t opcode = program.ReadU8();
+        if (opcode >= opcodeBase)
+        {
+            // Special opcode
+            uint8_t adjusted = opcode - opcodeBase;
+            state.address += uint64_t(adjusted / lineRange) * minimumInstructionLength;
+            state.line += lineBase + adjusted % lineRange;
+            emitRow();
+            continue;
+        }
+
+        switch (opcode)
+        {
+        case 0: {
+            uint64_t length = program.ReadULEB128();
+            if (length == 0)
+            {
+                break;
+            }
+            uint64_t next = program.GetOffset() + length;
+            uint8_t extended = program.ReadU8();
+            switch (extended)
+            {
+            case DW_LNE_end_sequence:
+                state.endSequence = true;
+                emitRow();
+                break;
+            case DW_LNE_set_address:
+                state.address = program.ReadUnsigned(static_cast<uint8_t>(length - 1));
+                break;
+            case DW_LNE_define_file: {
+                std::string_view name = program.ReadCString();
+                uint64_t directory = program.ReadULEB128();
+                _fileNames.push_back(JoinPath(directory < directories.size() ? directories[directory] : "", name));
+            }
+            break;
+            default:
+                break; // DW_LNE_set_discriminator and vendor extensions carry nothing we keep
+            }
+            program.SetOffset(next);
+        }
+        break;
+        case DW_LNS_copy:
+            emitRow();
+            break;
+        case DW_LNS_advance_pc:
+            state.address += program.ReadULEB128() * minimumInstructionLength;
+            break;
+        case DW_LNS_advance_line:
+            state.line += static_cast<int32_t>(program.ReadSLEB128());
+            break;
+        case DW_LNS_set_file:
+            state.file = static_cast<uint32_t>(program.ReadULEB128());
+            break;
+        case DW_LNS_set_column:
+            state.column = static_cast<uint32_t>(program.ReadULEB128());
+            break;
+        case DW_LNS_negate_stmt:
+            state.isStmt = !state.isStmt;
+            break;
+        case DW_LNS_const_add_pc:
+            state.address += uint64_t((255 - opcodeBase) / lineRange) * minimumInstructionLength;
+            break;
+        case DW_LNS_fixed_advance_pc:
+            state.address += program.ReadU16();
+            break;
+        case DW_LNS_set_basic_block:
+        case DW_LNS_set_prologue_end:
+        case DW_LNS_set_epilogue_begin:
+            break;
+        default:
+            // Unknown standard opcode, skip its ULEB128 operands
+            for (uint8_t i = 0; i < standardOpcodeLengths[opcode - 1]; i++)
+            {
+                program.ReadULEB128();
+            }
+            break;
+        }
+    }
+
+    Encode(sequences);
+}
+
+/**
+ * @brief Parses a DWARF 5 directory or file name table described by an entry format list.
+ *
+ * @param reader The reader positioned at the entry format count.
+ * @param sections The debug sections, for string forms.
+ * @param is64 Whether the unit uses the 64-bit DWARF format.
+ * @param addressSize The size of a target address.
+ * @param directories The directory table; filled when isDirectoryTable, used to resolve file entries otherwise.
+ * @param isDirectoryTable Whether the table being parsed is the directory table.
+ */
+void DwarfLineTable::ParseFileEntries(DwarfReader &reader, const DwarfSections &sections, bool is64,
+                                      uint8_t addressSize, std::vector<std::string> &directories,
+                                      bool isDirectoryTable)
+{
+    std::vector<std::pair<uint64_t, uint16_t>> formats(reader.ReadU8());
+    for (auto &[contentType, form] : formats)
+    {
+        contentType = reader.ReadULEB128();
+        form = static_cast<uint16_t>(reader.ReadULEB128());
+    }
+
+    uint64_t count = reader.ReadULEB128();
+    for (uint64_t i = 0; i < count; i++)
+    {
+        std::string_view path;
+        uint64_t directory = 0;
+        for (const auto &[contentType, form] : formats)
+        {
+            if (contentType == DW_LNCT_path)
+            {
+                path = ReadLineString(reader, sections, form, is64);
+            }
+            else if (contentType == DW_LNCT_directory_index && (form == DW_FORM_udata || form == DW_FORM_data1 ||
+                                                                form == DW_FORM_data2))
+            {
+                directory = form == DW_FORM_udata ? reader.ReadULEB128()
+                                                  : reader.ReadUnsigned(form == DW_FORM_data1 ? 1 : 2);
+            }
+            else
+            {
+                reader.SkipForm(form, addressSize, is64, _version);
+            }
+        }
+
+        if (isDirectoryTable)
+        {
+            // Entry 0 is the compilation directory, every other entry is relative to it
+            directories.push_back(i == 0 ? std::string(path) : JoinPath(directories[0], path));
+        }
+        else
+        {
+            _fileNames.push_back(JoinPath(directory < directories.size() ? directories[directory] : "", path));
+        }
+    }
+}
+
+/**
+ * @brief Sorts the sequences by address and delta encodes their rows.
+ *
+ * @param sequences The sequences of the program, each ending with its end_sequence row.
+ */
+void DwarfLineTable::Encode(std::vector<std::vector<DwarfLineRow>> &sequences)
+{
+    // Sequences of functions discarded by the linker are left at address 0 or at a tombstone value; they would
+    // shadow real code, so drop them unless they are all there is (as in a relocatable object).
+    bool hasNonZero = std::any_of(sequences.begin(), sequences.end(), [](const auto &s) { return s[0].address != 0; });
+    std::erase_if(sequences, [&](const auto &s) {
+        return s[0].address == UINT64_MAX || s[0].address == UINT32_MAX || (hasNonZero && s[0].address == 0);
+    });
+    std::sort(sequences.begin(), sequences.end(),
+              [](const auto &a, const auto &b) { return a[0].address < b[0].address; });
+
+    DwarfLineRow previous{};
+    for (const auto &sequence : sequences)
+    {
+        _sequenceRanges.emplace_back(sequence.front().address, sequence.back().address);
+        for (const auto &row : sequence)
+        {
+            if (_rowCount % DWARF_LINE_CHECKPOINT_INTERVAL == 0)
+            {
+                _checkpoints.push_back({row.address, 0, row.file, row.line, row.column, row.isStmt, row.endSequence});
+                _checkpoints.back().encodedOffset = static_cast<uint32_t>(_encoded.size());
+            }
+            else
+            {
+                uint8_t flags = (row.endSequence ? ROW_END_SEQUENCE : 0) | (row.isStmt ? ROW_IS_STMT : 0) |
+                                (row.file != previous.file ? ROW_FILE_CHANGED : 0) |
+                                (row.line != previous.line ? ROW_LINE_CHANGED : 0) |
+                                (row.column != previous.column ? ROW_COLUMN_CHANGED : 0);
+                _encoded.push_back(flags);
+                // Rows within the sorted table never go backwards, so the address delta is unsigned
+                WriteULEB128(_encoded, row.address - previous.address);
+                if (flags & ROW_FILE_CHANGED)
+                {
+                    WriteULEB128(_encoded, row.file);
+                }
+                if (flags & ROW_LINE_CHANGED)
+                {
+                    // zigzag encode the signed line delta
+                    int64_t delta = int64_t(row.line) - int64_t(previous.line);
+                    WriteULEB128(_encoded, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+                }
+                if (flags & ROW_COLUMN_CHANGED)
+                {
+                    WriteULEB128(_encoded, row.column);
+                }
+            }
+            previous = row;
+            _rowCount++;
+        }
+    }
+    _encoded.shrink_to_fit();
+    _checkpoints.shrink_to_fit();
+}
+
+/**
+ * @brief Applies one encoded row to the previous row.
+ */
+void DwarfLineTable::DecodeRow(const uint8_t *&cursor, DwarfLineRow &row)
+{
+    uint8_t flags = *cursor++;
+    row.endSequence = flags & ROW_END_SEQUENCE;
+    row.isStmt = flags & ROW_IS_STMT;
+    row.address += ReadULEB128Unchecked(cursor);
+    if (flags & ROW_FILE_CHANGED)
+    {
+        row.file = static_cast<uint32_t>(ReadULEB128Unchecked(cursor));
+    }
+    if (flags & ROW_LINE_CHANGED)
+    {
+        uint64_t zigzag = ReadULEB128Unchecked(cursor);
+        row.line += static_cast<int32_t>((zigzag >> 1) ^ -(zigzag & 1));
+    }
+    if (flags & ROW_COLUMN_CHANGED)
+    {
+        row.column = static_cast<uint32_t>(ReadULEB128Unchecked(cursor));
+    }
+}
+
+/**
+ * @brief Finds the row covering an address.
+ *
+ * @param address The address to look up.
+ * @return The last row at or below the address, or std::nullopt if the address falls outside every sequence.
+ */
+std::optional<DwarfLineRow> DwarfLineTable::Lookup(uint64_t address) const
+{
+    auto it = std::upper_bound(_checkpoints.begin(), _checkpoints.end(), address,
+                               [](uint64_t value, const Checkpoint &checkpoint) { return value < checkpoint.address; });
+    if (it == _checkpoints.begin())
+    {
+        return std::nullopt;
+    }
+    --it;
+
+    size_t block = it - _checkpoints.begin();
+    size_t rowsInBlock = std::min(DWARF_LINE_CHECKPOINT_INTERVAL, _rowCount - block * DWARF_LINE_CHECKPOINT_INTERVAL);
+    DwarfLineRow row{it->address, it->file, it->line, it->column, it->isStmt, it->endSequence};
+    DwarfLineRow best = row;
+    const uint8_t *cursor = _encoded.data() + it->encodedOffset;
+    for (size_t i = 1; i < rowsInBlock; i++)
+    {
+        DecodeRow(cursor, row);
+        if (row.address > address)
+        {
+            break;
+        }
+        best = row;
+    }
+
+    if (best.endSequence)
+    {
+        return std::nullopt;
+    }
+    return best;
+}
+
+uint64_t DwarfLineTable::GetOffset() const
+{
+    return _offset;
+}
+
+uint16_t DwarfLineTable::GetVersion() const
+{
+    return _version;
+}
+
+size_t DwarfLineTable::GetRowCount() const
+{
+    return _rowCount;
+}
+
+/**
+ * @brief Returns the memory held by the row table, in bytes.
+ */
+size_t DwarfLineTable::GetEncodedSize() const
+{
+    return _encoded.size() + _checkpoints.size() * sizeof(Checkpoint);
+}
+
+const std::vector<std::pair<uint64_t, uint64_t>> &DwarfLineTable::GetSequenceRanges() const
+{
+    return _sequenceRanges;
+}
+
+const std::string &DwarfLineTable::GetFileName(uint32_t file) const
+{
+    static const std::string unknown = "??";
+    return file < _fileNames.size() ? _fileNames[file] : unknown;
+}
+
+/**
+ * @brief Locates every line number program in .debug_line without decoding any of them.
+ *
+ * @param sections The debug sections of the file.
+ * @param pool The pool DecodeAll decodes on, or nullptr to decode on the calling thread.
+ */
+DwarfLineIndex::DwarfLineIndex(const DwarfSections &sections, ThreadPool *pool) : _sections(sections), _pool(pool)
+{
+    std::vector<uint64_t> offsets;
+    DwarfReader reader(_sections.line);
+    try
+    {
+        while (!reader.AtEnd())
+        {
+            uint64_t offset = reader.GetOffset();
+            bool is64 = false;
+            uint64_t length = reader.ReadUnitLength(is64);
+            reader.Skip(length);
+            offsets.push_back(offset);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Warning, "Stopped scanning .debug_line after %zu programs", offsets.size());
+    }
+
+    _unitCount = offsets.size();
+    _units = std::make_unique<Unit[]>(_unitCount);
+    for (size_t i = 0; i < _unitCount; i++)
+    {
+        _units[i].offset = offsets[i];
+    }
+}
+
+size_t DwarfLineIndex::GetUnitCount() const
+{
+    return _unitCount;
+}
+
+uint64_t DwarfLineIndex::GetUnitOffset(size_t unit) const
+{
+    return _units[unit].offset;
+}
+
+/**
+ * @brief Returns the decoded table of a unit, decoding it on first use. Safe to call concurrently.
+ *
+ * @param unit The index of the unit.
+ * @param compDir The compilation directory of the unit, only used by the call that decodes it.
+ * @return The line table; empty if the program could not be decoded.
+ */
+const DwarfLineTable &DwarfLineIndex::GetTable(size_t unit, std::string_view compDir)
+{
+    Unit &entry = _units[unit];
+    std::call_once(entry.decoded, [&]() {
+        try
+        {
+            entry.table = std::make_unique<DwarfLineTable>(_sections, entry.offset, compDir);
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Skipping DWARF line program at 0x%lx", entry.offset);
+            entry.table = std::make_unique<DwarfLineTable>();
+        }
+    });
+    return *entry.table;
+}
+
+/**
+ * @brief Returns the decoded table of the program at a DW_AT_stmt_list offset.
+ *
+ * @return The line table, or nullptr if no program starts at that offset.
+ */
+const DwarfLineTable *DwarfLineIndex::GetTableAtOffset(uint64_t offset, std::string_view compDir)
+{
+    auto begin = _units.get();
+    auto end = begin + _unitCount;
+    auto it =
+        std::lower_bound(begin, end, offset, [](const Unit &unit, uint64_t value) { return unit.offset < value; });
+    if (it == end || it->offset != offset)
+    {
+        return nullptr;
+    }
+    return &GetTable(it - begin, compDir);
+}
+
+/**
+ * @brief Decodes every line number program, one pool task each when the index has a pool.
+ */
+void DwarfLineIndex::DecodeAll()
+{
+    if (_pool == nullptr)
+    {
+        for (size_t unit = 0; unit < _unitCount; unit++)
+        {
+            GetTable(unit);
+        }
+        return;
+    }
+    TaskGroup group(*_pool);
+    for (size_t unit = 0; unit < _unitCount; unit++)
+    {
+        group.Submit([this, unit]() { GetTable(unit); });
+    }
+    group.Wait();
+}
+
+/**
+ * @brief Looks up an address without knowing its compilation unit.
+ *
+ * @details Without a unit to start from every program has to be decoded once, which is done through DecodeAll on
+ * the first call; that call must then not run as a task of the index's pool. Callers that know the DW_AT_stmt_list
+ * of the unit should use the other overload.
+ *
+ * @param address The address to resolve.
+ * @return The source location, or std::nullopt if no program covers the address.
+ */
+std::optional<DwarfLineInfo> DwarfLineIndex::Lookup(uint64_t address)
+{
+    std::call_once(_rangesBuilt, [this]() {
+        DecodeAll();
+        for (size_t unit = 0; unit < _unitCount; unit++)
+        {
+            for (const auto &[low, high] : GetTable(unit).GetSequenceRanges())
+            {
+                _ranges.push_back({low, high, unit});
+            }
+        }
+        std::sort(_ranges.begin(), _ranges.end(), [](const auto &a, const auto &b) { return a.low < b.low; });
+    });
+
+    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), address,
+                               [](uint64_t value, const UnitRange &range) { return value < range.low; });
+    if (it == _ranges.begin() || address >= (--it)->high)
+    {
+        return std::nullopt;
+    }
+    return LookupInTable(GetTable(it->unit), address);
+}
+
+/**
+ * @brief Looks up an address in the line program of a known compilation unit, decoding only that program.
+ *
+ * @param address The address to resolve.
+ * @param stmtList The DW_AT_stmt_list of the unit.
+ * @param compDir The DW_AT_comp_dir of the unit.
+ * @return The source location, or std::nullopt if the program does not cover the address.
+ */
+std::optional<DwarfLineInfo> DwarfLineIndex::Lookup(uint64_t address, uint64_t stmtList, std::string_view compDir)
+{
+    const DwarfLineTable *table = GetTableAtOffset(stmtList, compDir);
+    if (table == nullptr)
+    {
+        return std::nullopt;
+    }
+    return LookupInTable(*table, address);
+}
+
+std::optional<DwarfLineInfo> DwarfLineIndex::LookupInTable(const DwarfLineTable &table, uint64_t address)
+{
+    auto row = table.Lookup(address);
+    if (!row)
+    {
+        return std::nullopt;
+    }
+    return DwarfLineInfo{table.GetFileName(row->file), row->line, row->column};
+}
@@ -0,0 +1,436 @@
+#include "elf_diff.hpp"
+#include "content_hash.hpp"
+#include "elf_regions.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <string_view>
+
+// Names hashed, or matched pairs compared, per pool task
+constexpr size_t DIFF_HASH_BATCH_SIZE = 4096;
+
+// End of a chain of old items sharing a name
+constexpr uint32_t DIFF_NO_ITEM = UINT32_MAX;
+
+// One file's view of a segment, section or symbol
+struct DiffItem
+{
+    std::string_view name;         // Viewing a string that outlives the match
+    uint64_t size;                 // Size in memory for segments and .bss-like sections, in the file otherwise
+    uint64_t attributes;           // Flags that make two items differ even when their bytes do not
+    std::span<const uint8_t> data; // File bytes; empty when the item has none
+};
+
+/**
+ * @brief Runs every batch of DIFF_HASH_BATCH_SIZE items, as separate tasks of the pool when there is one.
+ */
+static void RunBatches(size_t itemCount, ThreadPool *pool, const std::function<void(size_t)> &runBatch)
+{
+    size_t batchCount = (itemCount + DIFF_HASH_BATCH_SIZE - 1) / DIFF_HASH_BATCH_SIZE;
+    if (pool == nullptr)
+    {
+        for (size_t batch = 0; batch < batchCount; batch++)
+        {
+            runBatch(batch);
+        }
+        return;
+    }
+    TaskGroup group(*pool);
+    for (size_t batch = 0; batch < batchCount; batch++)
+    {
+        group.Submit([&runBatch, batch]() { runBatch(batch); });
+    }
+    group.Wait();
+}
+
+/**
+ * @brief Hashes the names of a set of items in batches.
+ */
+static std::vector<uint64_t> HashNames(const std::vector<DiffItem> &items, ThreadPool *pool)
+{
+    std::vector<uint64_t> hashes(items.size());
+    RunBatches(items.size(), pool, [&](size_t batch) {
+        size_t end = std::min(items.size(), (batch + 1) * DIFF_HASH_BATCH_SIZE);
+        for (size_t i = batch * DIFF_HASH_BATCH_SIZE; i < end; i++)
+        {
+            std::string_view name = items[i].name;
+            hashes[i] = Xxh3Hash64({reinterpret_cast<const uint8_t *>(name.data()), name.size()});
+        }
+    });
+    return hashes;
+}
+
+/**
+ * @brief Matches the items of the two files by name and appends an entry for every item added, removed, resized
+ * or changed. Names are hashed in parallel, then the old items go into an open addressing table with one slot per
+ * distinct name. A slot heads a chain of the items bearing its name in their original order, and every new item
+ * takes the first unmatched item of its chain. The contents of the matched pairs of equal size are then hashed in
+ * parallel batches.
+ *
+ * @param level The level the items belong to.
+ * @param oldItems The items of the old file.
+ * @param newItems The items of the new file.
+ * @param entries The entries to append to.
+ * @param pool The pool to hash on, or nullptr to hash on the calling thread.
+ */
+static void MatchItems(DiffLevel level, const std::vector<DiffItem> &oldItems, const std::vector<DiffItem> &newItems,
+                       std::vector<ElfDiffEntry> &entries, ThreadPool *pool)
+{
+    std::vector<uint64_t> oldHashes = HashNames(oldItems, pool);
+    std::vector<uint64_t> newHashes = HashNames(newItems, pool);
+
+    // Linear probing over a table at most half full. A slot keeps the first item of its name, which identifies
+    // the slot, and a cursor on the first item of the chain not matched yet.
+    size_t mask = std::bit_ceil(oldItems.size() * 2 + 1) - 1;
+    std::vector<uint32_t> keys(mask + 1, DIFF_NO_ITEM);
+    std::vector<uint32_t> cursors(mask + 1, DIFF_NO_ITEM);
+    auto findSlot = [&](std::string_view name, uint64_t hash) {
+        size_t slot = hash & mask;
+        while (keys[slot] != DIFF_NO_ITEM && (oldHashes[keys[slot]] != hash || oldItems[keys[slot]].name != name))
+        {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    };
+    std::vector<uint32_t> next(oldItems.size(), DIFF_NO_ITEM);
+    for (uint32_t i = static_cast<uint32_t>(oldItems.size()); i-- > 0;)
+    {
+        size_t slot = findSlot(oldItems[i].name, oldHashes[i]);
+        next[i] = cursors[slot];
+        keys[slot] = i;
+        cursors[slot] = i;
+    }
+
+    std::vector<bool> matched(oldItems.size(), false);
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    pairs.reserve(std::min(oldItems.size(), newItems.size()));
+    for (uint32_t j = 0; j < newItems.size(); j++)
+    {
+        size_t slot = findSlot(newItems[j].name, newHashes[j]);
+        if (cursors[slot] == DIFF_NO_ITEM)
+        {
+            entries.push_back({level, DiffChange::Added, std::string(newItems[j].name), 0, newItems[j].size});
+            continue;
+        }
+        uint32_t i = cursors[slot];
+        cursors[slot] = next[i];
+        matched[i] = true;
+        pairs.push_back({i, j});
+    }
+    for (uint32_t i = 0; i < oldItems.size(); i++)
+    {
+        if (!matched[i])
+        {
+            entries.push_back({level, DiffChange::Removed, std::string(oldItems[i].name), oldItems[i].size, 0});
+        }
+    }
+
+    std::vector<uint8_t> changed(pairs.size(), 0);
+    RunBatches(pairs.size(), pool, [&](size_t batch) {
+        size_t end = std::min(pairs.size(), (batch + 1) * DIFF_HASH_BATCH_SIZE);
+        for (size_t k = batch * DIFF_HASH_BATCH_SIZE; k < end; k++)
+        {
+            const DiffItem &oldItem = oldItems[pairs[k].first];
+            const DiffItem &newItem = newItems[pairs[k].second];
+            changed[k] = oldItem.size == newItem.size &&
+                         (oldItem.attributes != newItem.attributes || oldItem.data.size() != newItem.data.size() ||
+                          Xxh3Hash64(oldItem.data) != Xxh3Hash64(newItem.data));
+        }
+    });
+    for (size_t k = 0; k < pairs.size(); k++)
+    {
+        const DiffItem &oldItem = oldItems[pairs[k].first];
+        const DiffItem &newItem = newItems[pairs[k].second];
+        if (oldItem.size != newItem.size || changed[k])
+        {
+            entries.push_back({level, oldItem.size != newItem.size ? DiffChange::Resized : DiffChange::ContentChanged,
+                               std::string(newItem.name), oldItem.size, newItem.size});
+        }
+    }
+}
+
+/**
+ * @brief Adds up the sizes of a set of items.
+ */
+static uint64_t TotalSize(const std::vector<DiffItem> &items)
+{
+    uint64_t size = 0;
+    for (const DiffItem &item : items)
+    {
+        size += item.size;
+    }
+    return size;
+}
+
+/**
+ * @brief Returns the file bytes of a range, or an empty span if the range lies outside the file.
+ */
+static std::span<const uint8_t> FileBytes(const ElfHandler &elfHandler, uint64_t offset, uint64_t size)
+{
+    const MappedFile &file = elfHandler.GetFile();
+    if (offset > file.Size() || size > file.Size() - offset)
+    {
+        return {};
+    }
+    return file.Slice(offset, size);
+}
+
+/**
+ * @brief Constructor for the ElfDiff class. Compares the two files level by level.
+ *
+ * @param oldHandler The parsed old file.
+ * @param oldSegments The program headers of the old file.
+ * @param newHandler The parsed new file.
+ * @param newSegments The program headers of the new file.
+ * @param pool The pool to hash names and contents on, or nullptr to hash on the calling thread.
+ */
+ElfDiff::ElfDiff(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+                 const ElfSegments &newSegments, ThreadPool *pool)
+{
+    DiffHeaders(oldHandler, oldSegments, newHandler, newSegments);
+    DiffSegments(oldHandler, oldSegments, newHandler, newSegments, pool);
+    DiffSections(oldHandler, newHandler, pool);
+    DiffSymbols(oldHandler, oldSegments, newHandler, newSegments, pool);
+
+    std::sort(_entries.begin(), _entries.end(), [](const ElfDiffEntry &a, const ElfDiffEntry &b) {
+        if (a.level != b.level)
+            return a.level < b.level;
+        int64_t growthA = static_cast<int64_t>(a.newSize - a.oldSize);
+        int64_t growthB = static_cast<int64_t>(b.newSize - b.oldSize);
+        if (growthA != growthB)
+            return growthA > growthB;
+        return a.name < b.name;
+    });
+}
+
+const std::vector<ElfHeaderChange> &ElfDiff::GetHeaderChanges() const
+{
+    return _headerChanges;
+}
+
+const std::vector<ElfDiffEntry> &ElfDiff::GetEntries() const
+{
+    return _entries;
+}
+
+/**
+ * @brief Prints the header fields that changed, then for each level a summary line followed by the entries that
+ * grew the most: a mark (+ added, - removed, ~ resized, * content changed), the old and new sizes, the growth and
+ * the name.
+ *
+ * @param limit The number of entries listed per level.
+ */
+void ElfDiff::PrintDiff(size_t limit) const
+{
+    for (const auto &change : _headerChanges)
+    {
+        printf("header %-10s 0x%lx -> 0x%lx\n", change.field.c_str(), change.oldValue, change.newValue);
+    }
+
+    static const char marks[] = {'+', '-', '~', '*'};
+    for (DiffLevel level : {DiffLevel::Segment, DiffLevel::Section, DiffLevel::Symbol})
+    {
+        size_t counts[4] = {};
+        std::vector<const ElfDiffEntry *> entries;
+        for (const auto &entry : _entries)
+        {
+            if (entry.level == level)
+            {
+                counts[static_cast<size_t>(entry.change)]++;
+                entries.push_back(&entry);
+            }
+        }
+
+        size_t index = static_cast<size_t>(level);
+        printf("%s: %lu added, %lu removed, %lu resized, %lu changed, %lu -> %lu bytes (%+ld)\n",
+               DiffLevelName(level), counts[0], counts[1], counts[2], counts[3], _oldSizes[index], _newSizes[index],
+               static_cast<int64_t>(_newSizes[index] - _oldSizes[index]));
+        for (size_t i = 0; i < std::min(limit, entries.size()); i++)
+        {
+            const ElfDiffEntry &entry = *entries[i];
+            printf("  %c %12lu %12lu %+12ld  %s\n", marks[static_cast<size_t>(entry.change)], entry.oldSize,
+                   entry.newSize, static_cast<int64_t>(entry.newSize - entry.oldSize), entry.name.c_str());
+        }
+        if (entries.size() > limit)
+        {
+            printf("  ... %lu more\n", entries.size() - limit);
+        }
+    }
+}
+
+/**
+ * @brief Records the ELF header fields, and the counts of program and section headers, that differ.
+ */
+void ElfDiff::DiffHeaders(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+                          const ElfSegments &newSegments)
+{
+    const ElfHeaderChange fields[] = {
+        {"class", static_cast<uint64_t>(oldSegments.GetElfType()), static_cast<uint64_t>(newSegments.GetElfType())},
+        {"type", oldSegments.GetObjectType(), newSegments.GetObjectType()},
+        {"machine", oldSegments.GetMachine(), newSegments.GetMachine()},
+        {"entry", oldSegments.GetEntry(), newSegments.GetEntry()},
+        {"segments", oldSegments.GetSegments().size(), newSegments.GetSegments().size()},
+        {"sections", oldHandler.GetSections().size(), newHandler.GetSections().size()},
+    };
+    for (const auto &field : fields)
+    {
+        if (field.oldValue != field.newValue)
+        {
+            _headerChanges.push_back(field);
+        }
+    }
+}
+
+/**
+ * @brief Compares the segments by memory size, flags and file bytes. Segments are matched by their SegmentNames name,
+ * so inserting a PT_NOTE does not shift the names of the PT_LOADs.
+ */
+void ElfDiff::DiffSegments(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+                           const ElfSegments &newSegments, ThreadPool *pool)
+{
+    std::vector<std::string> oldNames;
+    std::vector<std::string> newNames;
+    auto collect = [](const ElfHandler &elfHandler, const ElfSegments &segments, std::vector<std::string> &names) {
+        std::vector<DiffItem> items;
+        names = SegmentNames(segments.GetSegments());
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            const ElfSegment &segment = segments.GetSegments()[i];
+            items.push_back(
+                {names[i], segment.memsz, segment.flags, FileBytes(elfHandler, segment.offset, segment.filesz)});
+        }
+        return items;
+    };
+    std::vector<DiffItem> oldItems = collect(oldHandler, oldSegments, oldNames);
+    std::vector<DiffItem> newItems = collect(newHandler, newSegments, newNames);
+
+    size_t index = static_cast<size_t>(DiffLevel::Segment);
+    _oldSizes[index] = TotalSize(oldItems);
+    _newSizes[index] = TotalSize(newItems);
+    MatchItems(DiffLevel::Segment, oldItems, newItems, _entries, pool);
+}
+
+/**
+ * @brief Compares the sections by size, type, flags and contents.
+ */
+void ElfDiff::DiffSections(const ElfHandler &oldHandler, const ElfHandler &newHandler, ThreadPool *pool)
+{
+    auto collect = [](const ElfHandler &elfHandler) {
+        std::vector<DiffItem> items;
+        for (const ElfSection &section : elfHandler.GetSections())
+        {
+            if (section.type == static_cast<uint32_t>(SectionHeaderType::SHT_NULL))
+            {
+                continue;
+            }
+            std::span<const uint8_t> data;
+            if (section.type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+            {
+                data = FileBytes(elfHandler, section.offset, section.size);
+            }
+            items.push_back({section.name, section.size, section.flags << 32 | section.type, data});
+        }
+        return items;
+    };
+    std::vector<DiffItem> oldItems = collect(oldHandler);
+    std::vector<DiffItem> newItems = collect(newHandler);
+
+    size_t index = static_cast<size_t>(DiffLevel::Section);
+    _oldSizes[index] = TotalSize(oldItems);
+    _newSizes[index] = TotalSize(newItems);
+    MatchItems(DiffLevel::Section, oldItems, newItems, _entries, pool);
+}
+
+/**
+ * @brief Compares the sized function and object symbols by size and by the bytes they cover. Code that only moved
+ * shows up as changed as well, since its relative calls and references moved with it.
+ */
+void ElfDiff::DiffSymbols(const ElfHandler &oldHandler, const ElfSegments &oldSegments, const ElfHandler &newHandler,
+                          const ElfSegments &newSegments, ThreadPool *pool)
+{
+    auto collect = [](const ElfHandler &elfHandler, const ElfSegments &segments, std::vector<ElfSymbol> &symbols) {
+        symbols = elfHandler.GetSymbols();
+        if (symbols.empty())
+        {
+            symbols = elfHandler.GetDynamicSymbols();
+        }
+        std::erase_if(symbols, [](const ElfSymbol &symbol) {
+            return symbol.name.empty() || symbol.size == 0 || symbol.sectionIndex == SHN_UNDEF ||
+                   symbol.sectionIndex >= SHN_LORESERVE ||
+                   (symbol.type != SymbolType::STT_FUNC && symbol.type != SymbolType::STT_OBJECT &&
+                    symbol.type != SymbolType::STT_GNU_IFUNC && symbol.type != SymbolType::STT_TLS);
+        });
+
+        std::vector<const ElfSection *> sectionsByIndex;
+        for (const ElfSection &section : elfHandler.GetSections())
+        {
+            if (section.index >= sectionsByIndex.size())
+            {
+                sectionsByIndex.resize(section.index + 1, nullptr);
+            }
+            sectionsByIndex[section.index] = &section;
+        }
+
+        // Symbol values of relocatable files, and of thread-local symbols, are not addresses
+        bool relocatable = segments.GetObjectType() == static_cast<uint16_t>(ElfObjectType::ET_REL);
+        std::vector<DiffItem> items;
+        items.reserve(symbols.size());
+        for (const ElfSymbol &symbol : symbols)
+        {
+            const ElfSection *section =
+                symbol.sectionIndex < sectionsByIndex.size() ? sectionsByIndex[symbol.sectionIndex] : nullptr;
+            std::span<const uint8_t> data;
+            if (section != nullptr && symbol.type != SymbolType::STT_TLS &&
+                section->type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+            {
+                uint64_t offset = relocatable ? symbol.value : symbol.value - section->addr;
+                if (offset < section->size && symbol.size <= section->size - offset)
+                {
+                    data = FileBytes(elfHandler, section->offset + offset, symbol.size);
+                }
+            }
+            items.push_back({symbol.name, symbol.size, static_cast<uint64_t>(symbol.type), data});
+        }
+        return items;
+    };
+    std::vector<ElfSymbol> oldSymbols;
+    std::vector<ElfSymbol> newSymbols;
+    std::vector<DiffItem> oldItems = collect(oldHandler, oldSegments, oldSymbols);
+    std::vector<DiffItem> newItems = collect(newHandler, newSegments, newSymbols);
+
+    size_t index = static_cast<size_t>(DiffLevel::Symbol);
+    _oldSizes[index] = TotalSize(oldItems);
+    _newSizes[index] = TotalSize(newItems);
+    MatchItems(DiffLevel::Symbol, oldItems, newItems, _entries, pool);
+}
+
+const char *DiffLevelName(DiffLevel level)
+{
+    switch (level)
+    {
+    case DiffLevel::Segment:
+        return "segments";
+    case DiffLevel::Section:
+        return "sections";
+    case DiffLevel::Symbol:
+        return "symbols";
+    }
+    return "unknown";
+}
+
+const char *DiffChangeName(DiffChange change)
+{
+    switch (change)
+    {
+    case DiffChange::Added:
+        return "added";
+    case DiffChange::Removed:
+        return "removed";
+    case DiffChange::Resized:
+        return "resized";
+    case DiffChange::ContentChanged:
+        return "changed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,376 @@
+#include "elf_dynamic.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Constructor for the ElfDynamic class. Reads the PT_DYNAMIC entries, and the tables they point at when those
+ * are small.
+ *
+ * @param segments The program headers of the file, which must outlive this object.
+ * @throws std::runtime_error if the dynamic segment lies outside the file.
+ */
+ElfDynamic::ElfDynamic(const ElfSegments &segments) : _segments(segments)
+{
+    const ElfSegment *dynamic = segments.FindSegment(ProgramHeaderType::PT_DYNAMIC);
+    if (dynamic == nullptr)
+    {
+        return;
+    }
+
+    std::span<const uint8_t> data = segments.GetSegmentData(*dynamic);
+    if (segments.GetElfType() == ElfType::ELF_32)
+        ReadEntries<Elf32Dyn>(data);
+    else
+        ReadEntries<Elf64Dyn>(data);
+
+    auto strtab = GetValue(DT_STRTAB);
+    auto strsz = GetValue(DT_STRSZ);
+    if (strtab && strsz)
+    {
+        _stringsAddress = *strtab;
+        _stringsSize = *strsz;
+        ReadTables(*strtab, *strsz);
+    }
+}
+
+/**
+ * @brief Reads the hash tables, .dynsym and .dynstr with a single pread. Linkers place them next to each other in
+ * the first PT_LOAD segment, ending with .dynstr, so one range from the lowest of their addresses to the end of the
+ * string table covers every later lookup. Skipped when the range exceeds DYNAMIC_TABLES_READ_SIZE.
+ *
+ * @param strtab The address of the string table.
+ * @param strsz The size of the string table.
+ */
+void ElfDynamic::ReadTables(uint64_t strtab, uint64_t strsz)
+{
+    uint64_t begin = strtab;
+    for (int64_t tag : {DT_HASH, DT_GNU_HASH, DT_SYMTAB})
+    {
+        if (auto address = GetValue(tag))
+        {
+            begin = std::min(begin, *address);
+        }
+    }
+    if (strsz > UINT64_MAX - strtab || strtab + strsz - begin > DYNAMIC_TABLES_READ_SIZE)
+    {
+        return;
+    }
+
+    // Left unset when the tables are not contiguous, each lookup then reads its own range
+    std::span<const uint8_t> tables = ReadVirtualAvailable(begin, strtab + strsz - begin);
+    if (tables.size() == strtab + strsz - begin)
+    {
+        _tablesAddress = begin;
+        _tables = tables;
+    }
+}
+
+/**
+ * @brief Decodes the dynamic entries up to DT_NULL.
+ */
+template <typename ElfDyn> void ElfDynamic::ReadEntries(std::span<const uint8_t> data)
+{
+    for (size_t offset = 0; offset + sizeof(ElfDyn) <= data.size(); offset += sizeof(ElfDyn))
+    {
+        ElfDyn dyn;
+        memcpy(&dyn, data.data() + offset, sizeof(ElfDyn));
+        if (dyn.d_tag == DT_NULL)
+        {
+            break;
+        }
+        _entries.push_back({static_cast<int64_t>(dyn.d_tag), static_cast<uint64_t>(dyn.d_val)});
+    }
+}
+
+bool ElfDynamic::IsPresent() const
+{
+    return !_entries.empty();
+}
+
+const std::vector<ElfDynamicEntry> &ElfDynamic::GetEntries() const
+{
+    return _entries;
+}
+
+/**
+ * @brief Returns the value of the first entry with a tag, or std::nullopt if there is none.
+ */
+std::optional<uint64_t> ElfDynamic::GetValue(int64_t tag) const
+{
+    for (const auto &entry : _entries)
+    {
+        if (entry.tag == tag)
+        {
+            return entry.value;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Returns the strings named by every entry with a tag, such as the DT_NEEDED libraries.
+ */
+std::vector<std::string_view> ElfDynamic::GetStrings(int64_t tag) const
+{
+    std::vector<std::string_view> strings;
+    for (const auto &entry : _entries)
+    {
+        if (entry.tag == tag)
+        {
+            strings.push_back(GetString(entry.value));
+        }
+    }
+    return strings;
+}
+
+/**
+ * @brief Returns a string of the dynamic string table, or an empty view if the offset is invalid. Unless the tables
+ * were read up front the string table is read a chunk at a time, with a longer read for strings crossing a chunk end.
+ */
+std::string_view ElfDynamic::GetString(uint64_t offset) const
+{
+    if (offset >= _stringsSize)
+    {
+        return {};
+    }
+
+    uint64_t remaining = _stringsSize - offset;
+    uint64_t requested = remaining;
+    std::span<const uint8_t> bytes;
+    if (!_tables.empty())
+    {
+        bytes = ReadVirtualAvailable(_stringsAddress + offset, remaining);
+    }
+    else
+    {
+        uint64_t index = offset / DYNAMIC_STRING_CHUNK_SIZE;
+        auto chunk = _stringChunks.find(index);
+        if (chunk == _stringChunks.end())
+        {
+            uint64_t begin = index * DYNAMIC_STRING_CHUNK_SIZE;
+            uint64_t size = std::min<uint64_t>(DYNAMIC_STRING_CHUNK_SIZE, _stringsSize - begin);
+            chunk = _stringChunks.emplace(index, ReadVirtualAvailable(_stringsAddress + begin, size)).first;
+        }
+        uint64_t chunkOffset = offset % DYNAMIC_STRING_CHUNK_SIZE;
+        bytes = chunk->second.subspan(std::min<uint64_t>(chunkOffset, chunk->second.size()));
+        requested = std::min<uint64_t>(remaining, DYNAMIC_STRING_CHUNK_SIZE - chunkOffset);
+    }
+
+    for (uint64_t size = 2 * DYNAMIC_STRING_CHUNK_SIZE;; size *= 2)
+    {
+        const char *begin = reinterpret_cast<const char *>(bytes.data());
+        size_t length = strnlen(begin, bytes.size());
+        if (length < bytes.size() || bytes.size() < requested || requested == remaining)
+        {
+            return {begin, length};
+        }
+        requested = std::min(size, remaining);
+        bytes = ReadVirtualAvailable(_stringsAddress + offset, requested);
+    }
+}
+
+/**
+ * @brief Returns the bytes at a virtual address, which must lie within the file part of one PT_LOAD segment.
+ *
+ * @throws std::runtime_error if the range is not backed by the file.
+ */
+std::span<const uint8_t> ElfDynamic::ReadVirtual(uint64_t vaddr, uint64_t size) const
+{
+    std::span<const uint8_t> data = ReadVirtualAvailable(vaddr, size);
+    if (data.size() != size)
+        LOG_THROW(Logger::LogLevel::Error, "Range 0x%lx+0x%lx is not backed by %s", vaddr, size,
+                  _segments.GetFileName().c_str());
+    return data;
+}
+
+/**
+ * @brief Returns up to maxSize bytes at a virtual address, stopping at the end of the file part of its PT_LOAD
+ * segment; empty if the address is not backed by the file. Ranges inside the tables read up front cost no read.
+ */
+std::span<const uint8_t> ElfDynamic::ReadVirtualAvailable(uint64_t vaddr, uint64_t maxSize) const
+{
+    if (vaddr >= _tablesAddress && vaddr - _tablesAddress <= _tables.size() &&
+        maxSize <= _tables.size() - (vaddr - _tablesAddress))
+    {
+        return _tables.subspan(vaddr - _tablesAddress, maxSize);
+    }
+    for (const auto &segment : _segments.GetSegments())
+    {
+        if (segment.type == static_cast<uint32_t>(ProgramHeaderType::PT_LOAD) && vaddr >= segment.vaddr &&
+            vaddr - segment.vaddr < segment.filesz)
+        {
+            uint64_t available = segment.filesz - (vaddr - segment.vaddr);
+            return _segments.ReadRange(segment.offset + (vaddr - segment.vaddr), std::min(maxSize, available));
+        }
+    }
+    return {};
+}
+
+/**
+ * @brief Counts the dynamic symbols from a GNU hash table: the symbols past the highest bucket start are found by
+ * following its chain to the entry with the low bit set.
+ *
+ * @param vaddr The address of the table.
+ * @return The number of symbols, including the unhashed ones before symoffset; 0 if no symbol is hashed.
+ */
+size_t ElfDynamic::CountGnuHashSymbols(uint64_t vaddr) const
+{
+    std::span<const uint8_t> header = ReadVirtual(vaddr, 4 * sizeof(uint32_t));
+    uint32_t fields[4];
+    memcpy(fields, header.data(), sizeof(fields));
+    uint32_t bucketCount = fields[0];
+    uint32_t symbolOffset = fields[1];
+    uint64_t bloomSize = uint64_t(fields[2]) * (_segments.GetElfType() == ElfType::ELF_32 ? 4 : 8);
+
+    uint64_t bucketsAddress = vaddr + sizeof(fields) + bloomSize;
+    std::span<const uint8_t> buckets = ReadVirtual(bucketsAddress, uint64_t(bucketCount) * sizeof(uint32_t));
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < bucketCount; i++)
+    {
+        uint32_t bucket;
+        memcpy(&bucket, buckets.data() + i * sizeof(uint32_t), sizeof(bucket));
+        last = std::max(last, bucket);
+    }
+    if (last < symbolOffset)
+    {
+        return 0;
+    }
+
+    uint64_t chainsAddress = bucketsAddress + buckets.size();
+    uint64_t index = last;
+    while (true)
+    {
+        // The chain is read in blocks; it usually ends within the first
+        std::span<const uint8_t> chain =
+            ReadVirtualAvailable(chainsAddress + (index - symbolOffset) * sizeof(uint32_t), 64 * sizeof(uint32_t));
+        if (chain.size() < sizeof(uint32_t))
+            LOG_THROW(Logger::LogLevel::Error, "Truncated GNU hash chain in %s", _segments.GetFileName().c_str());
+        for (size_t i = 0; i + sizeof(uint32_t) <= chain.size(); i += sizeof(uint32_t), index++)
+        {
+            uint32_t hash;
+            memcpy(&hash, chain.data() + i, sizeof(hash));
+            if (hash & 1)
+            {
+                return index + 1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Bounds the dynamic symbol table by the closest table the dynamic section places after it; linkers emit
+ * .dynsym directly before .dynstr or .gnu.version.
+ *
+ * @param symtab The address of the symbol table.
+ * @param entrySize The size of one symbol.
+ * @return The number of symbols that fit before the next table, or before the end of the PT_LOAD segment.
+ */
+size_t ElfDynamic::CountSymbolsBeforeNextTable(uint64_t symtab, uint64_t entrySize) const
+{
+    static constexpr int64_t addressTags[] = {DT_PLTGOT, DT_HASH,   DT_STRTAB,   DT_RELA,   DT_INIT,   DT_FINI,
+                                              DT_REL,    DT_JMPREL, DT_GNU_HASH, DT_VERSYM, DT_VERDEF, DT_VERNEED};
+    uint64_t end = symtab;
+    for (const auto &segment : _segments.GetSegments())
+    {
+        if (segment.type == static_cast<uint32_t>(ProgramHeaderType::PT_LOAD) && symtab >= segment.vaddr &&
+            symtab - segment.vaddr < segment.filesz)
+        {
+            end = segment.vaddr + segment.filesz;
+        }
+    }
+    for (const auto &entry : _entries)
+    {
+        if (std::find(std::begin(addressTags), std::end(addressTags), entry.tag) != std::end(addressTags) &&
+            entry.value > symtab)
+        {
+            end = std::min(end, entry.value);
+        }
+    }
+    return (end - symtab) / entrySize;
+}
+
+/**
+ * @brief Returns the number of entries of the dynamic symbol table, from DT_HASH or DT_GNU_HASH; 0 without either.
+ */
+size_t ElfDynamic::GetSymbolCount() const
+{
+    if (auto hash = GetValue(DT_HASH))
+    {
+        std::span<const uint8_t> header = ReadVirtual(*hash, 2 * sizeof(uint32_t));
+        uint32_t chainCount;
+        memcpy(&chainCount, header.data() + sizeof(uint32_t), sizeof(chainCount));
+        return chainCount;
+    }
+    auto gnuHash = GetValue(DT_GNU_HASH);
+    auto symtab = GetValue(DT_SYMTAB);
+    if (!gnuHash || !symtab)
+    {
+        return 0;
+    }
+
+    // Symbols left out of the hash table precede the hashed ones, but when nothing is hashed at all symoffset need
+    // not cover the imports, so the count is bounded from the layout instead
+    size_t count = CountGnuHashSymbols(*gnuHash);
+    if (count == 0)
+    {
+        uint64_t entrySize = _segments.GetElfType() == ElfType::ELF_32 ? sizeof(Elf32Sym) : sizeof(Elf64Sym);
+        count = CountSymbolsBeforeNextTable(*symtab, entrySize);
+    }
+    return count;
+}
+
+/**
+ * @brief Decodes the dynamic symbols. With importsOnly the names of defined symbols are never looked up, so on a
+ * large library only the pages of .dynstr holding import names are read.
+ */
+template <typename ElfSym>
+void ElfDynamic::ReadSymbols(const DynamicSymbolCallback &callback, bool importsOnly) const
+{
+    auto symtab = GetValue(DT_SYMTAB);
+    size_t count = GetSymbolCount();
+    if (!symtab || count == 0)
+    {
+        return;
+    }
+    if (GetValue(DT_SYMENT).value_or(sizeof(ElfSym)) != sizeof(ElfSym))
+        LOG_THROW(Logger::LogLevel::Error, "Invalid dynamic symbol entry size in %s", _segments.GetFileName().c_str());
+
+    std::span<const uint8_t> table = ReadVirtual(*symtab, count * sizeof(ElfSym));
+    for (size_t i = 0; i < count; i++)
+    {
+        ElfSym symbol;
+        memcpy(&symbol, table.data() + i * sizeof(ElfSym), sizeof(ElfSym));
+        if (!importsOnly || symbol.st_shndx == SHN_UNDEF)
+        {
+            callback({GetString(symbol.st_name), symbol.st_value, symbol.st_size, symbol.st_info, symbol.st_shndx});
+        }
+    }
+}
+
+/**
+ * @brief Calls a function for every entry of the dynamic symbol table, in table order.
+ *
+ * @throws std::runtime_error if the table lies outside the file.
+ */
+void ElfDynamic::ForEachSymbol(const DynamicSymbolCallback &callback) const
+{
+    if (_segments.GetElfType() == ElfType::ELF_32)
+        ReadSymbols<Elf32Sym>(callback, false);
+    else
+        ReadSymbols<Elf64Sym>(callback, false);
+}
+
+/**
+ * @brief Calls a function for every undefined entry of the dynamic symbol table, in table order. Cheaper than
+ * ForEachSymbol on large libraries, as the names of the exported symbols are not read.
+ *
+ * @throws std::runtime_error if the table lies outside the file.
+ */
+void ElfDynamic::ForEachImport(const DynamicSymbolCallback &callback) const
+{
+    if (_segments.GetElfType() == ElfType::ELF_32)
+        ReadSymbols<Elf32Sym>(callback, true);
+    else
+        ReadSymbols<Elf64Sym>(callback, true);
+}
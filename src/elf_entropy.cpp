@@ -0,0 +1,77 @@
+#include "elf_entropy.hpp"
+
+/**
+ * @brief Constructor for the ElfEntropyProfile class. Profiles every section with file content and every segment.
+ *
+ * @param elfHandler The parsed file, whose mapping the regions are read from.
+ * @param segments The program headers of the same file.
+ * @param pool The pool to spread the regions over, or nullptr to profile on the calling thread.
+ * @param windowSize Bytes per sliding window, or 0 for whole-region figures only.
+ * @param stride Distance between consecutive windows; defaults to the window size.
+ */
+ElfEntropyProfile::ElfEntropyProfile(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool,
+                                     size_t windowSize, size_t stride)
+{
+    std::vector<ElfRegion> regions = CollectElfRegions(elfHandler, segments);
+    if (stride == 0)
+    {
+        stride = windowSize;
+    }
+
+    _regions.resize(regions.size());
+    auto profile = [this, &regions, windowSize, stride](size_t i) {
+        const ElfRegion &region = regions[i];
+        ElfRegionEntropy &result = _regions[i];
+        result.kind = region.kind;
+        result.name = region.name;
+        result.offset = region.offset;
+        result.size = region.data.size();
+        result.histogram = ComputeByteHistogram(region.data);
+        result.entropy = ShannonEntropy(result.histogram);
+        result.estimatedSize = EstimateCompressedSize(result.histogram);
+        if (windowSize != 0)
+        {
+            result.windows = SlidingWindowEntropy(region.data, windowSize, stride);
+        }
+    };
+
+    if (pool == nullptr)
+    {
+        for (size_t i = 0; i < regions.size(); i++)
+        {
+            profile(i);
+        }
+        return;
+    }
+    TaskGroup group(*pool);
+    for (size_t i = 0; i < regions.size(); i++)
+    {
+        group.Submit([&profile, i]() { profile(i); });
+    }
+    group.Wait();
+}
+
+const std::vector<ElfRegionEntropy> &ElfEntropyProfile::GetRegions() const
+{
+    return _regions;
+}
+
+/**
+ * @brief Prints one line per region: kind, name, file offset, size, entropy, estimated compressed size and ratio,
+ * and a flag for high entropy regions. Sliding windows follow their region, one per line, with file offsets.
+ */
+void ElfEntropyProfile::PrintProfile() const
+{
+    for (const auto &region : _regions)
+    {
+        double ratio = region.size == 0 ? 1.0 : double(region.estimatedSize) / region.size;
+        printf("%-7s %-24s 0x%08lx %10lu %6.3f %10lu %6.1f%%%s\n", ElfRegionKindName(region.kind),
+               region.name.c_str(), region.offset, region.size, region.entropy, region.estimatedSize, ratio * 100,
+               region.entropy >= HIGH_ENTROPY_THRESHOLD ? " high" : "");
+        for (const auto &window : region.windows)
+        {
+            printf("    0x%08lx %6.3f%s\n", region.offset + window.offset, window.entropy,
+                   window.entropy >= HIGH_ENTROPY_THRESHOLD ? " high" : "");
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#include "elf_fingerprint.hpp"
+#include <map>
+
+/**
+ * @brief Constructor for the ElfFingerprint class. Hashes every section with file content and every segment.
+ *
+ * @param elfHandler The parsed file, whose mapping the regions are hashed from.
+ * @param segments The program headers of the same file.
+ * @param pool The pool to spread the batch over, or nullptr to hash on the calling thread.
+ */
+ElfFingerprint::ElfFingerprint(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool)
+{
+    std::vector<std::span<const uint8_t>> buffers;
+    std::vector<size_t> bufferOfRegion;
+    std::map<std::pair<uint64_t, uint64_t>, size_t> bufferOfRange;
+    for (ElfRegion &region : CollectElfRegions(elfHandler, segments))
+    {
+        auto [it, inserted] = bufferOfRange.try_emplace({region.offset, region.data.size()}, buffers.size());
+        if (inserted)
+        {
+            buffers.push_back(region.data);
+        }
+        bufferOfRegion.push_back(it->second);
+        _regions.push_back({region.kind, std::move(region.name), region.offset, region.data.size(), {}});
+    }
+
+    std::vector<ContentHash> hashes = HashBuffers(buffers, pool);
+    for (size_t i = 0; i < _regions.size(); i++)
+    {
+        _regions[i].hash = hashes[bufferOfRegion[i]];
+    }
+}
+
+const std::vector<ElfRegionHash> &ElfFingerprint::GetRegions() const
+{
+    return _regions;
+}
+
+/**
+ * @brief Prints one line per region: kind, name, file offset, size, XXH3 and SHA-256.
+ */
+void ElfFingerprint::PrintHashes() const
+{
+    for (const auto &region : _regions)
+    {
+        printf("%-7s %-24s 0x%08lx %10lu %016lx %s\n", ElfRegionKindName(region.kind), region.name.c_str(),
+               region.offset, region.size, region.hash.xxh3, FormatSha256(region.hash.sha256).c_str());
+    }
+}
@@ -3,55 +3,75 @@
 #include <algorithm>
 #include <format>
 
+// Symbols whose names are resolved per pool task
+constexpr size_t SYMBOL_NAME_BATCH_SIZE = 4096;
+
+/**
+ * @brief Copies consecutive structures from an offset of the file mapping. The mapping gives no alignment guarantee
+ * for file offsets, so the structures are copied rather than viewed in place.
+ *
+ * @param file The file mapping.
+ * @param offset The file offset of the first structure.
+ * @param out Receives the structures.
+ * @param count The number of structures.
+ * @return Whether the structures lie inside the file.
+ */
+template <typename T> static bool ReadFromFile(const MappedFile &file, uint64_t offset, T *out, uint64_t count = 1)
+{
+    if (count == 0)
+    {
+        return true;
+    }
+    if (offset > file.Size() || count > (file.Size() - offset) / sizeof(T))
+    {
+        return false;
+    }
+    std::memcpy(out, file.Data() + offset, count * sizeof(T));
+    return true;
+}
+
 /**
  * @brief Constructor for the ElfHandler class.
  *
  * @param fileName The name of the ELF file to be read.
+ * @param pool The pool to resolve the symbol names on, or nullptr to resolve them on the calling thread.
  */
-ElfHandler::ElfHandler(const std::string &fileName)
+ElfHandler::ElfHandler(const std::string &fileName, ThreadPool *pool) : _mappedFile(fileName)
 {
-    ReadFile(fileName);
+    ReadFile(fileName, pool);
 }
 
 /**
- * Reads an ELF file and validates its headers and sections.
+ * Reads an ELF file and validates its headers and sections. Everything is read from the file mapping.
  * @param fileName The path to the ELF file to read.
- * @throws std::runtime_error if the file cannot be opened or if any of the headers or sections are invalid.
+ * @param pool The pool to resolve the symbol names on, or nullptr.
+ * @throws std::runtime_error if any of the headers or sections are invalid.
  */
-void ElfHandler::ReadFile(const std::string &fileName)
+void ElfHandler::ReadFile(const std::string &fileName, ThreadPool *pool)
 {
     LOG(Logger::LogLevel::Debug, "Reading ELF file: %s", fileName.c_str());
-    std::ifstream file(fileName, std::ios::binary);
-    if (!file.is_open())
-    {
-        LOG_THROW(Logger::LogLevel::Error, "Failed to open file: %s", fileName.c_str());
-    }
-
-    file.seekg(0, std::ios::end);
-    _fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
+    _fileSize = _mappedFile.Size();
 
     std::array<uint8_t, EI_NIDENT> ident{};
-    file.read(reinterpret_cast<char *>(ident.data()), EI_NIDENT);
-    if (file.gcount() != EI_NIDENT)
+    if (!ReadFromFile(_mappedFile, 0, ident.data(), EI_NIDENT))
     {
         LOG_THROW(Logger::LogLevel::Error, "Incomplete ident read from file: %s", fileName.c_str());
     }
 
     ValidateElfMagic(ident);
-    ValidateElfClass(ident, file);
+    ValidateElfClass(ident);
     ValidateElfDataEncoding(ident);
     ValidateFileVersion(ident);
     ValidateOSABI(ident);
     ValidateABIVersion(ident);
     ValidatePAD(ident);
     ValidateIdent(ident);
-    ValidateElfProgramHeaders(file);
-    ValidateElfSectionHeaders(file);
+    ValidateElfProgramHeaders();
+    ValidateElfSectionHeaders();
 
-    CreateSectionHeaderNameMap(file);
-    ParseTables(file);
-    PrintSectionHeaders();
+    CreateSectionHeaderNameMap();
+    CreateSectionList();
+    ParseTables(pool);
 }
 
 /**
@@ -171,10 +191,9 @@ void ElfHandler::ValidateElfMagic(const std::array<uint8_t, EI_NIDENT> &ident)
  * Validates the ELF class of the given file and reads the ELF header accordingly.
  *
  * @param ident The array of bytes containing the ELF identification information.
- * @param file The input file stream to read the ELF header from.
  * @throws std::runtime_error if the ELF class is invalid.
  */
-void ElfHandler::ValidateElfClass(const std::array<uint8_t, EI_NIDENT> &ident, std::ifstream &file)
+void ElfHandler::ValidateElfClass(const std::array<uint8_t, EI_NIDENT> &ident)
 {
     LOG(Logger::LogLevel::Debug, "Validating ELF class");
     switch (ident[ELFCLASS_OFFSET])
@@ -182,13 +201,13 @@ void ElfHandler::ValidateElfClass(const std::array<uint8_t, EI_NIDENT> &ident, s
     case ELFCLASS32:
         LOG(Logger::LogLevel::Debug, "ELF class: 32-bit");
         _elfType = ElfType::ELF_32;
-        ReadElfHeader<Elf32Ehdr>(file);
+        ReadElfHeader<Elf32Ehdr>();
         break;
 
     case ELFCLASS64:
         LOG(Logger::LogLevel::Debug, "ELF class: 64-bit");
         _elfType = ElfType::ELF_64;
-        ReadElfHeader<Elf64Ehdr>(file);
+        ReadElfHeader<Elf64Ehdr>();
         break;
 
     default:
@@ -197,19 +216,16 @@ void ElfHandler::ValidateElfClass(const std::array<uint8_t, EI_NIDENT> &ident, s
 }
 
 /**
- * @brief Reads the ELF header from the given file stream and stores it in the ElfHandler object.
+ * @brief Reads the ELF header from the file mapping and stores it in the ElfHandler object.
  *
  * @tparam Elf_Ehdr_Type The ELF header type to read.
- * @param file The file stream to read from.
  * @throws std::runtime_error If an incomplete ELF header is read.
  */
-template <typename ElfEhdrType> void ElfHandler::ReadElfHeader(std::ifstream &file)
+template <typename ElfEhdrType> void ElfHandler::ReadElfHeader()
 {
     LOG(Logger::LogLevel::Debug, "Reading ELF header");
     ElfEhdrType ehdr{};
-    file.seekg(0);
-    file.read(reinterpret_cast<char *>(&ehdr), sizeof(ElfEhdrType));
-    if (file.gcount() != sizeof(ElfEhdrType))
+    if (!ReadFromFile(_mappedFile, 0, &ehdr))
     {
         LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF header read");
     }
@@ -351,18 +367,17 @@ void ElfHandler::ValidateIdent(const std::array<uint8_t, EI_NIDENT> &ident)
 /**
  * @brief Validates the program headers of an ELF file.
  *
- * @param file The input file stream of the ELF file.
  * @throws std::runtime_error if the ELF type is invalid.
  */
-void ElfHandler::ValidateElfProgramHeaders(std::ifstream &file)
+void ElfHandler::ValidateElfProgramHeaders()
 {
     switch (_elfType)
     {
     case ElfType::ELF_32:
-        ReadElfProgramHeaders<Elf32Phdr, Elf32Ehdr>(file);
+        ReadElfProgramHeaders<Elf32Phdr, Elf32Ehdr>();
         break;
     case ElfType::ELF_64:
-        ReadElfProgramHeaders<Elf64Phdr, Elf64Ehdr>(file);
+        ReadElfProgramHeaders<Elf64Phdr, Elf64Ehdr>();
         break;
     default:
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF type");
@@ -373,43 +388,43 @@ void ElfHandler::ValidateElfProgramHeaders(std::ifstream &file)
  * @brief Reads the program headers of an ELF file and stores them in a vector.
  *
  * @tparam Elf_Phdr_Type The type of the ELF program header.
- * @param file The input file stream of the ELF file.
  * @throws std::runtime_error if the ELF type is invalid or if an incomplete ELF program header is read.
  */
-template <typename ElfPhdrType, typename ElfEhdr> void ElfHandler::ReadElfProgramHeaders(std::ifstream &file)
+template <typename ElfPhdrType, typename ElfEhdr> void ElfHandler::ReadElfProgramHeaders()
 {
     LOG(Logger::LogLevel::Debug, "Reading ELF program headers");
     uint64_t phoff = std::get<ElfEhdr>(_elfEhdr).e_phoff;
     uint64_t phnum = std::get<ElfEhdr>(_elfEhdr).e_phnum;
 
-    file.seekg(phoff);
-    for (size_t i = 0; i < phnum; ++i)
+    std::vector<ElfPhdrType> phdrs(phnum);
+    if (!ReadFromFile(_mappedFile, phoff, phdrs.data(), phnum))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF program header read");
+    }
+    _elfPhdrs.reserve(phnum);
+    _segments.reserve(phnum);
+    for (const ElfPhdrType &phdr : phdrs)
     {
-        ElfPhdrType phdr{};
-        file.read(reinterpret_cast<char *>(&phdr), sizeof(ElfPhdrType));
-        if (file.gcount() != sizeof(ElfPhdrType))
-        {
-            LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF program header read");
-        }
         _elfPhdrs.push_back(phdr);
+        _segments.push_back({phdr.p_type, phdr.p_flags, phdr.p_offset, phdr.p_vaddr, phdr.p_paddr, phdr.p_filesz,
+                             phdr.p_memsz, phdr.p_align});
     }
 }
 
 /**
  * @brief Validates the section headers of an ELF file.
  *
- * @param file The input file stream of the ELF file.
  * @throws std::runtime_error If the ELF type is invalid.
  */
-void ElfHandler::ValidateElfSectionHeaders(std::ifstream &file)
+void ElfHandler::ValidateElfSectionHeaders()
 {
     switch (_elfType)
     {
     case ElfType::ELF_32:
-        ReadElfSectionHeaders<Elf32Shdr, Elf32Ehdr>(file);
+        ReadElfSectionHeaders<Elf32Shdr, Elf32Ehdr>();
         break;
     case ElfType::ELF_64:
-        ReadElfSectionHeaders<Elf64Shdr, Elf64Ehdr>(file);
+        ReadElfSectionHeaders<Elf64Shdr, Elf64Ehdr>();
         break;
     default:
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF type");
@@ -420,49 +435,49 @@ void ElfHandler::ValidateElfSectionHeaders(std::ifstream &file)
  * @brief Reads the section headers of an ELF file.
  *
  * @tparam Elf_Shdr_Type The type of the ELF section header.
- * @param file The input file stream to read from.
  * @throws std::runtime_error If the ELF type is invalid or if the section header read is incomplete.
  */
-template <typename ElfShdrType, typename ElfEhdr> void ElfHandler::ReadElfSectionHeaders(std::ifstream &file)
+template <typename ElfShdrType, typename ElfEhdr> void ElfHandler::ReadElfSectionHeaders()
 {
     LOG(Logger::LogLevel::Debug, "Reading ELF section headers");
     uint64_t shoff = std::get<ElfEhdr>(_elfEhdr).e_shoff;
     uint64_t shnum = std::get<ElfEhdr>(_elfEhdr).e_shnum;
 
-    file.seekg(shoff);
+    std::vector<ElfShdrType> shdrs(shnum);
+    if (!ReadFromFile(_mappedFile, shoff, shdrs.data(), shnum))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF section header read");
+    }
     for (size_t i = 0; i < shnum; ++i)
     {
-        ElfShdrType shdr{};
-        file.read(reinterpret_cast<char *>(&shdr), sizeof(ElfShdrType));
-        if (file.gcount() != sizeof(ElfShdrType))
-        {
-            LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF section header read");
-        }
-        _elfShdrs.push_back(shdr);
+        _elfShdrIndices.push_back(static_cast<uint32_t>(i));
     }
 
-    // sort the section headers by offset in ascending order
-    std::sort(_elfShdrs.begin(), _elfShdrs.end(), [](auto const &a, auto const &b) {
-        return std::get<ElfShdrType>(a).sh_offset < std::get<ElfShdrType>(b).sh_offset;
-    });
+    // sort the section headers by offset in ascending order, remembering where each one came from so that
+    // sh_link, st_shndx and e_shstrndx can still be resolved
+    std::stable_sort(_elfShdrIndices.begin(), _elfShdrIndices.end(),
+                     [&shdrs](uint32_t a, uint32_t b) { return shdrs[a].sh_offset < shdrs[b].sh_offset; });
+    for (uint32_t index : _elfShdrIndices)
+    {
+        _elfShdrs.push_back(shdrs[index]);
+    }
 }
 
 /**
  * @brief Creates a map of section header names to their corresponding indices in the section header table.
  *
- * @param file An input file stream object representing the ELF file.
  * @return void
  * @throws std::runtime_error if the ELF type is invalid.
  */
-void ElfHandler::CreateSectionHeaderNameMap(std::ifstream &file)
+void ElfHandler::CreateSectionHeaderNameMap()
 {
     switch (_elfType)
     {
     case ElfType::ELF_32:
-        CreateSectionHeaderNameMap<Elf32Shdr, Elf32Ehdr, Elf32Shdr>(file);
+        CreateSectionHeaderNameMap<Elf32Shdr, Elf32Ehdr, Elf32Shdr>();
         break;
     case ElfType::ELF_64:
-        CreateSectionHeaderNameMap<Elf64Shdr, Elf64Ehdr, Elf64Shdr>(file);
+        CreateSectionHeaderNameMap<Elf64Shdr, Elf64Ehdr, Elf64Shdr>();
         break;
     default:
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF type");
@@ -475,39 +490,40 @@ void ElfHandler::CreateSectionHeaderNameMap(std::ifstream &file)
  * @tparam ElfShdrType The type of the ELF section header.
  * @tparam ElfEhdr The type of the ELF header.
  * @tparam ElfShdr The type of the ELF section.
- * @param file The input file stream of the ELF file.
  * @throws std::runtime_error If the ELF section header string table index is invalid, the ELF section header string
  * table size is invalid, or the ELF section header name offset is invalid.
  */
-template <typename ElfShdrType, typename ElfEhdr, typename ElfShdr>
-void ElfHandler::CreateSectionHeaderNameMap(std::ifstream &file)
+template <typename ElfShdrType, typename ElfEhdr, typename ElfShdr> void ElfHandler::CreateSectionHeaderNameMap()
 {
     LOG(Logger::LogLevel::Debug, "Creating section header name map");
+    if (_elfShdrs.empty())
+    {
+        LOG(Logger::LogLevel::Info, "No section headers, possibly stripped of them. Skipping...");
+        return;
+    }
     uint64_t shstrndx = std::get<ElfEhdr>(_elfEhdr).e_shstrndx; // section header string table index
 
     if (shstrndx >= _elfShdrs.size())
     {
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF section header string table index");
     }
+    // e_shstrndx refers to the original table order, find where the entry ended up after sorting
+    shstrndx = std::find(_elfShdrIndices.begin(), _elfShdrIndices.end(), shstrndx) - _elfShdrIndices.begin();
 
     ElfShdr shstrtab_hdr = std::get<ElfShdr>(_elfShdrs[shstrndx]); // section header string table header
 
     uint64_t shstrtabOffset = shstrtab_hdr.sh_offset; // section header string table offset
     uint64_t shstrtabSize = shstrtab_hdr.sh_size;    // section header string table size
 
-    file.seekg(shstrtabOffset);
-
     if (shstrtabSize == 0 || shstrtabSize > _fileSize)
     {
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF section header string table size");
     }
-
-    std::vector<char> shstrtab(shstrtabSize);
-    file.read(shstrtab.data(), shstrtabSize);
-    if (file.gcount() != static_cast<std::streamsize>(shstrtabSize))
+    if (shstrtabOffset > _fileSize - shstrtabSize)
     {
         LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF section header string table read");
     }
+    auto shstrtab = reinterpret_cast<const char *>(_mappedFile.Data() + shstrtabOffset);
 
     uint64_t previousOffset = 0;
     uint64_t previousSize = 0;
@@ -517,19 +533,22 @@ void ElfHandler::CreateSectionHeaderNameMap(std::ifstream &file)
         uint64_t nameOffset = shdr.sh_name;
         uint64_t shOffset = shdr.sh_offset;
         uint64_t shSize = shdr.sh_size;
+        // SHT_NOBITS sections occupy no space in the file and their offsets carry no meaning, debug files are full
+        // of them, so they take no part in the layout checks
+        bool isNoBits = shdr.sh_type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS);
 
-        if (shOffset > _fileSize)
+        if (!isNoBits && shOffset > _fileSize)
         {
             LOG_THROW(Logger::LogLevel::Error, "Invalid ELF section header offset, exceeds file size");
         }
 
-        if (previousOffset + previousSize > shOffset && previousOffset != shOffset)
+        if (!isNoBits && previousOffset + previousSize > shOffset && previousOffset != shOffset)
         {
             LOG_THROW(Logger::LogLevel::Error,
                               "Invalid ELF section header offset, overlaps with previous section");
         }
 
-        if (previousOffset == shOffset)
+        if (!isNoBits && previousOffset == shOffset)
         {
             LOG(Logger::LogLevel::Warning,
                 "ELF section header offset is the same as previous section, will continue and hope for the best...");
@@ -546,53 +565,109 @@ void ElfHandler::CreateSectionHeaderNameMap(std::ifstream &file)
             LOG_THROW(Logger::LogLevel::Error, "Invalid ELF section header name offset");
         }
 
-        std::string sectionName(shstrtab.data() + nameOffset, nextNull);
+        std::string sectionName(shstrtab + nameOffset, nextNull);
         _sectionHeaderNameMap[i] = sectionName;
         LOG(Logger::LogLevel::Debug, "Section[%d] Name: %s", i, sectionName.c_str());
-        previousOffset = shOffset;
-        previousSize = shSize;
+        if (!isNoBits)
+        {
+            previousOffset = shOffset;
+            previousSize = shSize;
+        }
     }
 }
 
 /**
  * @brief Parses the tables of the ELF file.
  * 
- * @param file The input file stream of the ELF file.
+ * @param pool The pool to resolve the symbol names on, or nullptr.
  * @tparam Elf32Shdr The ELF32 section header type.
  * @tparam Elf32Ehdr The ELF32 header type.
  * @tparam Elf64Shdr The ELF64 section header type.
  * @tparam Elf64Sym The ELF64 symbol type.
  * @throws Logger::Log with error if the ELF type is invalid.
  */
-void ElfHandler::ParseTables(std::ifstream &file)
+void ElfHandler::ParseTables(ThreadPool *pool)
 {
     switch (_elfType)
     {
     case ElfType::ELF_32:
-        ParseTables<Elf32Shdr, Elf32Sym>(file);
+        ParseTables<Elf32Shdr, Elf32Sym>(pool);
         break;
     case ElfType::ELF_64:
-        ParseTables<Elf64Shdr, Elf64Sym>(file);
+        ParseTables<Elf64Shdr, Elf64Sym>(pool);
         break;
     default:
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF type");
     }
 }
 
+/**
+ * @brief Resolves the name of every symbol of a table against its string table, in batches of
+ * SYMBOL_NAME_BATCH_SIZE symbols that run as separate pool tasks when there is a pool.
+ *
+ * @param symtab The symbol table.
+ * @param strtab The string table the names point into, viewed in the file mapping.
+ * @param dynamic Whether the tables are .dynsym and .dynstr, for the error message.
+ * @param pool The pool to resolve the names on, or nullptr.
+ * @return The name of each symbol, by index.
+ * @throws Logger::Log if a symbol name offset is invalid.
+ */
+template <typename ElfSym>
+static std::vector<std::string> ResolveSymbolNames(const std::vector<ElfSym> &symtab, std::span<const char> strtab,
+                                                   bool dynamic, ThreadPool *pool)
+{
+    std::vector<std::string> names(symtab.size());
+    auto resolveBatch = [&](size_t batch) {
+        size_t end = std::min(symtab.size(), (batch + 1) * SYMBOL_NAME_BATCH_SIZE);
+        for (size_t i = batch * SYMBOL_NAME_BATCH_SIZE; i < end; i++)
+        {
+            uint64_t nameOffset = symtab[i].st_name;
+
+            if (nameOffset >= strtab.size())
+                LOG_THROW(Logger::LogLevel::Error, "Invalid ELF %ssymbol name offset", dynamic ? "dynamic " : "");
+
+            size_t nextNull = strnlen(strtab.data() + nameOffset, strtab.size() - nameOffset);
+
+            if (nameOffset + nextNull >= strtab.size())
+                LOG_THROW(Logger::LogLevel::Error, "Invalid ELF %ssymbol name offset", dynamic ? "dynamic " : "");
+
+            names[i].assign(strtab.data() + nameOffset, nextNull);
+        }
+    };
+
+    size_t batchCount = (symtab.size() + SYMBOL_NAME_BATCH_SIZE - 1) / SYMBOL_NAME_BATCH_SIZE;
+    if (pool == nullptr || batchCount <= 1)
+    {
+        for (size_t batch = 0; batch < batchCount; batch++)
+        {
+            resolveBatch(batch);
+        }
+    }
+    else
+    {
+        TaskGroup group(*pool);
+        for (size_t batch = 0; batch < batchCount; batch++)
+        {
+            group.Submit([&resolveBatch, batch]() { resolveBatch(batch); });
+        }
+        group.Wait();
+    }
+    return names;
+}
+
 /**
  * @brief Parses the symbol and string tables of an ELF file.
  * 
  * @tparam ElfShdr The type of the ELF section header.
  * @tparam ElfSym The type of the ELF symbol.
- * @param file The input file stream of the ELF file.
+ * @param pool The pool to resolve the symbol names on, or nullptr.
  * @throws Logger::Log if the dynamic symbol table or dynamic string table is not found.
  * @throws Logger::Log if the symbol table or string table sizes are invalid.
  * @throws Logger::Log if the read of the symbol table or string table is incomplete.
  * @throws Logger::Log if a symbol name offset is invalid.
  */
 
-template <typename ElfShdr, typename ElfSym>
-void ElfHandler::ParseTables(std::ifstream &file)
+template <typename ElfShdr, typename ElfSym> void ElfHandler::ParseTables(ThreadPool *pool)
 {
     LOG(Logger::LogLevel::Debug, "Parsing Tables");
     int64_t shsymtabndx = -1; // symbol table index
@@ -609,58 +684,50 @@ void ElfHandler::ParseTables(std::ifstream &file)
 
     // DYNAMIC TABLES FIRST
     LOG(Logger::LogLevel::Debug, "Parsing Dynamic Tables");
-    // Handle Missing Dynamic Tables
-    if (shdynsymndx == -1) { LOG_THROW(Logger::LogLevel::Error, "No dynamic symbol table found"); }
-    if (shdynstrndx == -1) { LOG_THROW(Logger::LogLevel::Error, "No dynamic string table found"); }
-
-    // Read Dynamic Symbol Table
-    ElfShdr dynsymtab_hdr = std::get<ElfShdr>(_elfShdrs[shdynsymndx]);
-    uint64_t dynsymtabSize = dynsymtab_hdr.sh_size;
-    uint64_t dynsymtabOffset = dynsymtab_hdr.sh_offset;
-
-    if (dynsymtabSize == 0 || dynsymtabSize > _fileSize)
-        LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic symbol table size");
-
-    if (dynsymtabSize % sizeof(ElfSym) != 0)
-        LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic symbol table size");
-
-    file.seekg(dynsymtabOffset);
-    std::vector<ElfSym> dynsymtab(dynsymtabSize / sizeof(ElfSym));
-    file.read(reinterpret_cast<char *>(dynsymtab.data()), dynsymtabSize);
+    // Handle Missing Dynamic Tables, statically linked files have neither
+    if (shdynsymndx == -1 && shdynstrndx == -1)
+    {
+        LOG(Logger::LogLevel::Info, "No dynamic symbol or string table found, possibly static. Skipping...");
+    }
+    else if (shdynsymndx == -1) { LOG_THROW(Logger::LogLevel::Error, "No dynamic symbol table found"); }
+    else if (shdynstrndx == -1) { LOG_THROW(Logger::LogLevel::Error, "No dynamic string table found"); }
+    else if (_sections[shdynsymndx].type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+    {
+        LOG(Logger::LogLevel::Info, "Dynamic symbol table has no contents, possibly a debug file. Skipping...");
+    }
+    else
+    {
+        // Read Dynamic Symbol Table
+        ElfShdr dynsymtab_hdr = std::get<ElfShdr>(_elfShdrs[shdynsymndx]);
+        uint64_t dynsymtabSize = dynsymtab_hdr.sh_size;
+        uint64_t dynsymtabOffset = dynsymtab_hdr.sh_offset;
 
-    if (file.gcount() != static_cast<std::streamsize>(dynsymtabSize))
-        LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF dynamic symbol table read");
+        if (dynsymtabSize == 0 || dynsymtabSize > _fileSize)
+            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic symbol table size");
 
-    // Read Dynamic String Table
-    ElfShdr dynstrtab_hdr = std::get<ElfShdr>(_elfShdrs[shdynstrndx]);
-    uint64_t dynstrtabSize = dynstrtab_hdr.sh_size;
-    uint64_t dynstrtabOffset = dynstrtab_hdr.sh_offset;
+        if (dynsymtabSize % sizeof(ElfSym) != 0)
+            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic symbol table size");
 
-    if (dynstrtabSize == 0 || dynstrtabSize > _fileSize)
-        LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic string table size");
+        std::vector<ElfSym> dynsymtab(dynsymtabSize / sizeof(ElfSym));
+        if (!ReadFromFile(_mappedFile, dynsymtabOffset, dynsymtab.data(), dynsymtab.size()))
+            LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF dynamic symbol table read");
 
-    file.seekg(dynstrtabOffset);
-    std::vector<char> dynstrtab(dynstrtabSize);
-    file.read(dynstrtab.data(), dynstrtabSize);
-    if (file.gcount() != static_cast<std::streamsize>(dynstrtabSize))
-        LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF dynamic string table read");
+        // Read Dynamic String Table
+        ElfShdr dynstrtab_hdr = std::get<ElfShdr>(_elfShdrs[shdynstrndx]);
+        uint64_t dynstrtabSize = dynstrtab_hdr.sh_size;
+        uint64_t dynstrtabOffset = dynstrtab_hdr.sh_offset;
 
-    // Parse Dynamic Symbol Names
-    for (size_t i = 0; i < dynsymtab.size(); i++)
-    {
-        uint64_t nameOffset = dynsymtab[i].st_name;
-        
-        if (nameOffset >= dynstrtabSize)
-            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic symbol name offset");
-        
-        size_t nextNull = strnlen(dynstrtab.data() + nameOffset, dynstrtabSize - nameOffset);
+        if (dynstrtabSize == 0 || dynstrtabSize > _fileSize)
+            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic string table size");
 
-        if (nameOffset + nextNull >= dynstrtabSize)
-            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF dynamic symbol name offset");
+        if (dynstrtabOffset > _fileSize - dynstrtabSize)
+            LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF dynamic string table read");
+        std::span<const char> dynstrtab(reinterpret_cast<const char *>(_mappedFile.Data() + dynstrtabOffset),
+                                        dynstrtabSize);
 
-        std::string dynsymbolName(dynstrtab.data() + nameOffset, nextNull);
-        _dynamicSymbolTableMap[i] = dynsymbolName;
-        _elfDynamicSymtab.push_back(dynsymtab[i]);
+        // Parse Dynamic Symbol Names
+        _dynamicSymbolNames = ResolveSymbolNames(dynsymtab, dynstrtab, true, pool);
+        _elfDynamicSymtab.assign(dynsymtab.begin(), dynsymtab.end());
     }
 
     // OTHER TABLES
@@ -685,6 +752,12 @@ void ElfHandler::ParseTables(std::ifstream &file)
         return;
     }
 
+    if (_sections[shsymtabndx].type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+    {
+        LOG(Logger::LogLevel::Info, "Symbol table has no contents. Skipping...");
+        return;
+    }
+
     // Read Symbol Table
     ElfShdr symtab_hdr = std::get<ElfShdr>(_elfShdrs[shsymtabndx]);
     uint64_t symtabSize = symtab_hdr.sh_size;
@@ -696,11 +769,8 @@ void ElfHandler::ParseTables(std::ifstream &file)
     if (symtabSize % sizeof(ElfSym) != 0)
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF symbol table size");
 
-    file.seekg(symtabOffset);
     std::vector<ElfSym> symtab(symtabSize / sizeof(ElfSym));
-    file.read(reinterpret_cast<char *>(symtab.data()), symtabSize);
-
-    if (file.gcount() != static_cast<std::streamsize>(symtabSize))
+    if (!ReadFromFile(_mappedFile, symtabOffset, symtab.data(), symtab.size()))
         LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF symbol table read");
 
     // Read String Table
@@ -711,28 +781,160 @@ void ElfHandler::ParseTables(std::ifstream &file)
     if (strtabSize == 0 || strtabSize > _fileSize)
         LOG_THROW(Logger::LogLevel::Error, "Invalid ELF string table size");
 
-    file.seekg(strtabOffset);
-    std::vector<char> strtab(strtabSize);
-    file.read(strtab.data(), strtabSize);
-
-    if (file.gcount() != static_cast<std::streamsize>(strtabSize))
+    if (strtabOffset > _fileSize - strtabSize)
         LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF string table read");
+    std::span<const char> strtab(reinterpret_cast<const char *>(_mappedFile.Data() + strtabOffset), strtabSize);
 
     // Parse Symbol Names
-    for (size_t i = 0; i < symtab.size(); i++)
+    _symbolNames = ResolveSymbolNames(symtab, strtab, false, pool);
+    _elfSymtab.assign(symtab.begin(), symtab.end());
+}
+
+/**
+ * @brief Creates the class independent section list from the section headers and their names.
+ *
+ * @throws std::runtime_error if the ELF type is invalid.
+ */
+void ElfHandler::CreateSectionList()
+{
+    switch (_elfType)
+    {
+    case ElfType::ELF_32:
+        CreateSectionList<Elf32Shdr>();
+        break;
+    case ElfType::ELF_64:
+        CreateSectionList<Elf64Shdr>();
+        break;
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Invalid ELF type");
+    }
+}
+
+/**
+ * @brief Creates the class independent section list.
+ *
+ * @tparam ElfShdr The type of the ELF section header.
+ */
+template <typename ElfShdr> void ElfHandler::CreateSectionList()
+{
+    _sections.reserve(_elfShdrs.size());
+    for (size_t i = 0; i < _elfShdrs.size(); i++)
+    {
+        const ElfShdr &shdr = std::get<ElfShdr>(_elfShdrs[i]);
+        _sections.push_back({_sectionHeaderNameMap[i], _elfShdrIndices[i], shdr.sh_type, shdr.sh_flags, shdr.sh_addr,
+                             shdr.sh_offset, shdr.sh_size, shdr.sh_link, shdr.sh_info, shdr.sh_addralign,
+                             shdr.sh_entsize});
+    }
+}
+
+const std::string &ElfHandler::GetFileName() const
+{
+    return _mappedFile.GetFileName();
+}
+
+ElfType ElfHandler::GetElfType() const
+{
+    return _elfType;
+}
+
+uint16_t ElfHandler::GetMachine() const
+{
+    return std::visit([](const auto &ehdr) { return ehdr.e_machine; }, _elfEhdr);
+}
+
+/**
+ * @brief Returns the sections of the file, sorted by file offset.
+ */
+const std::vector<ElfSection> &ElfHandler::GetSections() const
+{
+    return _sections;
+}
+
+/**
+ * @brief Finds a section by name.
+ *
+ * @param name The section name, e.g. ".gnu_debuglink".
+ * @return A pointer to the first section with that name, or nullptr if there is none.
+ */
+const ElfSection *ElfHandler::FindSection(const std::string &name) const
+{
+    for (const auto &section : _sections)
     {
-        uint64_t nameOffset = symtab[i].st_name;
-        
-        if (nameOffset >= strtabSize)
-            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF symbol name offset");
-        
-        size_t nextNull = strnlen(strtab.data() + nameOffset, strtabSize - nameOffset);
+        if (section.name == name)
+        {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Returns the contents of a section straight from the file mapping.
+ *
+ * @param section The section to view.
+ * @return A span over the section bytes, empty for SHT_NOBITS sections.
+ * @throws std::runtime_error if the section lies outside the file.
+ */
+std::span<const uint8_t> ElfHandler::GetSectionData(const ElfSection &section) const
+{
+    if (section.type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+    {
+        return {};
+    }
+    return _mappedFile.Slice(section.offset, section.size);
+}
+
+const MappedFile &ElfHandler::GetFile() const
+{
+    return _mappedFile;
+}
+
+/**
+ * @brief Returns the entries of .symtab, in table order; empty for stripped files.
+ */
+std::vector<ElfSymbol> ElfHandler::GetSymbols() const
+{
+    return CreateSymbolList(_elfSymtab, _symbolNames);
+}
 
-        if (nameOffset + nextNull >= strtabSize)
-            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF symbol name offset");
+/**
+ * @brief Returns the entries of .dynsym, in table order; empty for static files.
+ */
+std::vector<ElfSymbol> ElfHandler::GetDynamicSymbols() const
+{
+    return CreateSymbolList(_elfDynamicSymtab, _dynamicSymbolNames);
+}
 
-        std::string symbolName(strtab.data() + nameOffset, nextNull);
-        _symbolTableMap[i] = symbolName;
-        _elfSymtab.push_back(symtab[i]);
+/**
+ * @brief Returns the program headers, in table order.
+ */
+const std::vector<ElfSegment> &ElfHandler::GetSegments() const
+{
+    return _segments;
+}
+
+/**
+ * @brief Creates the class independent view of a symbol table.
+ *
+ * @param symtab The raw symbol table entries.
+ * @param names The name of each entry, by index.
+ * @return The symbols, in table order.
+ */
+std::vector<ElfSymbol> ElfHandler::CreateSymbolList(const std::vector<std::variant<Elf32Sym, Elf64Sym>> &symtab,
+                                                    const std::vector<std::string> &names) const
+{
+    std::vector<ElfSymbol> symbols;
+    symbols.reserve(symtab.size());
+    for (size_t i = 0; i < symtab.size(); i++)
+    {
+        std::visit(
+            [&](const auto &symbol) {
+                symbols.push_back({i < names.size() ? names[i] : std::string(), symbol.st_value,
+                                   symbol.st_size, static_cast<SymbolType>(symbol.st_info & 0xf),
+                                   static_cast<SymbolBinding>(symbol.st_info >> 4), symbol.st_other,
+                                   symbol.st_shndx});
+            },
+            symtab[i]);
     }
-}
\ No newline at end of file
+    return symbols;
+}
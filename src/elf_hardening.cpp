@@ -0,0 +1,204 @@
+#include "elf_hardening.hpp"
+#include "elf_notes.hpp"
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <optional>
+#include <string_view>
+
+// glibc functions with a FORTIFY_SOURCE checking variant, __<name>_chk; sorted for binary search
+static constexpr std::array<std::string_view, 79> FORTIFIABLE_FUNCTIONS = {
+    "asprintf", "confstr", "dprintf", "explicit_bzero", "fdelt", "fgets", "fgets_unlocked", "fgetws",
+    "fgetws_unlocked", "fprintf", "fread", "fread_unlocked", "fwprintf", "getcwd", "getdomainname", "getgroups",
+    "gethostname", "getlogin_r", "gets", "getwd", "longjmp", "mbsnrtowcs", "mbsrtowcs", "mbstowcs", "memcpy",
+    "memmove", "mempcpy", "memset", "obstack_printf", "obstack_vprintf", "poll", "ppoll", "pread", "pread64", "printf",
+    "ptsname_r", "read", "readlink", "readlinkat", "realpath", "recv", "recvfrom", "snprintf", "sprintf", "stpcpy",
+    "stpncpy", "strcat", "strcpy", "strncat", "strncpy", "swprintf", "syslog", "ttyname_r", "vasprintf", "vdprintf",
+    "vfprintf", "vfwprintf", "vprintf", "vsnprintf", "vsprintf", "vswprintf", "vsyslog", "vwprintf", "wcpcpy",
+    "wcpncpy", "wcrtomb", "wcscat", "wcscpy", "wcsncat", "wcsncpy", "wcsnrtombs", "wcsrtombs", "wcstombs", "wctomb",
+    "wmemcpy", "wmemmove", "wmempcpy", "wmemset", "wprintf"};
+
+/**
+ * @brief Returns the index of a function in FORTIFIABLE_FUNCTIONS, or std::nullopt if it has no FORTIFY_SOURCE
+ * variant.
+ */
+static std::optional<size_t> FindFortifiable(std::string_view name)
+{
+    auto it = std::lower_bound(FORTIFIABLE_FUNCTIONS.begin(), FORTIFIABLE_FUNCTIONS.end(), name);
+    if (it == FORTIFIABLE_FUNCTIONS.end() || *it != name)
+    {
+        return std::nullopt;
+    }
+    return it - FORTIFIABLE_FUNCTIONS.begin();
+}
+
+/**
+ * @brief Constructor for the ElfHardening class. Computes the report from the program headers and dynamic section.
+ *
+ * @param segments The program headers of the file.
+ * @throws std::runtime_error if the dynamic tables lie outside the file.
+ */
+ElfHardening::ElfHardening(const ElfSegments &segments) : _fileName(segments.GetFileName())
+{
+    bool interpreter = false;
+    for (const auto &segment : segments.GetSegments())
+    {
+        switch (static_cast<ProgramHeaderType>(segment.type))
+        {
+        case ProgramHeaderType::PT_GNU_RELRO:
+            _report.relro = RelroLevel::Partial;
+            break;
+        case ProgramHeaderType::PT_GNU_STACK:
+            _report.nx = !(segment.flags & ProgramHeaderFlags::PF_X);
+            break;
+        case ProgramHeaderType::PT_INTERP:
+            interpreter = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    ElfDynamic dynamic(segments);
+    _report.isStatic = dynamic.GetStrings(DT_NEEDED).empty();
+
+    uint64_t flags = dynamic.GetValue(DT_FLAGS).value_or(0);
+    uint64_t flags1 = dynamic.GetValue(DT_FLAGS_1).value_or(0);
+    bool bindNow = dynamic.GetValue(DT_BIND_NOW) || (flags & DynamicFlags::DF_BIND_NOW) ||
+                   (flags1 & DynamicFlags::DF_1_NOW);
+    if (_report.relro == RelroLevel::Partial && bindNow)
+    {
+        _report.relro = RelroLevel::Full;
+    }
+    _report.textRelocations = dynamic.GetValue(DT_TEXTREL) || (flags & DynamicFlags::DF_TEXTREL);
+
+    switch (static_cast<ElfObjectType>(segments.GetObjectType()))
+    {
+    case ElfObjectType::ET_DYN:
+        _report.pie = (flags1 & DynamicFlags::DF_1_PIE) || interpreter ? PieKind::Pie : PieKind::SharedObject;
+        break;
+    case ElfObjectType::ET_REL:
+        _report.pie = PieKind::Relocatable;
+        break;
+    default:
+        _report.pie = PieKind::None;
+        break;
+    }
+
+    for (auto path : dynamic.GetStrings(DT_RPATH))
+        _report.rpath.emplace_back(path);
+    for (auto path : dynamic.GetStrings(DT_RUNPATH))
+        _report.runpath.emplace_back(path);
+
+    ElfNotes notes(segments);
+    _report.x86Features = notes.GetProperty(GNU_PROPERTY_X86_FEATURE_1_AND).value_or(0);
+    _report.aarch64Features = notes.GetProperty(GNU_PROPERTY_AARCH64_FEATURE_1_AND).value_or(0);
+
+    ReadImports(dynamic);
+}
+
+/**
+ * @brief Classifies the undefined dynamic symbols: stack protector and FORTIFY_SOURCE imports.
+ */
+void ElfHardening::ReadImports(const ElfDynamic &dynamic)
+{
+    // Functions are counted once, whether imported plainly, fortified or both
+    std::bitset<FORTIFIABLE_FUNCTIONS.size()> fortified;
+    std::bitset<FORTIFIABLE_FUNCTIONS.size()> fortifiable;
+    dynamic.ForEachImport([&](const ElfDynamicSymbol &symbol) {
+        std::string_view name = symbol.name;
+        if (name == "__stack_chk_fail" || name == "__stack_chk_guard")
+        {
+            _report.stackProtector = true;
+        }
+        else if (name.starts_with("__") && name.ends_with("_chk"))
+        {
+            if (auto index = FindFortifiable(name.substr(2, name.size() - 6)))
+            {
+                fortified.set(*index);
+                fortifiable.set(*index);
+            }
+        }
+        else if (auto index = FindFortifiable(name))
+        {
+            fortifiable.set(*index);
+        }
+    });
+    _report.fortified = fortified.count();
+    _report.fortifiable = fortifiable.count();
+}
+
+const ElfHardeningReport &ElfHardening::GetReport() const
+{
+    return _report;
+}
+
+const char *ElfHardening::RelroLevelName(RelroLevel level)
+{
+    switch (level)
+    {
+    case RelroLevel::Partial:
+        return "partial";
+    case RelroLevel::Full:
+        return "full";
+    default:
+        return "none";
+    }
+}
+
+const char *ElfHardening::PieKindName(PieKind kind)
+{
+    switch (kind)
+    {
+    case PieKind::Pie:
+        return "pie";
+    case PieKind::SharedObject:
+        return "dso";
+    case PieKind::Relocatable:
+        return "rel";
+    default:
+        return "no";
+    }
+}
+
+/**
+ * @brief Joins search paths for printing, "-" when there are none.
+ */
+static std::string JoinPaths(const std::vector<std::string> &paths)
+{
+    if (paths.empty())
+    {
+        return "-";
+    }
+    std::string joined;
+    for (const auto &path : paths)
+    {
+        joined += (joined.empty() ? "" : ";") + path;
+    }
+    return joined;
+}
+
+/**
+ * @brief Prints the report on one line, in the order of checksec.
+ */
+void ElfHardening::PrintReport() const
+{
+    std::string canary = _report.isStatic ? "n/a" : _report.stackProtector ? "yes" : "no";
+    std::string fortify = _report.isStatic ? "n/a"
+                                           : std::to_string(_report.fortified) + "/" +
+                                                 std::to_string(_report.fortifiable);
+    std::string cet;
+    if (_report.x86Features & GnuPropertyFlags::X86_FEATURE_1_IBT)
+        cet += ",ibt";
+    if (_report.x86Features & GnuPropertyFlags::X86_FEATURE_1_SHSTK)
+        cet += ",shstk";
+    if (_report.aarch64Features & GnuPropertyFlags::AARCH64_FEATURE_1_BTI)
+        cet += ",bti";
+    if (_report.aarch64Features & GnuPropertyFlags::AARCH64_FEATURE_1_PAC)
+        cet += ",pac";
+
+    printf("relro=%s nx=%s pie=%s canary=%s fortify=%s textrel=%s cet=%s rpath=%s runpath=%s %s\n",
+           RelroLevelName(_report.relro), _report.nx ? "yes" : "no", PieKindName(_report.pie), canary.c_str(),
+           fortify.c_str(), _report.textRelocations ? "yes" : "no", cet.empty() ? "-" : cet.c_str() + 1,
+           JoinPaths(_report.rpath).c_str(), JoinPaths(_report.runpath).c_str(), _fileName.c_str());
+}
@@ -0,0 +1,236 @@
+#include "elf_notes.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+/**
+ * @brief Rounds a value up to the given power of two alignment.
+ */
+static uint64_t AlignUp(uint64_t value, uint64_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+/**
+ * @brief Collects the notes from every PT_NOTE segment of the file.
+ *
+ * @param segments The program header view of the ELF file.
+ * @throws std::runtime_error if a note segment lies outside the file.
+ */
+ElfNotes::ElfNotes(const ElfSegments &segments)
+{
+    for (const auto &segment : segments.GetSegments())
+    {
+        if (segment.type != static_cast<uint32_t>(ProgramHeaderType::PT_NOTE))
+        {
+            continue;
+        }
+        // Notes are 4 byte aligned, except for segments that declare 8 byte alignment such as .note.gnu.property
+        uint64_t align = segment.align == 8 ? 8 : 4;
+        ParseNoteSegment(segments.GetSegmentData(segment), align, segments.GetElfType());
+    }
+}
+
+/**
+ * @brief Walks the notes of a single note segment.
+ *
+ * @param data The bytes of the note segment.
+ * @param align The alignment of the name and descriptor fields.
+ * @param elfType The ELF class, which determines the alignment of GNU properties.
+ */
+void ElfNotes::ParseNoteSegment(std::span<const uint8_t> data, uint64_t align, ElfType elfType)
+{
+    uint64_t offset = 0;
+    while (data.size() - offset >= sizeof(ElfNhdr))
+    {
+        ElfNhdr nhdr;
+        memcpy(&nhdr, data.data() + offset, sizeof(ElfNhdr));
+        uint64_t nameOffset = offset + sizeof(ElfNhdr);
+        uint64_t descOffset = AlignUp(nameOffset + nhdr.n_namesz, align);
+        uint64_t nextOffset = AlignUp(descOffset + nhdr.n_descsz, align);
+
+        // The final descriptor may omit its trailing padding
+        if (descOffset > data.size() || nhdr.n_descsz > data.size() - descOffset)
+        {
+            LOG(Logger::LogLevel::Warning, "Truncated ELF note at segment offset 0x%lx", offset);
+            return;
+        }
+
+        std::span<const uint8_t> desc = data.subspan(descOffset, nhdr.n_descsz);
+        bool isGnu = nhdr.n_namesz == sizeof(ELF_NOTE_GNU) &&
+                     memcmp(data.data() + nameOffset, ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)) == 0;
+        if (isGnu)
+        {
+            switch (nhdr.n_type)
+            {
+            case NT_GNU_BUILD_ID:
+                _buildId.assign(desc.begin(), desc.end());
+                break;
+            case NT_GNU_ABI_TAG:
+                if (desc.size() >= sizeof(ElfGnuAbiTag))
+                {
+                    ElfGnuAbiTag tag;
+                    memcpy(&tag, desc.data(), sizeof(ElfGnuAbiTag));
+                    _abiTag = tag;
+                }
+                break;
+            case NT_GNU_PROPERTY_TYPE_0:
+                ParseGnuProperties(desc, elfType);
+                break;
+            default:
+                break;
+            }
+        }
+        offset = std::min<uint64_t>(nextOffset, data.size());
+    }
+}
+
+/**
+ * @brief Decodes the property array of an NT_GNU_PROPERTY_TYPE_0 note.
+ *
+ * @param desc The note descriptor.
+ * @param elfType The ELF class; properties are padded to 8 bytes in 64-bit files and 4 bytes in 32-bit files.
+ */
+void ElfNotes::ParseGnuProperties(std::span<const uint8_t> desc, ElfType elfType)
+{
+    uint64_t align = elfType == ElfType::ELF_64 ? 8 : 4;
+    uint64_t offset = 0;
+    while (desc.size() - offset >= 2 * sizeof(uint32_t))
+    {
+        uint32_t type;
+        uint32_t size;
+        memcpy(&type, desc.data() + offset, sizeof(uint32_t));
+        memcpy(&size, desc.data() + offset + sizeof(uint32_t), sizeof(uint32_t));
+        offset += 2 * sizeof(uint32_t);
+        if (size > desc.size() - offset)
+        {
+            LOG(Logger::LogLevel::Warning, "Truncated GNU property 0x%x", type);
+            return;
+        }
+
+        uint64_t value = 0;
+        memcpy(&value, desc.data() + offset, std::min<uint64_t>(size, sizeof(value)));
+        _properties.push_back({type, size, value});
+        offset = std::min<uint64_t>(AlignUp(offset + size, align), desc.size());
+    }
+}
+
+const std::vector<uint8_t> &ElfNotes::GetBuildId() const
+{
+    return _buildId;
+}
+
+/**
+ * @brief Returns the build-id as a lower case hex string, or an empty string if the file has none.
+ */
+std::string ElfNotes::GetBuildIdHex() const
+{
+    static const char hexChars[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(_buildId.size() * 2);
+    for (uint8_t byte : _buildId)
+    {
+        result += hexChars[byte >> 4];
+        result += hexChars[byte & 0x0F];
+    }
+    return result;
+}
+
+const std::optional<ElfGnuAbiTag> &ElfNotes::GetAbiTag() const
+{
+    return _abiTag;
+}
+
+const std::vector<ElfGnuProperty> &ElfNotes::GetProperties() const
+{
+    return _properties;
+}
+
+/**
+ * @brief Looks up a GNU property by type.
+ *
+ * @param type The GNU_PROPERTY_* type.
+ * @return The property's payload, or std::nullopt if it is not present.
+ */
+std::optional<uint64_t> ElfNotes::GetProperty(uint32_t type) const
+{
+    for (const auto &property : _properties)
+    {
+        if (property.type == type)
+        {
+            return property.value;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Formats an x86 ISA level bitmask as a list of x86-64 micro-architecture levels.
+ */
+static std::string FormatX86IsaLevels(uint64_t value)
+{
+    static const std::pair<uint32_t, const char *> levels[] = {
+        {GnuPropertyFlags::X86_ISA_1_BASELINE, "x86-64-baseline"},
+        {GnuPropertyFlags::X86_ISA_1_V2, "x86-64-v2"},
+        {GnuPropertyFlags::X86_ISA_1_V3, "x86-64-v3"},
+        {GnuPropertyFlags::X86_ISA_1_V4, "x86-64-v4"}};
+
+    std::string result;
+    for (const auto &[flag, name] : levels)
+    {
+        if (value & flag)
+        {
+            result += result.empty() ? "" : ", ";
+            result += name;
+        }
+    }
+    return result.empty() ? "<none>" : result;
+}
+
+/**
+ * @brief Prints the recovered notes.
+ *
+ * @return void
+ */
+void ElfNotes::PrintNotes() const
+{
+    printf("Build ID: %s\n", _buildId.empty() ? "<none>" : GetBuildIdHex().c_str());
+
+    if (_abiTag)
+    {
+        static const char *osNames[] = {"Linux", "GNU", "Solaris2", "FreeBSD"};
+        const char *osName = _abiTag->os <= ELF_NOTE_OS_FREEBSD ? osNames[_abiTag->os] : "Unknown";
+        printf("ABI Tag: %s %u.%u.%u\n", osName, _abiTag->major, _abiTag->minor, _abiTag->patch);
+    }
+
+    for (const auto &property : _properties)
+    {
+        switch (property.type)
+        {
+        case GNU_PROPERTY_X86_FEATURE_1_AND:
+            printf("Property: x86 feature:%s%s\n",
+                   property.value & GnuPropertyFlags::X86_FEATURE_1_IBT ? " IBT" : "",
+                   property.value & GnuPropertyFlags::X86_FEATURE_1_SHSTK ? " SHSTK" : "");
+            break;
+        case GNU_PROPERTY_X86_ISA_1_NEEDED:
+            printf("Property: x86 ISA needed: %s\n", FormatX86IsaLevels(property.value).c_str());
+            break;
+        case GNU_PROPERTY_X86_ISA_1_USED:
+            printf("Property: x86 ISA used: %s\n", FormatX86IsaLevels(property.value).c_str());
+            break;
+        case GNU_PROPERTY_AARCH64_FEATURE_1_AND:
+            printf("Property: AArch64 feature:%s%s\n",
+                   property.value & GnuPropertyFlags::AARCH64_FEATURE_1_BTI ? " BTI" : "",
+                   property.value & GnuPropertyFlags::AARCH64_FEATURE_1_PAC ? " PAC" : "");
+            break;
+        case GNU_PROPERTY_STACK_SIZE:
+            printf("Property: stack size: 0x%lx\n", property.value);
+            break;
+        case GNU_PROPERTY_NO_COPY_ON_PROTECTED:
+            printf("Property: no copy on protected\n");
+            break;
+        default:
+            printf("Property: type 0x%x, size %u, value 0x%lx\n", property.type, property.size, property.value);
+            break;
+        }
+    }
+}
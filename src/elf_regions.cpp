@@ -0,0 +1,105 @@
+#include "elf_regions.hpp"
+#include "logger.hpp"
+#include <unordered_map>
+
+/**
+ * @brief Returns the name of a program header type as readelf prints it.
+ */
+std::string SegmentTypeName(uint32_t type)
+{
+    switch (static_cast<ProgramHeaderType>(type))
+    {
+    case ProgramHeaderType::PT_NULL:
+        return "NULL";
+    case ProgramHeaderType::PT_LOAD:
+        return "LOAD";
+    case ProgramHeaderType::PT_DYNAMIC:
+        return "DYNAMIC";
+    case ProgramHeaderType::PT_INTERP:
+        return "INTERP";
+    case ProgramHeaderType::PT_NOTE:
+        return "NOTE";
+    case ProgramHeaderType::PT_SHLIB:
+        return "SHLIB";
+    case ProgramHeaderType::PT_PHDR:
+        return "PHDR";
+    case ProgramHeaderType::PT_TLS:
+        return "TLS";
+    case ProgramHeaderType::PT_GNU_EH_FRAME:
+        return "GNU_EH_FRAME";
+    case ProgramHeaderType::PT_GNU_STACK:
+        return "GNU_STACK";
+    case ProgramHeaderType::PT_GNU_RELRO:
+        return "GNU_RELRO";
+    case ProgramHeaderType::PT_GNU_PROPERTY:
+        return "GNU_PROPERTY";
+    default: {
+        char name[16];
+        snprintf(name, sizeof(name), "0x%x", type);
+        return name;
+    }
+    }
+}
+
+/**
+ * @brief Names every segment after its type and its position among the segments of that type, such as LOAD[1]. A
+ * PT_NOTE inserted by another build does not shift the names of the PT_LOADs, so reports over different files, and
+ * the different reports over one file, can be joined on the name.
+ *
+ * @param segments The program headers of a file.
+ * @return The name of each segment, in program header order.
+ */
+std::vector<std::string> SegmentNames(const std::vector<ElfSegment> &segments)
+{
+    std::unordered_map<uint32_t, size_t> ordinals;
+    std::vector<std::string> names;
+    names.reserve(segments.size());
+    for (const ElfSegment &segment : segments)
+    {
+        names.push_back(SegmentTypeName(segment.type) + "[" + std::to_string(ordinals[segment.type]++) + "]");
+    }
+    return names;
+}
+
+/**
+ * @brief Lists every section with a header, then every segment, with views of their bytes in the file mapping.
+ *
+ * @param elfHandler The parsed file.
+ * @param segments The program headers of the same file.
+ * @return The regions in section header order, followed by the segments in program header order.
+ */
+std::vector<ElfRegion> CollectElfRegions(const ElfHandler &elfHandler, const ElfSegments &segments)
+{
+    std::vector<ElfRegion> regions;
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        if (section.type == static_cast<uint32_t>(SectionHeaderType::SHT_NULL))
+        {
+            continue;
+        }
+        regions.push_back({ElfRegionKind::Section, section.name, section.offset, elfHandler.GetSectionData(section)});
+    }
+
+    const auto &programHeaders = segments.GetSegments();
+    std::vector<std::string> names = SegmentNames(programHeaders);
+    for (size_t i = 0; i < programHeaders.size(); i++)
+    {
+        const ElfSegment &segment = programHeaders[i];
+        std::span<const uint8_t> data;
+        try
+        {
+            data = elfHandler.GetFile().Slice(segment.offset, segment.filesz);
+        }
+        catch (const std::exception &)
+        {
+            LOG(Logger::LogLevel::Warning, "Segment %zu lies outside the file, treating it as empty", i);
+        }
+        regions.push_back({ElfRegionKind::Segment, names[i], segment.offset, data});
+    }
+    return regions;
+}
+
+const char *ElfRegionKindName(ElfRegionKind kind)
+{
+    return kind == ElfRegionKind::Section ? "section" : "segment";
+}
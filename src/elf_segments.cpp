@@ -0,0 +1,227 @@
+#include "elf_segments.hpp"
+#include "logger.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Reads the ELF header and program header table of the given file.
+ *
+ * @param fileName The path to the ELF file.
+ * @throws std::runtime_error if the file is not a native byte order ELF file or its program headers are invalid.
+ */
+ElfSegments::ElfSegments(const std::string &fileName) : _fileName(fileName)
+{
+    _fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_fd < 0)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Failed to open file: %s", fileName.c_str());
+    }
+
+    ssize_t headSize = pread(_fd, _head.data(), _head.size(), 0);
+    if (headSize < 0)
+    {
+        close(_fd);
+        LOG_THROW(Logger::LogLevel::Error, "Failed to read file: %s", fileName.c_str());
+    }
+    _headSize = static_cast<size_t>(headSize);
+
+    if (_headSize < EI_NIDENT || memcmp(_head.data(), &ELFMAG, ELFMAG_SIZE) != 0)
+    {
+        close(_fd);
+        LOG_THROW(Logger::LogLevel::Error, "Invalid ELF magic in file: %s", fileName.c_str());
+    }
+
+    // Fields are read in place, so only files matching the host byte order are accepted
+    if (_head[ELFDATA_OFFSET] != ELFDATA2LSB)
+    {
+        close(_fd);
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported ELF data encoding in file: %s", fileName.c_str());
+    }
+
+    try
+    {
+        switch (_head[ELFCLASS_OFFSET])
+        {
+        case ELFCLASS32:
+            _elfType = ElfType::ELF_32;
+            ReadSegments<Elf32Ehdr, Elf32Phdr>();
+            break;
+        case ELFCLASS64:
+            _elfType = ElfType::ELF_64;
+            ReadSegments<Elf64Ehdr, Elf64Phdr>();
+            break;
+        default:
+            LOG_THROW(Logger::LogLevel::Error, "Invalid ELF class");
+        }
+    }
+    catch (...)
+    {
+        close(_fd);
+        throw;
+    }
+}
+
+/**
+ * @brief Closes the file.
+ */
+ElfSegments::~ElfSegments()
+{
+    close(_fd);
+}
+
+/**
+ * @brief Decodes the ELF header and program header table into class independent records.
+ *
+ * @tparam ElfEhdr The ELF header type.
+ * @tparam ElfPhdr The ELF program header type.
+ * @throws std::runtime_error if either table lies outside the file.
+ */
+template <typename ElfEhdr, typename ElfPhdr> void ElfSegments::ReadSegments()
+{
+    if (_headSize < sizeof(ElfEhdr))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Incomplete ELF header read");
+    }
+
+    ElfEhdr ehdr;
+    memcpy(&ehdr, _head.data(), sizeof(ElfEhdr));
+    _objectType = ehdr.e_type;
+    _machine = ehdr.e_machine;
+    _entry = ehdr.e_entry;
+
+    if (ehdr.e_phnum == 0)
+    {
+        return;
+    }
+    if (ehdr.e_phentsize != sizeof(ElfPhdr))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Invalid ELF program header entry size");
+    }
+
+    std::span<const uint8_t> table = ReadRange(ehdr.e_phoff, uint64_t(ehdr.e_phnum) * sizeof(ElfPhdr));
+    _segments.reserve(ehdr.e_phnum);
+    for (size_t i = 0; i < ehdr.e_phnum; ++i)
+    {
+        ElfPhdr phdr;
+        memcpy(&phdr, table.data() + i * sizeof(ElfPhdr), sizeof(ElfPhdr));
+        _segments.push_back({phdr.p_type, phdr.p_flags, phdr.p_offset, phdr.p_vaddr, phdr.p_paddr, phdr.p_filesz,
+                             phdr.p_memsz, phdr.p_align});
+    }
+}
+
+const std::string &ElfSegments::GetFileName() const
+{
+    return _fileName;
+}
+
+ElfType ElfSegments::GetElfType() const
+{
+    return _elfType;
+}
+
+uint16_t ElfSegments::GetObjectType() const
+{
+    return _objectType;
+}
+
+uint16_t ElfSegments::GetMachine() const
+{
+    return _machine;
+}
+
+uint64_t ElfSegments::GetEntry() const
+{
+    return _entry;
+}
+
+const std::vector<ElfSegment> &ElfSegments::GetSegments() const
+{
+    return _segments;
+}
+
+/**
+ * @brief Finds the first segment of the given type.
+ *
+ * @param type The program header type to look for.
+ * @return A pointer to the segment, or nullptr if the file has none.
+ */
+const ElfSegment *ElfSegments::FindSegment(ProgramHeaderType type) const
+{
+    for (const auto &segment : _segments)
+    {
+        if (segment.type == static_cast<uint32_t>(type))
+        {
+            return &segment;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Returns the file backed bytes of a segment.
+ *
+ * @param segment The segment to view.
+ * @return A span over the segment's p_filesz bytes.
+ * @throws std::runtime_error if the segment lies outside the file.
+ */
+std::span<const uint8_t> ElfSegments::GetSegmentData(const ElfSegment &segment) const
+{
+    return ReadRange(segment.offset, segment.filesz);
+}
+
+/**
+ * @brief Returns the bytes of a file range. Ranges inside the first page are served from the header read, anything
+ * else is read with pread and kept alive for as long as this object.
+ *
+ * @param offset The file offset of the first byte.
+ * @param size The number of bytes to read.
+ * @return A span over the requested bytes.
+ * @throws std::runtime_error if the range does not lie within the file.
+ */
+std::span<const uint8_t> ElfSegments::ReadRange(uint64_t offset, uint64_t size) const
+{
+    if (offset <= _headSize && size <= _headSize - offset)
+    {
+        return {_head.data() + offset, size};
+    }
+
+    // Only ranges outside the first page pay for the size check, which keeps corrupt headers from requesting
+    // arbitrarily large buffers
+    struct stat st{};
+    if (fstat(_fd, &st) != 0 || offset > static_cast<uint64_t>(st.st_size) ||
+        size > static_cast<uint64_t>(st.st_size) - offset)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Range 0x%lx+0x%lx exceeds file size of %s", offset, size,
+                  _fileName.c_str());
+    }
+
+    std::vector<uint8_t> &buffer = _buffers.emplace_back(size);
+    ssize_t bytesRead = pread(_fd, buffer.data(), size, static_cast<off_t>(offset));
+    if (bytesRead < 0 || static_cast<uint64_t>(bytesRead) != size)
+    {
+        _buffers.pop_back();
+        LOG_THROW(Logger::LogLevel::Error, "Incomplete read of range 0x%lx+0x%lx from %s", offset, size,
+                  _fileName.c_str());
+    }
+    return {buffer.data(), size};
+}
+
+/**
+ * @brief Translates a virtual address to a file offset using the PT_LOAD segments.
+ *
+ * @param vaddr The virtual address to translate.
+ * @return The file offset, or std::nullopt if the address is not backed by file contents.
+ */
+std::optional<uint64_t> ElfSegments::VirtualToFileOffset(uint64_t vaddr) const
+{
+    for (const auto &segment : _segments)
+    {
+        if (segment.type == static_cast<uint32_t>(ProgramHeaderType::PT_LOAD) && vaddr >= segment.vaddr &&
+            vaddr - segment.vaddr < segment.filesz)
+        {
+            return segment.offset + (vaddr - segment.vaddr);
+        }
+    }
+    return std::nullopt;
+}
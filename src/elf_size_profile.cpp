@@ -0,0 +1,596 @@
+#include "elf_size_profile.hpp"
+#include "dwarf_info.hpp"
+#include "elf_regions.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+// Label of the range bounding the file; bytes it owns are gaps
+constexpr uint32_t SIZE_GAP_LABEL = UINT32_MAX;
+
+// File extents of the ELF header and of the two header tables
+struct ElfHeaderExtents
+{
+    uint64_t headerSize;
+    uint64_t programHeaderOffset;
+    uint64_t programHeaderSize;
+    uint64_t sectionHeaderOffset;
+    uint64_t sectionHeaderSize;
+};
+
+/**
+ * @brief Reads the header table extents from the ELF header at the start of the mapping, which ElfHandler has
+ * already validated.
+ */
+template <typename ElfEhdr> static ElfHeaderExtents ReadHeaderExtents(const MappedFile &file)
+{
+    ElfEhdr header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    return {header.e_ehsize, header.e_phoff, uint64_t(header.e_phnum) * header.e_phentsize, header.e_shoff,
+            uint64_t(header.e_shnum) * header.e_shentsize};
+}
+
+/**
+ * @brief Returns the PT_LOAD segments of a file.
+ */
+static std::vector<ElfSegment> LoadSegments(const ElfSegments &segments)
+{
+    std::vector<ElfSegment> loads;
+    for (const ElfSegment &segment : segments.GetSegments())
+    {
+        if (segment.type == static_cast<uint32_t>(ProgramHeaderType::PT_LOAD))
+        {
+            loads.push_back(segment);
+        }
+    }
+    return loads;
+}
+
+/**
+ * @brief Adds a range of the file, and the virtual addresses the PT_LOAD segments map its bytes to.
+ */
+static void AddFileRange(std::vector<SizeRange> &fileRanges, std::vector<SizeRange> &vmRanges,
+                         const std::vector<ElfSegment> &loads, uint64_t offset, uint64_t size, uint32_t label)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    fileRanges.push_back({offset, offset + size, label});
+    for (const ElfSegment &load : loads)
+    {
+        uint64_t begin = std::max(offset, load.offset);
+        uint64_t end = std::min(offset + size, load.offset + load.filesz);
+        if (begin < end)
+        {
+            vmRanges.push_back({load.vaddr + (begin - load.offset), load.vaddr + (end - load.offset), label});
+        }
+    }
+}
+
+/**
+ * @brief Adds a range of virtual addresses, and the bytes of the file the PT_LOAD segments map to it. Addresses
+ * beyond the file part of a segment, such as those of .bss, have no file bytes.
+ */
+static void AddVirtualRange(std::vector<SizeRange> &fileRanges, std::vector<SizeRange> &vmRanges,
+                            const std::vector<ElfSegment> &loads, uint64_t address, uint64_t size, uint32_t label)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    vmRanges.push_back({address, address + size, label});
+    for (const ElfSegment &load : loads)
+    {
+        uint64_t begin = std::max(address, load.vaddr);
+        uint64_t end = std::min(address + size, load.vaddr + load.filesz);
+        if (begin < end)
+        {
+            fileRanges.push_back({load.offset + (begin - load.vaddr), load.offset + (end - load.vaddr), label});
+        }
+    }
+}
+
+/**
+ * @brief Splits a bounded space into pieces owned by a single range. Range boundaries are sorted once and swept in
+ * order while a heap keeps the ranges covering the sweep position, keyed by their position in the lists, so each
+ * piece goes to the earliest listed range covering it. Ranges leaving the sweep are only marked and dropped once
+ * they reach the top of the heap.
+ *
+ * @param ranges The ranges, earliest listed first.
+ * @param bounds The extent of the space. A piece no range covers is owned by its bound; pieces outside every bound
+ * are skipped, whatever covers them.
+ * @param attribute Called with the owner's index and the bounds of each piece, in increasing order. Indices past
+ * the end of ranges stand for bounds[index - ranges.size()].
+ */
+template <typename Fn>
+static void SweepRanges(const std::vector<SizeRange> &ranges, const std::vector<SizeRange> &bounds, Fn &&attribute)
+{
+    size_t count = ranges.size() + bounds.size();
+    auto getRange = [&](size_t index) -> const SizeRange & {
+        return index < ranges.size() ? ranges[index] : bounds[index - ranges.size()];
+    };
+
+    std::vector<std::pair<uint64_t, uint64_t>> events; // position, range index * 2 + 1 for the range end
+    events.reserve(count * 2);
+    for (size_t i = 0; i < count; i++)
+    {
+        const SizeRange &range = getRange(i);
+        if (range.begin < range.end)
+        {
+            events.push_back({range.begin, i * 2});
+            events.push_back({range.end, i * 2 + 1});
+        }
+    }
+    std::sort(events.begin(), events.end());
+
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> active;
+    std::vector<bool> ended(count, false);
+    size_t activeBounds = 0;
+    size_t next = 0;
+    while (next < events.size())
+    {
+        uint64_t position = events[next].first;
+        for (; next < events.size() && events[next].first == position; next++)
+        {
+            size_t index = events[next].second / 2;
+            bool end = events[next].second % 2 != 0;
+            if (end)
+            {
+                ended[index] = true;
+                activeBounds -= index >= ranges.size() ? 1 : 0;
+            }
+            else
+            {
+                active.push(index);
+                activeBounds += index >= ranges.size() ? 1 : 0;
+            }
+        }
+        while (!active.empty() && ended[active.top()])
+        {
+            active.pop();
+        }
+        if (activeBounds != 0 && next < events.size())
+        {
+            attribute(active.top(), position, events[next].first);
+        }
+    }
+}
+
+/**
+ * @brief Constructor for the ElfSizeProfile class. Collects the ranges of the dimension and of the fallbacks, then
+ * attributes the file and the mapped segments.
+ *
+ * @param elfHandler The parsed file.
+ * @param segments The program headers of the same file.
+ * @param dimension What the bytes are attributed to.
+ * @param pool The pool to read the compilation units on, or nullptr to read them on the calling thread.
+ */
+ElfSizeProfile::ElfSizeProfile(const ElfHandler &elfHandler, const ElfSegments &segments, SizeDimension dimension,
+                               ThreadPool *pool)
+    : _dimension(dimension)
+{
+    switch (dimension)
+    {
+    case SizeDimension::Sections:
+        break;
+    case SizeDimension::Segments:
+        AddSegments(segments);
+        break;
+    case SizeDimension::Symbols:
+        AddSymbols(elfHandler, segments);
+        break;
+    case SizeDimension::CompileUnits:
+        AddCompileUnits(elfHandler, segments, pool);
+        break;
+    }
+    AddSections(elfHandler, dimension != SizeDimension::Sections);
+    AddHeaders(elfHandler, segments);
+    Attribute(elfHandler, segments);
+}
+
+SizeDimension ElfSizeProfile::GetDimension() const
+{
+    return _dimension;
+}
+
+const std::vector<SizeProfileRow> &ElfSizeProfile::GetRows() const
+{
+    return _rows;
+}
+
+uint64_t ElfSizeProfile::GetFileSize() const
+{
+    uint64_t size = 0;
+    for (const auto &row : _rows)
+    {
+        size += row.fileSize;
+    }
+    return size;
+}
+
+uint64_t ElfSizeProfile::GetVmSize() const
+{
+    uint64_t size = 0;
+    for (const auto &row : _rows)
+    {
+        size += row.vmSize;
+    }
+    return size;
+}
+
+/**
+ * @brief Prints the largest rows with their share of the file and of the mapped segments, the remaining rows
+ * folded into one, and the totals.
+ *
+ * @param limit The number of rows to list before folding.
+ */
+void ElfSizeProfile::PrintProfile(size_t limit) const
+{
+    uint64_t fileTotal = GetFileSize();
+    uint64_t vmTotal = GetVmSize();
+    auto printRow = [&](uint64_t fileSize, uint64_t vmSize, const char *label) {
+        printf("%6.2f%% %12lu  %6.2f%% %12lu  %s\n", fileTotal == 0 ? 0.0 : 100.0 * fileSize / fileTotal, fileSize,
+               vmTotal == 0 ? 0.0 : 100.0 * vmSize / vmTotal, vmSize, label);
+    };
+
+    printf("%20s  %20s  %s\n", "FILE SIZE", "VM SIZE", SizeDimensionName(_dimension));
+    limit = std::min(limit, _rows.size());
+    for (size_t i = 0; i < limit; i++)
+    {
+        printRow(_rows[i].fileSize, _rows[i].vmSize, _rows[i].label.c_str());
+    }
+    if (limit < _rows.size())
+    {
+        uint64_t fileSize = 0;
+        uint64_t vmSize = 0;
+        for (size_t i = limit; i < _rows.size(); i++)
+        {
+            fileSize += _rows[i].fileSize;
+            vmSize += _rows[i].vmSize;
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "[%lu others]", _rows.size() - limit);
+        printRow(fileSize, vmSize, label);
+    }
+    printRow(fileTotal, vmTotal, "TOTAL");
+}
+
+/**
+ * @brief Returns the index of a label in _rows, adding an empty row the first time it is seen.
+ */
+uint32_t ElfSizeProfile::Label(const std::string &label)
+{
+    auto [entry, added] = _labels.try_emplace(label, static_cast<uint32_t>(_rows.size()));
+    if (added)
+    {
+        _rows.push_back({label, 0, 0});
+    }
+    return entry->second;
+}
+
+/**
+ * @brief Adds the PT_LOAD segments, named by SegmentNames like in the other reports.
+ */
+void ElfSizeProfile::AddSegments(const ElfSegments &segments)
+{
+    const std::vector<ElfSegment> &headers = segments.GetSegments();
+    std::vector<std::string> names = SegmentNames(headers);
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        if (headers[i].type != static_cast<uint32_t>(ProgramHeaderType::PT_LOAD))
+        {
+            continue;
+        }
+        uint32_t label = Label(names[i]);
+        _fileRanges.push_back({headers[i].offset, headers[i].offset + headers[i].filesz, label});
+        _vmRanges.push_back({headers[i].vaddr, headers[i].vaddr + headers[i].memsz, label});
+    }
+}
+
+/**
+ * @brief Adds the sized function and object symbols of .symtab, or of .dynsym when .symtab is missing. Symbols are
+ * ordered by address, so a symbol nested in an earlier one adds nothing; of aliases covering the same range, the
+ * global one is added first. Thread-local symbols are left to their section, their values are not addresses.
+ */
+void ElfSizeProfile::AddSymbols(const ElfHandler &elfHandler, const ElfSegments &segments)
+{
+    std::vector<ElfSymbol> symbols = elfHandler.GetSymbols();
+    if (symbols.empty())
+    {
+        symbols = elfHandler.GetDynamicSymbols();
+    }
+    std::erase_if(symbols, [](const ElfSymbol &symbol) {
+        return symbol.size == 0 || symbol.sectionIndex == SHN_UNDEF || symbol.sectionIndex >= SHN_LORESERVE ||
+               (symbol.type != SymbolType::STT_FUNC && symbol.type != SymbolType::STT_OBJECT &&
+                symbol.type != SymbolType::STT_GNU_IFUNC);
+    });
+    if (symbols.empty())
+    {
+        LOG(Logger::LogLevel::Warning, "No sized symbols in %s, attributing by section",
+            elfHandler.GetFileName().c_str());
+        return;
+    }
+
+    auto bindingRank = [](SymbolBinding binding) {
+        return binding == SymbolBinding::STB_GLOBAL ? 0 : binding == SymbolBinding::STB_WEAK ? 1 : 2;
+    };
+    std::sort(symbols.begin(), symbols.end(), [&](const ElfSymbol &a, const ElfSymbol &b) {
+        if (a.sectionIndex != b.sectionIndex)
+            return a.sectionIndex < b.sectionIndex;
+        if (a.value != b.value)
+            return a.value < b.value;
+        if (a.size != b.size)
+            return a.size > b.size;
+        return bindingRank(a.binding) < bindingRank(b.binding);
+    });
+
+    std::vector<const ElfSection *> sectionsByIndex;
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        if (section.index >= sectionsByIndex.size())
+        {
+            sectionsByIndex.resize(section.index + 1, nullptr);
+        }
+        sectionsByIndex[section.index] = &section;
+    }
+
+    // Symbol values of relocatable files are offsets into their section, which is not mapped anywhere
+    bool relocatable = segments.GetObjectType() == static_cast<uint16_t>(ElfObjectType::ET_REL);
+    for (const ElfSymbol &symbol : symbols)
+    {
+        const ElfSection *section =
+            symbol.sectionIndex < sectionsByIndex.size() ? sectionsByIndex[symbol.sectionIndex] : nullptr;
+        if (section == nullptr)
+        {
+            continue;
+        }
+        uint64_t offset = relocatable ? symbol.value : symbol.value - section->addr;
+        if (offset >= section->size)
+        {
+            continue;
+        }
+        uint64_t size = std::min(symbol.size, section->size - offset);
+        uint32_t label = Label(symbol.name);
+        if (section->type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+        {
+            _fileRanges.push_back({section->offset + offset, section->offset + offset + size, label});
+        }
+        if (!relocatable && (section->flags & SectionHeaderFlags::SHF_ALLOC) != 0)
+        {
+            _vmRanges.push_back({symbol.value, symbol.value + size, label});
+        }
+    }
+}
+
+/**
+ * @brief Adds the address ranges of every DWARF compilation unit, named after the unit's DW_AT_name. Units are read
+ * as separate pool tasks when given a pool; a unit DIE without ranges falls back to the ranges of its subprograms.
+ */
+void ElfSizeProfile::AddCompileUnits(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool)
+{
+    DwarfSections sections = LoadDwarfSections(elfHandler, pool);
+    if (sections.info.empty())
+    {
+        LOG(Logger::LogLevel::Warning, "No DWARF units in %s, attributing by section",
+            elfHandler.GetFileName().c_str());
+        return;
+    }
+
+    std::vector<DwarfUnitHeader> headers = ReadUnitHeaders(sections.info);
+    std::vector<std::string> names(headers.size());
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> unitRanges(headers.size());
+    auto readUnit = [&](size_t i) {
+        try
+        {
+            DwarfAbbrevTable abbrevs(sections.abbrev, headers[i].abbrevOffset);
+            DwarfUnit unit(sections, headers[i], abbrevs);
+            names[i] = unit.GetName();
+
+            auto ranges = unit.GetRanges(unit.GetUnitDie());
+            if (ranges.empty() && unit.GetUnitDie().HasChildren())
+            {
+                DwarfReader reader(sections.info.subspan(0, headers[i].endOffset), headers[i].dieOffset);
+                DwarfDie die{};
+                unit.ReadDie(reader, die);
+                while (!reader.AtEnd())
+                {
+                    if (unit.ReadDie(reader, die) && die.GetTag() == DW_TAG_subprogram)
+                    {
+                        auto functionRanges = unit.GetRanges(die);
+                        ranges.insert(ranges.end(), functionRanges.begin(), functionRanges.end());
+                    }
+                }
+            }
+            unitRanges[i] = std::move(ranges);
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Skipping ranges of DWARF unit at 0x%lx", headers[i].offset);
+        }
+    };
+    if (pool == nullptr)
+    {
+        for (size_t i = 0; i < headers.size(); i++)
+        {
+            readUnit(i);
+        }
+    }
+    else
+    {
+        TaskGroup group(*pool);
+        for (size_t i = 0; i < headers.size(); i++)
+        {
+            group.Submit([&readUnit, i]() { readUnit(i); });
+        }
+        group.Wait();
+    }
+
+    std::vector<ElfSegment> loads = LoadSegments(segments);
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        if (unitRanges[i].empty())
+        {
+            continue;
+        }
+        char fallback[32];
+        snprintf(fallback, sizeof(fallback), "[unit 0x%lx]", headers[i].offset);
+        uint32_t label = Label(names[i].empty() ? fallback : names[i]);
+        for (const auto &[low, high] : unitRanges[i])
+        {
+            // Ranges of discarded code are left at 0
+            if (low != 0 && low < high)
+            {
+                AddVirtualRange(_fileRanges, _vmRanges, loads, low, high - low, label);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds every section with contents in the file or in memory. Thread-local .tbss takes no room in the
+ * segments and overlaps the sections after it, so it adds nothing.
+ *
+ * @param bracketed Whether the labels are the section names in brackets, marking bytes the dimension left over.
+ */
+void ElfSizeProfile::AddSections(const ElfHandler &elfHandler, bool bracketed)
+{
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        bool noBits = section.type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS);
+        bool mapped = (section.flags & SectionHeaderFlags::SHF_ALLOC) != 0 &&
+                      (!noBits || (section.flags & SectionHeaderFlags::SHF_TLS) == 0);
+        if (section.size == 0 || (noBits && !mapped))
+        {
+            continue;
+        }
+        uint32_t label = Label(bracketed ? "[" + section.name + "]" : section.name);
+        if (!noBits)
+        {
+            _fileRanges.push_back({section.offset, section.offset + section.size, label});
+        }
+        if (mapped)
+        {
+            _vmRanges.push_back({section.addr, section.addr + section.size, label});
+        }
+    }
+}
+
+/**
+ * @brief Adds the ELF header and the program and section header tables, along with the addresses they are mapped
+ * at when a PT_LOAD segment covers them.
+ */
+void ElfSizeProfile::AddHeaders(const ElfHandler &elfHandler, const ElfSegments &segments)
+{
+    const MappedFile &file = elfHandler.GetFile();
+    ElfHeaderExtents extents = elfHandler.GetElfType() == ElfType::ELF_32 ? ReadHeaderExtents<Elf32Ehdr>(file)
+                                                                           : ReadHeaderExtents<Elf64Ehdr>(file);
+    std::vector<ElfSegment> loads = LoadSegments(segments);
+    AddFileRange(_fileRanges, _vmRanges, loads, 0, extents.headerSize, Label("[ELF Header]"));
+    if (extents.programHeaderOffset != 0)
+    {
+        AddFileRange(_fileRanges, _vmRanges, loads, extents.programHeaderOffset, extents.programHeaderSize,
+                     Label("[Program Headers]"));
+    }
+    if (extents.sectionHeaderOffset != 0)
+    {
+        AddFileRange(_fileRanges, _vmRanges, loads, extents.sectionHeaderOffset, extents.sectionHeaderSize,
+                     Label("[Section Headers]"));
+    }
+}
+
+/**
+ * @brief Sweeps the file, then the PT_LOAD segments, and adds each piece to the row of its owner. Gaps are told
+ * apart by the bytes they hold; in memory, the part of a segment beyond its file bytes is zero filled.
+ */
+void ElfSizeProfile::Attribute(const ElfHandler &elfHandler, const ElfSegments &segments)
+{
+    const MappedFile &file = elfHandler.GetFile();
+    const uint8_t *data = file.Data();
+    auto isZero = [data](uint64_t begin, uint64_t end) {
+        return std::all_of(data + begin, data + end, [](uint8_t byte) { return byte == 0; });
+    };
+    uint32_t padding = Label("[Padding]");
+    uint32_t unattributed = Label("[Unattributed]");
+
+    std::vector<SizeRange> bounds = {{0, file.Size(), SIZE_GAP_LABEL}};
+    SweepRanges(_fileRanges, bounds, [&](size_t owner, uint64_t begin, uint64_t end) {
+        uint32_t label = owner < _fileRanges.size() ? _fileRanges[owner].label
+                         : isZero(begin, end)       ? padding
+                                                    : unattributed;
+        _rows[label].fileSize += end - begin;
+    });
+
+    // Bounds of the image carry the index of their segment in loads
+    std::vector<ElfSegment> loads = LoadSegments(segments);
+    bounds.clear();
+    for (uint32_t i = 0; i < loads.size(); i++)
+    {
+        bounds.push_back({loads[i].vaddr, loads[i].vaddr + loads[i].memsz, i});
+    }
+    SweepRanges(_vmRanges, bounds, [&](size_t owner, uint64_t begin, uint64_t end) {
+        uint32_t label = padding;
+        if (owner < _vmRanges.size())
+        {
+            label = _vmRanges[owner].label;
+        }
+        else
+        {
+            const ElfSegment &load = loads[bounds[owner - _vmRanges.size()].label];
+            uint64_t fileEnd = std::min(end, load.vaddr + load.filesz);
+            if (begin < fileEnd && load.offset + (fileEnd - load.vaddr) <= file.Size() &&
+                !isZero(load.offset + (begin - load.vaddr), load.offset + (fileEnd - load.vaddr)))
+            {
+                label = unattributed;
+            }
+        }
+        _rows[label].vmSize += end - begin;
+    });
+
+    std::erase_if(_rows, [](const SizeProfileRow &row) { return row.fileSize == 0 && row.vmSize == 0; });
+    std::sort(_rows.begin(), _rows.end(), [](const SizeProfileRow &a, const SizeProfileRow &b) {
+        if (a.fileSize != b.fileSize)
+            return a.fileSize > b.fileSize;
+        if (a.vmSize != b.vmSize)
+            return a.vmSize > b.vmSize;
+        return a.label < b.label;
+    });
+    _labels.clear();
+    _fileRanges.clear();
+    _vmRanges.clear();
+}
+
+/**
+ * @brief Parses a dimension name as given on the command line.
+ *
+ * @return The dimension, or std::nullopt if the name is not one of sections, segments, symbols and units.
+ */
+std::optional<SizeDimension> ParseSizeDimension(const std::string &name)
+{
+    if (name == "sections")
+        return SizeDimension::Sections;
+    if (name == "segments")
+        return SizeDimension::Segments;
+    if (name == "symbols")
+        return SizeDimension::Symbols;
+    if (name == "units")
+        return SizeDimension::CompileUnits;
+    return std::nullopt;
+}
+
+const char *SizeDimensionName(SizeDimension dimension)
+{
+    switch (dimension)
+    {
+    case SizeDimension::Sections:
+        return "sections";
+    case SizeDimension::Segments:
+        return "segments";
+    case SizeDimension::Symbols:
+        return "symbols";
+    case SizeDimension::CompileUnits:
+        return "units";
+    }
+    return "unknown";
+}
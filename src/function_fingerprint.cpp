@@ -0,0 +1,184 @@
+#include "function_fingerprint.hpp"
+#include "x86_decoder.hpp"
+#include <algorithm>
+
+// FNV-1a, for the few bytes of one normalised instruction
+constexpr uint64_t FINGERPRINT_FNV_OFFSET = 0xcbf29ce484222325;
+constexpr uint64_t FINGERPRINT_FNV_PRIME = 0x100000001b3;
+
+/**
+ * @brief splitmix64 finaliser, spreading every input bit over the whole word.
+ */
+static constexpr uint64_t MixBits(uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+    return value ^ (value >> 31);
+}
+
+// Hash function k of the signature maps a shingle x to the high half of a[k] * x + b[k]. The constants are drawn
+// from a fixed splitmix64 sequence so signatures computed by different runs can be compared.
+struct MinHashFunctions
+{
+    std::array<uint64_t, MINHASH_SIZE> multipliers; // Odd
+    std::array<uint64_t, MINHASH_SIZE> increments;
+};
+
+static constexpr MinHashFunctions BuildMinHashFunctions()
+{
+    MinHashFunctions functions{};
+    uint64_t state = 0x45584550534d4831; // "EXEPSMH1"
+    for (size_t k = 0; k < MINHASH_SIZE; k++)
+    {
+        state += 0x9e3779b97f4a7c15;
+        functions.multipliers[k] = MixBits(state) | 1;
+        state += 0x9e3779b97f4a7c15;
+        functions.increments[k] = MixBits(state);
+    }
+    return functions;
+}
+
+static constexpr MinHashFunctions MINHASH_FUNCTIONS = BuildMinHashFunctions();
+
+/**
+ * @brief Computes the MinHash signature of a function body. Each instruction is normalised to its prefixes, opcode,
+ * ModRM and SIB bytes plus the number of displacement and immediate bytes that follow, whose values are dropped:
+ * those hold branch targets, RIP-relative addresses, stack offsets and constants, everything a relocation or a
+ * different link layout changes. Runs of FINGERPRINT_NGRAM_SIZE normalised instructions are hashed into shingles,
+ * and the signature keeps the minimum of every hash function over the shingles. Bytes that do not decode are
+ * skipped one at a time.
+ *
+ * @param code The function body.
+ * @param signature Receives the signature.
+ * @param instructionCount Receives the number of instructions decoded.
+ * @return false if the body has fewer than FINGERPRINT_MIN_INSTRUCTIONS instructions, leaving signature unset.
+ */
+bool ComputeFunctionSignature(std::span<const uint8_t> code, MinHashSignature &signature, uint32_t &instructionCount)
+{
+    std::array<uint64_t, FINGERPRINT_NGRAM_SIZE> window{};
+    std::array<uint64_t, MINHASH_SIZE> minima;
+    minima.fill(UINT64_MAX);
+    instructionCount = 0;
+
+    size_t offset = 0;
+    while (offset < code.size())
+    {
+        X86Instruction instruction;
+        if (!DecodeX86Instruction(code.subspan(offset), instruction))
+        {
+            offset++;
+            continue;
+        }
+        uint64_t token = FINGERPRINT_FNV_OFFSET;
+        for (size_t i = 0; i < instruction.operandOffset; i++)
+        {
+            token = (token ^ code[offset + i]) * FINGERPRINT_FNV_PRIME;
+        }
+        token = (token ^ (0x100 | (instruction.length - instruction.operandOffset))) * FINGERPRINT_FNV_PRIME;
+        offset += instruction.length;
+
+        window[instructionCount % FINGERPRINT_NGRAM_SIZE] = token;
+        instructionCount++;
+        if (instructionCount < FINGERPRINT_NGRAM_SIZE)
+        {
+            continue;
+        }
+
+        // Oldest instruction first, so the shingle depends on the order of the instructions
+        uint64_t shingle = 0;
+        for (size_t i = 0; i < FINGERPRINT_NGRAM_SIZE; i++)
+        {
+            shingle = MixBits(shingle ^ window[(instructionCount + i) % FINGERPRINT_NGRAM_SIZE]);
+        }
+        for (size_t k = 0; k < MINHASH_SIZE; k++)
+        {
+            uint64_t hash = MINHASH_FUNCTIONS.multipliers[k] * shingle + MINHASH_FUNCTIONS.increments[k];
+            minima[k] = std::min(minima[k], hash);
+        }
+    }
+
+    if (instructionCount < FINGERPRINT_MIN_INSTRUCTIONS)
+    {
+        return false;
+    }
+    for (size_t k = 0; k < MINHASH_SIZE; k++)
+    {
+        signature[k] = static_cast<uint32_t>(minima[k] >> 32);
+    }
+    return true;
+}
+
+/**
+ * @brief Fingerprints every function long enough to be worth it. Functions are cut into batches of
+ * CODE_FUNCTION_BATCH_SIZE bytes, each fingerprinted on its own and the results concatenated in batch order.
+ *
+ * @param functions The functions of an x86-64 file.
+ * @param pool The pool to spread the batches over, or nullptr to fingerprint on the calling thread.
+ * @return The fingerprints, in function order.
+ */
+std::vector<FunctionFingerprint> FingerprintFunctions(const CodeFunctions &functions, ThreadPool *pool)
+{
+    const std::vector<CodeFunction> &list = functions.GetFunctions();
+    std::vector<std::pair<uint32_t, uint32_t>> batches;
+    uint64_t batchBytes = 0;
+    for (uint32_t i = 0; i < list.size(); i++)
+    {
+        if (batches.empty() || batchBytes >= CODE_FUNCTION_BATCH_SIZE)
+        {
+            batches.push_back({i, i});
+            batchBytes = 0;
+        }
+        batches.back().second = i + 1;
+        batchBytes += list[i].size;
+    }
+
+    std::vector<std::vector<FunctionFingerprint>> results(batches.size());
+    auto fingerprintBatch = [&](size_t batch) {
+        for (uint32_t i = batches[batch].first; i < batches[batch].second; i++)
+        {
+            FunctionFingerprint fingerprint{i, 0, {}};
+            if (ComputeFunctionSignature(functions.GetCode(list[i]), fingerprint.signature,
+                                         fingerprint.instructionCount))
+            {
+                results[batch].push_back(fingerprint);
+            }
+        }
+    };
+    if (pool == nullptr)
+    {
+        for (size_t batch = 0; batch < batches.size(); batch++)
+        {
+            fingerprintBatch(batch);
+        }
+    }
+    else
+    {
+        TaskGroup group(*pool);
+        for (size_t batch = 0; batch < batches.size(); batch++)
+        {
+            group.Submit([&fingerprintBatch, batch]() { fingerprintBatch(batch); });
+        }
+        group.Wait();
+    }
+
+    std::vector<FunctionFingerprint> fingerprints;
+    for (const auto &result : results)
+    {
+        fingerprints.insert(fingerprints.end(), result.begin(), result.end());
+    }
+    return fingerprints;
+}
+
+/**
+ * @brief Estimates the Jaccard similarity of the shingle sets behind two signatures, the fraction of hash functions
+ * whose minima agree.
+ */
+double EstimateSimilarity(const MinHashSignature &a, const MinHashSignature &b)
+{
+    size_t equal = 0;
+    for (size_t k = 0; k < MINHASH_SIZE; k++)
+    {
+        equal += a[k] == b[k] ? 1 : 0;
+    }
+    return static_cast<double>(equal) / MINHASH_SIZE;
+}
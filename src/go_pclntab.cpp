@@ -0,0 +1,381 @@
+#include "go_pclntab.hpp"
+#include "logger.hpp"
+#include <cstring>
+
+// Size of the magic, the two zero bytes, the pc quantum and the pointer size that start the table header
+constexpr uint64_t GO_PCLNTAB_HEADER_PREFIX = 8;
+
+// 32-bit fields of _func after its first, entry, field, counted from 1 as in debug/gosym
+constexpr uint32_t GO_FUNC_NAME_OFFSET = 1;
+constexpr uint32_t GO_FUNC_PCFILE = 5;
+constexpr uint32_t GO_FUNC_PCLN = 6;
+constexpr uint32_t GO_FUNC_CU_OFFSET = 8;
+constexpr uint32_t GO_FUNC_FIELD_COUNT = 9;
+
+/**
+ * @brief Reads a little-endian value of 1 to 8 bytes, failing rather than reading past the end of the data.
+ */
+static bool ReadValue(std::span<const uint8_t> data, uint64_t offset, uint64_t size, uint64_t &value)
+{
+    if (offset > data.size() || size > data.size() - offset)
+    {
+        return false;
+    }
+    value = 0;
+    memcpy(&value, data.data() + offset, size);
+    return true;
+}
+
+/**
+ * @brief Reads a Go uvarint, the same encoding as ULEB128, advancing the offset past it.
+ */
+static bool ReadVarint(std::span<const uint8_t> data, uint64_t &offset, uint32_t &value)
+{
+    value = 0;
+    for (unsigned shift = 0; offset < data.size(); shift += 7)
+    {
+        uint8_t byte = data[offset++];
+        if (shift < 32)
+        {
+            value |= uint32_t(byte & 0x7f) << shift;
+        }
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns the NUL terminated string at an offset, or an empty view if it is out of bounds or unterminated.
+ */
+static std::string_view ReadString(std::span<const uint8_t> data, uint64_t offset)
+{
+    if (offset >= data.size())
+    {
+        return {};
+    }
+    const char *start = reinterpret_cast<const char *>(data.data() + offset);
+    size_t length = strnlen(start, data.size() - offset);
+    return length == data.size() - offset ? std::string_view() : std::string_view(start, length);
+}
+
+/**
+ * @brief Constructor for the GoPclnTable class. Finds the table and checks its header and function table bounds;
+ * files without one get an empty table.
+ *
+ * @details Internally linked binaries keep the table in its own section, .gopclntab or, when position independent,
+ * .data.rel.ro.gopclntab. Externally linked position independent binaries merge it into .data.rel.ro, which is
+ * then searched for a valid header, but only in files carrying a Go build-id note or build information.
+ *
+ * @param elfHandler The parsed file, which must outlive the table.
+ */
+GoPclnTable::GoPclnTable(const ElfHandler &elfHandler)
+{
+    const ElfSection *text = elfHandler.FindSection(".text");
+    uint64_t textAddress = text != nullptr ? text->addr : 0;
+    for (const char *name : {".gopclntab", ".data.rel.ro.gopclntab"})
+    {
+        if (const ElfSection *section = elfHandler.FindSection(name))
+        {
+            if (!Load(elfHandler.GetSectionData(*section), textAddress))
+            {
+                LOG(Logger::LogLevel::Warning, "Unrecognised Go pclntab in %s", name);
+            }
+            return;
+        }
+    }
+
+    if (elfHandler.FindSection(".go.buildinfo") == nullptr && elfHandler.FindSection(".note.go.buildid") == nullptr)
+    {
+        return;
+    }
+    const ElfSection *section = elfHandler.FindSection(".data.rel.ro");
+    if (section == nullptr)
+    {
+        return;
+    }
+    std::span<const uint8_t> data = elfHandler.GetSectionData(*section);
+    for (uint64_t offset = 0; offset + GO_PCLNTAB_HEADER_PREFIX <= data.size(); offset += 4)
+    {
+        uint64_t magic = 0;
+        ReadValue(data, offset, 4, magic);
+        if ((magic == GO_PCLNTAB_MAGIC_12 || magic == GO_PCLNTAB_MAGIC_116 || magic == GO_PCLNTAB_MAGIC_118 ||
+             magic == GO_PCLNTAB_MAGIC_120) &&
+            Load(data.subspan(offset), textAddress))
+        {
+            LOG(Logger::LogLevel::Debug, "Found Go pclntab at offset 0x%lx of .data.rel.ro", offset);
+            return;
+        }
+    }
+}
+
+GoPclnVersion GoPclnTable::GetVersion() const
+{
+    return _version;
+}
+
+size_t GoPclnTable::GetFunctionCount() const
+{
+    return _functionCount;
+}
+
+/**
+ * @brief Finds the function containing an address.
+ *
+ * @param address The address to look up.
+ * @return The function, or std::nullopt if the address is outside every function or its record is corrupt.
+ */
+std::optional<GoFunction> GoPclnTable::FindFunction(uint64_t address) const
+{
+    if (_functionCount == 0 || address < EntryAt(0) || address >= EntryAt(_functionCount))
+    {
+        return std::nullopt;
+    }
+
+    // Last function whose entry is at or before the address
+    uint64_t low = 0;
+    uint64_t high = _functionCount;
+    while (high - low > 1)
+    {
+        uint64_t middle = low + (high - low) / 2;
+        if (EntryAt(middle) <= address)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    uint64_t dataOffset = 0;
+    ReadValue(_functionTable, (2 * low + 1) * FieldSize(), FieldSize(), dataOffset);
+    uint64_t entrySize = _version >= GoPclnVersion::Go118 ? 4 : _pointerSize;
+    if (dataOffset > _functionData.size() || entrySize + GO_FUNC_FIELD_COUNT * 4 > _functionData.size() - dataOffset)
+    {
+        return std::nullopt;
+    }
+    return GoFunction{EntryAt(low), EntryAt(low + 1),
+                      ReadString(_functionNames, FunctionField(dataOffset, GO_FUNC_NAME_OFFSET)), dataOffset};
+}
+
+/**
+ * @brief Resolves an address of a function to its source file and line, decoding the function's file and line
+ * pc-value tables up to the address.
+ *
+ * @param function The function containing the address, as returned by FindFunction.
+ * @param address The address to resolve.
+ * @return The location, or std::nullopt if the tables do not cover the address.
+ */
+std::optional<GoSourceLocation> GoPclnTable::FindLocation(const GoFunction &function, uint64_t address) const
+{
+    auto fileIndex = PcValue(FunctionField(function.dataOffset, GO_FUNC_PCFILE), function.entry, address);
+    auto line = PcValue(FunctionField(function.dataOffset, GO_FUNC_PCLN), function.entry, address);
+    if (!fileIndex || !line || *fileIndex < 0 || *line < 0)
+    {
+        return std::nullopt;
+    }
+
+    // Go 1.2 numbers the files of the whole table, later versions the files of the function's compile unit
+    std::string_view fileName;
+    uint64_t nameOffset = 0;
+    if (_version == GoPclnVersion::Go12)
+    {
+        if (*fileIndex > 0 && ReadValue(_files, uint64_t(*fileIndex) * 4, 4, nameOffset))
+        {
+            fileName = ReadString(_table, nameOffset);
+        }
+    }
+    else
+    {
+        uint64_t unit = FunctionField(function.dataOffset, GO_FUNC_CU_OFFSET);
+        if (ReadValue(_compileUnits, (unit + uint64_t(*fileIndex)) * 4, 4, nameOffset) && nameOffset != UINT32_MAX)
+        {
+            fileName = ReadString(_files, nameOffset);
+        }
+    }
+    return GoSourceLocation{fileName, static_cast<uint32_t>(*line)};
+}
+
+/**
+ * @brief Parses the table header, following debug/gosym's parsePclnTab.
+ *
+ * @param table The table, header first. It may extend past the end of the table.
+ * @param textAddress Address of .text, the base of the entry offsets when the header's own is zero, as it is on
+ * disk in position independent files where a dynamic relocation fills it in.
+ * @return true if the header is valid and the function table fits.
+ */
+bool GoPclnTable::Load(std::span<const uint8_t> table, uint64_t textAddress)
+{
+    uint64_t magic = 0;
+    if (!ReadValue(table, 0, 4, magic) || table.size() < GO_PCLNTAB_HEADER_PREFIX || table[4] != 0 || table[5] != 0 ||
+        (table[6] != 1 && table[6] != 2 && table[6] != 4) || (table[7] != 4 && table[7] != 8))
+    {
+        return false;
+    }
+    GoPclnVersion version = GoPclnVersion::None;
+    switch (magic)
+    {
+    case GO_PCLNTAB_MAGIC_12:
+        version = GoPclnVersion::Go12;
+        break;
+    case GO_PCLNTAB_MAGIC_116:
+        version = GoPclnVersion::Go116;
+        break;
+    case GO_PCLNTAB_MAGIC_118:
+        version = GoPclnVersion::Go118;
+        break;
+    case GO_PCLNTAB_MAGIC_120:
+        version = GoPclnVersion::Go120;
+        break;
+    default:
+        return false;
+    }
+    _version = version;
+    _quantum = table[6];
+    _pointerSize = table[7];
+    _table = table;
+
+    // Header words after the prefix; from Go 1.16 on most are offsets of the subtables from the table start
+    bool valid = true;
+    auto word = [&](uint32_t index) {
+        uint64_t value = 0;
+        valid = ReadValue(table, GO_PCLNTAB_HEADER_PREFIX + index * _pointerSize, _pointerSize, value) && valid;
+        return value;
+    };
+    auto subtable = [&](uint32_t index) {
+        uint64_t offset = word(index);
+        valid = offset <= table.size() && valid;
+        return valid ? table.subspan(offset) : std::span<const uint8_t>();
+    };
+
+    _functionCount = word(0);
+    switch (version)
+    {
+    case GoPclnVersion::Go118:
+    case GoPclnVersion::Go120:
+        _textStart = word(2) != 0 ? word(2) : textAddress;
+        _functionNames = subtable(3);
+        _compileUnits = subtable(4);
+        _files = subtable(5);
+        _pcTables = subtable(6);
+        _functionData = subtable(7);
+        _functionTable = _functionData;
+        break;
+    case GoPclnVersion::Go116:
+        _functionNames = subtable(2);
+        _compileUnits = subtable(3);
+        _files = subtable(4);
+        _pcTables = subtable(5);
+        _functionData = subtable(6);
+        _functionTable = _functionData;
+        break;
+    default:
+        _functionNames = table;
+        _pcTables = table;
+        _functionData = table;
+        _functionTable = table.subspan(std::min<uint64_t>(table.size(), GO_PCLNTAB_HEADER_PREFIX + _pointerSize));
+        break;
+    }
+
+    // The function table holds an entry and a _func offset per function, then the end of the last function
+    uint64_t tableSize = (2 * _functionCount + 1) * FieldSize();
+    if (!valid || _functionCount == 0 || _functionCount > _functionTable.size() / (2 * FieldSize()) ||
+        tableSize > _functionTable.size() || EntryAt(0) > EntryAt(_functionCount))
+    {
+        _version = GoPclnVersion::None;
+        _functionCount = 0;
+        return false;
+    }
+    if (version == GoPclnVersion::Go12)
+    {
+        // The file table offset follows the function table; its first word is the number of files
+        uint64_t fileOffset = 0;
+        uint64_t fileCount = 0;
+        if (ReadValue(_functionTable, tableSize, 4, fileOffset) && ReadValue(table, fileOffset, 4, fileCount) &&
+            fileCount <= (table.size() - fileOffset) / 4)
+        {
+            _files = table.subspan(fileOffset, fileCount * 4);
+        }
+    }
+    _functionTable = _functionTable.first(tableSize);
+    LOG(Logger::LogLevel::Debug, "Go pclntab: %s layout, %lu functions", GoPclnVersionName(_version), _functionCount);
+    return true;
+}
+
+/**
+ * @brief Size of the function table fields: pointers before Go 1.18, 32-bit offsets after.
+ */
+uint64_t GoPclnTable::FieldSize() const
+{
+    return _version >= GoPclnVersion::Go118 ? 4 : _pointerSize;
+}
+
+/**
+ * @brief Returns the entry of a function of the function table, or the end of the last one for _functionCount.
+ */
+uint64_t GoPclnTable::EntryAt(uint64_t index) const
+{
+    uint64_t entry = 0;
+    ReadValue(_functionTable, 2 * index * FieldSize(), FieldSize(), entry);
+    return _version >= GoPclnVersion::Go118 ? _textStart + entry : entry;
+}
+
+/**
+ * @brief Reads a 32-bit field of a _func record whose bounds FindFunction checked.
+ */
+uint32_t GoPclnTable::FunctionField(uint64_t dataOffset, uint32_t field) const
+{
+    uint64_t entrySize = _version >= GoPclnVersion::Go118 ? 4 : _pointerSize;
+    uint64_t value = 0;
+    ReadValue(_functionData, dataOffset + entrySize + (field - 1) * 4, 4, value);
+    return static_cast<uint32_t>(value);
+}
+
+/**
+ * @brief Decodes a pc-value table up to an address. Each step holds a zig-zag encoded value delta and a pc delta in
+ * quanta, the value applying up to the new pc; a zero value delta after the first step ends the table.
+ *
+ * @param tableOffset Offset of the table in the pc-value tables.
+ * @param entry Entry of the function, where the table starts.
+ * @param address The address whose value is wanted.
+ * @return The value at the address, or std::nullopt if the table ends before it or is corrupt.
+ */
+std::optional<int32_t> GoPclnTable::PcValue(uint32_t tableOffset, uint64_t entry, uint64_t address) const
+{
+    uint64_t offset = tableOffset;
+    uint64_t pc = entry;
+    int32_t value = -1;
+    for (bool first = true;; first = false)
+    {
+        uint32_t valueDelta = 0;
+        uint32_t pcDelta = 0;
+        if (tableOffset == 0 || !ReadVarint(_pcTables, offset, valueDelta) || (valueDelta == 0 && !first) ||
+            !ReadVarint(_pcTables, offset, pcDelta))
+        {
+            return std::nullopt;
+        }
+        value += static_cast<int32_t>((valueDelta & 1) != 0 ? ~(valueDelta >> 1) : valueDelta >> 1);
+        pc += uint64_t(pcDelta) * _quantum;
+        if (address < pc)
+        {
+            return value;
+        }
+    }
+}
+
+const char *GoPclnVersionName(GoPclnVersion version)
+{
+    switch (version)
+    {
+    case GoPclnVersion::None:
+        return "none";
+    case GoPclnVersion::Go12:
+        return "Go 1.2";
+    case GoPclnVersion::Go116:
+        return "Go 1.16";
+    case GoPclnVersion::Go118:
+        return "Go 1.18";
+    case GoPclnVersion::Go120:
+        return "Go 1.20";
+    }
+    return "unknown";
+}
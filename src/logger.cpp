@@ -20,6 +20,11 @@ void Logger::InitializeLogFile(const std::string& logFilePath) {
     }
 }
 
+void Logger::SetConsoleLevel(LogLevel level) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    consoleLevel = level;
+}
+
 std::runtime_error Logger::Log(LogLevel level, const char* format, const std::source_location location, ...) {
     va_list args;
     va_start(args, location);
@@ -46,6 +51,7 @@ void Logger::outputLog(LogLevel level, const std::string& message, const std::so
     };
 
     const auto& [levelStr, colorCode, stream] = logLevelMap.at(level);
+    std::lock_guard<std::mutex> lock(logMutex);
 
     if (logDict.find(location) == logDict.end()) {
         logDict[location] = logDict.size() + 1;
@@ -56,7 +62,9 @@ void Logger::outputLog(LogLevel level, const std::string& message, const std::so
     logStream << colorCode << "[" << std::hex << std::setw(4) << std::setfill('0') << logDictIndex << "] "
               << levelStr << "\033[0m: " << message;
 
-    fprintf(stream, "%s\n", logStream.str().c_str());
+    if (level >= consoleLevel) {
+        fprintf(stream, "%s\n", logStream.str().c_str());
+    }
 
     if (logFile.is_open()) {
         logFile << "[" << location.file_name() << ":" << location.function_name() << ":" << location.line() << "] "
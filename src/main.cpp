@@ -1,20 +1,545 @@
+#include "batch_scan.hpp"
+#include "call_frame.hpp"
+#include "call_graph.hpp"
+#include "cfi_unwinder.hpp"
+#include "debug_locator.hpp"
+#include "dwarf_index.hpp"
+#include "dwarf_info.hpp"
+#include "dwarf_line.hpp"
+#include "elf_diff.hpp"
+#include "elf_entropy.hpp"
+#include "elf_fingerprint.hpp"
 #include "elf_handler.hpp"
+#include "elf_hardening.hpp"
+#include "elf_notes.hpp"
+#include "elf_size_profile.hpp"
 #include "logger.hpp"
+#include "pattern_rules.hpp"
+#include "signature_scanner.hpp"
+#include "similarity_index.hpp"
+#include "string_scanner.hpp"
+#include "symbolizer.hpp"
+#include "template_bloat.hpp"
+#include "x86_decoder.hpp"
+#include "x86_isa.hpp"
+#include <cstring>
 #include <iostream>
+#include <optional>
+
+static void PrintUsage(const char *program)
+{
+    printf("Usage: %s [options] <executable>\n", program);
+    printf("       %s --batch [--hashes] <input>...\n", program);
+    printf("  --notes              Print the build-id, ABI tag and GNU properties using only the program headers\n");
+    printf("  --checksec           Print RELRO, NX, PIE, stack protector, FORTIFY, CET and RPATH/RUNPATH status\n");
+    printf("  --debug-file         Locate the separate debug file by build-id or .gnu_debuglink\n");
+    printf("  --debug-dir <dir>    Add a debug directory to search (default: %s)\n", DEFAULT_DEBUG_DIRECTORY);
+    printf("  --debug-index <path> Location of the persistent debug index (default: %s)\n",
+           DebugFileLocator::DefaultIndexPath().c_str());
+    printf("  --rebuild-index      Rebuild the debug index before searching\n");
+    printf("  --addr2line <addr>   Resolve an address to file:line:column using .debug_line (repeatable)\n");
+    printf("  --inlines            With --addr2line, print the function and the chain of inlined calls\n");
+    printf("  --dwp <path>         DWARF package of a -gsplit-dwarf build (default: <executable>.dwp)\n");
+    printf("  --functions          List function boundaries from the .eh_frame FDEs (works on stripped files)\n");
+    printf("  --unwind <samples>   Unwind the stacks of a sample capture file with the call frame information\n");
+    printf("  --load-bias <addr>   With --unwind, runtime address minus file address of the sampled binary\n");
+    printf("  --hashes             Print XXH3 and SHA-256 hashes of every section and segment\n");
+    printf("  --entropy            Print the entropy and estimated compressed size of every section and segment\n");
+    printf("  --entropy-window <n> With --entropy, also print the entropy of each n byte window\n");
+    printf("  --entropy-stride <n> Distance between windows (default: the window size)\n");
+    printf("  --strings            Print the printable strings of the data sections\n");
+    printf("  --section <name>     With --strings, --signatures, --rules or --code-map, scan this section instead\n");
+    printf("                       (repeatable)\n");
+    printf("  --min-length <n>     Minimum string length (default: %zu)\n", DEFAULT_MIN_STRING_LENGTH);
+    printf("  --utf16              Also find UTF-16LE strings\n");
+    printf("  --signatures <file>  Report matches of the byte signatures listed in a file, with their symbol\n");
+    printf("  --rules <file>       Report matches of the YARA style hex patterns in a file, with their symbol\n");
+    printf("  --exec-only          With --rules, only scan executable sections\n");
+    printf("  --code-map           Sweep the executable sections as x86-64 code and list the control transfers\n");
+    printf("  --call-graph         Rank the functions by the number of distinct direct callers (x86-64)\n");
+    printf("  --top <n>            Rows listed by --call-graph, --sizes, --diff and --similar, children per node\n");
+    printf("                       by --template-bloat (default: %zu)\n", DEFAULT_CALL_GRAPH_TOP);
+    printf("  --isa                Report the ISA extensions and x86-64 level of each function, check the ISA notes\n");
+    printf("  --sizes <dimension>  Attribute the file and VM bytes to sections, segments, symbols or units\n");
+    printf("  --template-bloat     Sum symbol sizes by namespace, class and template, template arguments stripped\n");
+    printf("  --depth <n>          With --template-bloat, levels listed (default: %zu)\n",
+           DEFAULT_TEMPLATE_BLOAT_DEPTH);
+    printf("  --diff <old>         Compare the headers, segments, sections and symbols of <old> with the executable\n");
+    printf("  --similarity-build   Index the functions of the x86-64 ELF files below <executable>, a directory\n");
+    printf("  --similar            List the indexed functions resembling each function of the executable\n");
+    printf("  --function <name>    With --similar, only query this function\n");
+    printf("  --min-similarity <x> With --similar, lowest estimated similarity listed (default: %.2f)\n",
+           DEFAULT_MIN_SIMILARITY);
+    printf("  --similarity-index <path> Location of the similarity index (default: %s)\n",
+           SimilarityIndex::DefaultIndexPath().c_str());
+    printf("  --batch              Summarise every ELF file below the inputs, one line each; an input is a file,\n");
+    printf("                       a directory, a glob pattern or @list, a file of inputs (@- for stdin)\n");
+    printf("                       With --hashes, list the region hashes of every file instead\n");
+    printf("  --worker-stats       With --batch, print the tasks, steals and busy time of each pool worker\n");
+    printf("  --find-name <name>   List the DWARF units and DIEs defining a name (repeatable)\n");
+    printf("  --no-dwarf-cache     Do not read or write the cached DWARF unit index\n");
+}
+
+/**
+ * @brief Returns the DWARF unit index cache path of a file, keyed by its build-id; empty if it has none.
+ */
+static std::string DwarfCachePath(const char *fileName)
+{
+    try
+    {
+        ElfSegments segments(fileName);
+        std::string buildId = ElfNotes(segments).GetBuildIdHex();
+        return buildId.empty() ? std::string() : DwarfUnitIndex::DefaultCachePath(buildId);
+    }
+    catch (const std::exception &e)
+    {
+        return {};
+    }
+}
+
+/**
+ * @brief Scans every ELF file below the inputs on one pool, printing a summary line or the region hashes of each.
+ * With --hashes, large files split their symbol names and hashing into subtasks of the same pool. The totals, and
+ * with workerStats the counters of each worker, go to stderr. Only errors reach the console, on stderr, so stdout
+ * stays a single machine readable table; the rest of the log still goes to the log file.
+ */
+static void RunBatch(const std::vector<std::string> &inputs, bool hashes, bool workerStats)
+{
+    Logger::Instance().SetConsoleLevel(Logger::LogLevel::Error);
+    ThreadPool pool;
+    BatchScanner::ScanFunction scanFunction = DescribeElfFile;
+    if (hashes)
+    {
+        scanFunction = [&pool](const std::string &path) { return DescribeElfHashes(path, &pool); };
+        printf("# path\tkind\tname\toffset\tsize\txxh3\tsha256\n");
+    }
+    else
+    {
+        printf("# path\tclass\tmachine\ttype\trelro\tnx\tcanary\tfortified\tbuild-id\n");
+    }
+
+    BatchScanner scanner(pool, scanFunction);
+    for (const auto &input : inputs)
+    {
+        scanner.AddInput(input);
+    }
+    BatchScanStats stats = scanner.Finish();
+    fprintf(stderr, "%lu ELF files of %lu files in %lu directories, %lu failed\n", stats.elfFiles, stats.files,
+            stats.directories, stats.failures);
+
+    if (workerStats)
+    {
+        uint64_t elapsed = std::max<uint64_t>(pool.GetElapsedNanoseconds(), 1);
+        std::vector<ThreadPoolWorkerStats> workers = pool.GetWorkerStats();
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            fprintf(stderr, "worker %2zu: %8lu tasks %8lu stolen %10.1f ms busy %5.1f%%\n", i, workers[i].tasks,
+                    workers[i].stolen, workers[i].busyNanoseconds / 1e6, 100.0 * workers[i].busyNanoseconds / elapsed);
+        }
+    }
+}
 
 int main(int argc, char **argv)
 {
     LOG_INIT("log.txt");
-    if (argc < 2)
+
+    enum class Mode
+    {
+        SectionHeaders,
+        Notes,
+        Checksec,
+        DebugFile,
+        AddrToLine,
+        FindName,
+        Functions,
+        Unwind,
+        Hashes,
+        Entropy,
+        Strings,
+        Signatures,
+        Rules,
+        CodeMap,
+        CallGraph,
+        Isa,
+        Sizes,
+        Diff,
+        SimilarityBuild,
+        Similar,
+        TemplateBloat
+    } mode = Mode::SectionHeaders;
+    std::vector<std::string> debugDirectories;
+    std::string debugIndex = DebugFileLocator::DefaultIndexPath();
+    bool rebuildIndex = false;
+    std::vector<uint64_t> addresses;
+    std::vector<std::string> names;
+    bool useDwarfCache = true;
+    bool showInlines = false;
+    std::string samplePath;
+    uint64_t loadBias = 0;
+    std::string packagePath;
+    size_t entropyWindow = 0;
+    size_t entropyStride = 0;
+    std::vector<std::string> sectionNames;
+    StringScanOptions stringOptions;
+    std::string signaturePath;
+    std::string rulePath;
+    bool executableOnly = false;
+    size_t topCount = DEFAULT_CALL_GRAPH_TOP;
+    SizeDimension sizeDimension = SizeDimension::Sections;
+    std::string diffBase;
+    std::string similarityIndex = SimilarityIndex::DefaultIndexPath();
+    std::string functionName;
+    double minSimilarity = DEFAULT_MIN_SIMILARITY;
+    size_t bloatDepth = DEFAULT_TEMPLATE_BLOAT_DEPTH;
+    bool batch = false;
+    bool workerStats = false;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--notes") == 0)
+            mode = Mode::Notes;
+        else if (strcmp(argv[i], "--checksec") == 0)
+            mode = Mode::Checksec;
+        else if (strcmp(argv[i], "--debug-file") == 0)
+            mode = Mode::DebugFile;
+        else if (strcmp(argv[i], "--debug-dir") == 0 && hasValue)
+            debugDirectories.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--debug-index") == 0 && hasValue)
+            debugIndex = argv[++i];
+        else if (strcmp(argv[i], "--rebuild-index") == 0)
+            rebuildIndex = true;
+        else if (strcmp(argv[i], "--addr2line") == 0 && hasValue)
+        {
+            mode = Mode::AddrToLine;
+            addresses.push_back(strtoull(argv[++i], nullptr, 16));
+        }
+        else if (strcmp(argv[i], "--inlines") == 0)
+            showInlines = true;
+        else if (strcmp(argv[i], "--dwp") == 0 && hasValue)
+            packagePath = argv[++i];
+        else if (strcmp(argv[i], "--find-name") == 0 && hasValue)
+        {
+            mode = Mode::FindName;
+            names.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--functions") == 0)
+            mode = Mode::Functions;
+        else if (strcmp(argv[i], "--unwind") == 0 && hasValue)
+        {
+            mode = Mode::Unwind;
+            samplePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--load-bias") == 0 && hasValue)
+            loadBias = strtoull(argv[++i], nullptr, 16);
+        else if (strcmp(argv[i], "--hashes") == 0)
+            mode = Mode::Hashes;
+        else if (strcmp(argv[i], "--entropy") == 0)
+            mode = Mode::Entropy;
+        else if (strcmp(argv[i], "--entropy-window") == 0 && hasValue)
+            entropyWindow = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "--entropy-stride") == 0 && hasValue)
+            entropyStride = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "--strings") == 0)
+            mode = Mode::Strings;
+        else if (strcmp(argv[i], "--section") == 0 && hasValue)
+            sectionNames.push_back(argv[++i]);
+        else if (strcmp(argv[i], "--min-length") == 0 && hasValue)
+            stringOptions.minLength = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "--utf16") == 0)
+            stringOptions.utf16le = true;
+        else if (strcmp(argv[i], "--signatures") == 0 && hasValue)
+        {
+            mode = Mode::Signatures;
+            signaturePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--rules") == 0 && hasValue)
+        {
+            mode = Mode::Rules;
+            rulePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--exec-only") == 0)
+            executableOnly = true;
+        else if (strcmp(argv[i], "--code-map") == 0)
+            mode = Mode::CodeMap;
+        else if (strcmp(argv[i], "--call-graph") == 0)
+            mode = Mode::CallGraph;
+        else if (strcmp(argv[i], "--top") == 0 && hasValue)
+            topCount = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "--isa") == 0)
+            mode = Mode::Isa;
+        else if (strcmp(argv[i], "--sizes") == 0 && hasValue && ParseSizeDimension(argv[i + 1]).has_value())
+        {
+            mode = Mode::Sizes;
+            sizeDimension = *ParseSizeDimension(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--diff") == 0 && hasValue)
+        {
+            mode = Mode::Diff;
+            diffBase = argv[++i];
+        }
+        else if (strcmp(argv[i], "--similarity-build") == 0)
+            mode = Mode::SimilarityBuild;
+        else if (strcmp(argv[i], "--similar") == 0)
+            mode = Mode::Similar;
+        else if (strcmp(argv[i], "--function") == 0 && hasValue)
+            functionName = argv[++i];
+        else if (strcmp(argv[i], "--min-similarity") == 0 && hasValue)
+            minSimilarity = strtod(argv[++i], nullptr);
+        else if (strcmp(argv[i], "--similarity-index") == 0 && hasValue)
+            similarityIndex = argv[++i];
+        else if (strcmp(argv[i], "--template-bloat") == 0)
+            mode = Mode::TemplateBloat;
+        else if (strcmp(argv[i], "--depth") == 0 && hasValue)
+            bloatDepth = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "--batch") == 0)
+            batch = true;
+        else if (strcmp(argv[i], "--worker-stats") == 0)
+            workerStats = true;
+        else if (strcmp(argv[i], "--no-dwarf-cache") == 0)
+            useDwarfCache = false;
+        else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0)
+            inputs.push_back(argv[i]);
+        else
+        {
+            LOG(Logger::LogLevel::Error, "Unrecognised argument: %s", argv[i]);
+            PrintUsage(argv[0]);
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if (inputs.empty())
     {
         LOG(Logger::LogLevel::Error, "No executable specified");
-        printf("Usage: %s <executable>", argv[0]);
+        PrintUsage(argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+    if (batch)
+    {
+        if (mode != Mode::SectionHeaders && mode != Mode::Hashes)
+        {
+            LOG(Logger::LogLevel::Error, "Only the summary and --hashes are supported with --batch");
+            std::exit(EXIT_FAILURE);
+        }
+        RunBatch(inputs, mode == Mode::Hashes, workerStats);
+        return 0;
+    }
+    if (inputs.size() > 1)
+    {
+        LOG(Logger::LogLevel::Error, "Unrecognised argument: %s", inputs[1].c_str());
+        PrintUsage(argv[0]);
         std::exit(EXIT_FAILURE);
     }
+    const char *fileName = inputs.front().c_str();
 
     try
     {
-        ElfHandler elfHandler(argv[1]);
+        switch (mode)
+        {
+        case Mode::SectionHeaders: {
+            ElfHandler elfHandler(fileName);
+            elfHandler.PrintSectionHeaders();
+        }
+        break;
+        case Mode::Notes: {
+            ElfSegments segments(fileName);
+            ElfNotes(segments).PrintNotes();
+        }
+        break;
+        case Mode::Checksec: {
+            ElfSegments segments(fileName);
+            ElfHardening(segments).PrintReport();
+        }
+        break;
+        case Mode::DebugFile: {
+            DebugFileLocator locator(debugDirectories, debugIndex);
+            if (rebuildIndex)
+            {
+                locator.RebuildIndex();
+            }
+            auto debugFile = locator.FindDebugFile(fileName);
+            if (!debugFile)
+            {
+                printf("No debug file found for %s\n", fileName);
+                return EXIT_FAILURE;
+            }
+            printf("%s\n", debugFile->c_str());
+        }
+        break;
+        case Mode::AddrToLine: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            Symbolizer symbolizer(elfHandler, useDwarfCache ? DwarfCachePath(fileName) : std::string(), packagePath,
+                                  &pool);
+            auto results = symbolizer.SymbolizeBatch(addresses, pool);
+            for (size_t i = 0; i < addresses.size(); i++)
+            {
+                const auto &frames = results[i];
+                if (frames.empty())
+                {
+                    printf("0x%lx: ??:0\n", addresses[i]);
+                    continue;
+                }
+                if (!showInlines)
+                {
+                    const SymbolizedFrame &frame = frames.front();
+                    if (frame.line == 0)
+                        printf("0x%lx: %s:0\n", addresses[i], frame.fileName.c_str());
+                    else
+                        printf("0x%lx: %s:%u:%u\n", addresses[i], frame.fileName.c_str(), frame.line, frame.column);
+                    continue;
+                }
+                for (size_t j = 0; j < frames.size(); j++)
+                {
+                    const SymbolizedFrame &frame = frames[j];
+                    const char *function = frame.function.empty() ? "??" : frame.function.c_str();
+                    if (j == 0)
+                        printf("0x%lx: ", addresses[i]);
+                    else
+                        printf("  (inlined by) ");
+                    printf("%s at %s:%u:%u\n", function, frame.fileName.c_str(), frame.line, frame.column);
+                }
+            }
+        }
+        break;
+        case Mode::FindName: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            DwarfSections sections = LoadDwarfSections(elfHandler, &pool);
+            DwarfUnitIndex unitIndex(sections, useDwarfCache ? DwarfCachePath(fileName) : std::string(), &pool);
+            for (const auto &name : names)
+            {
+                auto matches = unitIndex.FindName(name);
+                if (matches.empty())
+                    printf("%s: not found\n", name.c_str());
+                for (const auto &match : matches)
+                {
+                    DwarfUnitHeader header = ReadUnitHeader(sections.info, match.unitOffset);
+                    DwarfAbbrevTable abbrevs(sections.abbrev, header.abbrevOffset);
+                    DwarfUnit unit(sections, header, abbrevs);
+                    std::string unitName(unit.GetName());
+                    printf("%s: unit 0x%lx (%s) die 0x%lx\n", name.c_str(), match.unitOffset, unitName.c_str(),
+                           match.dieOffset);
+                }
+            }
+        }
+        break;
+        case Mode::Functions: {
+            ElfHandler elfHandler(fileName);
+            CallFrameInfo callFrames(elfHandler);
+            if (callFrames.GetTableSource() == CfiTableSource::None)
+            {
+                callFrames = CallFrameInfo(elfHandler, CfiSectionType::DebugFrame);
+            }
+            for (const auto &[begin, end] : callFrames.GetFunctionRanges())
+            {
+                printf("0x%lx-0x%lx %lu\n", begin, end, end - begin);
+            }
+        }
+        break;
+        case Mode::Unwind: {
+            ElfHandler elfHandler(fileName);
+            CallFrameInfo callFrames(elfHandler);
+            if (callFrames.GetTableSource() == CfiTableSource::None)
+            {
+                callFrames = CallFrameInfo(elfHandler, CfiSectionType::DebugFrame);
+            }
+            UnwindSampleFile samples(samplePath);
+            ThreadPool pool;
+            CfiUnwinder unwinder(callFrames, elfHandler.GetMachine(), loadBias);
+            PrintUnwoundStacks(unwinder, samples.GetSamples(), pool);
+        }
+        break;
+        case Mode::Hashes: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            ElfSegments segments(fileName);
+            ElfFingerprint(elfHandler, segments, &pool).PrintHashes();
+        }
+        break;
+        case Mode::Entropy: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            ElfSegments segments(fileName);
+            ElfEntropyProfile(elfHandler, segments, &pool, entropyWindow, entropyStride).PrintProfile();
+        }
+        break;
+        case Mode::Strings: {
+            ElfHandler elfHandler(fileName);
+            ScanSectionStrings(elfHandler, sectionNames, stringOptions, PrintString);
+        }
+        break;
+        case Mode::Signatures: {
+            ElfHandler elfHandler(fileName);
+            SignatureSet signatures = SignatureSet::FromFile(signaturePath);
+            PrintSignatureMatches(elfHandler, signatures, sectionNames);
+        }
+        break;
+        case Mode::Rules: {
+            ElfHandler elfHandler(fileName);
+            PatternRuleSet rules = PatternRuleSet::FromFile(rulePath);
+            PrintPatternMatches(elfHandler, rules, sectionNames, executableOnly);
+        }
+        break;
+        case Mode::CodeMap: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            ScanSectionCode(elfHandler, sectionNames, &pool, PrintCodeMap);
+        }
+        break;
+        case Mode::CallGraph: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            CallGraph(elfHandler, &pool).PrintFanIn(topCount);
+        }
+        break;
+        case Mode::Isa: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            ElfSegments segments(fileName);
+            X86IsaProfile(elfHandler, segments, &pool).PrintReport();
+        }
+        break;
+        case Mode::Sizes: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            ElfSegments segments(fileName);
+            ElfSizeProfile(elfHandler, segments, sizeDimension, &pool).PrintProfile(topCount);
+        }
+        break;
+        case Mode::Diff: {
+            // Symbol tables dominate the parse time of large files, so the old one is parsed on the pool meanwhile
+            ThreadPool pool;
+            std::optional<ElfHandler> oldHandler;
+            TaskGroup oldLoader(pool);
+            oldLoader.Submit([&]() { oldHandler.emplace(diffBase, &pool); });
+            ElfHandler newHandler(fileName, &pool);
+            oldLoader.Wait();
+            ElfSegments oldSegments(diffBase);
+            ElfSegments newSegments(fileName);
+            ElfDiff(*oldHandler, oldSegments, newHandler, newSegments, &pool).PrintDiff(topCount);
+        }
+        break;
+        case Mode::SimilarityBuild: {
+            ThreadPool pool;
+            SimilarityIndex::Build({fileName}, similarityIndex, &pool);
+        }
+        break;
+        case Mode::Similar: {
+            SimilarityIndex index(similarityIndex);
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            PrintSimilarFunctions(index, elfHandler, functionName, minSimilarity, topCount, &pool);
+        }
+        break;
+        case Mode::TemplateBloat: {
+            ThreadPool pool;
+            ElfHandler elfHandler(fileName, &pool);
+            TemplateBloatReport(elfHandler, &pool).PrintReport(topCount, bloatDepth);
+        }
+        break;
+        }
     }
     catch (const std::exception &e)
     {
@@ -23,4 +548,4 @@ int main(int argc, char **argv)
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,124 @@
+#include "mapped_file.hpp"
+#include "logger.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+/**
+ * @brief Maps the given file read-only into memory.
+ *
+ * @param fileName The path of the file to map.
+ * @throws std::runtime_error if the file cannot be opened, inspected or mapped.
+ */
+MappedFile::MappedFile(const std::string &fileName) : _fileName(fileName)
+{
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Failed to open file: %s", fileName.c_str());
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        LOG_THROW(Logger::LogLevel::Error, "Failed to stat file: %s", fileName.c_str());
+    }
+    _size = static_cast<uint64_t>(st.st_size);
+
+    // mmap rejects zero length mappings, an empty file is simply an empty view
+    if (_size != 0)
+    {
+        void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            LOG_THROW(Logger::LogLevel::Error, "Failed to map file: %s", fileName.c_str());
+        }
+        _data = static_cast<const uint8_t *>(data);
+    }
+    close(fd);
+}
+
+/**
+ * @brief Unmaps the file.
+ */
+MappedFile::~MappedFile()
+{
+    Unmap();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : _fileName(std::move(other._fileName)), _data(std::exchange(other._data, nullptr)),
+      _size(std::exchange(other._size, 0))
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        Unmap();
+        _fileName = std::move(other._fileName);
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+    }
+    return *this;
+}
+
+const uint8_t *MappedFile::Data() const
+{
+    return _data;
+}
+
+uint64_t MappedFile::Size() const
+{
+    return _size;
+}
+
+const std::string &MappedFile::GetFileName() const
+{
+    return _fileName;
+}
+
+/**
+ * @brief Returns a bounds checked view of part of the mapping.
+ *
+ * @param offset The file offset of the first byte.
+ * @param size The number of bytes in the view.
+ * @return A span over the requested bytes.
+ * @throws std::runtime_error if the range does not lie within the file.
+ */
+std::span<const uint8_t> MappedFile::Slice(uint64_t offset, uint64_t size) const
+{
+    if (offset > _size || size > _size - offset)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Range 0x%lx+0x%lx exceeds file size of %s", offset, size,
+                  _fileName.c_str());
+    }
+    return {_data + offset, size};
+}
+
+/**
+ * @brief Disables read-ahead on the mapping, for large files such as .dwp packages that are read at a few scattered
+ * places, so only the pages actually touched are read from disk.
+ */
+void MappedFile::AdviseRandomAccess() const
+{
+    if (_data != nullptr)
+    {
+        madvise(const_cast<uint8_t *>(_data), _size, MADV_RANDOM);
+    }
+}
+
+void MappedFile::Unmap()
+{
+    if (_data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(_data), _size);
+        _data = nullptr;
+        _size = 0;
+    }
+}
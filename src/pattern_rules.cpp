@@ -0,0 +1,411 @@
+#include "pattern_rules.hpp"
+#include "logger.hpp"
+#include "symbol_map.hpp"
+#include <algorithm>
+#include <fstream>
+
+/**
+ * @brief Constructor for the PatternRuleSet class. Selects the atom of every rule and compiles the atoms.
+ *
+ * @param rules The rules; matches refer to them by index.
+ */
+PatternRuleSet::PatternRuleSet(std::vector<PatternRule> rules)
+    : _rules(std::move(rules)), _atomSet(SelectAtoms(_rules, _atoms, _unanchoredRules))
+{
+    for (uint32_t rule : _unanchoredRules)
+    {
+        LOG(Logger::LogLevel::Warning, "Rule %s has no literal byte and is tried at every position",
+            _rules[rule].name.c_str());
+    }
+}
+
+/**
+ * @brief Parses a YARA hexadecimal string: pairs of hex digits, with '?' standing for a wildcard nibble, and jumps
+ * written [n] or [n-m]. Whitespace is optional, and surrounding braces are ignored.
+ *
+ * @param name The rule name.
+ * @param pattern The pattern text.
+ * @return The rule, split at its jumps.
+ * @throws Logger::Log if the pattern is malformed, starts or ends with a jump, or has an unbounded jump.
+ */
+PatternRule PatternRuleSet::ParseRule(const std::string &name, const std::string &pattern)
+{
+    auto nibble = [](char c, uint8_t &value) -> bool {
+        if (c >= '0' && c <= '9')
+            value = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value = c - 'A' + 10;
+        else
+            return false;
+        return true;
+    };
+
+    PatternRule rule{name, {{}}, {}};
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        char c = pattern[i];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '{' || c == '}')
+        {
+            continue;
+        }
+        if (c == '[')
+        {
+            size_t close = pattern.find(']', i);
+            if (close == std::string::npos)
+                LOG_THROW(Logger::LogLevel::Error, "Rule %s: unterminated jump", name.c_str());
+            std::string range = pattern.substr(i + 1, close - i - 1);
+            size_t dash = range.find('-');
+            char *end;
+            uint32_t min = static_cast<uint32_t>(strtoul(range.c_str(), &end, 10));
+            uint32_t max = min;
+            if (end == range.c_str())
+                LOG_THROW(Logger::LogLevel::Error, "Rule %s: invalid jump [%s]", name.c_str(), range.c_str());
+            if (dash != std::string::npos)
+            {
+                const char *maxText = range.c_str() + dash + 1;
+                max = static_cast<uint32_t>(strtoul(maxText, &end, 10));
+                if (end == maxText)
+                    LOG_THROW(Logger::LogLevel::Error, "Rule %s: unbounded jump [%s]", name.c_str(), range.c_str());
+            }
+            if (max < min)
+                LOG_THROW(Logger::LogLevel::Error, "Rule %s: invalid jump [%s]", name.c_str(), range.c_str());
+            if (rule.segments.back().empty())
+                LOG_THROW(Logger::LogLevel::Error, "Rule %s: a jump must follow a byte", name.c_str());
+            rule.jumps.push_back({min, max});
+            rule.segments.emplace_back();
+            i = close;
+            continue;
+        }
+        if (i + 1 >= pattern.size())
+            LOG_THROW(Logger::LogLevel::Error, "Rule %s: odd number of hex digits", name.c_str());
+
+        MaskedByte byte{0, 0};
+        uint8_t value;
+        for (size_t half = 0; half < 2; half++)
+        {
+            char digit = pattern[i + half];
+            int shift = half == 0 ? 4 : 0;
+            if (digit == '?')
+                continue;
+            if (!nibble(digit, value))
+                LOG_THROW(Logger::LogLevel::Error, "Rule %s: invalid hex digit '%c'", name.c_str(), digit);
+            byte.value |= value << shift;
+            byte.mask |= 0xf << shift;
+        }
+        rule.segments.back().push_back(byte);
+        i++;
+    }
+    if (rule.segments.back().empty())
+        LOG_THROW(Logger::LogLevel::Error, "Rule %s: pattern is empty or ends with a jump", name.c_str());
+    return rule;
+}
+
+/**
+ * @brief Reads a rule file. Each line holds a name and a hex pattern, "name = { 4d 5a ?? ?? [2-4] e8 }"; the
+ * leading '$' of YARA string identifiers is accepted. Blank lines and lines starting with '#' or "//" are skipped.
+ *
+ * @param path The rule file.
+ * @return The compiled set.
+ * @throws Logger::Log if the file cannot be read or a line is malformed.
+ */
+PatternRuleSet PatternRuleSet::FromFile(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        LOG_THROW(Logger::LogLevel::Error, "Failed to open rule file %s", path.c_str());
+
+    std::vector<PatternRule> rules;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#' || line.compare(begin, 2, "//") == 0)
+            continue;
+        size_t equals = line.find('=', begin);
+        if (equals == std::string::npos)
+            LOG_THROW(Logger::LogLevel::Error, "%s:%zu: expected name = { pattern }", path.c_str(), lineNumber);
+        std::string name = line.substr(begin, equals - begin);
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (!name.empty() && name[0] == '$')
+            name.erase(0, 1);
+        rules.push_back(ParseRule(name, line.substr(equals + 1)));
+    }
+    return PatternRuleSet(std::move(rules));
+}
+
+size_t PatternRuleSet::GetRuleCount() const
+{
+    return _rules.size();
+}
+
+const PatternRule &PatternRuleSet::GetRule(uint32_t index) const
+{
+    return _rules.at(index);
+}
+
+/**
+ * @brief Picks the atom of every rule: the literal run of at most PATTERN_MAX_ATOM_SIZE bytes with the best score,
+ * where common filler bytes count less, and compiles the atoms into a signature set.
+ *
+ * @param rules The rules.
+ * @param atoms Receives the atom of each anchored rule, by signature index.
+ * @param unanchoredRules Receives the rules without a literal byte.
+ * @return The signature set of the atoms.
+ */
+SignatureSet PatternRuleSet::SelectAtoms(const std::vector<PatternRule> &rules, std::vector<Atom> &atoms,
+                                         std::vector<uint32_t> &unanchoredRules)
+{
+    auto byteScore = [](uint8_t value) {
+        return value == 0x00 || value == 0xff || value == 0x90 || value == 0xcc ? 1 : 3;
+    };
+
+    std::vector<Signature> signatures;
+    for (uint32_t index = 0; index < rules.size(); index++)
+    {
+        const PatternRule &rule = rules[index];
+        int bestScore = 0;
+        Atom best{index, 0, 0};
+        size_t bestSize = 0;
+        for (uint32_t segment = 0; segment < rule.segments.size(); segment++)
+        {
+            const auto &bytes = rule.segments[segment];
+            for (size_t start = 0; start < bytes.size(); start++)
+            {
+                int score = 0;
+                for (size_t size = 1; size <= PATTERN_MAX_ATOM_SIZE && start + size <= bytes.size(); size++)
+                {
+                    if (bytes[start + size - 1].mask != 0xff)
+                        break;
+                    score += byteScore(bytes[start + size - 1].value);
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = {index, segment, static_cast<uint32_t>(start)};
+                        bestSize = size;
+                    }
+                }
+            }
+        }
+        if (bestSize == 0)
+        {
+            unanchoredRules.push_back(index);
+            continue;
+        }
+        Signature atom{rule.name, {}};
+        for (size_t i = 0; i < bestSize; i++)
+        {
+            atom.bytes.push_back(rule.segments[best.segment][best.offset + i].value);
+        }
+        signatures.push_back(std::move(atom));
+        atoms.push_back(best);
+    }
+    return SignatureSet(std::move(signatures));
+}
+
+bool PatternRuleSet::MatchSegment(std::span<const uint8_t> data, const std::vector<MaskedByte> &segment,
+                                  uint64_t position)
+{
+    if (position + segment.size() > data.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < segment.size(); i++)
+    {
+        if ((data[position + i] & segment[i].mask) != segment[i].value)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Matches the segments after a matched one, trying every length of each jump.
+ *
+ * @param data The scanned bytes.
+ * @param rule The rule.
+ * @param segment The last matched segment.
+ * @param position Where that segment matched.
+ * @param end Receives the end of the first complete match found.
+ * @return Whether the rest of the rule matches.
+ */
+bool PatternRuleSet::MatchForward(std::span<const uint8_t> data, const PatternRule &rule, size_t segment,
+                                  uint64_t position, uint64_t &end) const
+{
+    uint64_t after = position + rule.segments[segment].size();
+    if (segment + 1 == rule.segments.size())
+    {
+        end = after;
+        return true;
+    }
+    const PatternJump &jump = rule.jumps[segment];
+    const auto &next = rule.segments[segment + 1];
+    for (uint64_t distance = jump.min; distance <= jump.max && after + distance + next.size() <= data.size();
+         distance++)
+    {
+        if (MatchSegment(data, next, after + distance) &&
+            MatchForward(data, rule, segment + 1, after + distance, end))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Matches the segments before a matched one, collecting every start of the rule that fits.
+ *
+ * @param data The scanned bytes.
+ * @param rule The rule.
+ * @param segment The first matched segment.
+ * @param position Where that segment matched.
+ * @param starts Receives the start of every complete match.
+ */
+void PatternRuleSet::MatchBackward(std::span<const uint8_t> data, const PatternRule &rule, size_t segment,
+                                   uint64_t position, std::vector<uint64_t> &starts) const
+{
+    if (segment == 0)
+    {
+        starts.push_back(position);
+        return;
+    }
+    const PatternJump &jump = rule.jumps[segment - 1];
+    const auto &previous = rule.segments[segment - 1];
+    for (uint64_t distance = jump.min; distance <= jump.max && distance + previous.size() <= position; distance++)
+    {
+        uint64_t start = position - distance - previous.size();
+        if (MatchSegment(data, previous, start))
+        {
+            MatchBackward(data, rule, segment - 1, start, starts);
+        }
+    }
+}
+
+/**
+ * @brief Verifies a rule around one of its segments placed at a position.
+ */
+void PatternRuleSet::Verify(std::span<const uint8_t> data, uint32_t rule, size_t segment, uint64_t position,
+                            std::vector<PatternMatch> &matches) const
+{
+    const PatternRule &patternRule = _rules[rule];
+    uint64_t end;
+    if (!MatchSegment(data, patternRule.segments[segment], position) ||
+        !MatchForward(data, patternRule, segment, position, end))
+    {
+        return;
+    }
+    std::vector<uint64_t> starts;
+    MatchBackward(data, patternRule, segment, position, starts);
+    for (uint64_t start : starts)
+    {
+        matches.push_back({rule, start, end - start});
+    }
+}
+
+/**
+ * @brief Finds every start position of every rule. A rule matching from one start in several ways is reported
+ * once, with the first way found.
+ *
+ * @param data The bytes to scan.
+ * @param callback Called once per match, in offset order.
+ */
+void PatternRuleSet::Scan(std::span<const uint8_t> data, const PatternCallback &callback) const
+{
+    std::vector<PatternMatch> matches;
+    _atomSet.Scan(data, [&](const SignatureMatch &hit) {
+        const Atom &atom = _atoms[hit.signature];
+        if (hit.offset >= atom.offset)
+        {
+            Verify(data, atom.rule, atom.segment, hit.offset - atom.offset, matches);
+        }
+    });
+    for (uint32_t rule : _unanchoredRules)
+    {
+        for (uint64_t position = 0; position < data.size(); position++)
+        {
+            Verify(data, rule, 0, position, matches);
+        }
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const PatternMatch &a, const PatternMatch &b) {
+        return a.offset != b.offset ? a.offset < b.offset : a.rule < b.rule;
+    });
+    matches.erase(std::unique(matches.begin(), matches.end(),
+                              [](const PatternMatch &a, const PatternMatch &b) {
+                                  return a.offset == b.offset && a.rule == b.rule;
+                              }),
+                  matches.end());
+    for (const PatternMatch &match : matches)
+    {
+        callback(match);
+    }
+}
+
+/**
+ * @brief Scans sections of a file for pattern rules, one section after another in section header order.
+ *
+ * @param elfHandler The parsed file.
+ * @param rules The compiled rules.
+ * @param sectionNames The sections to scan. When empty, every allocated section with file contents is scanned.
+ * @param executableOnly Skip sections without SHF_EXECINSTR.
+ * @param callback Called once per match with its section; offsets are relative to the section.
+ */
+void ScanSectionPatterns(const ElfHandler &elfHandler, const PatternRuleSet &rules,
+                         const std::vector<std::string> &sectionNames, bool executableOnly,
+                         const SectionPatternCallback &callback)
+{
+    for (const std::string &name : sectionNames)
+    {
+        if (elfHandler.FindSection(name) == nullptr)
+        {
+            LOG(Logger::LogLevel::Warning, "Section %s not found", name.c_str());
+        }
+    }
+
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        bool selected;
+        if (sectionNames.empty())
+        {
+            selected = (section.flags & SectionHeaderFlags::SHF_ALLOC) != 0 &&
+                       section.type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS);
+        }
+        else
+        {
+            selected = std::find(sectionNames.begin(), sectionNames.end(), section.name) != sectionNames.end();
+        }
+        if (executableOnly && (section.flags & SectionHeaderFlags::SHF_EXECINSTR) == 0)
+        {
+            selected = false;
+        }
+        if (!selected)
+        {
+            continue;
+        }
+        rules.Scan(elfHandler.GetSectionData(section),
+                   [&section, &callback](const PatternMatch &match) { callback(section, match); });
+    }
+}
+
+/**
+ * @brief Prints one line per match: section, file offset, address, size, rule name and the symbol containing the
+ * match as symbol+offset, or '-' outside any symbol.
+ */
+void PrintPatternMatches(const ElfHandler &elfHandler, const PatternRuleSet &rules,
+                         const std::vector<std::string> &sectionNames, bool executableOnly)
+{
+    SymbolMap symbols(elfHandler);
+    ScanSectionPatterns(
+        elfHandler, rules, sectionNames, executableOnly, [&](const ElfSection &section, const PatternMatch &match) {
+            uint64_t address = section.addr + match.offset;
+            printf("%-20s 0x%08lx 0x%08lx %4lu %s", section.name.c_str(), section.offset + match.offset, address,
+                   match.size, rules.GetRule(match.rule).name.c_str());
+            const ElfSymbol *symbol = symbols.Find(static_cast<uint16_t>(section.index), address);
+            if (symbol != nullptr)
+                printf(" %s+0x%lx\n", symbol->name.c_str(), address - symbol->value);
+            else
+                printf(" -\n");
+        });
+}
@@ -0,0 +1,339 @@
+#include "section_decompressor.hpp"
+#include "logger.hpp"
+#include <climits>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Mappings kept for reuse after their section was evicted
+constexpr size_t MAX_SPARE_MAPPINGS = 4;
+
+// Buffers from this size on ask for transparent huge pages
+constexpr size_t HUGE_PAGE_THRESHOLD = 2ULL << 20;
+
+/**
+ * @brief Reserves an anonymous mapping for decompressed data.
+ *
+ * @param capacity The number of bytes needed, rounded up to whole pages.
+ * @throws std::runtime_error if the mapping cannot be created.
+ */
+DecompressedSection::DecompressedSection(size_t capacity)
+{
+    if (capacity == 0)
+    {
+        return;
+    }
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    _capacity = (capacity + pageSize - 1) / pageSize * pageSize;
+    void *data = mmap(nullptr, _capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+    {
+        _capacity = 0;
+        LOG_THROW(Logger::LogLevel::Error, "Failed to map %zu bytes for a decompressed section", capacity);
+    }
+    if (_capacity >= HUGE_PAGE_THRESHOLD)
+    {
+        madvise(data, _capacity, MADV_HUGEPAGE);
+    }
+    _data = static_cast<uint8_t *>(data);
+}
+
+DecompressedSection::~DecompressedSection()
+{
+    if (_data != nullptr)
+    {
+        munmap(_data, _capacity);
+    }
+}
+
+std::span<const uint8_t> DecompressedSection::GetData() const
+{
+    return {_data, _size};
+}
+
+size_t DecompressedSection::GetCapacity() const
+{
+    return _capacity;
+}
+
+/**
+ * @brief Constructor for the SectionDecompressor class.
+ *
+ * @param elfHandler The file whose sections are decompressed; must outlive the decompressor.
+ * @param cacheLimit The decompressed bytes to keep for repeated use.
+ */
+SectionDecompressor::SectionDecompressor(const ElfHandler &elfHandler, size_t cacheLimit)
+    : _elfHandler(elfHandler), _cacheLimit(cacheLimit)
+{
+}
+
+/**
+ * @brief Checks whether a section is stored compressed, either as SHF_COMPRESSED or as a GNU .zdebug section.
+ */
+bool SectionDecompressor::IsCompressed(const ElfSection &section)
+{
+    if (section.type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+    {
+        return false;
+    }
+    return (section.flags & SectionHeaderFlags::SHF_COMPRESSED) != 0 || section.name.starts_with(".zdebug");
+}
+
+/**
+ * @brief Returns the decompressed contents of a section, decompressing it unless it is cached. Safe to call
+ * concurrently; different sections decompress in parallel.
+ *
+ * @param section The section to decompress.
+ * @return The decompressed section, or nullptr if the section is not compressed.
+ * @throws std::runtime_error if the section is malformed or uses an unsupported compression format.
+ */
+std::shared_ptr<const DecompressedSection> SectionDecompressor::Get(const ElfSection &section)
+{
+    if (!IsCompressed(section))
+    {
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _entries.find(section.index);
+        if (found != _entries.end())
+        {
+            _lru.splice(_lru.begin(), _lru, found->second);
+            return found->second->section;
+        }
+    }
+
+    std::shared_ptr<DecompressedSection> decompressed = Decompress(section);
+    Insert(section.index, decompressed);
+    return decompressed;
+}
+
+/**
+ * @brief Decompresses several sections at once, one task each, so that they are cached for the following Get calls.
+ *
+ * @param sections The sections to decompress; uncompressed ones are ignored.
+ * @param pool The pool to decompress on, or nullptr to decompress on the calling thread.
+ */
+void SectionDecompressor::Prefetch(const std::vector<const ElfSection *> &sections, ThreadPool *pool)
+{
+    std::vector<const ElfSection *> pending;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const ElfSection *section : sections)
+        {
+            if (section != nullptr && IsCompressed(*section) && !_entries.contains(section->index))
+            {
+                pending.push_back(section);
+            }
+        }
+    }
+    if (pool == nullptr)
+    {
+        for (const ElfSection *section : pending)
+        {
+            Get(*section);
+        }
+    }
+    else
+    {
+        TaskGroup group(*pool);
+        for (const ElfSection *section : pending)
+        {
+            group.Submit([this, section]() { Get(*section); });
+        }
+        group.Wait();
+    }
+}
+
+size_t SectionDecompressor::GetCachedBytes() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cachedBytes;
+}
+
+std::shared_ptr<DecompressedSection> SectionDecompressor::Decompress(const ElfSection &section)
+{
+    std::span<const uint8_t> data = _elfHandler.GetSectionData(section);
+    uint32_t type = 0;
+    uint64_t size = 0;
+    size_t headerSize = 0;
+    if ((section.flags & SectionHeaderFlags::SHF_COMPRESSED) != 0)
+    {
+        if (_elfHandler.GetElfType() == ElfType::ELF_64 && data.size() >= sizeof(Elf64Chdr))
+        {
+            Elf64Chdr header;
+            std::memcpy(&header, data.data(), sizeof(header));
+            type = header.ch_type;
+            size = header.ch_size;
+            headerSize = sizeof(header);
+        }
+        else if (_elfHandler.GetElfType() == ElfType::ELF_32 && data.size() >= sizeof(Elf32Chdr))
+        {
+            Elf32Chdr header;
+            std::memcpy(&header, data.data(), sizeof(header));
+            type = header.ch_type;
+            size = header.ch_size;
+            headerSize = sizeof(header);
+        }
+        else
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Truncated compression header in section %s", section.name.c_str());
+        }
+    }
+    else
+    {
+        // .zdebug: "ZLIB" followed by the uncompressed size as a 64-bit big-endian integer
+        if (data.size() < 12 || std::memcmp(data.data(), "ZLIB", 4) != 0)
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Invalid .zdebug header in section %s", section.name.c_str());
+        }
+        for (size_t i = 4; i < 12; i++)
+        {
+            size = (size << 8) | data[i];
+        }
+        type = static_cast<uint32_t>(ElfCompressionType::ELFCOMPRESS_ZLIB);
+        headerSize = 12;
+    }
+
+    LOG(Logger::LogLevel::Debug, "Decompressing section %s: %lu -> %lu bytes", section.name.c_str(),
+        data.size() - headerSize, size);
+    std::shared_ptr<DecompressedSection> output = Allocate(size);
+    output->_size = size;
+    switch (static_cast<ElfCompressionType>(type))
+    {
+    case ElfCompressionType::ELFCOMPRESS_ZLIB:
+        Inflate(data.subspan(headerSize), *output, section);
+        break;
+    case ElfCompressionType::ELFCOMPRESS_ZSTD:
+        DecompressZstd(data.subspan(headerSize), *output, section);
+        break;
+    default:
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported compression type %u in section %s", type,
+                  section.name.c_str());
+    }
+    return output;
+}
+
+/**
+ * @brief Returns a buffer for size bytes, reusing the smallest spare mapping that is large enough.
+ */
+std::shared_ptr<DecompressedSection> SectionDecompressor::Allocate(size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto best = _spare.end();
+        for (auto it = _spare.begin(); it != _spare.end(); ++it)
+        {
+            if ((*it)->GetCapacity() >= size && (best == _spare.end() || (*it)->GetCapacity() < (*best)->GetCapacity()))
+            {
+                best = it;
+            }
+        }
+        if (best != _spare.end())
+        {
+            std::shared_ptr<DecompressedSection> reused = std::move(*best);
+            _spare.erase(best);
+            return reused;
+        }
+    }
+    return std::make_shared<DecompressedSection>(size);
+}
+
+/**
+ * @brief Adds a section to the cache and evicts the least recently used ones beyond the limit. The most recent
+ * section is always kept, even if it alone exceeds the limit.
+ */
+void SectionDecompressor::Insert(uint32_t index, const std::shared_ptr<DecompressedSection> &section)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_entries.contains(index))
+    {
+        return; // Decompressed concurrently by another thread
+    }
+    _lru.push_front({index, section});
+    _entries[index] = _lru.begin();
+    _cachedBytes += section->_size;
+
+    while (_cachedBytes > _cacheLimit && _lru.size() > 1)
+    {
+        CacheEntry &evicted = _lru.back();
+        _cachedBytes -= evicted.section->_size;
+        _entries.erase(evicted.index);
+        if (evicted.section.use_count() == 1 && _spare.size() < MAX_SPARE_MAPPINGS)
+        {
+            _spare.push_back(std::move(evicted.section));
+        }
+        _lru.pop_back();
+    }
+}
+
+void SectionDecompressor::Inflate(std::span<const uint8_t> input, DecompressedSection &output,
+                                  const ElfSection &section)
+{
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Failed to initialise zlib for section %s", section.name.c_str());
+    }
+
+    // zlib counts in uInt, so sections over 4 GiB are fed in pieces
+    size_t consumed = 0;
+    size_t produced = 0;
+    int result = Z_OK;
+    while (result == Z_OK)
+    {
+        if (stream.avail_in == 0 && consumed < input.size())
+        {
+            stream.next_in = const_cast<Bytef *>(input.data() + consumed);
+            stream.avail_in = static_cast<uInt>(std::min<size_t>(input.size() - consumed, UINT_MAX));
+            consumed += stream.avail_in;
+        }
+        if (stream.avail_out == 0 && produced < output._size)
+        {
+            stream.next_out = output._data + produced;
+            stream.avail_out = static_cast<uInt>(std::min<size_t>(output._size - produced, UINT_MAX));
+            produced += stream.avail_out;
+        }
+        result = inflate(&stream, Z_NO_FLUSH);
+    }
+    size_t total = stream.total_out;
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Failed to inflate section %s: %s", section.name.c_str(),
+                  result == Z_BUF_ERROR ? "truncated or larger than its header states" : "corrupt data");
+    }
+    if (total != output._size)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Section %s inflated to %zu bytes, expected %zu", section.name.c_str(),
+                  total, output._size);
+    }
+}
+
+void SectionDecompressor::DecompressZstd(std::span<const uint8_t> input, DecompressedSection &output,
+                                         const ElfSection &section)
+{
+#ifdef HAVE_ZSTD
+    size_t result = ZSTD_decompress(output._data, output._size, input.data(), input.size());
+    if (ZSTD_isError(result))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Failed to decompress section %s: %s", section.name.c_str(),
+                  ZSTD_getErrorName(result));
+    }
+    if (result != output._size)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Section %s decompressed to %zu bytes, expected %zu",
+                  section.name.c_str(), result, output._size);
+    }
+#else
+    (void)input;
+    (void)output;
+    LOG_THROW(Logger::LogLevel::Error, "Section %s is zstd compressed; rebuild with ZSTD=1 to read it",
+              section.name.c_str());
+#endif
+}
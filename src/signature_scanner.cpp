@@ -0,0 +1,443 @@
+#include "signature_scanner.hpp"
+#include "logger.hpp"
+#include "symbol_map.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+constexpr uint32_t SIGNATURE_HASH_MULTIPLIER = 0x9E3779B1U;
+
+static inline uint32_t HashQgram(uint32_t qgram)
+{
+    return (qgram * SIGNATURE_HASH_MULTIPLIER) >> (32 - SIGNATURE_FILTER_BITS);
+}
+
+static inline bool TestBit(const std::vector<uint64_t> &bits, uint32_t index)
+{
+    return (bits[index >> 6] >> (index & 63)) & 1;
+}
+
+static inline void SetBit(std::vector<uint64_t> &bits, uint32_t index)
+{
+    bits[index >> 6] |= 1ULL << (index & 63);
+}
+
+/**
+ * @brief Constructor for the SignatureSet class. Compiles the trie and the prefilter tables.
+ *
+ * @param signatures The signatures; matches refer to them by index.
+ * @throws Logger::Log if a signature is empty.
+ */
+SignatureSet::SignatureSet(std::vector<Signature> signatures) : _signatures(std::move(signatures))
+{
+    for (const Signature &signature : _signatures)
+    {
+        if (signature.bytes.empty())
+            LOG_THROW(Logger::LogLevel::Error, "Signature %s has no bytes", signature.name.c_str());
+    }
+    BuildTrie();
+    BuildFilters();
+    LOG(Logger::LogLevel::Debug, "Compiled %zu signatures into %zu trie nodes, prefilter stride %zu",
+        _signatures.size(), _nodes.size(), _stride);
+}
+
+/**
+ * @brief Reads a signature file. Each line holds a name followed by the bytes, either as hexadecimal digits, which
+ * may be separated by spaces, or as a double quoted string with C escapes. Blank lines and lines starting with '#'
+ * are skipped.
+ *
+ * @param path The signature file.
+ * @return The compiled set.
+ * @throws Logger::Log if the file cannot be read or a line is malformed.
+ */
+SignatureSet SignatureSet::FromFile(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        LOG_THROW(Logger::LogLevel::Error, "Failed to open signature file %s", path.c_str());
+
+    auto hexValue = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+
+    std::vector<Signature> signatures;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+            continue;
+        size_t nameEnd = line.find_first_of(" \t", begin);
+        if (nameEnd == std::string::npos)
+            LOG_THROW(Logger::LogLevel::Error, "%s:%zu: signature has no bytes", path.c_str(), lineNumber);
+
+        Signature signature{line.substr(begin, nameEnd - begin), {}};
+        size_t i = line.find_first_not_of(" \t", nameEnd);
+        if (i != std::string::npos && line[i] == '"')
+        {
+            for (i++; i < line.size() && line[i] != '"'; i++)
+            {
+                if (line[i] != '\\' || i + 1 >= line.size())
+                {
+                    signature.bytes.push_back(line[i]);
+                    continue;
+                }
+                char escape = line[++i];
+                if (escape == 'x' && i + 2 < line.size() && hexValue(line[i + 1]) >= 0 && hexValue(line[i + 2]) >= 0)
+                {
+                    signature.bytes.push_back(hexValue(line[i + 1]) << 4 | hexValue(line[i + 2]));
+                    i += 2;
+                }
+                else if (escape == 'n')
+                    signature.bytes.push_back('\n');
+                else if (escape == 't')
+                    signature.bytes.push_back('\t');
+                else if (escape == 'r')
+                    signature.bytes.push_back('\r');
+                else if (escape == '0')
+                    signature.bytes.push_back('\0');
+                else
+                    signature.bytes.push_back(escape);
+            }
+            if (i >= line.size())
+                LOG_THROW(Logger::LogLevel::Error, "%s:%zu: unterminated string", path.c_str(), lineNumber);
+        }
+        else
+        {
+            int high = -1;
+            for (; i < line.size(); i++)
+            {
+                if (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')
+                    continue;
+                int value = hexValue(line[i]);
+                if (value < 0)
+                    LOG_THROW(Logger::LogLevel::Error, "%s:%zu: invalid hex digit '%c'", path.c_str(), lineNumber,
+                              line[i]);
+                if (high < 0)
+                {
+                    high = value;
+                    continue;
+                }
+                signature.bytes.push_back(high << 4 | value);
+                high = -1;
+            }
+            if (high >= 0)
+                LOG_THROW(Logger::LogLevel::Error, "%s:%zu: odd number of hex digits", path.c_str(), lineNumber);
+        }
+        signatures.push_back(std::move(signature));
+    }
+    return SignatureSet(std::move(signatures));
+}
+
+size_t SignatureSet::GetSignatureCount() const
+{
+    return _signatures.size();
+}
+
+const Signature &SignatureSet::GetSignature(uint32_t index) const
+{
+    return _signatures.at(index);
+}
+
+/**
+ * @brief Builds the trie of all signatures and flattens it into the node, edge and output arrays.
+ */
+void SignatureSet::BuildTrie()
+{
+    std::vector<std::vector<std::pair<uint8_t, uint32_t>>> children(1);
+    std::vector<std::vector<uint32_t>> outputs(1);
+    for (uint32_t index = 0; index < _signatures.size(); index++)
+    {
+        uint32_t node = 0;
+        for (uint8_t byte : _signatures[index].bytes)
+        {
+            auto &edges = children[node];
+            auto edge = std::find_if(edges.begin(), edges.end(), [byte](const auto &e) { return e.first == byte; });
+            if (edge != edges.end())
+            {
+                node = edge->second;
+                continue;
+            }
+            uint32_t child = static_cast<uint32_t>(children.size());
+            edges.push_back({byte, child});
+            children.emplace_back();
+            outputs.emplace_back();
+            node = child;
+        }
+        outputs[node].push_back(index);
+    }
+
+    _nodes.resize(children.size());
+    for (uint32_t node = 0; node < children.size(); node++)
+    {
+        auto &edges = children[node];
+        std::sort(edges.begin(), edges.end());
+        _nodes[node] = {static_cast<uint32_t>(_edgeBytes.size()), static_cast<uint32_t>(edges.size()),
+                        static_cast<uint32_t>(_outputs.size()), static_cast<uint32_t>(outputs[node].size())};
+        for (const auto &[byte, child] : edges)
+        {
+            _edgeBytes.push_back(byte);
+            _edgeTargets.push_back(child);
+        }
+        _outputs.insert(_outputs.end(), outputs[node].begin(), outputs[node].end());
+    }
+    for (const auto &[byte, child] : children[0])
+    {
+        _rootChildren[byte] = child;
+    }
+}
+
+/**
+ * @brief Builds the prefilter tables. Signatures at least a q-gram long get the q-grams at offsets 0 to stride - 1
+ * hashed into the long filter; whichever of those positions the scan samples, the q-gram there is in the table.
+ * The first q-grams alone also go into the prefix filter. Shorter signatures set every two byte value they can start
+ * with in the exact short filter.
+ */
+void SignatureSet::BuildFilters()
+{
+    size_t shortestLong = SIZE_MAX;
+    for (const Signature &signature : _signatures)
+    {
+        if (signature.bytes.size() >= SIGNATURE_QGRAM_SIZE)
+            shortestLong = std::min(shortestLong, signature.bytes.size());
+        else
+            _hasShort = true;
+    }
+    _hasLong = shortestLong != SIZE_MAX;
+    if (_hasLong)
+    {
+        _stride = std::min(SIGNATURE_MAX_STRIDE, shortestLong - SIGNATURE_QGRAM_SIZE + 1);
+        _longFilter.assign((1ULL << SIGNATURE_FILTER_BITS) / 64, 0);
+        _prefixFilter.assign((1ULL << SIGNATURE_FILTER_BITS) / 64, 0);
+    }
+    if (_hasShort)
+    {
+        _shortFilter.assign(65536 / 64, 0);
+    }
+
+    for (const Signature &signature : _signatures)
+    {
+        const std::vector<uint8_t> &bytes = signature.bytes;
+        if (bytes.size() >= SIGNATURE_QGRAM_SIZE)
+        {
+            for (size_t k = 0; k < _stride; k++)
+            {
+                uint32_t qgram;
+                memcpy(&qgram, bytes.data() + k, sizeof(qgram));
+                SetBit(_longFilter, HashQgram(qgram));
+                if (k == 0)
+                {
+                    SetBit(_prefixFilter, HashQgram(qgram));
+                }
+            }
+        }
+        else if (bytes.size() == 1)
+        {
+            for (uint32_t next = 0; next < 256; next++)
+            {
+                SetBit(_shortFilter, bytes[0] | next << 8);
+            }
+        }
+        else
+        {
+            SetBit(_shortFilter, bytes[0] | bytes[1] << 8);
+        }
+    }
+}
+
+uint32_t SignatureSet::Child(uint32_t node, uint8_t byte) const
+{
+    if (node == 0)
+    {
+        return _rootChildren[byte];
+    }
+    const TrieNode &trieNode = _nodes[node];
+    const uint8_t *first = _edgeBytes.data() + trieNode.firstEdge;
+    const uint8_t *last = first + trieNode.edgeCount;
+    const uint8_t *edge = std::lower_bound(first, last, byte);
+    if (edge == last || *edge != byte)
+    {
+        return 0;
+    }
+    return _edgeTargets[edge - _edgeBytes.data()];
+}
+
+/**
+ * @brief Follows the trie from a start position, reporting the signatures whose length lies in a range.
+ *
+ * @param data The scanned bytes.
+ * @param start The position of the first byte.
+ * @param minDepth The shortest signature to report.
+ * @param maxDepth The longest signature to report.
+ * @param callback Called once per match.
+ */
+void SignatureSet::Walk(std::span<const uint8_t> data, uint64_t start, size_t minDepth, size_t maxDepth,
+                        const SignatureCallback &callback) const
+{
+    uint32_t node = 0;
+    for (size_t depth = 1; depth <= maxDepth && start + depth <= data.size(); depth++)
+    {
+        node = Child(node, data[start + depth - 1]);
+        if (node == 0)
+        {
+            return;
+        }
+        if (depth < minDepth)
+        {
+            continue;
+        }
+        const TrieNode &trieNode = _nodes[node];
+        for (uint32_t i = 0; i < trieNode.outputCount; i++)
+        {
+            callback({_outputs[trieNode.firstOutput + i], start});
+        }
+    }
+}
+
+/**
+ * @brief Checks a sampled position that passed the long filter: any long signature present covering it starts at
+ * most stride - 1 bytes earlier. Each of those starts is tested against the hashed first q-grams of the
+ * signatures before the trie, whose nodes are mostly out of cache, is walked.
+ */
+void SignatureSet::CheckSample(std::span<const uint8_t> data, uint64_t position,
+                               const SignatureCallback &callback) const
+{
+    uint64_t first = position >= _stride - 1 ? position - (_stride - 1) : 0;
+    for (uint64_t start = first; start <= position && start + SIGNATURE_QGRAM_SIZE <= data.size(); start++)
+    {
+        uint32_t prefix;
+        memcpy(&prefix, data.data() + start, sizeof(prefix));
+        if (TestBit(_prefixFilter, HashQgram(prefix)))
+        {
+            Walk(data, start, SIGNATURE_QGRAM_SIZE, SIZE_MAX, callback);
+        }
+    }
+}
+
+/**
+ * @brief Finds the signatures at least a q-gram long by sampling every stride-th position.
+ */
+void SignatureSet::ScanLong(std::span<const uint8_t> data, const SignatureCallback &callback) const
+{
+    for (uint64_t position = 0; position + SIGNATURE_QGRAM_SIZE <= data.size(); position += _stride)
+    {
+        uint32_t qgram;
+        memcpy(&qgram, data.data() + position, sizeof(qgram));
+        if (TestBit(_longFilter, HashQgram(qgram)))
+        {
+            CheckSample(data, position, callback);
+        }
+    }
+}
+
+/**
+ * @brief Finds the signatures shorter than a q-gram by testing the first two bytes of every position.
+ */
+void SignatureSet::ScanShort(std::span<const uint8_t> data, const SignatureCallback &callback) const
+{
+    for (uint64_t position = 0; position < data.size(); position++)
+    {
+        uint32_t next = position + 1 < data.size() ? data[position + 1] : 0;
+        if (TestBit(_shortFilter, data[position] | next << 8))
+        {
+            Walk(data, position, 1, SIGNATURE_QGRAM_SIZE - 1, callback);
+        }
+    }
+}
+
+/**
+ * @brief Finds every occurrence of every signature, overlapping ones included. Matches of signatures shorter than
+ * a q-gram are reported after the others, so matches are not in offset order.
+ *
+ * @param data The bytes to scan.
+ * @param callback Called once per match.
+ */
+void SignatureSet::Scan(std::span<const uint8_t> data, const SignatureCallback &callback) const
+{
+    if (_hasLong)
+    {
+        ScanLong(data, callback);
+    }
+    if (_hasShort)
+    {
+        ScanShort(data, callback);
+    }
+}
+
+/**
+ * @brief Scans sections of a file for signatures, one section after another in section header order.
+ *
+ * @param elfHandler The parsed file.
+ * @param signatures The compiled signatures.
+ * @param sectionNames The sections to scan. When empty, every allocated section with file contents is scanned.
+ * @param callback Called once per match with its section, in offset order within each section; offsets are
+ * relative to the section.
+ */
+void ScanSectionSignatures(const ElfHandler &elfHandler, const SignatureSet &signatures,
+                           const std::vector<std::string> &sectionNames, const SectionSignatureCallback &callback)
+{
+    for (const std::string &name : sectionNames)
+    {
+        if (elfHandler.FindSection(name) == nullptr)
+        {
+            LOG(Logger::LogLevel::Warning, "Section %s not found", name.c_str());
+        }
+    }
+
+    std::vector<SignatureMatch> matches;
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        bool selected;
+        if (sectionNames.empty())
+        {
+            selected = (section.flags & SectionHeaderFlags::SHF_ALLOC) != 0 &&
+                       section.type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS);
+        }
+        else
+        {
+            selected = std::find(sectionNames.begin(), sectionNames.end(), section.name) != sectionNames.end();
+        }
+        if (!selected)
+        {
+            continue;
+        }
+
+        matches.clear();
+        signatures.Scan(elfHandler.GetSectionData(section),
+                        [&matches](const SignatureMatch &match) { matches.push_back(match); });
+        std::sort(matches.begin(), matches.end(), [](const SignatureMatch &a, const SignatureMatch &b) {
+            return a.offset != b.offset ? a.offset < b.offset : a.signature < b.signature;
+        });
+        for (const SignatureMatch &match : matches)
+        {
+            callback(section, match);
+        }
+    }
+}
+
+/**
+ * @brief Prints one line per match: section, file offset, address, signature name and the symbol containing the
+ * match as symbol+offset, or '-' outside any symbol.
+ */
+void PrintSignatureMatches(const ElfHandler &elfHandler, const SignatureSet &signatures,
+                           const std::vector<std::string> &sectionNames)
+{
+    SymbolMap symbols(elfHandler);
+    ScanSectionSignatures(
+        elfHandler, signatures, sectionNames, [&](const ElfSection &section, const SignatureMatch &match) {
+            uint64_t address = section.addr + match.offset;
+            printf("%-20s 0x%08lx 0x%08lx %s", section.name.c_str(), section.offset + match.offset, address,
+                   signatures.GetSignature(match.signature).name.c_str());
+            const ElfSymbol *symbol = symbols.Find(static_cast<uint16_t>(section.index), address);
+            if (symbol != nullptr)
+                printf(" %s+0x%lx\n", symbol->name.c_str(), address - symbol->value);
+            else
+                printf(" -\n");
+        });
+}
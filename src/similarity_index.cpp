@@ -0,0 +1,474 @@
+#include "similarity_index.hpp"
+#include "content_hash.hpp"
+#include "debug_locator.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+// Fingerprinted functions of one file of the corpus
+struct IndexedFile
+{
+    std::string path;
+    std::vector<SimilarityIndexFunction> functions; // nameOffset holds the index in names until the pool is built
+    std::vector<std::string> names;
+    std::vector<MinHashSignature> signatures;
+};
+
+/**
+ * @brief Checks for the ELF magic without going through the logging error path for non-ELF files.
+ */
+static bool HasElfMagic(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    uint32_t magic = 0;
+    bool isElf = pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == ELFMAG;
+    close(fd);
+    return isElf;
+}
+
+/**
+ * @brief Fingerprints the functions of one corpus file. Files that are not x86-64 or fail to parse are skipped with
+ * a debug message, leaving the list of functions empty. With a pool, the symbol names and the functions of a large
+ * file are split into subtasks that idle workers steal, so one huge binary does not finish the build on one thread.
+ */
+static void FingerprintFile(IndexedFile &file, ThreadPool *pool)
+{
+    try
+    {
+        ElfHandler elfHandler(file.path, pool);
+        if (elfHandler.GetMachine() != static_cast<uint16_t>(ElfMachine::EM_X86_64))
+        {
+            return;
+        }
+        CodeFunctions functions(elfHandler);
+        const std::vector<CodeFunction> &list = functions.GetFunctions();
+        for (const FunctionFingerprint &fingerprint : FingerprintFunctions(functions, pool))
+        {
+            const CodeFunction &function = list[fingerprint.function];
+            uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(function.size, UINT32_MAX));
+            file.functions.push_back(
+                {function.address, size, 0, static_cast<uint32_t>(file.names.size()), fingerprint.instructionCount});
+            file.names.push_back(function.name);
+            file.signatures.push_back(fingerprint.signature);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(Logger::LogLevel::Debug, "Skipping %s: %s", file.path.c_str(), e.what());
+        file.functions.clear();
+        file.names.clear();
+        file.signatures.clear();
+    }
+}
+
+/**
+ * @brief Hashes the rows of one band of a signature, the key two functions must share to become candidates.
+ */
+uint32_t SimilarityBandHash(const MinHashSignature &signature, size_t band)
+{
+    auto rows = std::span<const uint32_t>(signature).subspan(band * SIMILARITY_BAND_ROWS, SIMILARITY_BAND_ROWS);
+    return static_cast<uint32_t>(Xxh3Hash64({reinterpret_cast<const uint8_t *>(rows.data()), rows.size_bytes()}));
+}
+
+/**
+ * @brief Constructor for the SimilarityIndex class. Maps the index file and validates its header and table bounds.
+ *
+ * @param indexPath The index written by Build.
+ * @throws std::runtime_error if the index is missing, from another version or corrupt.
+ */
+SimilarityIndex::SimilarityIndex(const std::string &indexPath)
+{
+    if (access(indexPath.c_str(), R_OK) != 0)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "No similarity index at %s, build one with --similarity-build",
+                  indexPath.c_str());
+    }
+
+    _index = std::make_unique<MappedFile>(indexPath);
+    if (_index->Size() < sizeof(SimilarityIndexHeader))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Similarity index %s is truncated", indexPath.c_str());
+    }
+    auto header = reinterpret_cast<const SimilarityIndexHeader *>(_index->Data());
+    if (memcmp(header->magic, SIMILARITY_INDEX_MAGIC, sizeof(SIMILARITY_INDEX_MAGIC)) != 0 ||
+        header->version != SIMILARITY_INDEX_VERSION || header->hashSize != MINHASH_SIZE ||
+        header->bandCount != SIMILARITY_BAND_COUNT)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Similarity index %s has an unknown format, rebuild it", indexPath.c_str());
+    }
+
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset <= _index->Size() && count <= (_index->Size() - offset) / size;
+    };
+    if (header->functionCount > UINT32_MAX || header->fileCount > UINT32_MAX ||
+        !fits(header->fileOffset, header->fileCount, sizeof(SimilarityIndexFile)) ||
+        !fits(header->functionOffset, header->functionCount, sizeof(SimilarityIndexFunction)) ||
+        !fits(header->signatureOffset, header->functionCount, sizeof(MinHashSignature)) ||
+        !fits(header->bucketOffset, header->functionCount * SIMILARITY_BAND_COUNT, sizeof(SimilarityIndexBucket)) ||
+        !fits(header->stringsOffset, header->stringsSize, 1) || header->stringsSize == 0 ||
+        _index->Data()[header->stringsOffset + header->stringsSize - 1] != '\0' ||
+        header->signatureOffset % alignof(MinHashSignature) != 0 ||
+        header->functionOffset % alignof(SimilarityIndexFunction) != 0 ||
+        header->bucketOffset % alignof(SimilarityIndexBucket) != 0)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Similarity index %s is corrupt, rebuild it", indexPath.c_str());
+    }
+    _index->AdviseRandomAccess();
+    _header = header;
+}
+
+/**
+ * @brief Returns the default index location, similarity-index.bin in the cache directory.
+ */
+std::string SimilarityIndex::DefaultIndexPath()
+{
+    return DebugFileLocator::CacheDirectory() + "/similarity-index.bin";
+}
+
+/**
+ * @brief Fingerprints every x86-64 ELF file below a set of directories and writes a fresh index.
+ *
+ * @details Files are fingerprinted one task each. Every band gets its own table of (hash, function) records sorted
+ * by hash, so the functions sharing a band with a query are one binary search away. The index is written to a
+ * temporary file and renamed into place so that concurrent readers never see a partial index.
+ *
+ * @param directories The directory trees of the corpus. Symbolic links are not followed.
+ * @param indexPath Where to write the index.
+ * @param pool The pool to spread the files over, or nullptr to fingerprint on the calling thread.
+ * @throws std::runtime_error if the index cannot be written.
+ */
+void SimilarityIndex::Build(const std::vector<std::string> &directories, const std::string &indexPath,
+                            ThreadPool *pool)
+{
+    LOG(Logger::LogLevel::Info, "Building similarity index: %s", indexPath.c_str());
+
+    std::vector<IndexedFile> files;
+    for (const auto &root : directories)
+    {
+        std::error_code error;
+        if (std::filesystem::is_regular_file(root, error))
+        {
+            files.push_back({root, {}, {}, {}});
+            continue;
+        }
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, options, error);
+             it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            if (error)
+            {
+                break;
+            }
+            if (it->is_regular_file(error) && !it->is_symlink(error) && HasElfMagic(it->path().string()))
+            {
+                files.push_back({it->path().string(), {}, {}, {}});
+            }
+        }
+    }
+
+    if (pool == nullptr)
+    {
+        for (auto &file : files)
+        {
+            FingerprintFile(file, nullptr);
+        }
+    }
+    else
+    {
+        for (auto &file : files)
+        {
+            pool->Submit([&file, pool]() { FingerprintFile(file, pool); });
+        }
+        pool->Wait();
+    }
+
+    std::string strings(1, '\0'); // offset 0 is the empty string
+    auto addString = [&strings](const std::string &value) {
+        if (value.empty())
+        {
+            return uint32_t(0);
+        }
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings.append(value).push_back('\0');
+        return offset;
+    };
+
+    std::vector<SimilarityIndexFile> fileRecords;
+    std::vector<SimilarityIndexFunction> functions;
+    std::vector<MinHashSignature> signatures;
+    for (auto &file : files)
+    {
+        if (file.functions.empty())
+        {
+            continue;
+        }
+        if (functions.size() + file.functions.size() > UINT32_MAX)
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Too many functions for one similarity index");
+        }
+        uint32_t fileIndex = static_cast<uint32_t>(fileRecords.size());
+        fileRecords.push_back({addString(file.path), static_cast<uint32_t>(functions.size()),
+                               static_cast<uint32_t>(file.functions.size()), 0});
+        for (SimilarityIndexFunction function : file.functions)
+        {
+            function.file = fileIndex;
+            function.nameOffset = addString(file.names[function.nameOffset]);
+            functions.push_back(function);
+        }
+        signatures.insert(signatures.end(), file.signatures.begin(), file.signatures.end());
+        file = IndexedFile{};
+    }
+
+    std::vector<SimilarityIndexBucket> buckets(functions.size() * SIMILARITY_BAND_COUNT);
+    auto sortBand = [&](size_t band) {
+        SimilarityIndexBucket *table = buckets.data() + band * functions.size();
+        for (uint32_t i = 0; i < functions.size(); i++)
+        {
+            table[i] = {SimilarityBandHash(signatures[i], band), i};
+        }
+        std::sort(table, table + functions.size(), [](const auto &a, const auto &b) {
+            return a.bandHash != b.bandHash ? a.bandHash < b.bandHash : a.function < b.function;
+        });
+    };
+    if (pool == nullptr)
+    {
+        for (size_t band = 0; band < SIMILARITY_BAND_COUNT; band++)
+        {
+            sortBand(band);
+        }
+    }
+    else
+    {
+        for (size_t band = 0; band < SIMILARITY_BAND_COUNT; band++)
+        {
+            pool->Submit([&sortBand, band]() { sortBand(band); });
+        }
+        pool->Wait();
+    }
+
+    SimilarityIndexHeader header{};
+    memcpy(header.magic, SIMILARITY_INDEX_MAGIC, sizeof(SIMILARITY_INDEX_MAGIC));
+    header.version = SIMILARITY_INDEX_VERSION;
+    header.hashSize = MINHASH_SIZE;
+    header.bandCount = SIMILARITY_BAND_COUNT;
+    header.fileCount = fileRecords.size();
+    header.fileOffset = sizeof(SimilarityIndexHeader);
+    header.functionCount = functions.size();
+    header.functionOffset = header.fileOffset + fileRecords.size() * sizeof(SimilarityIndexFile);
+    header.signatureOffset = header.functionOffset + functions.size() * sizeof(SimilarityIndexFunction);
+    header.bucketOffset = header.signatureOffset + signatures.size() * sizeof(MinHashSignature);
+    header.stringsSize = strings.size();
+    header.stringsOffset = header.bucketOffset + buckets.size() * sizeof(SimilarityIndexBucket);
+
+    std::error_code error;
+    std::filesystem::path path(indexPath);
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path(), error);
+    }
+
+    std::string tempPath = indexPath + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Failed to write similarity index: %s", tempPath.c_str());
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(fileRecords.data()), fileRecords.size() * sizeof(SimilarityIndexFile));
+        out.write(reinterpret_cast<const char *>(functions.data()), functions.size() * sizeof(SimilarityIndexFunction));
+        out.write(reinterpret_cast<const char *>(signatures.data()), signatures.size() * sizeof(MinHashSignature));
+        out.write(reinterpret_cast<const char *>(buckets.data()), buckets.size() * sizeof(SimilarityIndexBucket));
+        out.write(strings.data(), strings.size());
+        if (!out.good())
+        {
+            LOG_THROW(Logger::LogLevel::Error, "Failed to write similarity index: %s", tempPath.c_str());
+        }
+    }
+    if (rename(tempPath.c_str(), indexPath.c_str()) != 0)
+    {
+        unlink(tempPath.c_str());
+        LOG_THROW(Logger::LogLevel::Error, "Failed to move similarity index into place: %s", indexPath.c_str());
+    }
+    LOG(Logger::LogLevel::Info, "Indexed %zu functions from %zu of %zu files", functions.size(), fileRecords.size(),
+        files.size());
+}
+
+/**
+ * @brief Finds the indexed functions resembling a signature.
+ *
+ * @details Candidates are the functions sharing at least one band hash with the signature; each is then scored on
+ * the full signature, which also weeds out band hash collisions.
+ *
+ * @param signature The signature of the queried function.
+ * @param minSimilarity Candidates estimated less similar than this are dropped.
+ * @param limit The maximum number of matches returned, 0 for all.
+ * @return The matches, most similar first.
+ */
+std::vector<SimilarityMatch> SimilarityIndex::Query(const MinHashSignature &signature, double minSimilarity,
+                                                    size_t limit) const
+{
+    std::vector<uint32_t> candidates;
+    for (size_t band = 0; band < SIMILARITY_BAND_COUNT; band++)
+    {
+        uint32_t hash = SimilarityBandHash(signature, band);
+        auto table = Buckets(band);
+        auto it = std::lower_bound(table.begin(), table.end(), hash,
+                                   [](const auto &bucket, uint32_t key) { return bucket.bandHash < key; });
+        for (; it != table.end() && it->bandHash == hash; ++it)
+        {
+            candidates.push_back(it->function);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<SimilarityMatch> matches;
+    for (uint32_t function : candidates)
+    {
+        double similarity = EstimateSimilarity(signature, Signature(function));
+        if (similarity >= minSimilarity)
+        {
+            matches.push_back({function, similarity});
+        }
+    }
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](const auto &a, const auto &b) { return a.similarity > b.similarity; });
+    if (limit != 0 && matches.size() > limit)
+    {
+        matches.resize(limit);
+    }
+    return matches;
+}
+
+const SimilarityIndexFunction &SimilarityIndex::GetFunction(uint32_t function) const
+{
+    return Functions()[function];
+}
+
+const char *SimilarityIndex::GetFunctionName(uint32_t function) const
+{
+    return IndexString(Functions()[function].nameOffset);
+}
+
+const char *SimilarityIndex::GetFilePath(uint32_t function) const
+{
+    uint32_t file = Functions()[function].file;
+    return file < _header->fileCount ? IndexString(Files()[file].pathOffset) : "";
+}
+
+size_t SimilarityIndex::GetFileCount() const
+{
+    return _header->fileCount;
+}
+
+size_t SimilarityIndex::GetFunctionCount() const
+{
+    return _header->functionCount;
+}
+
+const char *SimilarityIndex::IndexString(uint32_t offset) const
+{
+    if (offset >= _header->stringsSize)
+    {
+        return "";
+    }
+    return reinterpret_cast<const char *>(_index->Data() + _header->stringsOffset + offset);
+}
+
+std::span<const SimilarityIndexFile> SimilarityIndex::Files() const
+{
+    return {reinterpret_cast<const SimilarityIndexFile *>(_index->Data() + _header->fileOffset), _header->fileCount};
+}
+
+std::span<const SimilarityIndexFunction> SimilarityIndex::Functions() const
+{
+    return {reinterpret_cast<const SimilarityIndexFunction *>(_index->Data() + _header->functionOffset),
+            _header->functionCount};
+}
+
+std::span<const SimilarityIndexBucket> SimilarityIndex::Buckets(size_t band) const
+{
+    return {reinterpret_cast<const SimilarityIndexBucket *>(_index->Data() + _header->bucketOffset) +
+                band * _header->functionCount,
+            _header->functionCount};
+}
+
+const MinHashSignature &SimilarityIndex::Signature(uint32_t function) const
+{
+    return reinterpret_cast<const MinHashSignature *>(_index->Data() + _header->signatureOffset)[function];
+}
+
+/**
+ * @brief Prints, for every fingerprinted function of a file, the indexed functions resembling it.
+ *
+ * @param index The corpus index.
+ * @param elfHandler The queried file.
+ * @param functionName Only query the functions of this name, or every function when empty.
+ * @param minSimilarity Matches estimated less similar than this are not listed.
+ * @param limit The maximum number of matches listed per function, 0 for all.
+ * @param pool The pool to fingerprint the file's functions on, or nullptr to use the calling thread.
+ * @throws std::runtime_error if the file is not x86-64.
+ */
+void PrintSimilarFunctions(const SimilarityIndex &index, const ElfHandler &elfHandler, const std::string &functionName,
+                           double minSimilarity, size_t limit, ThreadPool *pool)
+{
+    if (elfHandler.GetMachine() != static_cast<uint16_t>(ElfMachine::EM_X86_64))
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Similarity queries need an x86-64 file, machine is %u",
+                  elfHandler.GetMachine());
+    }
+    CodeFunctions functions(elfHandler);
+    const std::vector<CodeFunction> &list = functions.GetFunctions();
+
+    std::vector<FunctionFingerprint> fingerprints;
+    if (functionName.empty())
+    {
+        fingerprints = FingerprintFunctions(functions, pool);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < list.size(); i++)
+        {
+            FunctionFingerprint fingerprint{i, 0, {}};
+            if (list[i].name == functionName &&
+                ComputeFunctionSignature(functions.GetCode(list[i]), fingerprint.signature,
+                                         fingerprint.instructionCount))
+            {
+                fingerprints.push_back(fingerprint);
+            }
+        }
+        if (fingerprints.empty())
+        {
+            LOG_THROW(Logger::LogLevel::Error, "No function %s of at least %u instructions", functionName.c_str(),
+                      FINGERPRINT_MIN_INSTRUCTIONS);
+        }
+    }
+
+    printf("Index: %zu functions in %zu files\n", index.GetFunctionCount(), index.GetFileCount());
+    for (const FunctionFingerprint &fingerprint : fingerprints)
+    {
+        auto matches = index.Query(fingerprint.signature, minSimilarity, limit);
+        if (matches.empty())
+        {
+            continue;
+        }
+        const CodeFunction &function = list[fingerprint.function];
+        printf("\n0x%lx %s (%u instructions)\n", function.address, function.name.empty() ? "??" : function.name.c_str(),
+               fingerprint.instructionCount);
+        for (const SimilarityMatch &match : matches)
+        {
+            const char *name = index.GetFunctionName(match.function);
+            printf("  %.3f %s 0x%lx %s\n", match.similarity, index.GetFilePath(match.function),
+                   index.GetFunction(match.function).address, *name == '\0' ? "??" : name);
+        }
+    }
+}
@@ -0,0 +1,427 @@
+#include "split_dwarf.hpp"
+#include "logger.hpp"
+#include <filesystem>
+#include <unistd.h>
+
+/**
+ * @brief Constructor for the DwarfPackageIndex class. Only the header and column identifiers are read.
+ *
+ * @param index The contents of .debug_cu_index or .debug_tu_index.
+ * @throws std::runtime_error if the index is truncated or of an unknown version.
+ */
+DwarfPackageIndex::DwarfPackageIndex(std::span<const uint8_t> index) : _index(index)
+{
+    _columns.fill(-1);
+    DwarfReader reader(_index);
+    // Version 5 is a 2 byte version followed by 2 bytes of padding, version 2 a 4 byte version
+    _version = reader.ReadU32();
+    if (_version != 2 && _version != 5)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Unsupported DWARF package index version %u", _version);
+    }
+    _columnCount = reader.ReadU32();
+    _unitCount = reader.ReadU32();
+    _slotCount = reader.ReadU32();
+    if ((_slotCount & (_slotCount - 1)) != 0 || _unitCount > _slotCount)
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Malformed DWARF package index: %u units in %u slots", _unitCount,
+                  _slotCount);
+    }
+
+    _signaturesOffset = reader.GetOffset();
+    _rowsOffset = _signaturesOffset + uint64_t(_slotCount) * 8;
+    uint64_t columnsOffset = _rowsOffset + uint64_t(_slotCount) * 4;
+    _offsetsOffset = columnsOffset + uint64_t(_columnCount) * 4;
+    _sizesOffset = _offsetsOffset + uint64_t(_unitCount) * _columnCount * 4;
+    if (_sizesOffset + uint64_t(_unitCount) * _columnCount * 4 > _index.size())
+    {
+        LOG_THROW(Logger::LogLevel::Error, "Truncated DWARF package index");
+    }
+
+    reader.SetOffset(columnsOffset);
+    for (uint32_t column = 0; column < _columnCount; column++)
+    {
+        uint32_t section = reader.ReadU32();
+        if (section <= DW_SECT_MAX)
+        {
+            _columns[section] = static_cast<int32_t>(column);
+        }
+    }
+}
+
+uint32_t DwarfPackageIndex::GetVersion() const
+{
+    return _version;
+}
+
+uint32_t DwarfPackageIndex::GetUnitCount() const
+{
+    return _unitCount;
+}
+
+/**
+ * @brief Looks a unit up by signature, following the probe sequence of the DWARF 5 package hash table.
+ *
+ * @param signature The DWO id of a compilation unit, or the signature of a type unit.
+ * @return The row of the unit in the offset and size tables, counted from 1; std::nullopt if it is not in the package.
+ */
+std::optional<uint32_t> DwarfPackageIndex::FindRow(uint64_t signature) const
+{
+    if (_slotCount == 0)
+    {
+        return std::nullopt;
+    }
+    uint32_t mask = _slotCount - 1;
+    uint32_t slot = static_cast<uint32_t>(signature) & mask;
+    uint32_t step = (static_cast<uint32_t>(signature >> 32) & mask) | 1;
+    DwarfReader reader(_index);
+    for (uint32_t probe = 0; probe < _slotCount; probe++)
+    {
+        reader.SetOffset(_signaturesOffset + uint64_t(slot) * 8);
+        uint64_t slotSignature = reader.ReadU64();
+        reader.SetOffset(_rowsOffset + uint64_t(slot) * 4);
+        uint32_t row = reader.ReadU32();
+        if (row == 0)
+        {
+            return std::nullopt;
+        }
+        if (slotSignature == signature)
+        {
+            return row <= _unitCount ? std::optional<uint32_t>(row) : std::nullopt;
+        }
+        slot = (slot + step) & mask;
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Returns the contribution of a unit to one section of the package.
+ *
+ * @param row The row of the unit, as returned by FindRow.
+ * @param section The DW_SECT_* identifier of the section.
+ * @return The offset and size of the contribution, std::nullopt if the package has no such column.
+ */
+std::optional<DwarfPackageContribution> DwarfPackageIndex::GetContribution(uint32_t row, uint32_t section) const
+{
+    if (row == 0 || row > _unitCount || section > DW_SECT_MAX || _columns[section] < 0)
+    {
+        return std::nullopt;
+    }
+    uint64_t cell = (uint64_t(row) - 1) * _columnCount + static_cast<uint32_t>(_columns[section]);
+    DwarfReader reader(_index, _offsetsOffset + cell * 4);
+    DwarfPackageContribution contribution{};
+    contribution.offset = reader.ReadU32();
+    reader.SetOffset(_sizesOffset + cell * 4);
+    contribution.size = reader.ReadU32();
+    return contribution;
+}
+
+/**
+ * @brief Constructor for the SplitDwarfResolver class. No file is opened until a unit is resolved.
+ *
+ * @param skeletonSections The debug sections of the binary holding the skeleton units; must outlive the resolver.
+ * @param executable The path of the binary.
+ * @param packagePath The .dwp package to use; <executable>.dwp when empty.
+ */
+SplitDwarfResolver::SplitDwarfResolver(const DwarfSections &skeletonSections, std::string executable,
+                                       std::string packagePath)
+    : _skeletonSections(skeletonSections), _executable(std::move(executable)),
+      _packagePath(packagePath.empty() ? _executable + ".dwp" : std::move(packagePath))
+{
+}
+
+/**
+ * @brief Returns the DWO id linking a skeleton unit to its split unit: the header's for DWARF 5, the DW_AT_GNU_dwo_id
+ * attribute for the GNU extension to DWARF 4.
+ *
+ * @return The DWO id, std::nullopt if the unit is not a skeleton.
+ */
+std::optional<uint64_t> SplitDwarfResolver::GetDwoId(const DwarfUnit &unit)
+{
+    if (unit.GetHeader().unitType == DW_UT_skeleton)
+    {
+        return unit.GetHeader().signature;
+    }
+    if (const DwarfAttribute *dwoId = unit.GetUnitDie().Find(DW_AT_GNU_dwo_id))
+    {
+        return dwoId->value;
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Finds the split unit of a skeleton unit, opening its package or .dwo file on first use.
+ *
+ * @param skeleton A unit of the binary.
+ * @return The split unit, or nullptr if the unit is not a skeleton or its split unit cannot be found.
+ */
+const SplitDwarfUnit *SplitDwarfResolver::Resolve(const DwarfUnit &skeleton)
+{
+    std::optional<uint64_t> dwoId = GetDwoId(skeleton);
+    if (!dwoId)
+    {
+        return nullptr;
+    }
+
+    const SplitFile *package = GetPackage();
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (auto cached = _units.find(*dwoId); cached != _units.end())
+    {
+        return cached->second.get();
+    }
+
+    std::unique_ptr<SplitDwarfUnit> unit;
+    try
+    {
+        if (package != nullptr)
+        {
+            unit = FromPackage(*package, package->cuIndex, *dwoId);
+        }
+        if (!unit)
+        {
+            for (const std::string &candidate : DwoCandidates(skeleton))
+            {
+                const SplitFile *file = GetDwoFile(candidate);
+                unit = file != nullptr ? FromDwoFile(*file, candidate, *dwoId) : nullptr;
+                if (unit)
+                {
+                    break;
+                }
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        unit.reset();
+    }
+    if (!unit)
+    {
+        LOG(Logger::LogLevel::Warning, "No split unit found for DWO id 0x%lx (%s)", *dwoId,
+            std::string(skeleton.GetName()).c_str());
+    }
+    return _units.emplace(*dwoId, std::move(unit)).first->second.get();
+}
+
+/**
+ * @brief Finds a type unit of the package by its signature, for DW_FORM_ref_sig8 references. Only DWARF 5 packages
+ * are searched: DWARF 4 type units live in .debug_types.dwo, which is not read.
+ *
+ * @return The type unit, or nullptr if the package has no such unit.
+ */
+const SplitDwarfUnit *SplitDwarfResolver::FindTypeUnit(uint64_t signature)
+{
+    const SplitFile *package = GetPackage();
+    if (package == nullptr || package->tuIndex.GetVersion() != 5)
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (auto cached = _typeUnits.find(signature); cached != _typeUnits.end())
+    {
+        return cached->second.get();
+    }
+    std::unique_ptr<SplitDwarfUnit> unit;
+    try
+    {
+        unit = FromPackage(*package, package->tuIndex, signature);
+    }
+    catch (const std::exception &e)
+    {
+        unit.reset();
+    }
+    return _typeUnits.emplace(signature, std::move(unit)).first->second.get();
+}
+
+const SplitDwarfResolver::SplitFile *SplitDwarfResolver::GetPackage()
+{
+    std::call_once(_packageOpened, [this]() {
+        if (access(_packagePath.c_str(), R_OK) != 0)
+        {
+            return;
+        }
+        try
+        {
+            _package = OpenFile(_packagePath);
+            if (_package->sections.info.empty() || !_package->elfHandler->FindSection(".debug_cu_index"))
+            {
+                LOG(Logger::LogLevel::Warning, "%s is not a DWARF package", _packagePath.c_str());
+                _package.reset();
+            }
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Ignoring unreadable DWARF package %s", _packagePath.c_str());
+            _package.reset();
+        }
+    });
+    return _package.get();
+}
+
+/**
+ * @brief Returns an opened .dwo file, opening it on first use. Called with the mutex held.
+ *
+ * @return The file, or nullptr if it does not exist or cannot be read.
+ */
+const SplitDwarfResolver::SplitFile *SplitDwarfResolver::GetDwoFile(const std::string &path)
+{
+    auto [it, inserted] = _dwoFiles.try_emplace(path);
+    if (inserted && access(path.c_str(), R_OK) == 0)
+    {
+        try
+        {
+            it->second = OpenFile(path);
+        }
+        catch (const std::exception &e)
+        {
+            LOG(Logger::LogLevel::Warning, "Ignoring unreadable split DWARF file %s", path.c_str());
+        }
+    }
+    return it->second.get();
+}
+
+/**
+ * @brief Opens a .dwo file or .dwp package and reads its index sections.
+ *
+ * @throws std::runtime_error if the file is not a valid ELF file or its indices are malformed.
+ */
+std::unique_ptr<SplitDwarfResolver::SplitFile> SplitDwarfResolver::OpenFile(const std::string &path) const
+{
+    auto file = std::make_unique<SplitFile>();
+    file->elfHandler = std::make_unique<ElfHandler>(path);
+    file->elfHandler->GetFile().AdviseRandomAccess();
+    file->decompressor = std::make_unique<SectionDecompressor>(*file->elfHandler);
+    // Opened from within pool tasks, so the sections are decompressed on the calling thread
+    file->sections = LoadDwarfSections(*file->elfHandler, *file->decompressor, ".dwo");
+
+    auto loadIndex = [&file](const char *name) {
+        const ElfSection *section = file->elfHandler->FindSection(name);
+        return section != nullptr ? DwarfPackageIndex(file->elfHandler->GetSectionData(*section)) : DwarfPackageIndex();
+    };
+    file->cuIndex = loadIndex(".debug_cu_index");
+    file->tuIndex = loadIndex(".debug_tu_index");
+    return file;
+}
+
+/**
+ * @brief Builds a unit from its contributions to the sections of a package.
+ *
+ * @return The unit, or nullptr if the index has no unit with that signature.
+ * @throws std::runtime_error if a contribution lies outside its section.
+ */
+std::unique_ptr<SplitDwarfUnit> SplitDwarfResolver::FromPackage(const SplitFile &package,
+                                                                const DwarfPackageIndex &index,
+                                                                uint64_t signature) const
+{
+    std::optional<uint32_t> row = index.FindRow(signature);
+    if (!row)
+    {
+        return nullptr;
+    }
+    auto contribution = [&index, row](std::span<const uint8_t> section, uint32_t column) {
+        std::optional<DwarfPackageContribution> part = index.GetContribution(*row, column);
+        if (!part)
+        {
+            return std::span<const uint8_t>{};
+        }
+        if (part->offset > section.size() || part->size > section.size() - part->offset)
+        {
+            LOG_THROW(Logger::LogLevel::Error, "DWARF package contribution 0x%x+0x%x exceeds its section",
+                      part->offset, part->size);
+        }
+        return section.subspan(part->offset, part->size);
+    };
+
+    auto unit = std::make_unique<SplitDwarfUnit>();
+    unit->sections = _skeletonSections;
+    unit->sections.info = contribution(package.sections.info, DW_SECT_INFO);
+    unit->sections.abbrev = contribution(package.sections.abbrev, DW_SECT_ABBREV);
+    unit->sections.strOffsets = contribution(package.sections.strOffsets, DW_SECT_STR_OFFSETS);
+    unit->sections.str = package.sections.str;
+    if (index.GetVersion() == 5)
+    {
+        unit->sections.rnglists = contribution(package.sections.rnglists, DW_SECT_RNGLISTS);
+    }
+    unit->sections.decompressed.insert(unit->sections.decompressed.end(), package.sections.decompressed.begin(),
+                                       package.sections.decompressed.end());
+    unit->header = ReadUnitHeader(unit->sections.info, 0);
+    unit->abbrevs = std::make_unique<DwarfAbbrevCache>(unit->sections.abbrev);
+    unit->fileName = package.elfHandler->GetFileName();
+    return unit;
+}
+
+/**
+ * @brief Finds the split compilation unit with a DWO id in a .dwo file.
+ *
+ * @return The unit, or nullptr if the file has no unit with that id.
+ * @throws std::runtime_error if the file is malformed.
+ */
+std::unique_ptr<SplitDwarfUnit> SplitDwarfResolver::FromDwoFile(const SplitFile &file, const std::string &path,
+                                                                uint64_t dwoId) const
+{
+    DwarfAbbrevCache abbrevs(file.sections.abbrev);
+    for (const DwarfUnitHeader &header : ReadUnitHeaders(file.sections.info))
+    {
+        bool matches = header.unitType == DW_UT_split_compile && header.signature == dwoId;
+        if (header.version < 5 && header.unitType == DW_UT_compile)
+        {
+            DwarfUnit unit(file.sections, header, abbrevs.Get(header.abbrevOffset));
+            matches = GetDwoId(unit) == dwoId;
+        }
+        if (!matches)
+        {
+            continue;
+        }
+
+        auto unit = std::make_unique<SplitDwarfUnit>();
+        unit->sections = _skeletonSections;
+        unit->sections.info = file.sections.info.subspan(header.offset, header.endOffset - header.offset);
+        unit->sections.abbrev = file.sections.abbrev;
+        unit->sections.strOffsets = file.sections.strOffsets;
+        unit->sections.str = file.sections.str;
+        if (header.version >= 5)
+        {
+            unit->sections.rnglists = file.sections.rnglists;
+        }
+        unit->sections.decompressed.insert(unit->sections.decompressed.end(), file.sections.decompressed.begin(),
+                                           file.sections.decompressed.end());
+        unit->header = ReadUnitHeader(unit->sections.info, 0);
+        unit->abbrevs = std::make_unique<DwarfAbbrevCache>(unit->sections.abbrev);
+        unit->fileName = path;
+        return unit;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Lists the paths a skeleton's .dwo file may be at: DW_AT_dwo_name as is when absolute, else relative to
+ * DW_AT_comp_dir, then in the binary's directory in case the build tree was moved.
+ */
+std::vector<std::string> SplitDwarfResolver::DwoCandidates(const DwarfUnit &skeleton) const
+{
+    const DwarfAttribute *name = skeleton.GetUnitDie().Find(DW_AT_dwo_name);
+    name = name != nullptr ? name : skeleton.GetUnitDie().Find(DW_AT_GNU_dwo_name);
+    if (name == nullptr)
+    {
+        return {};
+    }
+    std::filesystem::path dwoName(std::string(skeleton.GetString(*name)));
+    if (dwoName.empty())
+    {
+        return {};
+    }
+    if (dwoName.is_absolute())
+    {
+        return {dwoName.string()};
+    }
+
+    std::vector<std::string> candidates;
+    std::string_view compDir = skeleton.GetCompDir();
+    if (!compDir.empty())
+    {
+        candidates.push_back((std::filesystem::path(std::string(compDir)) / dwoName).string());
+    }
+    std::filesystem::path directory = std::filesystem::path(_executable).parent_path();
+    candidates.push_back((directory / dwoName).string());
+    candidates.push_back((directory / dwoName.filename()).string());
+    return candidates;
+}
@@ -0,0 +1,266 @@
+#include "string_scanner.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRING_SCANNER_X86 1
+#endif
+
+// Lattice of the even and odd byte positions of a block
+constexpr uint64_t EVEN_POSITIONS = 0x5555555555555555ULL;
+constexpr uint64_t ODD_POSITIONS = 0xAAAAAAAAAAAAAAAAULL;
+
+// Printable and zero bytes of one block, bit i standing for byte i
+struct BlockMasks
+{
+    uint64_t printable;
+    uint64_t zero;
+};
+
+// Run of valid character positions carried across blocks
+struct RunState
+{
+    bool inRun = false;
+    uint64_t start = 0;
+};
+
+/**
+ * @brief Returns whether a byte is printable the way GNU strings sees it: graphic ASCII, space or tab.
+ */
+static inline bool IsPrintable(uint8_t byte)
+{
+    return (byte >= 0x20 && byte <= 0x7e) || byte == '\t';
+}
+
+static BlockMasks ClassifyBlockScalar(const uint8_t *block)
+{
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < STRING_SCAN_BLOCK_SIZE; i++)
+    {
+        masks.printable |= uint64_t(IsPrintable(block[i])) << i;
+        masks.zero |= uint64_t(block[i] == 0) << i;
+    }
+    return masks;
+}
+
+#ifdef STRING_SCANNER_X86
+/**
+ * @brief Classifies 32 bytes with signed compares: bytes of 0x80 and above are negative, so one greater-than and one
+ * less-than test select 0x20 to 0x7e.
+ */
+__attribute__((target("avx2"))) static inline void ClassifyHalfAvx2(const uint8_t *data, uint32_t &printable,
+                                                                    uint32_t &zero)
+{
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+    __m256i graphic = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(0x1f)),
+                                       _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7f), bytes));
+    __m256i tab = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t'));
+    printable = uint32_t(_mm256_movemask_epi8(_mm256_or_si256(graphic, tab)));
+    zero = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_setzero_si256())));
+}
+
+__attribute__((target("avx2"))) static BlockMasks ClassifyBlockAvx2(const uint8_t *block)
+{
+    uint32_t printableLow, zeroLow, printableHigh, zeroHigh;
+    ClassifyHalfAvx2(block, printableLow, zeroLow);
+    ClassifyHalfAvx2(block + 32, printableHigh, zeroHigh);
+    return {printableLow | uint64_t(printableHigh) << 32, zeroLow | uint64_t(zeroHigh) << 32};
+}
+#endif
+
+static BlockMasks ClassifyBlock(const uint8_t *block)
+{
+#ifdef STRING_SCANNER_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+    {
+        return ClassifyBlockAvx2(block);
+    }
+#endif
+    return ClassifyBlockScalar(block);
+}
+
+/**
+ * @brief Advances a run of character positions over one block. Runs start at a valid position and end at the
+ * first lattice position that is not valid; runs long enough are reported.
+ *
+ * @param state The run carried over from the previous block.
+ * @param base Offset of the block within the data.
+ * @param valid Positions holding a character.
+ * @param invalid Lattice positions not holding one.
+ * @param report Called with the start and end offsets of every finished run.
+ */
+template <typename Report>
+static inline void AdvanceRuns(RunState &state, uint64_t base, uint64_t valid, uint64_t invalid, Report &&report)
+{
+    size_t position = 0;
+    while (position < STRING_SCAN_BLOCK_SIZE)
+    {
+        uint64_t pending = (state.inRun ? invalid : valid) & (~0ULL << position);
+        if (pending == 0)
+        {
+            return;
+        }
+        size_t next = __builtin_ctzll(pending);
+        if (state.inRun)
+        {
+            report(state.start, base + next);
+        }
+        else
+        {
+            state.start = base + next;
+        }
+        state.inRun = !state.inRun;
+        position = next + 1;
+    }
+}
+
+/**
+ * @brief Finds the runs of printable ASCII and UTF-16LE characters in a buffer. Each 64-byte block is classified
+ * into a printable and a zero mask with two vector compares per 32 bytes, and runs are then followed through the
+ * masks with bit scans, so long stretches of non-string data cost a few instructions per block. UTF-16LE runs are
+ * tracked separately on even and odd offsets.
+ *
+ * @param data The bytes to scan.
+ * @param options Minimum length and encodings to report.
+ * @param callback Called once per string, with a view of its bytes.
+ */
+void ScanStrings(std::span<const uint8_t> data, const StringScanOptions &options, const StringCallback &callback)
+{
+    size_t minLength = std::max<size_t>(options.minLength, 1);
+    RunState asciiRun;
+    RunState utf16Runs[2];
+    auto reportAscii = [&](uint64_t start, uint64_t end) {
+        if (end - start >= minLength)
+        {
+            callback({StringEncoding::Ascii, start, data.subspan(start, end - start), end - start});
+        }
+    };
+    auto reportUtf16 = [&](uint64_t start, uint64_t end) {
+        if ((end - start) / 2 >= minLength)
+        {
+            callback({StringEncoding::Utf16Le, start, data.subspan(start, end - start), (end - start) / 2});
+        }
+    };
+
+    // UTF-16LE characters need the zero bit of the following byte, so each block is finished once the next one
+    // has been classified
+    BlockMasks previous{0, 0};
+    auto finishUtf16 = [&](uint64_t base, uint64_t nextZero) {
+        uint64_t characters = previous.printable & ((previous.zero >> 1) | (nextZero << 63));
+        AdvanceRuns(utf16Runs[0], base, characters & EVEN_POSITIONS, ~characters & EVEN_POSITIONS, reportUtf16);
+        AdvanceRuns(utf16Runs[1], base, characters & ODD_POSITIONS, ~characters & ODD_POSITIONS, reportUtf16);
+    };
+
+    uint8_t tail[STRING_SCAN_BLOCK_SIZE];
+    for (uint64_t base = 0; base < data.size(); base += STRING_SCAN_BLOCK_SIZE)
+    {
+        const uint8_t *block = data.data() + base;
+        if (data.size() - base < STRING_SCAN_BLOCK_SIZE)
+        {
+            // Zero filled bytes past the end are not printable, so they end any open run
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, block, data.size() - base);
+            block = tail;
+        }
+        BlockMasks masks = ClassifyBlock(block);
+        if (block == tail)
+        {
+            masks.zero &= (1ULL << (data.size() - base)) - 1;
+        }
+        if (options.ascii)
+        {
+            AdvanceRuns(asciiRun, base, masks.printable, ~masks.printable, reportAscii);
+        }
+        if (options.utf16le)
+        {
+            if (base != 0)
+            {
+                finishUtf16(base - STRING_SCAN_BLOCK_SIZE, masks.zero & 1);
+            }
+            previous = masks;
+        }
+    }
+
+    if (options.ascii && asciiRun.inRun)
+    {
+        reportAscii(asciiRun.start, data.size());
+    }
+    if (options.utf16le && !data.empty())
+    {
+        finishUtf16((data.size() - 1) & ~(STRING_SCAN_BLOCK_SIZE - 1), 0);
+        for (RunState &run : utf16Runs)
+        {
+            if (run.inRun)
+            {
+                reportUtf16(run.start, data.size());
+            }
+        }
+    }
+}
+
+/**
+ * @brief Scans sections of a file for strings, one section after another in section header order.
+ *
+ * @param elfHandler The parsed file.
+ * @param sectionNames The sections to scan. When empty, every allocated, non-executable section with file contents
+ * is scanned, which covers .rodata, .data and the other initialised data.
+ * @param options Minimum length and encodings to report.
+ * @param callback Called once per string with its section; offsets are relative to the section.
+ */
+void ScanSectionStrings(const ElfHandler &elfHandler, const std::vector<std::string> &sectionNames,
+                        const StringScanOptions &options, const SectionStringCallback &callback)
+{
+    for (const std::string &name : sectionNames)
+    {
+        if (elfHandler.FindSection(name) == nullptr)
+        {
+            LOG(Logger::LogLevel::Warning, "Section %s not found", name.c_str());
+        }
+    }
+
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        bool selected;
+        if (sectionNames.empty())
+        {
+            selected = (section.flags & SectionHeaderFlags::SHF_ALLOC) != 0 &&
+                       (section.flags & SectionHeaderFlags::SHF_EXECINSTR) == 0 &&
+                       section.type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS);
+        }
+        else
+        {
+            selected = std::find(sectionNames.begin(), sectionNames.end(), section.name) != sectionNames.end();
+        }
+        if (!selected)
+        {
+            continue;
+        }
+        ScanStrings(elfHandler.GetSectionData(section), options,
+                    [&section, &callback](const FoundString &string) { callback(section, string); });
+    }
+}
+
+/**
+ * @brief Prints a string with its section, file offset and encoding, writing the characters straight from the
+ * scanned bytes.
+ */
+void PrintString(const ElfSection &section, const FoundString &string)
+{
+    printf("%-20s 0x%08lx %s ", section.name.c_str(), section.offset + string.offset,
+           string.encoding == StringEncoding::Ascii ? "a" : "w");
+    if (string.encoding == StringEncoding::Ascii)
+    {
+        fwrite(string.bytes.data(), 1, string.bytes.size(), stdout);
+    }
+    else
+    {
+        for (size_t i = 0; i < string.bytes.size(); i += 2)
+        {
+            putchar(string.bytes[i]);
+        }
+    }
+    putchar('\n');
+}
@@ -0,0 +1,73 @@
+#include "symbol_map.hpp"
+#include <algorithm>
+
+/**
+ * @brief Constructor for the SymbolMap class. Keeps the defined functions and objects with a size; when several
+ * symbols start at the same address, global ones are preferred over weak and local aliases.
+ *
+ * @param elfHandler The parsed file.
+ */
+SymbolMap::SymbolMap(const ElfHandler &elfHandler)
+{
+    std::vector<ElfSymbol> symbols = elfHandler.GetSymbols();
+    if (symbols.empty())
+    {
+        symbols = elfHandler.GetDynamicSymbols();
+    }
+
+    for (ElfSymbol &symbol : symbols)
+    {
+        bool code = symbol.type == SymbolType::STT_FUNC || symbol.type == SymbolType::STT_GNU_IFUNC;
+        bool data = symbol.type == SymbolType::STT_OBJECT || symbol.type == SymbolType::STT_TLS;
+        if ((code || data) && symbol.size != 0 && symbol.sectionIndex != SHN_UNDEF && symbol.sectionIndex < SHN_ABS)
+        {
+            _symbols.push_back(std::move(symbol));
+        }
+    }
+
+    auto rank = [](const ElfSymbol &symbol) { return symbol.binding == SymbolBinding::STB_GLOBAL ? 0 : 1; };
+    std::sort(_symbols.begin(), _symbols.end(), [&rank](const ElfSymbol &a, const ElfSymbol &b) {
+        if (a.sectionIndex != b.sectionIndex)
+            return a.sectionIndex < b.sectionIndex;
+        if (a.value != b.value)
+            return a.value < b.value;
+        return rank(a) < rank(b);
+    });
+    _symbols.erase(std::unique(_symbols.begin(), _symbols.end(),
+                               [](const ElfSymbol &a, const ElfSymbol &b) {
+                                   return a.sectionIndex == b.sectionIndex && a.value == b.value;
+                               }),
+                   _symbols.end());
+}
+
+/**
+ * @brief Finds the symbol containing a location.
+ *
+ * @param sectionIndex The section table index of the location.
+ * @param address The address, or the section offset in relocatable files.
+ * @return The symbol, or nullptr if no sized symbol covers the location.
+ */
+const ElfSymbol *SymbolMap::Find(uint16_t sectionIndex, uint64_t address) const
+{
+    auto it = std::upper_bound(_symbols.begin(), _symbols.end(), std::make_pair(sectionIndex, address),
+                               [](const std::pair<uint16_t, uint64_t> &location, const ElfSymbol &symbol) {
+                                   if (location.first != symbol.sectionIndex)
+                                       return location.first < symbol.sectionIndex;
+                                   return location.second < symbol.value;
+                               });
+    if (it == _symbols.begin())
+    {
+        return nullptr;
+    }
+    --it;
+    if (it->sectionIndex != sectionIndex || address - it->value >= it->size)
+    {
+        return nullptr;
+    }
+    return &*it;
+}
+
+const std::vector<ElfSymbol> &SymbolMap::GetSymbols() const
+{
+    return _symbols;
+}
@@ -0,0 +1,191 @@
+#include "symbolizer.hpp"
+#include <algorithm>
+#include <cstdio>
+
+/**
+ * @brief Constructor for the Symbolizer class. Nothing is decoded until an address is resolved.
+ *
+ * @param elfHandler The file holding the debug sections; must outlive the symbolizer.
+ * @param cachePath Where to keep the DWARF unit index cache; no cache when empty.
+ * @param packagePath The .dwp package of a split DWARF build; <file>.dwp when empty.
+ * @param pool The pool to decompress the debug sections and build the unit index on, or nullptr for the calling
+ * thread.
+ */
+Symbolizer::Symbolizer(const ElfHandler &elfHandler, std::string cachePath, std::string packagePath,
+                       ThreadPool *pool)
+    : _sections(LoadDwarfSections(elfHandler, pool)), _unitIndex(_sections, std::move(cachePath), pool),
+      _lineIndex(_sections, pool), _splitUnits(_sections, elfHandler.GetFileName(), std::move(packagePath)),
+      _functionIndex(_sections, &_splitUnits), _callFrames(elfHandler), _goTable(elfHandler)
+{
+}
+
+/**
+ * @brief Resolves an address to its inline chain.
+ *
+ * @param address The address to resolve.
+ * @return The frames, innermost first; empty if the address has no debug information.
+ */
+std::vector<SymbolizedFrame> Symbolizer::Symbolize(uint64_t address)
+{
+    return Resolve(address, _unitIndex.FindUnit(address));
+}
+
+/**
+ * @brief Resolves many addresses on a thread pool. The units of all addresses are mapped first, then every distinct
+ * unit is decoded as a separate task, and finally the addresses are resolved against the decoded units.
+ *
+ * @param addresses The addresses to resolve.
+ * @param pool The pool to run on.
+ * @return The frames of every address, innermost first, in the order of the addresses.
+ */
+std::vector<std::vector<SymbolizedFrame>> Symbolizer::SymbolizeBatch(std::span<const uint64_t> addresses,
+                                                                     ThreadPool &pool)
+{
+    std::vector<std::optional<uint64_t>> unitOffsets(addresses.size());
+    std::vector<uint64_t> distinctUnits;
+    for (size_t i = 0; i < addresses.size(); i++)
+    {
+        unitOffsets[i] = _unitIndex.FindUnit(addresses[i]);
+        if (unitOffsets[i])
+        {
+            distinctUnits.push_back(*unitOffsets[i]);
+        }
+    }
+    std::sort(distinctUnits.begin(), distinctUnits.end());
+    distinctUnits.erase(std::unique(distinctUnits.begin(), distinctUnits.end()), distinctUnits.end());
+
+    TaskGroup group(pool);
+    for (uint64_t unitOffset : distinctUnits)
+    {
+        group.Submit([this, unitOffset]() {
+            const DwarfUnitFunctions *functions = _functionIndex.GetUnitAtOffset(unitOffset);
+            if (functions != nullptr && functions->GetStmtList())
+            {
+                _lineIndex.GetTableAtOffset(*functions->GetStmtList(), functions->GetCompDir());
+            }
+        });
+    }
+    group.Wait();
+
+    std::vector<std::vector<SymbolizedFrame>> results(addresses.size());
+    constexpr size_t chunkSize = 256;
+    for (size_t start = 0; start < addresses.size(); start += chunkSize)
+    {
+        group.Submit([&, start]() {
+            size_t end = std::min(start + chunkSize, addresses.size());
+            for (size_t i = start; i < end; i++)
+            {
+                results[i] = Resolve(addresses[i], unitOffsets[i]);
+            }
+        });
+    }
+    group.Wait();
+    return results;
+}
+
+std::vector<SymbolizedFrame> Symbolizer::Resolve(uint64_t address, std::optional<uint64_t> unitOffset)
+{
+    std::vector<SymbolizedFrame> frames;
+    if (!unitOffset)
+    {
+        return ResolveFromGoTable(address);
+    }
+    const DwarfUnitFunctions *functions = _functionIndex.GetUnitAtOffset(*unitOffset);
+    if (functions == nullptr || !functions->GetStmtList())
+    {
+        return ResolveFromGoTable(address);
+    }
+    const DwarfLineTable *table = _lineIndex.GetTableAtOffset(*functions->GetStmtList(), functions->GetCompDir());
+    auto location = _lineIndex.Lookup(address, *functions->GetStmtList(), functions->GetCompDir());
+    SymbolizedFrame frame{"", "??", 0, 0, false};
+    if (location)
+    {
+        frame.fileName = std::move(location->fileName);
+        frame.line = location->line;
+        frame.column = location->column;
+    }
+
+    const DwarfFunction *function = functions->FindFunction(address);
+    if (function == nullptr)
+    {
+        if (!location)
+        {
+            return ResolveFromGoTable(address);
+        }
+        frames.push_back(std::move(frame));
+        return frames;
+    }
+
+    // Each inlined call is named after the callee and located at the current position; the position then moves to
+    // its call site in the caller
+    auto displayName = [](std::string_view name, std::string_view linkageName) {
+        return std::string(linkageName.empty() ? name : linkageName);
+    };
+    const auto &inlinedCalls = functions->GetInlinedCalls();
+    const DwarfInlinedCall *call = functions->FindInlinedCall(*function, address);
+    while (call != nullptr)
+    {
+        frame.function = displayName(call->name, call->linkageName);
+        frame.inlined = true;
+        frames.push_back(frame);
+
+        frame.fileName = table != nullptr ? table->GetFileName(call->callFile) : "??";
+        frame.line = call->callLine;
+        frame.column = call->callColumn;
+        call = call->parent == DWARF_NO_INLINE ? nullptr : &inlinedCalls[call->parent];
+    }
+    frame.function = displayName(function->name, function->linkageName);
+    frame.inlined = false;
+    frames.push_back(std::move(frame));
+    return frames;
+}
+
+/**
+ * @brief Resolves an address without debug information from the pclntab of a Go binary, decoding only the function
+ * containing the address. Falls back to the call frame information for other files and for code outside the table.
+ *
+ * @return A single frame, or no frame if neither source covers the address.
+ */
+std::vector<SymbolizedFrame> Symbolizer::ResolveFromGoTable(uint64_t address) const
+{
+    auto function = _goTable.FindFunction(address);
+    if (!function)
+    {
+        return ResolveFromCallFrames(address);
+    }
+    SymbolizedFrame frame{std::string(function->name), "??", 0, 0, false};
+    if (auto location = _goTable.FindLocation(*function, address))
+    {
+        if (!location->fileName.empty())
+        {
+            frame.fileName = location->fileName;
+        }
+        frame.line = location->line;
+    }
+    return {std::move(frame)};
+}
+
+/**
+ * @brief Names the function containing an address after the start of its FDE, for code without debug information.
+ *
+ * @return A single frame named sub_<start>, or no frame if no FDE covers the address.
+ */
+std::vector<SymbolizedFrame> Symbolizer::ResolveFromCallFrames(uint64_t address) const
+{
+    std::optional<CfiFde> fde;
+    try
+    {
+        fde = _callFrames.FindFde(address);
+    }
+    catch (const std::exception &e)
+    {
+        return {};
+    }
+    if (!fde)
+    {
+        return {};
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "sub_%lx", fde->pcBegin);
+    return {SymbolizedFrame{name, "??", 0, 0, false}};
+}
@@ -0,0 +1,376 @@
+#include "template_bloat.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <unordered_map>
+
+// Demangler output naming something that is not a function or object of its own: the prefix is dropped and the
+// entity's qualified name gets a leaf of this name, or none for thunks, which count toward their target
+struct SpecialNamePrefix
+{
+    std::string_view prefix;
+    const char *leaf;
+};
+
+static constexpr SpecialNamePrefix SPECIAL_NAME_PREFIXES[] = {
+    {"vtable for ", "[vtable]"},
+    {"construction vtable for ", "[vtable]"},
+    {"VTT for ", "[VTT]"},
+    {"typeinfo for ", "[typeinfo]"},
+    {"typeinfo name for ", "[typeinfo name]"},
+    {"guard variable for ", "[guard variable]"},
+    {"TLS init function for ", "[TLS init]"},
+    {"TLS wrapper function for ", "[TLS wrapper]"},
+    {"non-virtual thunk to ", nullptr},
+    {"virtual thunk to ", nullptr},
+    {"covariant return thunk to ", nullptr},
+    {"transaction clone for ", nullptr},
+};
+
+/**
+ * @brief Returns the position just past the bracket closing the one at the start position, counting nested
+ * brackets of the same kind, or the end of the name if it is unbalanced.
+ */
+static size_t SkipBracketed(std::string_view name, size_t position, char open, char close)
+{
+    size_t depth = 0;
+    for (size_t i = position; i < name.size(); i++)
+    {
+        if (name[i] == open)
+        {
+            depth++;
+        }
+        else if (name[i] == close && --depth == 0)
+        {
+            return i + 1;
+        }
+    }
+    return name.size();
+}
+
+/**
+ * @brief Splits a demangled name into its scopes, dropping what does not identify the entity.
+ *
+ * @details The name ends at the parameter list, so parameters, cv-qualifiers and clone suffixes go; the parameters of
+ * a function enclosing a local entity are dropped alone. A space outside brackets ends a return type, which is
+ * dropped too. Template arguments become <>, ABI tags are dropped, and lambdas and unnamed types lose their
+ * numbering. Operator names are kept whole, so operator<< is not read as a template argument list.
+ *
+ * @param demangled The demangled name, such as "void std::vector<int>::_M_realloc_insert<int>(int&&)".
+ * @return The scopes, outermost first, such as {"std", "vector<>", "_M_realloc_insert<>"}.
+ */
+std::vector<std::string> SplitSymbolName(std::string_view demangled)
+{
+    constexpr std::string_view anonymous = "(anonymous namespace)";
+    constexpr std::string_view operatorChars = "+-*/%^&|~!=<>,[]";
+
+    std::vector<std::string> scopes;
+    std::string current;
+    size_t i = 0;
+    while (i < demangled.size())
+    {
+        char c = demangled[i];
+        if (demangled.substr(i, anonymous.size()) == anonymous)
+        {
+            current += anonymous;
+            i += anonymous.size();
+        }
+        else if (current == "operator" && demangled.substr(i, 2) == "()")
+        {
+            current += "()";
+            i += 2;
+        }
+        else if (current == "operator" && operatorChars.find(c) != std::string_view::npos)
+        {
+            while (i < demangled.size() && operatorChars.find(demangled[i]) != std::string_view::npos)
+            {
+                current += demangled[i++];
+            }
+        }
+        else if (c == ':' && demangled.substr(i, 2) == "::")
+        {
+            scopes.push_back(std::move(current));
+            current.clear();
+            i += 2;
+        }
+        else if (c == '<')
+        {
+            current += "<>";
+            i = SkipBracketed(demangled, i, '<', '>');
+        }
+        else if (c == '[')
+        {
+            i = SkipBracketed(demangled, i, '[', ']');
+        }
+        else if (c == '{')
+        {
+            // {lambda(int)#1} and {unnamed type#2} keep their kind only
+            size_t end = SkipBracketed(demangled, i, '{', '}');
+            std::string_view inner = demangled.substr(i + 1, end - i - 1);
+            current.append("{").append(inner.substr(0, inner.find_first_of("(#"))).append("}");
+            i = end;
+        }
+        else if (c == '(' && (current == "decltype" || (current.empty() && scopes.empty())))
+        {
+            // decltype (expression) return type
+            current.clear();
+            i = SkipBracketed(demangled, i, '(', ')');
+        }
+        else if (c == '(')
+        {
+            // Parameters of the function, unless it encloses a local entity as in foo() const::{lambda()#1}
+            size_t end = SkipBracketed(demangled, i, '(', ')');
+            if (demangled.substr(end).starts_with(" const"))
+            {
+                end += 6;
+            }
+            if (!demangled.substr(end).starts_with("::"))
+            {
+                break;
+            }
+            i = end;
+        }
+        else if (c == ' ' && current.starts_with("operator"))
+        {
+            // operator new and conversion operators keep their space, operator< <T> loses it
+            if (current == "operator")
+            {
+                current += c;
+            }
+            i++;
+        }
+        else if (c == ' ')
+        {
+            scopes.clear();
+            current.clear();
+            i++;
+        }
+        else
+        {
+            current += c;
+            i++;
+        }
+    }
+    if (!current.empty() || scopes.empty())
+    {
+        scopes.push_back(std::move(current));
+    }
+    return scopes;
+}
+
+/**
+ * @brief Demangles a symbol name and splits it into scopes. Names that are not mangled C++ names go under [C], and
+ * the prefixes of vtables, typeinfo, guard variables and thunks are turned into leaves or dropped.
+ *
+ * @param name The symbol name.
+ * @param buffer Demangler output buffer, reused from one call to the next and grown with realloc as needed.
+ * @param bufferSize Size of the buffer.
+ */
+static std::vector<std::string> SymbolScopes(const std::string &name, char *&buffer, size_t &bufferSize)
+{
+    // Compilers append .suffixes to the mangled names of clones and local copies, as in _Z3foov.cold
+    int status = -1;
+    if (name.starts_with("_Z"))
+    {
+        std::string mangled = name.substr(0, name.find('.'));
+        char *demangled = abi::__cxa_demangle(mangled.c_str(), buffer, &bufferSize, &status);
+        if (status == 0)
+        {
+            buffer = demangled;
+        }
+    }
+    if (status != 0)
+    {
+        return {"[C]", name};
+    }
+
+    std::string_view demangled(buffer);
+    for (const SpecialNamePrefix &special : SPECIAL_NAME_PREFIXES)
+    {
+        if (demangled.starts_with(special.prefix))
+        {
+            demangled.remove_prefix(special.prefix.size());
+            std::vector<std::string> scopes = SplitSymbolName(demangled.substr(0, demangled.find("-in-")));
+            if (special.leaf != nullptr)
+            {
+                scopes.push_back(special.leaf);
+            }
+            return scopes;
+        }
+    }
+    return SplitSymbolName(demangled);
+}
+
+/**
+ * @brief Constructor for the TemplateBloatReport class. Collects the sized symbols, demangles and splits their
+ * names in batches, then builds the hierarchy and its totals.
+ *
+ * @param elfHandler The parsed file.
+ * @param pool The pool to spread the demangling over, or nullptr to demangle on the calling thread.
+ */
+TemplateBloatReport::TemplateBloatReport(const ElfHandler &elfHandler, ThreadPool *pool)
+{
+    _nodes.push_back({"", TEMPLATE_BLOAT_ROOT, 0, 0, 0, 0, {}});
+
+    std::vector<ElfSymbol> symbols = elfHandler.GetSymbols();
+    if (symbols.empty())
+    {
+        LOG(Logger::LogLevel::Warning, "No .symtab in %s, using .dynsym", elfHandler.GetFileName().c_str());
+        symbols = elfHandler.GetDynamicSymbols();
+    }
+    std::erase_if(symbols, [](const ElfSymbol &symbol) {
+        return symbol.size == 0 || symbol.sectionIndex == SHN_UNDEF || symbol.sectionIndex >= SHN_LORESERVE ||
+               (symbol.type != SymbolType::STT_FUNC && symbol.type != SymbolType::STT_OBJECT &&
+                symbol.type != SymbolType::STT_GNU_IFUNC && symbol.type != SymbolType::STT_TLS);
+    });
+
+    // Constructor and destructor variants, identical code folding and aliases name the same bytes; keep one name,
+    // the global one if any, so the bytes are counted once
+    auto bindingRank = [](SymbolBinding binding) {
+        return binding == SymbolBinding::STB_GLOBAL ? 0 : binding == SymbolBinding::STB_WEAK ? 1 : 2;
+    };
+    std::sort(symbols.begin(), symbols.end(), [&](const ElfSymbol &a, const ElfSymbol &b) {
+        if (a.sectionIndex != b.sectionIndex)
+            return a.sectionIndex < b.sectionIndex;
+        if (a.value != b.value)
+            return a.value < b.value;
+        if (a.size != b.size)
+            return a.size < b.size;
+        if (bindingRank(a.binding) != bindingRank(b.binding))
+            return bindingRank(a.binding) < bindingRank(b.binding);
+        return a.name < b.name;
+    });
+    symbols.erase(std::unique(symbols.begin(), symbols.end(),
+                              [](const ElfSymbol &a, const ElfSymbol &b) {
+                                  return a.sectionIndex == b.sectionIndex && a.value == b.value && a.size == b.size;
+                              }),
+                  symbols.end());
+
+    std::vector<std::vector<std::string>> scopes(symbols.size());
+    auto splitBatch = [&](size_t batch) {
+        size_t bufferSize = 256;
+        char *buffer = static_cast<char *>(malloc(bufferSize));
+        size_t end = std::min(symbols.size(), (batch + 1) * TEMPLATE_BLOAT_BATCH_SIZE);
+        for (size_t i = batch * TEMPLATE_BLOAT_BATCH_SIZE; i < end; i++)
+        {
+            scopes[i] = SymbolScopes(symbols[i].name, buffer, bufferSize);
+        }
+        free(buffer);
+    };
+    size_t batchCount = (symbols.size() + TEMPLATE_BLOAT_BATCH_SIZE - 1) / TEMPLATE_BLOAT_BATCH_SIZE;
+    if (pool == nullptr)
+    {
+        for (size_t batch = 0; batch < batchCount; batch++)
+        {
+            splitBatch(batch);
+        }
+    }
+    else
+    {
+        TaskGroup group(*pool);
+        for (size_t batch = 0; batch < batchCount; batch++)
+        {
+            group.Submit([&splitBatch, batch]() { splitBatch(batch); });
+        }
+        group.Wait();
+    }
+
+    // Children are found by parent index and name; parents are always created before their children
+    std::unordered_map<std::string, uint32_t> index;
+    std::string key;
+    for (size_t i = 0; i < symbols.size(); i++)
+    {
+        uint32_t node = TEMPLATE_BLOAT_ROOT;
+        for (std::string &scope : scopes[i])
+        {
+            key.assign(reinterpret_cast<const char *>(&node), sizeof(node)).append(scope);
+            auto [entry, added] = index.try_emplace(key, static_cast<uint32_t>(_nodes.size()));
+            if (added)
+            {
+                _nodes[node].children.push_back(entry->second);
+                _nodes.push_back({std::move(scope), node, 0, 0, 0, 0, {}});
+            }
+            node = entry->second;
+        }
+        _nodes[node].selfSize += symbols[i].size;
+        _nodes[node].selfSymbols++;
+    }
+
+    for (size_t i = _nodes.size(); i-- > 0;)
+    {
+        TemplateBloatNode &node = _nodes[i];
+        node.totalSize += node.selfSize;
+        node.totalSymbols += node.selfSymbols;
+        if (i != TEMPLATE_BLOAT_ROOT)
+        {
+            _nodes[node.parent].totalSize += node.totalSize;
+            _nodes[node.parent].totalSymbols += node.totalSymbols;
+        }
+    }
+    for (TemplateBloatNode &node : _nodes)
+    {
+        std::sort(node.children.begin(), node.children.end(), [this](uint32_t a, uint32_t b) {
+            if (_nodes[a].totalSize != _nodes[b].totalSize)
+                return _nodes[a].totalSize > _nodes[b].totalSize;
+            return _nodes[a].name < _nodes[b].name;
+        });
+    }
+}
+
+const std::vector<TemplateBloatNode> &TemplateBloatReport::GetNodes() const
+{
+    return _nodes;
+}
+
+/**
+ * @brief Prints the hierarchy, largest first, with the total and self size and symbol count of each node. Each
+ * level lists its largest children and folds the rest into one row.
+ *
+ * @param limit The number of children listed per node before folding.
+ * @param maxDepth The number of levels printed.
+ */
+void TemplateBloatReport::PrintReport(size_t limit, size_t maxDepth) const
+{
+    printf("%12s %7s %12s %8s  %s\n", "TOTAL", "", "SELF", "SYMBOLS", "NAME");
+    PrintNode(TEMPLATE_BLOAT_ROOT, 0, limit, maxDepth);
+    const TemplateBloatNode &root = _nodes[TEMPLATE_BLOAT_ROOT];
+    printf("%12lu %6.2f%% %12lu %8u  TOTAL\n", root.totalSize, 100.0, root.selfSize, root.totalSymbols);
+}
+
+void TemplateBloatReport::PrintNode(uint32_t node, size_t depth, size_t limit, size_t maxDepth) const
+{
+    if (depth >= maxDepth)
+    {
+        return;
+    }
+    uint64_t total = _nodes[TEMPLATE_BLOAT_ROOT].totalSize;
+    auto printRow = [&](uint64_t totalSize, uint64_t selfSize, uint32_t symbols, const char *name) {
+        printf("%12lu %6.2f%% %12lu %8u  %*s%s\n", totalSize, total == 0 ? 0.0 : 100.0 * totalSize / total, selfSize,
+               symbols, static_cast<int>(2 * depth), "", name);
+    };
+
+    const std::vector<uint32_t> &children = _nodes[node].children;
+    size_t listed = std::min(limit, children.size());
+    for (size_t i = 0; i < listed; i++)
+    {
+        const TemplateBloatNode &child = _nodes[children[i]];
+        printRow(child.totalSize, child.selfSize, child.totalSymbols, child.name.empty() ? "??" : child.name.c_str());
+        PrintNode(children[i], depth + 1, limit, maxDepth);
+    }
+    if (listed < children.size())
+    {
+        uint64_t totalSize = 0;
+        uint64_t selfSize = 0;
+        uint32_t symbols = 0;
+        for (size_t i = listed; i < children.size(); i++)
+        {
+            totalSize += _nodes[children[i]].totalSize;
+            selfSize += _nodes[children[i]].selfSize;
+            symbols += _nodes[children[i]].totalSymbols;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "[%lu others]", children.size() - listed);
+        printRow(totalSize, selfSize, symbols, name);
+    }
+}
@@ -0,0 +1,318 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+// Pool and queue index of the worker running on the current thread
+static thread_local const ThreadPool *t_currentPool = nullptr;
+static thread_local size_t t_currentWorker = 0;
+
+// Tasks running on the current thread, more than one while a task waits on a TaskGroup, and the time the outermost
+// one has spent blocked in such waits
+static thread_local size_t t_taskDepth = 0;
+static thread_local uint64_t t_blockedNanoseconds = 0;
+
+static uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Constructor for the ThreadPool class.
+ *
+ * @param threadCount The number of worker threads; hardware_concurrency when 0.
+ */
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        _threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+/**
+ * @brief Runs the remaining tasks, then stops and joins the workers.
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _taskAvailable.notify_all();
+    for (auto &thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const
+{
+    return _threads.size();
+}
+
+/**
+ * @brief Returns the counters of every worker, in worker order. Only exact once the pool is idle.
+ */
+std::vector<ThreadPoolWorkerStats> ThreadPool::GetWorkerStats() const
+{
+    std::vector<ThreadPoolWorkerStats> stats;
+    for (const auto &queue : _queues)
+    {
+        stats.push_back({queue->executed, queue->stolen, queue->busyNanoseconds});
+    }
+    return stats;
+}
+
+/**
+ * @brief Returns the time since the pool was created, the wall time the busy times of the workers compare to.
+ */
+uint64_t ThreadPool::GetElapsedNanoseconds() const
+{
+    return NanosecondsSince(_started);
+}
+
+/**
+ * @brief Queues a task. Tasks submitted from a task go to its worker's own deque, where they run next.
+ *
+ * @param task The work to run on one of the workers.
+ */
+void ThreadPool::Submit(std::function<void()> task)
+{
+    _unfinished++;
+    size_t index = t_currentPool == this ? t_currentWorker : _nextQueue++ % _queues.size();
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        _queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted under the pool mutex so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued++;
+    }
+    _taskAvailable.notify_one();
+}
+
+/**
+ * @brief Blocks until every submitted task has finished. Must not be called from a task of this pool; tasks wait on
+ * their subtasks through a TaskGroup.
+ *
+ * @throws The first exception thrown by a task since the last Wait.
+ */
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _allDone.wait(lock, [this]() { return _unfinished == 0; });
+    if (_error)
+    {
+        std::exception_ptr error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t index)
+{
+    t_currentPool = this;
+    t_currentWorker = index;
+    for (;;)
+    {
+        std::function<void()> task;
+        if (TryPop(index, task))
+        {
+            Execute(task, index);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _taskAvailable.wait(lock, [this]() { return _stopping || _queued > 0; });
+        if (_stopping && _queued == 0)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Takes the newest task of the worker's own deque, or else the oldest task of another worker.
+ */
+bool ThreadPool::TryPop(size_t index, std::function<void()> &task)
+{
+    {
+        WorkerQueue &own = *_queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            _queued--;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < _queues.size(); i++)
+    {
+        WorkerQueue &victim = *_queues[(index + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            _queued--;
+            _queues[index]->stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Runs a task on a worker and counts it. Only the outermost task of a thread adds to the busy time, as nested
+ * tasks run within it.
+ */
+void ThreadPool::Execute(std::function<void()> &task, size_t index)
+{
+    bool outermost = t_taskDepth++ == 0;
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        task();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_error)
+        {
+            _error = std::current_exception();
+        }
+    }
+    t_taskDepth--;
+
+    WorkerQueue &queue = *_queues[index];
+    queue.executed++;
+    if (outermost)
+    {
+        uint64_t elapsed = NanosecondsSince(start);
+        queue.busyNanoseconds += elapsed - std::min(elapsed, t_blockedNanoseconds);
+        t_blockedNanoseconds = 0;
+    }
+
+    if (--_unfinished == 0)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _allDone.notify_all();
+    }
+}
+
+/**
+ * @brief Waits for a TaskGroup counter to drop to zero. On a worker of this pool, queued tasks are run meanwhile and
+ * the thread only sleeps when every deque is empty; any other thread simply blocks.
+ */
+void ThreadPool::RunUntilDone(const std::atomic<size_t> &unfinished)
+{
+    if (t_currentPool != this)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _groupDone.wait(lock, [&unfinished]() { return unfinished == 0; });
+        return;
+    }
+
+    size_t index = t_currentWorker;
+    while (unfinished > 0)
+    {
+        std::function<void()> task;
+        if (TryPop(index, task))
+        {
+            Execute(task, index);
+            continue;
+        }
+
+        // The group's remaining subtasks are running on other workers
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _taskAvailable.wait(lock, [this, &unfinished]() { return _queued > 0 || unfinished == 0; });
+        }
+        t_blockedNanoseconds += NanosecondsSince(start);
+    }
+}
+
+/**
+ * @brief Wakes every thread waiting on a TaskGroup, after the last task of one has finished.
+ */
+void ThreadPool::NotifyGroupDone()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _taskAvailable.notify_all();
+    _groupDone.notify_all();
+}
+
+/**
+ * @brief Constructor for the TaskGroup class.
+ *
+ * @param pool The pool the tasks of the group run on.
+ */
+TaskGroup::TaskGroup(ThreadPool &pool) : _pool(pool)
+{
+}
+
+/**
+ * @brief Waits for the tasks still running, which may refer to the caller's locals. Their exceptions are dropped.
+ */
+TaskGroup::~TaskGroup()
+{
+    _pool.RunUntilDone(_unfinished);
+}
+
+/**
+ * @brief Queues a task of the group. From a task of the same pool, it goes to the worker's own deque to run next.
+ *
+ * @param task The work to run on one of the workers.
+ */
+void TaskGroup::Submit(std::function<void()> task)
+{
+    _unfinished++;
+    // The waiter may destroy the group as soon as the counter reaches zero, so the pool is captured on its own
+    ThreadPool &pool = _pool;
+    pool.Submit([this, &pool, task = std::move(task)]() {
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_error)
+            {
+                _error = std::current_exception();
+            }
+        }
+        if (--_unfinished == 0)
+        {
+            pool.NotifyGroupDone();
+        }
+    });
+}
+
+/**
+ * @brief Blocks until every task of the group has finished, running other queued tasks meanwhile when called on a
+ * worker of the pool.
+ *
+ * @throws The first exception thrown by a task of the group since the last Wait.
+ */
+void TaskGroup::Wait()
+{
+    _pool.RunUntilDone(_unfinished);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_error)
+    {
+        std::exception_ptr error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
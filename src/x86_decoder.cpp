@@ -0,0 +1,627 @@
+#include "x86_decoder.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+// Operand encoding of an opcode, as needed to find the instruction length
+typedef struct OpcodeFlags
+{
+    static constexpr uint16_t MODRM = 0x001;   // ModRM byte, with optional SIB and displacement
+    static constexpr uint16_t IMM8 = 0x002;    // 8-bit immediate
+    static constexpr uint16_t IMM16 = 0x004;   // 16-bit immediate
+    static constexpr uint16_t IMMZ = 0x008;    // 16 or 32-bit immediate, by operand size
+    static constexpr uint16_t IMMV = 0x010;    // 16, 32 or 64-bit immediate, by operand size and REX.W
+    static constexpr uint16_t MOFFS = 0x020;   // 32 or 64-bit absolute address, by address size
+    static constexpr uint16_t REL8 = 0x040;    // 8-bit branch displacement
+    static constexpr uint16_t REL32 = 0x080;   // 32-bit branch displacement
+    static constexpr uint16_t GROUP3 = 0x100;  // Immediate, validity or flow depend on ModRM.reg
+    static constexpr uint16_t PREFIX = 0x200;  // Legacy prefix
+    static constexpr uint16_t REX = 0x400;     // REX prefix
+    static constexpr uint16_t ESCAPE = 0x800;  // 0F, VEX or EVEX, decoded separately
+    static constexpr uint16_t INVALID = 0x1000; // Not encodable in 64-bit mode
+} OpcodeFlags;
+
+using OpcodeTable = std::array<uint16_t, 256>;
+
+/**
+ * @brief Builds the one-byte opcode map of 64-bit mode.
+ */
+static constexpr OpcodeTable BuildOneByteTable()
+{
+    using F = OpcodeFlags;
+    OpcodeTable table{};
+
+    // ALU blocks 00-3F: op r/m,r / op r,r/m in the first four, then al,imm8 and eax,imm32
+    for (int base = 0x00; base < 0x40; base += 8)
+    {
+        for (int i = 0; i < 4; i++)
+            table[base + i] = F::MODRM;
+        table[base + 4] = F::IMM8;
+        table[base + 5] = F::IMMZ;
+        table[base + 6] = F::INVALID;
+        table[base + 7] = F::INVALID;
+    }
+    table[0x0f] = F::ESCAPE;
+    for (int op : {0x26, 0x2e, 0x36, 0x3e, 0x64, 0x65, 0x66, 0x67, 0xf0, 0xf2, 0xf3})
+        table[op] = F::PREFIX;
+    for (int op = 0x40; op < 0x50; op++)
+        table[op] = F::REX;
+
+    table[0x60] = table[0x61] = F::INVALID;
+    table[0x62] = F::ESCAPE;
+    table[0x63] = F::MODRM;
+    table[0x68] = F::IMMZ;
+    table[0x69] = F::MODRM | F::IMMZ;
+    table[0x6a] = F::IMM8;
+    table[0x6b] = F::MODRM | F::IMM8;
+    for (int op = 0x70; op < 0x80; op++)
+        table[op] = F::REL8;
+
+    table[0x80] = F::MODRM | F::IMM8;
+    table[0x81] = F::MODRM | F::IMMZ;
+    table[0x82] = F::INVALID;
+    table[0x83] = F::MODRM | F::IMM8;
+    for (int op = 0x84; op < 0x90; op++)
+        table[op] = F::MODRM;
+    table[0x9a] = F::INVALID;
+
+    for (int op = 0xa0; op < 0xa4; op++)
+        table[op] = F::MOFFS;
+    table[0xa8] = F::IMM8;
+    table[0xa9] = F::IMMZ;
+    for (int op = 0xb0; op < 0xb8; op++)
+        table[op] = F::IMM8;
+    for (int op = 0xb8; op < 0xc0; op++)
+        table[op] = F::IMMV;
+
+    table[0xc0] = table[0xc1] = F::MODRM | F::IMM8;
+    table[0xc2] = F::IMM16;
+    table[0xc4] = table[0xc5] = F::ESCAPE;
+    table[0xc6] = F::MODRM | F::IMM8;
+    table[0xc7] = F::MODRM | F::IMMZ;
+    table[0xc8] = F::IMM16 | F::IMM8;
+    table[0xca] = F::IMM16;
+    table[0xcd] = F::IMM8;
+    table[0xce] = F::INVALID;
+
+    for (int op = 0xd0; op < 0xd4; op++)
+        table[op] = F::MODRM;
+    table[0xd4] = table[0xd5] = table[0xd6] = F::INVALID;
+    for (int op = 0xd8; op < 0xe0; op++)
+        table[op] = F::MODRM;
+
+    for (int op = 0xe0; op < 0xe4; op++)
+        table[op] = F::REL8;
+    for (int op = 0xe4; op < 0xe8; op++)
+        table[op] = F::IMM8;
+    table[0xe8] = table[0xe9] = F::REL32;
+    table[0xea] = F::INVALID;
+    table[0xeb] = F::REL8;
+
+    table[0xf6] = F::MODRM | F::GROUP3 | F::IMM8;
+    table[0xf7] = F::MODRM | F::GROUP3 | F::IMMZ;
+    table[0xfe] = table[0xff] = F::MODRM | F::GROUP3;
+    return table;
+}
+
+/**
+ * @brief Builds the two-byte opcode map, 0F xx.
+ */
+static constexpr OpcodeTable BuildTwoByteTable()
+{
+    using F = OpcodeFlags;
+    OpcodeTable table{};
+    for (auto &entry : table)
+        entry = F::MODRM;
+
+    // Opcodes without operands
+    for (int op : {0x05, 0x06, 0x07, 0x08, 0x09, 0x0b, 0x0e, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x37, 0x77, 0xa0,
+                   0xa1, 0xa2, 0xa8, 0xa9, 0xaa})
+        table[op] = 0;
+    for (int op = 0xc8; op < 0xd0; op++)
+        table[op] = 0;
+    for (int op : {0x04, 0x0a, 0x0c, 0x24, 0x25, 0x26, 0x27, 0x36, 0x39, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, 0x7a, 0x7b,
+                   0xa6, 0xa7})
+        table[op] = F::INVALID;
+    table[0x38] = table[0x3a] = F::ESCAPE;
+
+    // 3DNow! carries its opcode in a trailing byte
+    table[0x0f] = F::MODRM | F::IMM8;
+    for (int op : {0x70, 0x71, 0x72, 0x73, 0xa4, 0xac, 0xba, 0xc2, 0xc4, 0xc5, 0xc6})
+        table[op] = F::MODRM | F::IMM8;
+    for (int op = 0x80; op < 0x90; op++)
+        table[op] = F::REL32;
+    return table;
+}
+
+/**
+ * @brief Builds the control flow of the one-byte opcode map.
+ */
+static constexpr std::array<X86FlowType, 256> BuildOneByteFlow()
+{
+    std::array<X86FlowType, 256> flow{};
+    for (int op = 0x70; op < 0x80; op++)
+        flow[op] = X86FlowType::ConditionalJump;
+    for (int op = 0xe0; op < 0xe4; op++)
+        flow[op] = X86FlowType::ConditionalJump;
+    flow[0xe8] = X86FlowType::Call;
+    flow[0xe9] = flow[0xeb] = X86FlowType::Jump;
+    for (int op : {0xc2, 0xc3, 0xca, 0xcb, 0xcf})
+        flow[op] = X86FlowType::Return;
+    flow[0xcc] = flow[0xf4] = X86FlowType::Trap;
+    return flow;
+}
+
+/**
+ * @brief Builds the control flow of the two-byte opcode map.
+ */
+static constexpr std::array<X86FlowType, 256> BuildTwoByteFlow()
+{
+    std::array<X86FlowType, 256> flow{};
+    for (int op = 0x80; op < 0x90; op++)
+        flow[op] = X86FlowType::ConditionalJump;
+    flow[0x0b] = X86FlowType::Trap;
+    return flow;
+}
+
+/**
+ * @brief Returns the number of immediate and displacement bytes following the ModRM operands of an opcode.
+ *
+ * @param flags The OpcodeFlags of the opcode.
+ * @param mode Bit 0 set for an operand size prefix, bit 1 for REX.W and bit 2 for an address size prefix.
+ */
+static constexpr uint8_t ImmediateSize(uint16_t flags, size_t mode)
+{
+    using F = OpcodeFlags;
+    bool operandSize16 = mode & 1;
+    bool rexW = mode & 2;
+    bool addressSize32 = mode & 4;
+    uint8_t size = 0;
+    size += (flags & F::IMM8) ? 1 : 0;
+    size += (flags & F::IMM16) ? 2 : 0;
+    size += (flags & F::IMMZ) ? (operandSize16 ? 2 : 4) : 0;
+    size += (flags & F::IMMV) ? (rexW ? 8 : operandSize16 ? 2 : 4) : 0;
+    size += (flags & F::MOFFS) ? (addressSize32 ? 4 : 8) : 0;
+    size += (flags & F::REL8) ? 1 : 0;
+    size += (flags & F::REL32) ? 4 : 0; // The operand size prefix is ignored on near branches in 64-bit mode
+    return size;
+}
+
+// Number of prefix states that change immediate sizes, see ImmediateSize
+constexpr size_t X86_OPERAND_MODES = 8;
+
+// Decoding tables of one opcode map, indexed by opcode
+struct OpcodeMap
+{
+    OpcodeTable flags;
+    std::array<std::array<uint8_t, X86_OPERAND_MODES>, 256> immediateSize;
+    std::array<X86FlowType, 256> flow;
+};
+
+static constexpr OpcodeMap BuildOpcodeMap(const OpcodeTable &flags, const std::array<X86FlowType, 256> &flow)
+{
+    OpcodeMap map{flags, {}, flow};
+    for (size_t op = 0; op < 256; op++)
+        for (size_t mode = 0; mode < X86_OPERAND_MODES; mode++)
+            map.immediateSize[op][mode] = ImmediateSize(flags[op], mode);
+    return map;
+}
+
+/**
+ * @brief Builds the number of SIB and displacement bytes following each ModRM byte, leaving out the disp32 of a SIB
+ * byte with no base register.
+ */
+static constexpr std::array<uint8_t, 256> BuildModrmTable()
+{
+    std::array<uint8_t, 256> table{};
+    for (int modrm = 0; modrm < 256; modrm++)
+    {
+        int mod = modrm >> 6;
+        int rm = modrm & 7;
+        if (mod == 3)
+            continue;
+        table[modrm] = (rm == 4 ? 1 : 0) + (mod == 1 ? 1 : mod == 2 ? 4 : 0) + (mod == 0 && rm == 5 ? 4 : 0);
+    }
+    return table;
+}
+
+static constexpr OpcodeMap ONE_BYTE_MAP = BuildOpcodeMap(BuildOneByteTable(), BuildOneByteFlow());
+static constexpr OpcodeMap TWO_BYTE_MAP = BuildOpcodeMap(BuildTwoByteTable(), BuildTwoByteFlow());
+static constexpr std::array<uint8_t, 256> MODRM_TABLE = BuildModrmTable();
+
+/**
+ * @brief Returns the operand encoding of a VEX or EVEX instruction. Every one has a ModRM byte except vzeroupper and
+ * vzeroall; the 0F3A map and the shuffle, shift and compare opcodes of the 0F map take an 8-bit immediate.
+ *
+ * @param map The opcode map, 1 for 0F, 2 for 0F38 and 3 for 0F3A, 5 and 6 for the AVX512-FP16 maps.
+ * @param opcode The opcode byte.
+ * @param vex Whether the prefix is VEX rather than EVEX.
+ */
+static uint16_t VectorOpcodeFlags(uint8_t map, uint8_t opcode, bool vex)
+{
+    using F = OpcodeFlags;
+    switch (map)
+    {
+    case 1:
+        if (vex && opcode == 0x77)
+            return 0;
+        if ((opcode >= 0x70 && opcode <= 0x73) || opcode == 0xc2 || (opcode >= 0xc4 && opcode <= 0xc6))
+            return F::MODRM | F::IMM8;
+        return F::MODRM;
+    case 2:
+        return F::MODRM;
+    case 3:
+        return F::MODRM | F::IMM8;
+    case 5:
+    case 6:
+        return vex ? F::INVALID : F::MODRM;
+    default:
+        return F::INVALID;
+    }
+}
+
+/**
+ * @brief Decodes the length and control flow of the instruction at the start of a buffer. Only the encoding is
+ * examined: undefined opcodes inside defined maps decode as their neighbours do. Everything but the escapes and the
+ * ModRM.reg dependent groups is answered by table lookups, which keeps the common path nearly free of branches.
+ *
+ * @param code The bytes of the instruction and anything after it.
+ * @param instruction Filled in with the length, flow type and branch displacement.
+ * @return false if the bytes are not a 64-bit mode instruction or are truncated.
+ */
+bool DecodeX86Instruction(std::span<const uint8_t> code, X86Instruction &instruction)
+{
+    using F = OpcodeFlags;
+    const uint8_t *bytes = code.data();
+    size_t limit = std::min(code.size(), X86_MAX_INSTRUCTION_LENGTH);
+    size_t i = 0;
+
+    size_t mode = 0;
+    uint8_t repeatPrefix = 0;
+    uint8_t rex = 0;
+    uint8_t opcode;
+    uint16_t flags;
+    while (true)
+    {
+        if (i >= limit)
+            return false;
+        opcode = bytes[i++];
+        flags = ONE_BYTE_MAP.flags[opcode];
+        if (!(flags & (F::PREFIX | F::REX)))
+            break;
+        if (flags & F::PREFIX)
+        {
+            mode |= opcode == 0x66 ? 1 : opcode == 0x67 ? 4 : 0;
+            repeatPrefix = opcode == 0xf2 || opcode == 0xf3 ? opcode : repeatPrefix;
+            rex = 0; // REX only counts directly before the opcode
+        }
+        else
+        {
+            rex = opcode;
+        }
+    }
+    mode |= (rex & 0x08) ? 2 : 0;
+
+    const OpcodeMap *map = &ONE_BYTE_MAP;
+    uint8_t immediate = ONE_BYTE_MAP.immediateSize[opcode][mode];
+    X86FlowType flow = ONE_BYTE_MAP.flow[opcode];
+    if (flags & F::ESCAPE)
+    {
+        flow = X86FlowType::None;
+        if (opcode == 0x0f)
+        {
+            if (i >= limit)
+                return false;
+            opcode = bytes[i++];
+            map = &TWO_BYTE_MAP;
+            flags = TWO_BYTE_MAP.flags[opcode];
+            immediate = TWO_BYTE_MAP.immediateSize[opcode][mode];
+            flow = TWO_BYTE_MAP.flow[opcode];
+            if (opcode == 0x38 || opcode == 0x3a)
+            {
+                if (i >= limit)
+                    return false;
+                i++;
+                flags = F::MODRM;
+                immediate = opcode == 0x3a ? 1 : 0;
+            }
+            else if (opcode == 0x78 && ((mode & 1) || repeatPrefix == 0xf2))
+            {
+                immediate = 2; // SSE4a extrq and insertq, two 8-bit immediates
+            }
+        }
+        else
+        {
+            // VEX (C5 two-byte, C4 three-byte) or EVEX (62); the LES, LDS and BOUND forms do not exist in 64-bit mode
+            bool vex = opcode != 0x62;
+            size_t payload = opcode == 0xc5 ? 1 : opcode == 0xc4 ? 2 : 3;
+            if (i + payload >= limit)
+                return false;
+            uint8_t vectorMap = opcode == 0xc5 ? 1 : opcode == 0xc4 ? bytes[i] & 0x1f : bytes[i] & 0x07;
+            i += payload;
+            opcode = bytes[i++];
+            flags = VectorOpcodeFlags(vectorMap, opcode, vex);
+            immediate = (flags & F::IMM8) ? 1 : 0;
+            map = nullptr;
+        }
+    }
+    if (flags & F::INVALID)
+        return false;
+
+    size_t operands = i;
+    if (flags & F::MODRM)
+    {
+        if (i >= limit)
+            return false;
+        uint8_t modrm = bytes[i];
+        operands = i + 1 + ((modrm & 0xc0) != 0xc0 && (modrm & 7) == 4 ? 1 : 0);
+        i += 1 + MODRM_TABLE[modrm];
+        if ((modrm & 0xc7) == 0x04)
+        {
+            // SIB byte without a displacement, unless it has no base register
+            if (i > limit)
+                return false;
+            i += (bytes[i - 1] & 7) == 5 ? 4 : 0;
+        }
+
+        if (map == &ONE_BYTE_MAP && (flags & F::GROUP3))
+        {
+            uint8_t reg = (modrm >> 3) & 7;
+            if (opcode == 0xf6 || opcode == 0xf7)
+                immediate = reg > 1 ? 0 : immediate;
+            else if ((opcode == 0xfe && reg > 1) || (opcode == 0xff && reg == 7))
+                return false;
+            else if (opcode == 0xff && (reg == 2 || reg == 3))
+                flow = X86FlowType::IndirectCall;
+            else if (opcode == 0xff && (reg == 4 || reg == 5))
+                flow = X86FlowType::IndirectJump;
+        }
+    }
+
+    i += immediate;
+    if (i > limit)
+        return false;
+
+    instruction.length = static_cast<uint8_t>(i);
+    instruction.operandOffset = static_cast<uint8_t>(operands);
+    instruction.flow = flow;
+    instruction.displacement = 0;
+    if (flow == X86FlowType::Call || flow == X86FlowType::Jump || flow == X86FlowType::ConditionalJump)
+    {
+        // The displacement is the only operand of a direct branch
+        if (immediate == 1)
+            instruction.displacement = static_cast<int8_t>(bytes[i - 1]);
+        else
+            memcpy(&instruction.displacement, bytes + i - 4, sizeof(int32_t));
+    }
+    return true;
+}
+
+/**
+ * @brief Returns whether an instruction of the sweep starts at an address.
+ */
+bool X86CodeMap::IsBoundary(uint64_t instructionAddress) const
+{
+    uint64_t offset = instructionAddress - address;
+    return instructionAddress >= address && offset < size && (boundaries[offset / 64] >> (offset % 64)) & 1;
+}
+
+/**
+ * @brief Linear sweep over code[offset, end). The instruction starting last may extend past end.
+ *
+ * @param markStart Called with the offset of every decoded instruction.
+ * @param stopAt Called with the offset of every instruction before decoding it; the sweep stops when it returns true.
+ * @return The offset at which the sweep stopped.
+ */
+template <typename MarkStart, typename StopAt>
+static size_t SweepRange(std::span<const uint8_t> code, uint64_t address, size_t offset, size_t end,
+                         std::vector<X86Branch> &branches, std::vector<size_t> &invalid, MarkStart markStart,
+                         StopAt stopAt)
+{
+    X86Instruction instruction;
+    while (offset < end && !stopAt(offset))
+    {
+        if (!DecodeX86Instruction(code.subspan(offset), instruction))
+        {
+            invalid.push_back(offset);
+            offset++;
+            continue;
+        }
+
+        markStart(offset);
+        if (instruction.flow != X86FlowType::None)
+        {
+            // Call, Jump and ConditionalJump are the direct forms
+            uint64_t next = address + offset + instruction.length;
+            bool direct = instruction.flow <= X86FlowType::ConditionalJump;
+            branches.push_back({address + offset, direct ? next + instruction.displacement : 0, instruction.flow});
+        }
+        offset += instruction.length;
+    }
+    return offset;
+}
+
+// Part of a parallel sweep
+struct SweepChunk
+{
+    size_t begin;
+    size_t end;
+    size_t exit; // End of the last instruction starting before end
+    std::vector<X86Branch> branches;
+    std::vector<size_t> invalid;
+};
+
+/**
+ * @brief Decodes a block of code from start to end. Bytes that do not start a valid instruction are skipped one at a
+ * time, after which the sweep resynchronises within a few instructions.
+ *
+ * With a pool, blocks larger than X86_SWEEP_CHUNK_SIZE are cut into chunks swept in parallel, each from its own first
+ * byte. The chunks are then stitched in order: when the instruction crossing into a chunk ends on one of the chunk's
+ * own boundaries, only the boundaries before it are dropped; otherwise the chunk is decoded again from there until
+ * the two streams meet, which x86 code does after a few instructions. The result is that of a sequential sweep.
+ *
+ * @param code The machine code.
+ * @param address The virtual address of the first byte.
+ * @param pool The pool to spread large blocks over, or nullptr to sweep on the calling thread.
+ * @return The instruction boundaries and control transfer instructions of the block.
+ */
+X86CodeMap SweepX86Code(std::span<const uint8_t> code, uint64_t address, ThreadPool *pool)
+{
+    X86CodeMap codeMap;
+    codeMap.address = address;
+    codeMap.size = code.size();
+    codeMap.boundaries.assign((code.size() + 63) / 64, 0);
+    std::vector<uint64_t> &boundaries = codeMap.boundaries;
+    auto isBoundary = [&boundaries](size_t offset) { return (boundaries[offset / 64] >> (offset % 64)) & 1; };
+    auto markBoundary = [&boundaries](size_t offset) { boundaries[offset / 64] |= 1ULL << (offset % 64); };
+
+    size_t chunkCount = pool != nullptr ? (code.size() + X86_SWEEP_CHUNK_SIZE - 1) / X86_SWEEP_CHUNK_SIZE : 1;
+    chunkCount = std::max<size_t>(chunkCount, 1);
+    std::vector<SweepChunk> chunks(chunkCount);
+    auto sweepChunk = [&](size_t index) {
+        SweepChunk &chunk = chunks[index];
+        chunk.begin = index * X86_SWEEP_CHUNK_SIZE;
+        chunk.end = chunkCount == 1 ? code.size() : std::min(code.size(), chunk.begin + X86_SWEEP_CHUNK_SIZE);
+
+        // Compiled code has a control transfer roughly every 5 instructions, or 20 bytes
+        chunk.branches.reserve((chunk.end - chunk.begin) / 20);
+        chunk.exit = SweepRange(code, address, chunk.begin, chunk.end, chunk.branches, chunk.invalid, markBoundary,
+                                [](size_t) { return false; });
+    };
+    if (chunkCount == 1)
+    {
+        sweepChunk(0);
+    }
+    else
+    {
+        // Chunks are multiples of 64 bytes, so each task writes its own words of the bitmap
+        TaskGroup group(*pool);
+        for (size_t i = 0; i < chunkCount; i++)
+            group.Submit([&sweepChunk, i]() { sweepChunk(i); });
+        group.Wait();
+    }
+
+    for (size_t i = 1; i < chunkCount; i++)
+    {
+        SweepChunk &chunk = chunks[i];
+        size_t entry = chunks[i - 1].exit;
+        std::vector<size_t> starts;
+        std::vector<X86Branch> branches;
+        std::vector<size_t> invalid;
+        size_t meet = SweepRange(code, address, entry, chunk.end, branches, invalid,
+                                 [&starts](size_t offset) { starts.push_back(offset); }, isBoundary);
+
+        // Replace everything the chunk decoded before the streams met
+        for (size_t offset = chunk.begin; offset < std::min(meet, chunk.end); offset++)
+            boundaries[offset / 64] &= ~(1ULL << (offset % 64));
+        for (size_t offset : starts)
+            markBoundary(offset);
+        auto keptBranch = std::partition_point(chunk.branches.begin(), chunk.branches.end(),
+                                               [&](const X86Branch &b) { return b.source < address + meet; });
+        branches.insert(branches.end(), keptBranch, chunk.branches.end());
+        chunk.branches = std::move(branches);
+        invalid.insert(invalid.end(), std::lower_bound(chunk.invalid.begin(), chunk.invalid.end(), meet),
+                       chunk.invalid.end());
+        chunk.invalid = std::move(invalid);
+        if (meet >= chunk.end)
+        {
+            chunk.exit = meet;
+        }
+    }
+
+    codeMap.branches = std::move(chunks[0].branches);
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        if (i > 0)
+            codeMap.branches.insert(codeMap.branches.end(), chunks[i].branches.begin(), chunks[i].branches.end());
+        codeMap.invalidCount += chunks[i].invalid.size();
+    }
+    for (uint64_t word : boundaries)
+    {
+        codeMap.instructionCount += __builtin_popcountll(word);
+    }
+    return codeMap;
+}
+
+/**
+ * @brief Sweeps the executable sections of an x86-64 file, or the named sections.
+ *
+ * @param elfHandler The file to scan.
+ * @param sectionNames Sections to scan; all sections with SHF_EXECINSTR when empty.
+ * @param pool The pool to spread large sections over, or nullptr.
+ * @param callback Called with each section and its code map.
+ * @throws std::runtime_error if the file is not x86-64.
+ */
+void ScanSectionCode(const ElfHandler &elfHandler, const std::vector<std::string> &sectionNames, ThreadPool *pool,
+                     const SectionCodeCallback &callback)
+{
+    if (elfHandler.GetMachine() != static_cast<uint16_t>(ElfMachine::EM_X86_64))
+        LOG_THROW(Logger::LogLevel::Error, "Code scanning needs an x86-64 file, machine is %u",
+                  elfHandler.GetMachine());
+
+    for (const std::string &name : sectionNames)
+    {
+        if (elfHandler.FindSection(name) == nullptr)
+        {
+            LOG(Logger::LogLevel::Warning, "Section %s not found", name.c_str());
+        }
+    }
+
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        bool selected;
+        if (sectionNames.empty())
+        {
+            selected = (section.flags & SectionHeaderFlags::SHF_EXECINSTR) != 0 &&
+                       section.type != static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS);
+        }
+        else
+        {
+            selected = std::find(sectionNames.begin(), sectionNames.end(), section.name) != sectionNames.end();
+        }
+        if (selected)
+        {
+            callback(section, SweepX86Code(elfHandler.GetSectionData(section), section.addr, pool));
+        }
+    }
+}
+
+const char *X86FlowTypeName(X86FlowType type)
+{
+    switch (type)
+    {
+    case X86FlowType::Call:
+        return "call";
+    case X86FlowType::Jump:
+        return "jmp";
+    case X86FlowType::ConditionalJump:
+        return "jcc";
+    case X86FlowType::IndirectCall:
+        return "call*";
+    case X86FlowType::IndirectJump:
+        return "jmp*";
+    case X86FlowType::Return:
+        return "ret";
+    case X86FlowType::Trap:
+        return "trap";
+    default:
+        return "none";
+    }
+}
+
+/**
+ * @brief Prints a summary line for a section, followed by its control transfer instructions.
+ */
+void PrintCodeMap(const ElfSection &section, const X86CodeMap &codeMap)
+{
+    printf("%s: %lu bytes, %zu instructions, %zu invalid bytes, %zu branches\n", section.name.c_str(), codeMap.size,
+           codeMap.instructionCount, codeMap.invalidCount, codeMap.branches.size());
+    for (const auto &branch : codeMap.branches)
+    {
+        if (branch.target != 0)
+            printf("  0x%lx %-5s 0x%lx\n", branch.source, X86FlowTypeName(branch.type), branch.target);
+        else
+            printf("  0x%lx %s\n", branch.source, X86FlowTypeName(branch.type));
+    }
+}
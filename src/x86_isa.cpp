@@ -0,0 +1,653 @@
+#include "x86_isa.hpp"
+#include "elf_notes.hpp"
+#include "logger.hpp"
+#include "x86_decoder.hpp"
+#include <algorithm>
+
+// Mandatory prefix classes, numbered like the pp field of VEX and EVEX
+constexpr uint8_t PP_NONE = 0;
+constexpr uint8_t PP_66 = 1;
+constexpr uint8_t PP_F3 = 2;
+constexpr uint8_t PP_F2 = 3;
+
+// Extension of every opcode of a map, by mandatory prefix
+using ExtensionTable = std::array<std::array<X86IsaExtension, 256>, 4>;
+
+// Prefix bytes, as sorted by the classifier
+typedef struct PrefixKind
+{
+    static constexpr uint8_t NONE = 0;
+    static constexpr uint8_t OPERAND_SIZE = 1; // 66
+    static constexpr uint8_t REPEAT = 2;       // F2 and F3
+    static constexpr uint8_t OTHER = 3;        // Address size, lock and segment overrides
+    static constexpr uint8_t REX = 4;
+} PrefixKind;
+
+static constexpr std::array<uint8_t, 256> BuildPrefixKinds()
+{
+    std::array<uint8_t, 256> kinds{};
+    for (uint8_t prefix : {0x26, 0x2e, 0x36, 0x3e, 0x64, 0x65, 0x67, 0xf0})
+        kinds[prefix] = PrefixKind::OTHER;
+    for (size_t rex = 0x40; rex <= 0x4f; rex++)
+        kinds[rex] = PrefixKind::REX;
+    kinds[0x66] = PrefixKind::OPERAND_SIZE;
+    kinds[0xf2] = PrefixKind::REPEAT;
+    kinds[0xf3] = PrefixKind::REPEAT;
+    return kinds;
+}
+
+/**
+ * @brief Builds the extensions of the legacy 0F map. Unlisted opcodes are general purpose, system or MMX
+ * instructions. F3 0F BC (tzcnt) is left as baseline: it executes as bsf on older processors, and compilers emit it
+ * for that reason without targeting BMI1.
+ */
+static constexpr ExtensionTable BuildTwoByteExtensions()
+{
+    using E = X86IsaExtension;
+    ExtensionTable table{};
+    auto set = [&table](uint8_t pp, size_t first, size_t last, X86IsaExtension extension) {
+        for (size_t opcode = first; opcode <= last; opcode++)
+            table[pp][opcode] = extension;
+    };
+
+    // Scalar and packed floating point moves, conversions and arithmetic
+    set(PP_NONE, 0x10, 0x17, E::Sse);
+    set(PP_66, 0x10, 0x17, E::Sse2);
+    set(PP_F3, 0x10, 0x11, E::Sse);
+    set(PP_F2, 0x10, 0x11, E::Sse2);
+    set(PP_F3, 0x12, 0x12, E::Sse3);
+    set(PP_F3, 0x16, 0x16, E::Sse3);
+    set(PP_F2, 0x12, 0x12, E::Sse3);
+    set(PP_NONE, 0x28, 0x2f, E::Sse);
+    set(PP_66, 0x28, 0x2f, E::Sse2);
+    set(PP_F3, 0x2a, 0x2a, E::Sse);
+    set(PP_F3, 0x2b, 0x2b, E::Other);
+    set(PP_F3, 0x2c, 0x2d, E::Sse);
+    set(PP_F2, 0x2a, 0x2a, E::Sse2);
+    set(PP_F2, 0x2b, 0x2b, E::Other);
+    set(PP_F2, 0x2c, 0x2d, E::Sse2);
+    set(PP_NONE, 0x50, 0x5f, E::Sse);
+    set(PP_NONE, 0x5a, 0x5b, E::Sse2);
+    set(PP_66, 0x50, 0x5f, E::Sse2);
+    set(PP_F3, 0x51, 0x5f, E::Sse);
+    set(PP_F3, 0x5a, 0x5b, E::Sse2);
+    set(PP_F2, 0x51, 0x5f, E::Sse2);
+
+    // Packed integers: MMX without a prefix, SSE2 with 66
+    set(PP_66, 0x60, 0x7f, E::Sse2);
+    set(PP_66, 0x78, 0x79, E::Other);
+    set(PP_66, 0x7c, 0x7d, E::Sse3);
+    set(PP_NONE, 0x70, 0x70, E::Sse);
+    set(PP_F3, 0x6f, 0x70, E::Sse2);
+    set(PP_F3, 0x7e, 0x7f, E::Sse2);
+    set(PP_F2, 0x70, 0x70, E::Sse2);
+    set(PP_F2, 0x78, 0x79, E::Other);
+    set(PP_F2, 0x7c, 0x7d, E::Sse3);
+
+    set(PP_F3, 0xb8, 0xb8, E::Popcnt);
+    set(PP_F3, 0xbd, 0xbd, E::Lzcnt);
+
+    set(PP_NONE, 0xc2, 0xc2, E::Sse);
+    set(PP_F3, 0xc2, 0xc2, E::Sse);
+    set(PP_66, 0xc2, 0xc2, E::Sse2);
+    set(PP_F2, 0xc2, 0xc2, E::Sse2);
+    set(PP_NONE, 0xc3, 0xc3, E::Sse2);
+    set(PP_NONE, 0xc4, 0xc6, E::Sse);
+    set(PP_66, 0xc4, 0xc6, E::Sse2);
+
+    set(PP_66, 0xd0, 0xd0, E::Sse3);
+    set(PP_F2, 0xd0, 0xd0, E::Sse3);
+    set(PP_66, 0xd1, 0xfe, E::Sse2);
+    set(PP_F3, 0xd6, 0xd6, E::Sse2);
+    set(PP_F2, 0xd6, 0xd6, E::Sse2);
+    set(PP_F3, 0xe6, 0xe6, E::Sse2);
+    set(PP_F2, 0xe6, 0xe6, E::Sse2);
+    set(PP_F2, 0xf0, 0xf0, E::Sse3);
+    for (uint8_t opcode : {0xd7, 0xda, 0xde, 0xe0, 0xe3, 0xe4, 0xe7, 0xea, 0xee, 0xf6, 0xf7})
+        table[PP_NONE][opcode] = E::Sse; // Integer instructions SSE added to MMX
+    for (uint8_t opcode : {0xd4, 0xf4, 0xfb})
+        table[PP_NONE][opcode] = E::Sse2;
+    return table;
+}
+
+static constexpr ExtensionTable BuildThreeByte38Extensions()
+{
+    using E = X86IsaExtension;
+    ExtensionTable table{};
+    auto set = [&table](uint8_t pp, size_t first, size_t last, X86IsaExtension extension) {
+        for (size_t opcode = first; opcode <= last; opcode++)
+            table[pp][opcode] = extension;
+    };
+
+    for (uint8_t pp : {PP_NONE, PP_66})
+    {
+        set(pp, 0x00, 0x0b, E::Ssse3);
+        set(pp, 0x1c, 0x1e, E::Ssse3);
+        set(pp, 0xf0, 0xf1, E::Movbe);
+    }
+    for (uint8_t opcode : {0x10, 0x14, 0x15, 0x17})
+        table[PP_66][opcode] = E::Sse41;
+    set(PP_66, 0x20, 0x25, E::Sse41);
+    set(PP_66, 0x28, 0x2b, E::Sse41);
+    set(PP_66, 0x30, 0x35, E::Sse41);
+    set(PP_66, 0x37, 0x37, E::Sse42);
+    set(PP_66, 0x38, 0x41, E::Sse41);
+    set(PP_NONE, 0xc8, 0xcd, E::Sha);
+    set(PP_66, 0xcf, 0xcf, E::Other);
+    set(PP_66, 0xdb, 0xdf, E::Aes);
+    set(PP_F2, 0xf0, 0xf1, E::Sse42);
+    set(PP_66, 0xf6, 0xf6, E::Other);
+    set(PP_F3, 0xf6, 0xf6, E::Other);
+    return table;
+}
+
+static constexpr ExtensionTable BuildThreeByte3AExtensions()
+{
+    using E = X86IsaExtension;
+    ExtensionTable table{};
+    auto set = [&table](uint8_t pp, size_t first, size_t last, X86IsaExtension extension) {
+        for (size_t opcode = first; opcode <= last; opcode++)
+            table[pp][opcode] = extension;
+    };
+
+    set(PP_66, 0x08, 0x0e, E::Sse41);
+    set(PP_NONE, 0x0f, 0x0f, E::Ssse3);
+    set(PP_66, 0x0f, 0x0f, E::Ssse3);
+    set(PP_66, 0x14, 0x17, E::Sse41);
+    set(PP_66, 0x20, 0x22, E::Sse41);
+    set(PP_66, 0x40, 0x42, E::Sse41);
+    set(PP_66, 0x44, 0x44, E::Pclmul);
+    set(PP_66, 0x60, 0x63, E::Sse42);
+    set(PP_NONE, 0xcc, 0xcc, E::Sha);
+    set(PP_66, 0xce, 0xcf, E::Other);
+    set(PP_66, 0xdf, 0xdf, E::Aes);
+    return table;
+}
+
+static constexpr std::array<uint8_t, 256> PREFIX_KINDS = BuildPrefixKinds();
+static constexpr ExtensionTable TWO_BYTE_EXTENSIONS = BuildTwoByteExtensions();
+static constexpr ExtensionTable THREE_BYTE_38_EXTENSIONS = BuildThreeByte38Extensions();
+static constexpr ExtensionTable THREE_BYTE_3A_EXTENSIONS = BuildThreeByte3AExtensions();
+
+static constexpr std::array<uint8_t, X86_ISA_EXTENSION_COUNT> EXTENSION_LEVELS = {
+    1, 1, 1,                // Base, Sse, Sse2
+    2, 2, 2, 2, 2, 2, 2,    // Sse3 to LahfSahf
+    3, 3, 3, 3, 3, 3, 3, 3, // Avx to Movbe
+    4,                      // Avx512
+    0, 0, 0, 0};            // Aes, Pclmul, Sha, Other
+
+/**
+ * @brief Returns whether a VEX.66.0F opcode is a packed integer operation, which needs AVX2 at 256 bits.
+ */
+static bool IsVexIntegerOpcode(uint8_t opcode)
+{
+    if (opcode >= 0x60 && opcode <= 0x76)
+        return opcode != 0x6e && opcode != 0x6f;
+    if (opcode >= 0xd1 && opcode <= 0xfe)
+        return opcode != 0xd6 && opcode != 0xe6 && opcode != 0xe7 && opcode != 0xf0 && opcode != 0xf7;
+    return false;
+}
+
+/**
+ * @brief Classifies a VEX encoded instruction. BMI1, BMI2 and F16C live in the VEX maps next to AVX; the 256-bit
+ * forms of the integer instructions, and the permutes, broadcasts, gathers and variable shifts, are AVX2.
+ *
+ * @param map The opcode map, 1 for 0F, 2 for 0F38 and 3 for 0F3A.
+ * @param opcode The opcode byte.
+ * @param pp The mandatory prefix class.
+ * @param wide Whether VEX.L selects 256-bit vectors.
+ */
+static X86IsaExtension ClassifyVex(uint8_t map, uint8_t opcode, uint8_t pp, bool wide)
+{
+    using E = X86IsaExtension;
+    switch (map)
+    {
+    case 1:
+        if ((opcode >= 0x41 && opcode <= 0x4b) || (opcode >= 0x90 && opcode <= 0x93) || opcode == 0x98 ||
+            opcode == 0x99)
+            return E::Avx512;
+        if (wide && pp == PP_66 && IsVexIntegerOpcode(opcode))
+            return E::Avx2;
+        if (wide && opcode == 0x70)
+            return E::Avx2;
+        return E::Avx;
+    case 2:
+        if (opcode == 0xf2 || opcode == 0xf3 || (opcode == 0xf7 && pp == PP_NONE))
+            return E::Bmi1;
+        if (opcode >= 0xf5 && opcode <= 0xf7)
+            return E::Bmi2;
+        if (opcode == 0x13)
+            return E::F16c;
+        if (opcode >= 0x96 && opcode <= 0xbf && (opcode & 0x0f) >= 6)
+            return E::Fma;
+        if (opcode == 0x16 || opcode == 0x36 || (opcode >= 0x45 && opcode <= 0x47) ||
+            (opcode >= 0x58 && opcode <= 0x5a) || opcode == 0x78 || opcode == 0x79 || opcode == 0x8c ||
+            opcode == 0x8e || (opcode >= 0x90 && opcode <= 0x93))
+            return E::Avx2;
+        if ((opcode >= 0x50 && opcode <= 0x53) || (opcode >= 0xb0 && opcode <= 0xb5) || opcode == 0x49 ||
+            opcode == 0x4b || (opcode >= 0x5c && opcode <= 0x5e) || opcode == 0xcf ||
+            (opcode >= 0xdc && opcode <= 0xdf))
+            return E::Other; // AVX-VNNI, AVX-IFMA, AVX-NE-CONVERT, AMX, GFNI and VAES
+        if (wide && (opcode <= 0x0b || (opcode >= 0x1c && opcode <= 0x1e) || (opcode >= 0x20 && opcode <= 0x25) ||
+                     (opcode >= 0x28 && opcode <= 0x2b) || (opcode >= 0x30 && opcode <= 0x35) ||
+                     (opcode >= 0x37 && opcode <= 0x40)))
+            return E::Avx2;
+        return E::Avx;
+    case 3:
+        if (opcode == 0xf0)
+            return E::Bmi2;
+        if (opcode == 0x1d)
+            return E::F16c;
+        if (opcode >= 0x30 && opcode <= 0x33)
+            return E::Avx512;
+        if (opcode <= 0x02 || opcode == 0x38 || opcode == 0x39 || opcode == 0x46)
+            return E::Avx2;
+        if (wide && (opcode == 0x0e || opcode == 0x0f || opcode == 0x42 || opcode == 0x4c))
+            return E::Avx2;
+        if (opcode == 0x44)
+            return wide ? E::Other : E::Pclmul;
+        if (opcode == 0xce || opcode == 0xcf || opcode == 0xdf)
+            return E::Other;
+        return E::Avx;
+    default:
+        return E::Avx;
+    }
+}
+
+/**
+ * @brief Classifies one instruction by the extension that introduced it. Only the prefixes, the opcode and, for the
+ * 0F C7 group, the ModRM byte are looked at, so the cost is a few table lookups on top of decoding.
+ *
+ * @param instruction The bytes of an instruction accepted by DecodeX86Instruction, at least its length long.
+ * @return The extension; undefined encodings classify like their neighbours.
+ */
+X86IsaExtension ClassifyX86Instruction(std::span<const uint8_t> instruction)
+{
+    const uint8_t *bytes = instruction.data();
+    size_t i = 0;
+    uint8_t pp = PP_NONE;
+    bool operandSize = false;
+    uint8_t rex = 0;
+    while (true)
+    {
+        uint8_t kind = PREFIX_KINDS[bytes[i]];
+        if (kind == PrefixKind::NONE)
+            break;
+        if (kind == PrefixKind::REX)
+        {
+            rex = bytes[i++];
+            continue;
+        }
+        operandSize |= kind == PrefixKind::OPERAND_SIZE;
+        pp = kind == PrefixKind::REPEAT ? (bytes[i] == 0xf3 ? PP_F3 : PP_F2) : pp;
+        rex = 0;
+        i++;
+    }
+    if (pp == PP_NONE && operandSize)
+        pp = PP_66;
+
+    uint8_t opcode = bytes[i];
+    switch (opcode)
+    {
+    case 0x0f:
+        break;
+    case 0x9e:
+    case 0x9f:
+        return X86IsaExtension::LahfSahf;
+    case 0xc5:
+        return ClassifyVex(1, bytes[i + 2], bytes[i + 1] & 3, bytes[i + 1] & 4);
+    case 0xc4:
+        return ClassifyVex(bytes[i + 1] & 0x1f, bytes[i + 3], bytes[i + 2] & 3, bytes[i + 2] & 4);
+    case 0x62:
+        return X86IsaExtension::Avx512;
+    default:
+        return X86IsaExtension::Base;
+    }
+
+    opcode = bytes[i + 1];
+    if (opcode == 0x38)
+        return THREE_BYTE_38_EXTENSIONS[pp][bytes[i + 2]];
+    if (opcode == 0x3a)
+        return THREE_BYTE_3A_EXTENSIONS[pp][bytes[i + 2]];
+    if (opcode == 0xc7)
+    {
+        // Group 9: cmpxchg16b is /1 with REX.W, rdrand and rdseed are /6 and /7 on a register
+        uint8_t modrm = bytes[i + 2];
+        uint8_t reg = (modrm >> 3) & 7;
+        bool memory = (modrm >> 6) != 3;
+        if (reg == 1 && memory && (rex & 0x08))
+            return X86IsaExtension::Cx16;
+        if (reg >= 6 && !memory && pp == PP_NONE)
+            return X86IsaExtension::Other;
+        return X86IsaExtension::Base;
+    }
+    return TWO_BYTE_EXTENSIONS[pp][opcode];
+}
+
+/**
+ * @brief Returns the x86-64 level an extension belongs to, 1 for the baseline up to 4, or 0 for extensions that no
+ * level includes.
+ */
+uint8_t X86IsaExtensionLevel(X86IsaExtension extension)
+{
+    return EXTENSION_LEVELS[static_cast<size_t>(extension)];
+}
+
+/**
+ * @brief Returns the lowest x86-64 level providing every extension of a set; extensions outside the levels are
+ * ignored.
+ *
+ * @param extensions Bit n set for X86IsaExtension n.
+ */
+uint8_t X86IsaLevel(uint32_t extensions)
+{
+    uint8_t level = X86_ISA_LEVEL_BASELINE;
+    for (size_t i = 0; i < X86_ISA_EXTENSION_COUNT; i++)
+    {
+        if (extensions & (1u << i))
+        {
+            level = std::max(level, EXTENSION_LEVELS[i]);
+        }
+    }
+    return level;
+}
+
+/**
+ * @brief Returns the highest level recorded in a GNU_PROPERTY_X86_ISA_1_* bitmask, counting an empty mask as the
+ * baseline.
+ */
+static uint8_t NoteLevel(uint64_t value)
+{
+    if (value & GnuPropertyFlags::X86_ISA_1_V4)
+        return 4;
+    if (value & GnuPropertyFlags::X86_ISA_1_V3)
+        return 3;
+    return (value & GnuPropertyFlags::X86_ISA_1_V2) ? 2 : X86_ISA_LEVEL_BASELINE;
+}
+
+// Stretch of code swept by the scanner, a function or the space between functions
+struct IsaRange
+{
+    uint64_t address;
+    uint64_t size;
+    uint32_t sectionIndex;
+    uint32_t function; // Index in the function list, or UINT32_MAX outside any function
+};
+
+/**
+ * @brief Constructor for the X86IsaProfile class. Reads the ISA level notes and scans the executable sections.
+ *
+ * @param elfHandler The parsed file, which must outlive this object.
+ * @param segments The program headers of the same file, for the notes.
+ * @param pool The pool to spread the functions over, or nullptr to scan on the calling thread.
+ * @throws std::runtime_error If the file is not x86-64.
+ */
+X86IsaProfile::X86IsaProfile(const ElfHandler &elfHandler, const ElfSegments &segments, ThreadPool *pool)
+    : _fileName(elfHandler.GetFileName()), _functions(elfHandler)
+{
+    if (elfHandler.GetMachine() != static_cast<uint16_t>(ElfMachine::EM_X86_64))
+        LOG_THROW(Logger::LogLevel::Error, "ISA scanning needs an x86-64 file, machine is %u",
+                  elfHandler.GetMachine());
+
+    ElfNotes notes(segments);
+    if (std::optional<uint64_t> needed = notes.GetProperty(GNU_PROPERTY_X86_ISA_1_NEEDED))
+    {
+        _neededNoteLevel = NoteLevel(*needed);
+    }
+    if (std::optional<uint64_t> used = notes.GetProperty(GNU_PROPERTY_X86_ISA_1_USED))
+    {
+        _usedNoteLevel = NoteLevel(*used);
+    }
+    Scan(elfHandler, pool);
+}
+
+const CodeFunctions &X86IsaProfile::GetFunctions() const
+{
+    return _functions;
+}
+
+uint32_t X86IsaProfile::GetExtensions() const
+{
+    return _extensions;
+}
+
+uint32_t X86IsaProfile::GetFunctionExtensions(uint32_t function) const
+{
+    return _functionExtensions[function];
+}
+
+uint8_t X86IsaProfile::GetLevel() const
+{
+    return X86IsaLevel(_extensions);
+}
+
+const std::array<uint64_t, X86_ISA_EXTENSION_COUNT> &X86IsaProfile::GetInstructionCounts() const
+{
+    return _instructionCounts;
+}
+
+std::optional<uint8_t> X86IsaProfile::GetNeededNoteLevel() const
+{
+    return _neededNoteLevel;
+}
+
+std::optional<uint8_t> X86IsaProfile::GetUsedNoteLevel() const
+{
+    return _usedNoteLevel;
+}
+
+/**
+ * @brief Compares the level of the code with the level of a note.
+ *
+ * @param noteLevel The level from GetNeededNoteLevel or GetUsedNoteLevel.
+ */
+IsaNoteCheck X86IsaProfile::CheckNote(std::optional<uint8_t> noteLevel) const
+{
+    if (!noteLevel.has_value())
+        return IsaNoteCheck::Absent;
+    uint8_t level = GetLevel();
+    if (level > *noteLevel)
+        return IsaNoteCheck::CodeHigher;
+    return level < *noteLevel ? IsaNoteCheck::NoteHigher : IsaNoteCheck::Match;
+}
+
+/**
+ * @brief Prints the level of the file with both note checks, then the instruction count of every extension in use,
+ * then every function needing more than the baseline or using an extension outside the levels, in address order:
+ * level, address, name and the extensions above the baseline.
+ */
+void X86IsaProfile::PrintReport() const
+{
+    auto noteName = [](std::optional<uint8_t> level) { return level.has_value() ? X86IsaLevelName(*level) : "-"; };
+    printf("level=%s needed=%s(%s) used=%s(%s) %s\n", X86IsaLevelName(GetLevel()), noteName(_neededNoteLevel),
+           IsaNoteCheckName(CheckNote(_neededNoteLevel)), noteName(_usedNoteLevel),
+           IsaNoteCheckName(CheckNote(_usedNoteLevel)), _fileName.c_str());
+
+    for (size_t i = 0; i < X86_ISA_EXTENSION_COUNT; i++)
+    {
+        if (_instructionCounts[i] != 0)
+        {
+            printf("  %-9s %lu\n", X86IsaExtensionName(static_cast<X86IsaExtension>(i)), _instructionCounts[i]);
+        }
+    }
+
+    const std::vector<CodeFunction> &functions = _functions.GetFunctions();
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        uint32_t notable = 0;
+        for (size_t extension = 0; extension < X86_ISA_EXTENSION_COUNT; extension++)
+        {
+            if ((_functionExtensions[i] & (1u << extension)) && EXTENSION_LEVELS[extension] != X86_ISA_LEVEL_BASELINE)
+            {
+                notable |= 1u << extension;
+            }
+        }
+        if (notable == 0)
+        {
+            continue;
+        }
+
+        std::string names;
+        for (size_t extension = 0; extension < X86_ISA_EXTENSION_COUNT; extension++)
+        {
+            if (notable & (1u << extension))
+            {
+                names += names.empty() ? "" : ",";
+                names += X86IsaExtensionName(static_cast<X86IsaExtension>(extension));
+            }
+        }
+        printf("  %-15s 0x%lx %s %s\n", X86IsaLevelName(X86IsaLevel(_functionExtensions[i])), functions[i].address,
+               functions[i].name.empty() ? "-" : functions[i].name.c_str(), names.c_str());
+    }
+}
+
+/**
+ * @brief Splits the executable sections into functions and the stretches between them, and decodes them in batches
+ * of consecutive ranges. Each batch counts into its own array and writes the extension set of its own functions;
+ * the counts are summed once every batch is done, so no locks are taken.
+ *
+ * @param elfHandler The parsed file.
+ * @param pool The pool to spread the batches over, or nullptr.
+ */
+void X86IsaProfile::Scan(const ElfHandler &elfHandler, ThreadPool *pool)
+{
+    const std::vector<CodeFunction> &functions = _functions.GetFunctions();
+    _functionExtensions.assign(functions.size(), 0);
+
+    std::vector<IsaRange> ranges;
+    for (const ElfSection &section : elfHandler.GetSections())
+    {
+        if ((section.flags & SectionHeaderFlags::SHF_EXECINSTR) == 0 ||
+            section.type == static_cast<uint32_t>(SectionHeaderType::SHT_NOBITS))
+        {
+            continue;
+        }
+        uint64_t cursor = section.addr;
+        uint64_t end = section.addr + section.size;
+        auto it =
+            std::lower_bound(functions.begin(), functions.end(), section.addr,
+                             [](const CodeFunction &function, uint64_t value) { return function.address < value; });
+        for (; it != functions.end() && it->address < end; ++it)
+        {
+            if (it->address > cursor)
+            {
+                ranges.push_back({cursor, it->address - cursor, section.index, UINT32_MAX});
+            }
+            ranges.push_back({it->address, it->size, it->sectionIndex, static_cast<uint32_t>(it - functions.begin())});
+            cursor = std::max(cursor, it->address + it->size);
+        }
+        if (cursor < end)
+        {
+            ranges.push_back({cursor, end - cursor, section.index, UINT32_MAX});
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> batches;
+    uint64_t batchBytes = 0;
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        if (batches.empty() || batchBytes >= CODE_FUNCTION_BATCH_SIZE)
+        {
+            batches.emplace_back(i, i);
+            batchBytes = 0;
+        }
+        batches.back().second = i + 1;
+        batchBytes += ranges[i].size;
+    }
+
+    std::vector<std::array<uint64_t, X86_ISA_EXTENSION_COUNT>> batchCounts(batches.size());
+    auto scanBatch = [&](size_t batch) {
+        std::array<uint64_t, X86_ISA_EXTENSION_COUNT> &counts = batchCounts[batch];
+        counts.fill(0);
+        for (size_t r = batches[batch].first; r < batches[batch].second; r++)
+        {
+            const IsaRange &range = ranges[r];
+            std::span<const uint8_t> code = _functions.GetCode(range.sectionIndex, range.address, range.size);
+            uint32_t extensions = 0;
+            size_t offset = 0;
+            while (offset < code.size())
+            {
+                X86Instruction instruction;
+                if (!DecodeX86Instruction(code.subspan(offset), instruction))
+                {
+                    offset++;
+                    continue;
+                }
+                X86IsaExtension extension = ClassifyX86Instruction(code.subspan(offset, instruction.length));
+                counts[static_cast<size_t>(extension)]++;
+                extensions |= 1u << static_cast<size_t>(extension);
+                offset += instruction.length;
+            }
+            if (range.function != UINT32_MAX)
+            {
+                _functionExtensions[range.function] = extensions;
+            }
+        }
+    };
+
+    if (pool == nullptr)
+    {
+        for (size_t i = 0; i < batches.size(); i++)
+        {
+            scanBatch(i);
+        }
+    }
+    else
+    {
+        TaskGroup group(*pool);
+        for (size_t i = 0; i < batches.size(); i++)
+        {
+            group.Submit([&scanBatch, i]() { scanBatch(i); });
+        }
+        group.Wait();
+    }
+
+    for (const auto &counts : batchCounts)
+    {
+        for (size_t i = 0; i < X86_ISA_EXTENSION_COUNT; i++)
+        {
+            _instructionCounts[i] += counts[i];
+            _extensions |= counts[i] != 0 ? 1u << i : 0;
+        }
+    }
+}
+
+const char *X86IsaExtensionName(X86IsaExtension extension)
+{
+    static const char *const names[X86_ISA_EXTENSION_COUNT] = {
+        "base", "sse",  "sse2", "sse3",  "ssse3", "sse4.1", "sse4.2", "popcnt", "cx16", "lahf-sahf", "avx", "avx2",
+        "fma",  "f16c", "bmi1", "bmi2", "lzcnt", "movbe",  "avx512", "aes",    "pclmul", "sha",     "other"};
+    return names[static_cast<size_t>(extension)];
+}
+
+const char *X86IsaLevelName(uint8_t level)
+{
+    switch (level)
+    {
+    case 1:
+        return "x86-64-baseline";
+    case 2:
+        return "x86-64-v2";
+    case 3:
+        return "x86-64-v3";
+    case 4:
+        return "x86-64-v4";
+    default:
+        return "none";
+    }
+}
+
+const char *IsaNoteCheckName(IsaNoteCheck check)
+{
+    switch (check)
+    {
+    case IsaNoteCheck::Match:
+        return "match";
+    case IsaNoteCheck::CodeHigher:
+        return "code-higher";
+    case IsaNoteCheck::NoteHigher:
+        return "note-higher";
+    default:
+        return "absent";
+    }
+}